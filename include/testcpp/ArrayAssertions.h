@@ -0,0 +1,224 @@
+#ifndef TESTCPP_ARRAYASSERTIONS_H__
+#define TESTCPP_ARRAYASSERTIONS_H__
+
+#include <testcpp/testcpp.h>
+#include <testcpp/detail/ArrayCompare.h>
+
+#include <limits>
+
+namespace Test
+{
+
+/**
+ * How far floating point elements may differ in assertAllClose. An element
+ * is close when it equals the expected value or is within any of the
+ * non-zero limits. Non-finite values are only close to equal values, NaN
+ * to nothing.
+ */
+struct Tolerance
+{
+    explicit Tolerance(double absolute_ = 0, double relative_ = 0,
+            unsigned ulps_ = 0) :
+        absolute(absolute_),
+        relative(relative_),
+        ulps(ulps_)
+    { }
+
+    static Tolerance absoluteError(double error)
+    { return Tolerance(error); }
+
+    static Tolerance relativeError(double error)
+    { return Tolerance(0, error); }
+
+    static Tolerance ulpDistance(unsigned ulps)
+    { return Tolerance(0, 0, ulps); }
+
+    /** Limit of |actual - expected|. */
+    double absolute;
+
+    /** Limit of |actual - expected| / max(|actual|, |expected|). */
+    double relative;
+
+    /** Number of representable values between actual and expected. */
+    unsigned ulps;
+};
+
+namespace detail
+{
+
+template <typename T>
+struct IsBitwiseComparable
+{ static const bool result = false; };
+
+#define TESTCPP_BITWISE_COMPARABLE(type__) \
+    template <> struct IsBitwiseComparable<type__> \
+    { static const bool result = true; };
+
+TESTCPP_BITWISE_COMPARABLE(char)
+TESTCPP_BITWISE_COMPARABLE(signed char)
+TESTCPP_BITWISE_COMPARABLE(unsigned char)
+TESTCPP_BITWISE_COMPARABLE(short)
+TESTCPP_BITWISE_COMPARABLE(unsigned short)
+TESTCPP_BITWISE_COMPARABLE(int)
+TESTCPP_BITWISE_COMPARABLE(unsigned int)
+TESTCPP_BITWISE_COMPARABLE(long)
+TESTCPP_BITWISE_COMPARABLE(unsigned long)
+TESTCPP_BITWISE_COMPARABLE(long long)
+TESTCPP_BITWISE_COMPARABLE(unsigned long long)
+
+#undef TESTCPP_BITWISE_COMPARABLE
+
+template <bool IsBitwise>
+struct ArrayComparator
+{
+    template <typename T>
+    static void compare(const T* a, const T* b, size_t count,
+            ArrayMismatches& mismatches)
+    {
+        for (size_t i = 0; i < count; ++i)
+            if (!(a[i] == b[i]))
+                mismatches.add(i);
+    }
+};
+
+template <>
+struct ArrayComparator<true>
+{
+    template <typename T>
+    static void compare(const T* a, const T* b, size_t count,
+            ArrayMismatches& mismatches)
+    { compareBytes(a, b, sizeof(T), count, mismatches); }
+};
+
+template <typename T>
+void compareArrays(const T* a, const T* b, size_t count,
+        ArrayMismatches& mismatches)
+{
+    ArrayComparator<IsBitwiseComparable<T>::result>::compare(a, b, count,
+            mismatches);
+}
+
+inline void compareArrays(const float* a, const float* b, size_t count,
+        ArrayMismatches& mismatches)
+{ compareFloats(a, b, count, Tolerance(), mismatches); }
+
+inline void compareArrays(const double* a, const double* b, size_t count,
+        ArrayMismatches& mismatches)
+{ compareDoubles(a, b, count, Tolerance(), mismatches); }
+
+/** Only called on failure, floating point values with full precision. */
+template <typename T>
+void reportArrayMismatches(AssertionContext& c, const T* actual,
+        const T* expected, size_t count, const ArrayMismatches& mismatches)
+{
+    typedef std::numeric_limits<T> Limits;
+    const bool isFloatingPoint = Limits::is_specialized && !Limits::is_integer;
+
+    std::ostringstream summary;
+    summary << mismatches.count << " of " << count << " elements differ";
+    if (isFloatingPoint)
+        summary << ", max absolute error " << mismatches.maxError;
+    if (mismatches.count > mismatches.numIndices())
+        summary << ", the first " << mismatches.numIndices() << " follow";
+    c.onAssertFailureDetail(summary.str());
+
+    for (size_t i = 0; i < mismatches.numIndices(); ++i) {
+        const size_t index = mismatches.indices[i];
+
+        std::ostringstream detail;
+        if (isFloatingPoint)
+            detail.precision(Limits::digits10 + 3);
+        detail << std::boolalpha << "index " << index << ", values: ";
+        formatValue(detail, actual[index]);
+        detail << " and ";
+        formatValue(detail, expected[index]);
+        c.onAssertFailureDetail(detail.str());
+    }
+}
+
+}
+
+/**
+ * Compares count elements of two contiguous arrays with operator==. Integer
+ * and floating point arrays are compared with vectorized kernels.
+ */
+template <typename T>
+void assertArrayEqualImpl(const AssertSite& site,
+        const T* actual, const T* expected, size_t count)
+{
+    AssertionContext& c = Controller::currentContext();
+    c.beforeAssert(site);
+
+    detail::ArrayMismatches mismatches;
+    detail::compareArrays(actual, expected, count, mismatches);
+
+    c.afterAssert(mismatches.count == 0);
+    if (mismatches.count)
+        detail::reportArrayMismatches(c, actual, expected, count, mismatches);
+}
+
+inline void assertAllCloseImpl(const AssertSite& site,
+        const float* actual, const float* expected, size_t count,
+        const Tolerance& tolerance)
+{
+    AssertionContext& c = Controller::currentContext();
+    c.beforeAssert(site);
+
+    detail::ArrayMismatches mismatches;
+    detail::compareFloats(actual, expected, count, tolerance, mismatches);
+
+    c.afterAssert(mismatches.count == 0);
+    if (mismatches.count)
+        detail::reportArrayMismatches(c, actual, expected, count, mismatches);
+}
+
+inline void assertAllCloseImpl(const AssertSite& site,
+        const double* actual, const double* expected, size_t count,
+        const Tolerance& tolerance)
+{
+    AssertionContext& c = Controller::currentContext();
+    c.beforeAssert(site);
+
+    detail::ArrayMismatches mismatches;
+    detail::compareDoubles(actual, expected, count, tolerance, mismatches);
+
+    c.afterAssert(mismatches.count == 0);
+    if (mismatches.count)
+        detail::reportArrayMismatches(c, actual, expected, count, mismatches);
+}
+
+}
+
+#define TESTCPP_GET_MACRO_OVERLOAD5(_1, _2, _3, _4, _5, NAME, ...) NAME
+
+#define assertArrayEqual1(actual__, expected__, count__) \
+    TESTCPP_STATEMENT( \
+        TESTCPP_STATIC_ASSERT_SITE("assertArrayEqual", \
+            #actual__ " == " #expected__); \
+        Test::assertArrayEqualImpl(site__, (actual__), (expected__), (count__)); )
+
+#define assertArrayEqual2(label__, actual__, expected__, count__) \
+    Test::assertArrayEqualImpl(TESTCPP_ASSERT_SITE("assertArrayEqual", label__), \
+            (actual__), (expected__), (count__))
+
+#define assertArrayEqual(...) \
+    EXPAND_MACRO(TESTCPP_GET_MACRO_OVERLOAD5(__VA_ARGS__, _, \
+            assertArrayEqual2, assertArrayEqual1, _)(__VA_ARGS__))
+
+
+#define assertAllClose1(actual__, expected__, count__, tolerance__) \
+    TESTCPP_STATEMENT( \
+        TESTCPP_STATIC_ASSERT_SITE("assertAllClose", \
+            #actual__ " close to " #expected__); \
+        Test::assertAllCloseImpl(site__, (actual__), (expected__), (count__), \
+            (tolerance__)); )
+
+#define assertAllClose2(label__, actual__, expected__, count__, tolerance__) \
+    Test::assertAllCloseImpl(TESTCPP_ASSERT_SITE("assertAllClose", label__), \
+            (actual__), (expected__), (count__), (tolerance__))
+
+#define assertAllClose(...) \
+    EXPAND_MACRO(TESTCPP_GET_MACRO_OVERLOAD5(__VA_ARGS__, \
+            assertAllClose2, assertAllClose1, _)(__VA_ARGS__))
+
+#endif /* TESTCPP_ARRAYASSERTIONS_H */
@@ -0,0 +1,144 @@
+#ifndef TESTCPP_ASSERTBATCH_H__
+#define TESTCPP_ASSERTBATCH_H__
+
+#include <testcpp/testcpp.h>
+
+#include <utilcpp/disable_copy.h>
+
+#include <deque>
+
+namespace Test
+{
+
+/**
+ * Aggregates assertions made in tight loops. A passing check only
+ * increments a counter of its call site, a failing one keeps its index and
+ * values up to the given number of failures per site. When the batch goes
+ * out of scope, each call site is reported to the observer as a single
+ * assertion:
+ *
+ *   {
+ *       Test::AssertBatch batch;
+ *       for (size_t i = 0; i < output.size(); ++i)
+ *           assertBatchEqual(batch, i, output[i], expected[i]);
+ *   }
+ *
+ * A batch belongs to the assertion context that is current when it is
+ * created and must only be used on that thread.
+ */
+class AssertBatch
+{
+    UTILCPP_DISABLE_COPY(AssertBatch)
+
+public:
+    explicit AssertBatch(size_t maxRecordedFailures = 10);
+
+    /** Reports the results that have not been reported yet. */
+    ~AssertBatch();
+
+    /** Reports the results so far and starts over. */
+    void report();
+
+    void checkTrue(const AssertSite& site, size_t index, bool ok)
+    {
+        SiteResult& result = siteResult(site);
+        ++result.checks;
+        if (!ok && result.failures++ < _maxRecordedFailures)
+            recordFailure(result, index, std::string());
+    }
+
+    template <typename FirstCompareType, typename SecondCompareType>
+    void checkEqual(const AssertSite& site, size_t index,
+            const FirstCompareType& a, const SecondCompareType& b)
+    {
+        SiteResult& result = siteResult(site);
+        ++result.checks;
+        if (!(a == b) && result.failures++ < _maxRecordedFailures)
+            recordFailure(result, index, detail::formatValues(a, b));
+    }
+
+    template <typename FirstCompareType, typename SecondCompareType>
+    void checkNotEqual(const AssertSite& site, size_t index,
+            const FirstCompareType& a, const SecondCompareType& b)
+    {
+        SiteResult& result = siteResult(site);
+        ++result.checks;
+        if (!(a != b) && result.failures++ < _maxRecordedFailures)
+            recordFailure(result, index, detail::formatValues(a, b));
+    }
+
+private:
+    struct RecordedFailure
+    {
+        size_t index;
+        std::string values;
+    };
+
+    struct SiteResult
+    {
+        const AssertSite* site;
+        unsigned long checks;
+        unsigned long failures;
+        std::vector<RecordedFailure> recordedFailures;
+    };
+
+    enum { SITE_CACHE_SIZE = 16 };
+
+    /**
+     * Call sites are static, a loop body uses a few of them. Each has a
+     * slot in a small cache, selected by its address.
+     */
+    static size_t siteCacheSlot(const AssertSite& site)
+    {
+        return (reinterpret_cast<size_t>(&site) / sizeof(AssertSite))
+            % SITE_CACHE_SIZE;
+    }
+
+    SiteResult& siteResult(const AssertSite& site)
+    {
+        SiteResult* cached = _siteCache[siteCacheSlot(site)];
+        if (cached && cached->site == &site)
+            return *cached;
+        return findSiteResult(site);
+    }
+
+    SiteResult& findSiteResult(const AssertSite& site);
+    void clearSiteCache();
+
+    void recordFailure(SiteResult& result, size_t index,
+            const std::string& values);
+
+    AssertionContext& _context;
+    const unsigned long _maxRecordedFailures;
+
+    // in order of the first check, addresses stay valid on push_back
+    std::deque<SiteResult> _results;
+    SiteResult* _siteCache[SITE_CACHE_SIZE];
+};
+
+}
+
+// Batched assertions take the batch and the index of the check, e.g. the
+// loop counter. Labels are generated, the call site must be static.
+
+#define assertBatchTrue(batch__, index__, ok__) \
+    TESTCPP_STATEMENT( \
+        TESTCPP_STATIC_ASSERT_SITE("assertBatchTrue", #ok__); \
+        (batch__).checkTrue(site__, (index__), (ok__)); )
+
+#define assertBatchFalse(batch__, index__, ok__) \
+    TESTCPP_STATEMENT( \
+        TESTCPP_STATIC_ASSERT_SITE("assertBatchFalse", "!("#ok__")"); \
+        (batch__).checkTrue(site__, (index__), !(ok__)); )
+
+#define assertBatchEqual(batch__, index__, a__, b__) \
+    TESTCPP_STATEMENT( \
+        TESTCPP_STATIC_ASSERT_SITE("assertBatchEqual", #a__ " == " #b__); \
+        (batch__).checkEqual(site__, (index__), (a__), (b__)); )
+
+#define assertBatchNotEqual(batch__, index__, a__, b__) \
+    TESTCPP_STATEMENT( \
+        TESTCPP_STATIC_ASSERT_SITE("assertBatchNotEqual", #a__ " != " #b__); \
+        (batch__).checkNotEqual(site__, (index__), (a__), (b__)); )
+
+#endif /* TESTCPP_ASSERTBATCH_H */
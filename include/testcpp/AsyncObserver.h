@@ -0,0 +1,91 @@
+#ifndef TESTCPP_ASYNCOBSERVER_H__
+#define TESTCPP_ASYNCOBSERVER_H__
+
+#include <testcpp/detail/config.h>
+
+#ifdef TESTCPP_HAVE_THREADS
+
+#include <testcpp/detail/EventRecorder.h>
+
+#include <memory>
+
+namespace Test
+{
+
+/**
+ * AsyncObserver moves formatting and output of another observer off the
+ * test thread. Events are encoded into a fixed-size lock-free
+ * single-producer single-consumer ring buffer and a background thread
+ * replays them to the wrapped observer:
+ *
+ *   c.setObserver(new Test::AsyncObserver(new Test::ColoredStdOutView));
+ *
+ * When the ring is full, the BLOCK policy waits for the background thread
+ * while DROP_PASSING_EVENTS discards the events of passing assertions and
+ * waits only for everything else. All events are delivered before
+ * onAllTestSuitesEnd() returns.
+ *
+ * Events must not be delivered concurrently, which the controller
+ * guarantees. A copy in a forked process, like a worker of an isolated
+ * run, leaves the wrapped observer to the parent. Requires C++11 threads.
+ */
+class AsyncObserver : public EventRecorder
+{
+public:
+    enum BackpressurePolicy { BLOCK, DROP_PASSING_EVENTS };
+
+    /** Takes ownership of observer. */
+    explicit AsyncObserver(Observer* observer,
+            BackpressurePolicy policy = BLOCK,
+            size_t ringBytes = 1024 * 1024);
+
+    virtual ~AsyncObserver();
+
+    /** Number of passing assertions dropped under DROP_PASSING_EVENTS. */
+    unsigned long droppedAssertions() const;
+
+    /** Waits until the background thread has delivered all events. */
+    void drain();
+
+    virtual unsigned subscribedEvents() const
+    { return _observer->subscribedEvents(); }
+
+    virtual void onAssertBegin(const AssertSite& site);
+
+    virtual void onAssertEnd(bool ok);
+    virtual void onAssertExceptionEndWithExpectedException(const std::exception& e);
+    virtual void onAssertExceptionEndWithUnexpectedException(const std::exception& e);
+    virtual void onAssertExceptionEndWithEllipsisException();
+    virtual void onAssertNoExceptionEndWithStdException(const std::exception& e);
+    virtual void onAssertNoExceptionEndWithEllipsisException();
+
+    virtual void onAllTestSuitesEnd(int lastTestSuiteNum,
+            int testSuitesNumTotal, int numErrs, int numExcepts);
+
+protected:
+    virtual void eventRecorded();
+
+private:
+    void endAssert(bool ok);
+    void publish(bool droppable);
+
+    class Worker;
+
+    std::unique_ptr<Observer> _observer;
+    BackpressurePolicy _policy;
+
+    /** Defers publishing while an assertion begin or end is recorded. */
+    bool _deferPublish;
+
+    /** The buffer holds the begin of an assertion that has not ended. */
+    bool _assertPending;
+
+    unsigned long _droppedAssertions;
+    std::unique_ptr<Worker> _worker;
+};
+
+}
+
+#endif /* TESTCPP_HAVE_THREADS */
+
+#endif /* TESTCPP_ASYNCOBSERVER_H */
@@ -0,0 +1,411 @@
+#ifndef TESTCPP_ASYNCTEST_H__
+#define TESTCPP_ASYNCTEST_H__
+
+#include <testcpp/testcpp.h>
+
+#ifdef TESTCPP_HAVE_ASYNC_TESTS
+
+#include <testcpp/SharedFixture.h>
+#include <testcpp/TestCases.h>
+#include <testcpp/detail/Clock.h>
+#include <testcpp/detail/EventLoop.h>
+
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <future>
+#include <string>
+
+namespace Test
+{
+
+/**
+ * The return type of async test cases and of the coroutines that they
+ * await. Starts when awaited, an exception that the coroutine throws is
+ * rethrown in the awaiting coroutine.
+ */
+class AsyncTask
+{
+public:
+    class promise_type
+    {
+    public:
+        promise_type() :
+            continuation(),
+            exception(),
+            caseState(0)
+        { }
+
+        AsyncTask get_return_object()
+        {
+            return AsyncTask(
+                    std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept
+        { return std::suspend_always(); }
+
+        struct FinalAwaiter
+        {
+            bool await_ready() noexcept
+            { return false; }
+
+            std::coroutine_handle<> await_suspend(
+                    std::coroutine_handle<promise_type> handle) noexcept
+            {
+                promise_type& promise = handle.promise();
+                if (promise.continuation)
+                    return promise.continuation;
+                if (promise.caseState)
+                    promise.caseState->done = true;
+                return std::noop_coroutine();
+            }
+
+            void await_resume() noexcept
+            { }
+        };
+
+        FinalAwaiter final_suspend() noexcept
+        { return FinalAwaiter(); }
+
+        void return_void()
+        { }
+
+        void unhandled_exception()
+        { exception = std::current_exception(); }
+
+        std::coroutine_handle<> continuation;
+        std::exception_ptr exception;
+
+        /** Set for the coroutine of the test case itself. */
+        detail::AsyncCaseState* caseState;
+    };
+
+    AsyncTask() :
+        _handle()
+    { }
+
+    AsyncTask(AsyncTask&& other) noexcept :
+        _handle(other._handle)
+    { other._handle = std::coroutine_handle<promise_type>(); }
+
+    AsyncTask& operator=(AsyncTask&& other) noexcept
+    {
+        if (this != &other) {
+            destroy();
+            _handle = other._handle;
+            other._handle = std::coroutine_handle<promise_type>();
+        }
+        return *this;
+    }
+
+    ~AsyncTask()
+    { destroy(); }
+
+    bool await_ready() const noexcept
+    { return false; }
+
+    std::coroutine_handle<> await_suspend(
+            std::coroutine_handle<> caller) noexcept
+    {
+        _handle.promise().continuation = caller;
+        return _handle;
+    }
+
+    void await_resume()
+    {
+        if (_handle.promise().exception)
+            std::rethrow_exception(_handle.promise().exception);
+    }
+
+    /** Runs the task as a test case on the loop, see AsyncCaseState. */
+    void start(detail::EventLoop& loop, detail::AsyncCaseState& caseState)
+    {
+        _handle.promise().caseState = &caseState;
+        loop.start(_handle, caseState);
+    }
+
+    /** The exception that ended the task, null if there was none. */
+    std::exception_ptr exception() const
+    { return _handle.promise().exception; }
+
+private:
+    explicit AsyncTask(std::coroutine_handle<promise_type> handle) :
+        _handle(handle)
+    { }
+
+    AsyncTask(const AsyncTask&);
+    AsyncTask& operator=(const AsyncTask&);
+
+    void destroy()
+    {
+        if (_handle)
+            _handle.destroy();
+    }
+
+    std::coroutine_handle<promise_type> _handle;
+};
+
+namespace detail
+{
+
+class SleepAwaiter
+{
+    UTILCPP_DISABLE_COPY(SleepAwaiter)
+
+public:
+    explicit SleepAwaiter(double seconds) :
+        _deadline(monotonicSeconds() + seconds),
+        _wait()
+    { }
+
+    bool await_ready() const
+    { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    { EventLoop::current().waitUntil(_deadline, _wait, handle); }
+
+    void await_resume()
+    { }
+
+private:
+    double _deadline;
+    AsyncWait _wait;
+};
+
+class FdAwaiter
+{
+    UTILCPP_DISABLE_COPY(FdAwaiter)
+
+public:
+    FdAwaiter(int fd, EventLoop::FdEvent event, double timeoutSeconds) :
+        _fd(fd),
+        _event(event),
+        _deadline(timeoutSeconds > 0 ? monotonicSeconds() + timeoutSeconds : 0),
+        _wait()
+    { }
+
+    bool await_ready() const
+    { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    { EventLoop::current().waitForFd(_fd, _event, _deadline, _wait, handle); }
+
+    /** False if the timeout expired before the descriptor was ready. */
+    bool await_resume()
+    { return !_wait.timedOut; }
+
+private:
+    int _fd;
+    EventLoop::FdEvent _event;
+    double _deadline;
+    AsyncWait _wait;
+};
+
+template <typename ValueType>
+bool isFutureReady(const void* future)
+{
+    return static_cast<const std::future<ValueType>*>(future)->wait_for(
+            std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+template <typename ValueType>
+class FutureAwaiter
+{
+    UTILCPP_DISABLE_COPY(FutureAwaiter)
+
+public:
+    explicit FutureAwaiter(std::future<ValueType>& future) :
+        _future(future),
+        _wait()
+    { }
+
+    bool await_ready() const
+    { return isFutureReady<ValueType>(&_future); }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        EventLoop::current().waitForFuture(&isFutureReady<ValueType>,
+                &_future, _wait, handle);
+    }
+
+    ValueType await_resume()
+    { return _future.get(); }
+
+private:
+    std::future<ValueType>& _future;
+    AsyncWait _wait;
+};
+
+}
+
+/**
+ * Suspends the async test case for the given time, other cases run in the
+ * meantime. The loop wakes up with millisecond resolution.
+ */
+inline detail::SleepAwaiter sleepFor(double seconds)
+{ return detail::SleepAwaiter(seconds); }
+
+template <class Rep, class Period>
+detail::SleepAwaiter sleepFor(const std::chrono::duration<Rep, Period>& duration)
+{
+    return detail::SleepAwaiter(
+            std::chrono::duration<double>(duration).count());
+}
+
+/**
+ * Suspends until the file descriptor is readable or writable, or has an
+ * error or hangup, then returns true. When a timeout is given, returns
+ * false if it expires first.
+ */
+inline detail::FdAwaiter readable(int fd, double timeoutSeconds = 0)
+{ return detail::FdAwaiter(fd, detail::EventLoop::READABLE, timeoutSeconds); }
+
+inline detail::FdAwaiter writable(int fd, double timeoutSeconds = 0)
+{ return detail::FdAwaiter(fd, detail::EventLoop::WRITABLE, timeoutSeconds); }
+
+/** Suspends until the future is set and returns its result. */
+template <typename ValueType>
+detail::FutureAwaiter<ValueType> resultOf(std::future<ValueType>& future)
+{ return detail::FutureAwaiter<ValueType>(future); }
+
+/** A named async test case method of a fixture class. */
+template <class FixtureType>
+struct AsyncTestCase
+{
+    const char* name;
+    AsyncTask (FixtureType::*method)();
+};
+
+namespace detail
+{
+
+/** Starts the coroutine of an async test case. */
+struct AsyncTestCaseDescriptor
+{
+    AsyncTask (*run)(const void* testCase);
+    const void* testCase;
+};
+
+template <class FixtureType>
+AsyncTask runWithFreshFixture(const void* testCase)
+{
+    const AsyncTestCase<FixtureType>& asyncCase =
+        *static_cast<const AsyncTestCase<FixtureType>*>(testCase);
+    FixtureType fixture;
+    co_await (fixture.*asyncCase.method)();
+}
+
+template <class FixtureType>
+AsyncTask runWithSharedFixture(const void* testCase)
+{
+    const AsyncTestCase<FixtureType>& asyncCase =
+        *static_cast<const AsyncTestCase<FixtureType>*>(testCase);
+    SharedFixture<FixtureType> fixture;
+    co_await ((*fixture).*asyncCase.method)();
+}
+
+/**
+ * The suite factory of async test cases, the parameter is an
+ * AsyncTestCaseDescriptor. The controller recognizes async cases by it,
+ * see isAsyncTestCase(). The suite runs the case on an event loop of its
+ * own when it is run like other suites.
+ */
+suite_transferable_ptr createAsyncTestCase(const void* descriptor);
+
+inline bool isAsyncTestCase(const SuiteDescriptor& testSuite)
+{ return testSuite.parameterizedFactory == &createAsyncTestCase; }
+
+/** Keeps a copy of the descriptor for the rest of the program. */
+const AsyncTestCaseDescriptor* keepAsyncTestCase(
+        const AsyncTestCaseDescriptor& descriptor);
+
+}
+
+/**
+ * Adds C++20 coroutine test cases of a fixture class to the controller,
+ * each as a suite labelled "label/name" like addTestCases():
+ *
+ *   class EchoTest
+ *   {
+ *   public:
+ *       Test::AsyncTask testEcho()
+ *       {
+ *           write(_client, "ping", 4);
+ *           assertTrue(co_await Test::readable(_server, 1.0));
+ *           co_await Test::sleepFor(std::chrono::milliseconds(10));
+ *       }
+ *   };
+ *
+ *   const Test::AsyncTestCase<EchoTest> echoCases[] = {
+ *       { "echo", &EchoTest::testEcho }
+ *   };
+ *
+ *   Test::addAsyncTestCases("echo", echoCases);
+ *
+ * Async cases that follow each other in a sequential run are started
+ * together on the event loop of the controller, at most as many at a time
+ * as set with Controller::setAsyncTestCaseConcurrency(), and report to
+ * observers like suites that ran one after another, in plan order: a case
+ * that ends early is reported after the cases before it, and counts
+ * towards the limit until then. The wall time of a case is the time it
+ * was in flight, the CPU time that of its coroutines.
+ * Allocations and performance counters are not measured, as the cases
+ * share the thread. In parallel and isolated runs each case runs on an
+ * event loop of its own.
+ */
+template <class FixtureType, size_t CaseCount>
+void addAsyncTestCases(const std::string& label,
+        const AsyncTestCase<FixtureType> (&cases)[CaseCount],
+        TestCaseFixture fixture = FRESH_FIXTURE)
+{
+    Controller& controller = Controller::instance();
+
+    for (size_t i = 0; i < CaseCount; ++i) {
+        const std::string caseLabel = label + "/" + cases[i].name;
+        const detail::AsyncTestCaseDescriptor descriptor = {
+            fixture == SHARED_FIXTURE
+                ? &detail::runWithSharedFixture<FixtureType>
+                : &detail::runWithFreshFixture<FixtureType>,
+            &cases[i]
+        };
+
+        if (fixture == SHARED_FIXTURE)
+            controller.addTestSuite(caseLabel, &detail::createAsyncTestCase,
+                    detail::keepAsyncTestCase(descriptor),
+                    detail::sharedFixtureEntry<FixtureType>());
+        else
+            controller.addTestSuite(caseLabel, &detail::createAsyncTestCase,
+                    detail::keepAsyncTestCase(descriptor));
+    }
+}
+
+}
+
+#define TESTCPP_ASYNC_TEST_CASE_IMPL(fixtureclass__, method__, id__) \
+    namespace { \
+        const ::Test::AsyncTestCase<fixtureclass__> TESTCPP_CONCAT(testcpp_case_, id__) = \
+            { #method__, &fixtureclass__::method__ }; \
+        const ::Test::detail::AsyncTestCaseDescriptor TESTCPP_CONCAT(testcpp_async_, id__) = \
+            { &::Test::detail::runWithFreshFixture<fixtureclass__>, \
+              &TESTCPP_CONCAT(testcpp_case_, id__) }; \
+        const ::Test::SuiteDescriptor TESTCPP_CONCAT(testcpp_suite_, id__) = \
+            { #fixtureclass__ "/" #method__, 0, \
+              &::Test::detail::createAsyncTestCase, \
+              &TESTCPP_CONCAT(testcpp_async_, id__) }; \
+        TESTCPP_REGISTER_SUITE_DESCRIPTOR(TESTCPP_CONCAT(testcpp_suite_, id__), id__) \
+    }
+
+/**
+ * Registers an async test case method at namespace scope, labelled
+ * "FixtureClass/method" and run with a fresh fixture:
+ *
+ *   TESTCPP_ASYNC_TEST_CASE(EchoTest, testEcho)
+ */
+#define TESTCPP_ASYNC_TEST_CASE(fixtureclass__, method__) \
+    TESTCPP_ASYNC_TEST_CASE_IMPL(fixtureclass__, method__, TESTCPP_UNIQUE_ID)
+
+#endif
+
+#endif /* TESTCPP_ASYNCTEST_H */
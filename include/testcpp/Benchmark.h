@@ -0,0 +1,152 @@
+#ifndef TESTCPP_BENCHMARK_H__
+#define TESTCPP_BENCHMARK_H__
+
+#include <utilcpp/declarations.h>
+#include <utilcpp/detect_cpp11.h>
+#include <testcpp/PerformanceCounters.h>
+#ifndef UTILCPP_HAVE_CPP11
+  #include <utilcpp/scoped_ptr.h>
+#endif
+
+#if defined(_MSC_VER)
+  #include <intrin.h>
+#endif
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+namespace Test
+{
+
+class Benchmark;
+
+#ifdef UTILCPP_HAVE_CPP11
+  typedef std::unique_ptr<Benchmark> benchmark_transferable_ptr;
+  typedef std::unique_ptr<Benchmark> benchmark_scoped_ptr;
+#else
+  typedef std::auto_ptr<Benchmark> benchmark_transferable_ptr;
+  typedef utilcpp::scoped_ptr<Benchmark> benchmark_scoped_ptr;
+#endif
+
+/**
+ * Interface for micro-benchmarks, the counterpart of Suite. The benchmark
+ * runs the measured code the given number of times in benchmark(), the
+ * controller calibrates the iteration count, warms up, collects samples
+ * and rejects outliers.
+ *
+ * For fixture behaviour setup things in constructor and tear down in
+ * destructor. Use doNotOptimize() and clobberMemory() to keep the compiler
+ * from optimizing the measured code away.
+ */
+class Benchmark
+{
+    UTILCPP_DECLARE_INTERFACE(Benchmark)
+
+public:
+    /** Implement this, run the measured code iterations times. */
+    virtual void benchmark(size_t iterations) = 0;
+
+    /** Factory method for creating concrete benchmarks. */
+    template <class ConcreteBenchmarkType>
+    static benchmark_transferable_ptr instance()
+    {
+        return benchmark_transferable_ptr(new ConcreteBenchmarkType());
+    }
+};
+
+/** Controls how a benchmark is measured. */
+struct BenchmarkOptions
+{
+    BenchmarkOptions() :
+        warmupSeconds(0.1),
+        minSampleSeconds(0.01),
+        samples(30),
+        outlierThreshold(3.5),
+        cpu(-1)
+    { }
+
+    /** How long to run the benchmark before measuring. */
+    double warmupSeconds;
+
+    /** The iteration count is calibrated so that a sample takes this long. */
+    double minSampleSeconds;
+
+    int samples;
+
+    /**
+     * Samples that are further from the median than this many median
+     * absolute deviations are rejected as outliers, 0 keeps all samples.
+     */
+    double outlierThreshold;
+
+    /** Pin the benchmark to this CPU, -1 means no pinning. */
+    int cpu;
+};
+
+/** Per-iteration times of a benchmark in nanoseconds. */
+struct BenchmarkResult
+{
+    BenchmarkResult() :
+        label(),
+        iterationsPerSample(0),
+        rejectedSamples(0),
+        min(0), median(0), mean(0), p90(0), p99(0), max(0),
+        samples(),
+        counters()
+    { }
+
+    std::string label;
+    size_t iterationsPerSample;
+    int rejectedSamples;
+
+    double min;
+    double median;
+    double mean;
+    double p90;
+    double p99;
+    double max;
+
+    /** The samples that were kept, in measurement order. */
+    std::vector<double> samples;
+
+    /**
+     * CPU events per iteration over all samples, when the controller
+     * counts them, see Controller::setPerformanceCounters().
+     */
+    PerformanceCounters counters;
+};
+
+namespace detail
+{
+    void useCharPointer(const volatile char*);
+}
+
+/** Forces value to be computed, prevents dead code elimination. */
+template <typename T>
+inline void doNotOptimize(const T& value)
+{
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    detail::useCharPointer(&reinterpret_cast<const volatile char&>(value));
+#if defined(_MSC_VER)
+    _ReadWriteBarrier();
+#endif
+#endif
+}
+
+/** Forces pending memory writes to be completed. */
+inline void clobberMemory()
+{
+#if defined(__GNUC__)
+    asm volatile("" : : : "memory");
+#elif defined(_MSC_VER)
+    _ReadWriteBarrier();
+#endif
+}
+
+}
+
+#endif /* TESTCPP_BENCHMARK_H */
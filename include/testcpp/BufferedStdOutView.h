@@ -0,0 +1,165 @@
+#ifndef BUFFEREDSTDOUTVIEW_H__
+#define BUFFEREDSTDOUTVIEW_H__
+
+#include "detail/TextStreamTestView.h"
+
+#include <string>
+#include <iostream>
+
+namespace Test
+{
+
+/**
+ * BufferedStdOutView writes test output to stdout through a large buffer
+ * that is flushed at test suite boundaries or when it fills up, instead of
+ * flushing after every line like StdOutView.
+ *
+ * In FAILURES_ONLY mode the output of a test suite is kept in a scratch
+ * buffer until the suite ends. The output of a failed suite, or of one that
+ * leaked memory, is written in full, a passed suite is reduced to a single
+ * line.
+ */
+class BufferedStdOutView : public TextStreamTestView
+{
+public:
+    enum Mode { ALL_OUTPUT, FAILURES_ONLY };
+
+    explicit BufferedStdOutView(Mode mode = ALL_OUTPUT,
+            size_t bufferSize = 1024 * 1024) :
+        TextStreamTestView(),
+        _mode(mode),
+        _bufferSize(bufferSize),
+        _buffer(),
+        _suiteBuffer(),
+        _inSuite(false),
+        _suiteLeaked(false),
+        _suiteLabel(),
+        _suiteNum(0),
+        _suitesTotal(0)
+    {
+        _buffer.reserve(bufferSize);
+    }
+
+    virtual ~BufferedStdOutView()
+    { flush(); }
+
+    virtual void flush()
+    {
+        std::cout.write(_buffer.data(), _buffer.size());
+        std::cout.flush();
+        _buffer.clear();
+    }
+
+    virtual TextStreamTestView& operator<< (const std::string& msg)
+    { return append(msg.data(), msg.size()); }
+
+    virtual TextStreamTestView& operator<< (const char* msg)
+    { return append(msg, std::char_traits<char>::length(msg)); }
+
+    virtual TextStreamTestView& operator<< (int msg)
+    {
+        char digits[16];
+        char* end = digits + sizeof(digits);
+        char* begin = end;
+
+        unsigned int value = msg < 0 ? 0u - static_cast<unsigned int>(msg)
+                                     : static_cast<unsigned int>(msg);
+        do {
+            *--begin = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value);
+
+        if (msg < 0)
+            *--begin = '-';
+
+        return append(begin, end - begin);
+    }
+
+    virtual TextStreamTestView& operator<< (EndLine)
+    { return append("\n", 1); }
+
+    virtual TextStreamTestView& operator<< (Tab)
+    { return append("\t", 1); }
+
+    virtual void onTestSuiteBegin(const std::string& suiteName,
+            int num, int total)
+    {
+        if (_mode == FAILURES_ONLY) {
+            _inSuite = true;
+            _suiteLeaked = false;
+            _suiteLabel = suiteName;
+            _suiteNum = num;
+            _suitesTotal = total;
+        }
+        TextStreamTestView::onTestSuiteBegin(suiteName, num, total);
+    }
+
+    virtual void onTestSuiteAllocations(const AllocationStats& stats)
+    {
+        _suiteLeaked = stats.leakedBytes > 0;
+        TextStreamTestView::onTestSuiteAllocations(stats);
+    }
+
+    virtual void onTestSuiteEnd(int numErrs)
+    {
+        TextStreamTestView::onTestSuiteEnd(numErrs);
+        endSuite(numErrs == 0 && !_suiteLeaked);
+    }
+
+    virtual void onTestSuiteEndWithStdException(int numErrs, const std::exception& e)
+    {
+        TextStreamTestView::onTestSuiteEndWithStdException(numErrs, e);
+        endSuite(false);
+    }
+
+    virtual void onTestSuiteEndWithEllipsisException(int numErrs)
+    {
+        TextStreamTestView::onTestSuiteEndWithEllipsisException(numErrs);
+        endSuite(false);
+    }
+
+private:
+    TextStreamTestView& append(const char* data, size_t size)
+    {
+        if (_inSuite) {
+            _suiteBuffer.append(data, size);
+        } else {
+            _buffer.append(data, size);
+            if (_buffer.size() >= _bufferSize)
+                flush();
+        }
+        return *this;
+    }
+
+    void endSuite(bool ok)
+    {
+        if (_inSuite) {
+            _inSuite = false;
+
+            if (ok)
+                *this << "Test suite '" << _suiteLabel << "' (#" << _suiteNum
+                      << "/" << _suitesTotal << "): OK" << END_LINE;
+            else
+                append(_suiteBuffer.data(), _suiteBuffer.size());
+
+            // keep the capacity for the next suite
+            _suiteBuffer.clear();
+        }
+
+        flush();
+    }
+
+    Mode _mode;
+    size_t _bufferSize;
+    std::string _buffer;
+    std::string _suiteBuffer;
+    bool _inSuite;
+    bool _suiteLeaked;
+    std::string _suiteLabel;
+    int _suiteNum;
+    int _suitesTotal;
+};
+
+}
+
+#endif /* BUFFEREDSTDOUTVIEW_H */
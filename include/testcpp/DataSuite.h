@@ -0,0 +1,264 @@
+#ifndef TESTCPP_DATASUITE_H__
+#define TESTCPP_DATASUITE_H__
+
+#include <testcpp/testcpp.h>
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Test
+{
+
+/**
+ * Bytes of a field in a test vector file, not zero-terminated. Points into
+ * the mapped file and is valid while the suite that reads it runs.
+ */
+struct VectorField
+{
+    const char* data;
+    size_t size;
+
+    std::string str() const
+    { return std::string(data, size); }
+
+    bool equals(const void* bytes, size_t byteCount) const;
+};
+
+bool operator==(const VectorField& a, const VectorField& b);
+bool operator==(const VectorField& field, const std::string& str);
+bool operator==(const std::string& str, const VectorField& field);
+
+/** Prints at most 64 bytes, non-printable bytes escaped in hex. */
+std::ostream& operator<<(std::ostream& out, const VectorField& field);
+
+enum VectorFileFormat
+{
+    /**
+     * Records are lines of tab-separated fields, such as an input and the
+     * expected output. Empty lines are skipped.
+     */
+    LINE_VECTORS,
+
+    /**
+     * Records are a little-endian 32-bit field count followed by the
+     * fields, each a little-endian 32-bit byte count and the bytes.
+     */
+    BINARY_VECTORS
+};
+
+/** A record of a test vector file. */
+class TestVector
+{
+public:
+    enum { MAX_FIELDS = 8 };
+
+    TestVector() :
+        _offset(0),
+        _fieldCount(0)
+    { }
+
+    /** Byte offset of the record in the file. */
+    size_t offset() const
+    { return _offset; }
+
+    size_t fieldCount() const
+    { return _fieldCount; }
+
+    /** Throws std::out_of_range if the record has fewer fields. */
+    const VectorField& field(size_t i) const;
+
+private:
+    friend class VectorFileReader;
+
+    size_t _offset;
+    size_t _fieldCount;
+    VectorField _fields[MAX_FIELDS];
+};
+
+/** A read-only mapping of a whole file. */
+class MappedFile
+{
+    UTILCPP_DISABLE_COPY(MappedFile)
+
+public:
+    /** Throws std::runtime_error if the file cannot be mapped. */
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    const char* data() const
+    { return _data; }
+
+    size_t size() const
+    { return _size; }
+
+private:
+    const char* _data;
+    size_t _size;
+#ifdef _WIN32
+    void* _mapping;
+#endif
+};
+
+/**
+ * Reads the records of a mapped test vector file without copying. The
+ * file is split into parts by byte ranges, a part reads the records that
+ * begin in its range.
+ */
+class VectorFileReader
+{
+    UTILCPP_DISABLE_COPY(VectorFileReader)
+
+public:
+    /**
+     * Binary records can only be found from the start of the file, so a
+     * binary part after the first hops over the record headers of the
+     * parts before it. See binaryPartOffsets() for reading many parts.
+     */
+    VectorFileReader(const MappedFile& file, VectorFileFormat format,
+            unsigned part = 0, unsigned parts = 1);
+
+    /** Reads a binary part from an offset found by binaryPartOffsets(). */
+    VectorFileReader(const MappedFile& file, unsigned part, unsigned parts,
+            size_t partOffset);
+
+    /**
+     * The offsets where the binary parts begin, found with one pass over
+     * the record headers. The parts from a malformed record on begin at
+     * it, so that they report it.
+     */
+    static std::vector<size_t> binaryPartOffsets(const MappedFile& file,
+            unsigned parts);
+
+    /**
+     * Reads the next record of the part into vector, returns false at the
+     * end of the part. Throws std::runtime_error on malformed records.
+     */
+    bool next(TestVector& vector);
+
+private:
+    void setPartRange(unsigned part, unsigned parts);
+    bool nextLine(TestVector& vector);
+    bool nextBinary(TestVector& vector);
+    bool skipBinary();
+    unsigned long readLength(size_t pos, size_t offset) const;
+    void malformed(size_t offset) const;
+
+    const char* _data;
+    size_t _size;
+    VectorFileFormat _format;
+    size_t _pos;
+    size_t _end;
+};
+
+namespace detail
+{
+    class VectorFileIndex;
+}
+
+/** Where the suites of addDataSuite() read their records. */
+struct DataSuitePart
+{
+    std::string path;
+    VectorFileFormat format;
+    unsigned part;
+    unsigned parts;
+
+    /** The part offsets of a binary file, shared by its parts. */
+    detail::VectorFileIndex* index;
+};
+
+/**
+ * A suite that runs testVector() for every record of a test vector file,
+ * such as recorded codec input and the expected output:
+ *
+ *   class DecoderTest : public Test::DataSuite
+ *   {
+ *       void testVector(const Test::TestVector& vector)
+ *       {
+ *           assertEqual(decode(vector.field(0).str()), vector.field(1));
+ *       }
+ *   };
+ *
+ *   Test::addDataSuite<DecoderTest>("decoder", "decoder.vectors",
+ *           Test::BINARY_VECTORS, 8);
+ *
+ * The file is memory-mapped and the records are passed as views into the
+ * mapping, so reading them neither copies nor allocates. Failing
+ * assertions and exceptions thrown by testVector() are reported with the
+ * offset of the record; an exception fails the record and the suite
+ * continues with the next one.
+ *
+ * For fixture behaviour setup things in constructor and tear down in
+ * destructor, as with Suite.
+ */
+class DataSuite : public Suite
+{
+public:
+    DataSuite() :
+        _part(0)
+    { }
+
+    /** Implement this, called for every record of the part. */
+    virtual void testVector(const TestVector& vector) = 0;
+
+    virtual void test();
+
+    /** Factory method for creating concrete data suites of a part. */
+    template <class ConcreteDataSuiteType>
+    static suite_transferable_ptr instanceForPart(const void* part)
+    {
+        ConcreteDataSuiteType* suite = new ConcreteDataSuiteType();
+        static_cast<DataSuite*>(suite)->_part =
+            static_cast<const DataSuitePart*>(part);
+        return suite_transferable_ptr(suite);
+    }
+
+private:
+    void testVectors(VectorFileReader& reader);
+
+    const DataSuitePart* _part;
+};
+
+namespace detail
+{
+    /** Keeps the index for the lifetime of the process. */
+    VectorFileIndex* addVectorFileIndex();
+
+    /** Keeps the part for the lifetime of the process. */
+    const DataSuitePart* addDataSuitePart(const std::string& path,
+            VectorFileFormat format, unsigned part, unsigned parts,
+            VectorFileIndex* index);
+
+    std::string dataSuitePartLabel(const std::string& label,
+            unsigned part, unsigned parts);
+}
+
+/**
+ * Adds the data suite to the controller, split into the given number of
+ * suites that each read a part of the file. With more than one part the
+ * suites are labelled "label [1/4]" and so on, so that the parts can be
+ * filtered and run in parallel, in processes or on different shards like
+ * any other suites. The file is mapped when a part runs. The first binary
+ * part that runs in a process finds where all parts begin, the file must
+ * not change during the run.
+ */
+template <class ConcreteDataSuiteType>
+void addDataSuite(const std::string& label, const std::string& path,
+        VectorFileFormat format, unsigned parts = 1)
+{
+    if (parts == 0)
+        parts = 1;
+
+    detail::VectorFileIndex* index = detail::addVectorFileIndex();
+    for (unsigned i = 0; i < parts; ++i)
+        Controller::instance().addTestSuite(
+                detail::dataSuitePartLabel(label, i, parts),
+                &DataSuite::instanceForPart<ConcreteDataSuiteType>,
+                detail::addDataSuitePart(path, format, i, parts, index));
+}
+
+}
+
+#endif /* TESTCPP_DATASUITE_H */
@@ -0,0 +1,107 @@
+#ifndef TESTCPP_JUNITXMLOBSERVER_H__
+#define TESTCPP_JUNITXMLOBSERVER_H__
+
+#include <testcpp/testcpp.h>
+
+#include <string>
+#include <fstream>
+
+namespace Test
+{
+
+/**
+ * JUnitXmlObserver writes test results to a JUnit XML file as the events
+ * arrive. Every assertion becomes a testcase of the testsuite element of
+ * its test suite, failures carry the file, line and function of the
+ * assertion.
+ *
+ * Memory use does not depend on the number of assertions: the counts that
+ * JUnit XML needs in the testsuite start tags are written as fixed-width
+ * placeholders and patched in place when the suite ends.
+ *
+ * Assertions made outside of test suites, e.g. in main() before the run,
+ * have no testsuite element to go to and are left out.
+ *
+ * Combine it with a view through ForwardingObserver, or use it alone:
+ *
+ *   c.setObserver(new Test::JUnitXmlObserver("results.xml"));
+ */
+class JUnitXmlObserver : public Observer
+{
+public:
+    /** Throws std::runtime_error if the file cannot be opened. */
+    explicit JUnitXmlObserver(const std::string& path);
+
+    virtual ~JUnitXmlObserver();
+
+    virtual void onTestSuiteBegin(const std::string& testSuiteLabel,
+            int testSuiteNum, int testSuitesNumTotal);
+
+    virtual void onTestSuiteEnd(int numErrs);
+    virtual void onTestSuiteEndWithStdException(int numErrs, const std::exception& e);
+    virtual void onTestSuiteEndWithEllipsisException(int numErrs);
+
+    virtual void onTestSuiteStats(const TestSuiteStats& stats);
+
+    virtual void onAssertBegin(const AssertSite& site);
+
+    virtual void onAssertEnd(bool ok);
+    virtual void onAssertExceptionEndWithExpectedException(const std::exception& e);
+    virtual void onAssertExceptionEndWithUnexpectedException(const std::exception& e);
+    virtual void onAssertExceptionEndWithEllipsisException();
+    virtual void onAssertNoExceptionEndWithStdException(const std::exception& e);
+    virtual void onAssertNoExceptionEndWithEllipsisException();
+
+    virtual void onAllTestSuitesBegin(int testSuitesNumTotal);
+    virtual void onAllTestSuitesEnd(int lastTestSuiteNum, int testSuitesNumTotal, int numErrs, int numExcepts);
+
+    virtual void onAssertFailureDetail(const std::string& detail);
+
+private:
+    /** Positions of the fixed-width attribute values in the file. */
+    struct CountPlaceholders
+    {
+        std::streampos tests;
+        std::streampos failures;
+        std::streampos errors;
+        std::streampos time;
+    };
+
+    struct Counts
+    {
+        Counts() : tests(0), failures(0), errors(0), seconds(0) { }
+
+        int tests;
+        int failures;
+        int errors;
+        double seconds;
+    };
+
+    CountPlaceholders writePlaceholders();
+    void patch(const CountPlaceholders& placeholders, const Counts& counts);
+    void patchValue(std::streampos pos, const std::string& value);
+
+    void beginTestCase(const std::string& name, const std::string& file, int line);
+    void passTestCase();
+    void failTestCase(const std::string& type, const std::string& message);
+    void closeOpenTestCase();
+    void endSuite(bool exception, const std::string& type, const std::string& message);
+
+    std::ofstream _out;
+
+    std::string _suiteLabel;
+    CountPlaceholders _suitePlaceholders;
+    Counts _suiteCounts;
+
+    CountPlaceholders _allPlaceholders;
+    Counts _allCounts;
+    double _allStart;
+
+    AssertSite _site;
+    bool _inSuite;
+    bool _failureOpen;
+};
+
+}
+
+#endif /* TESTCPP_JUNITXMLOBSERVER_H */
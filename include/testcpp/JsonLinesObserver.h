@@ -0,0 +1,95 @@
+#ifndef TESTCPP_JSONLINESOBSERVER_H__
+#define TESTCPP_JSONLINESOBSERVER_H__
+
+#include <testcpp/testcpp.h>
+
+#include <string>
+#include <fstream>
+#include <ostream>
+
+namespace Test
+{
+
+/**
+ * JsonLinesObserver writes one JSON object per line for every test suite,
+ * assertion and benchmark as the events arrive, e.g.
+ *
+ *   {"event":"assert","suite":"MyTest","type":"assertEqual","label":"a == b",
+ *    "file":"test.cpp","line":12,"function":"void MyTest::test()","ok":false,
+ *    "details":["values: '1' and '2'"]}
+ *
+ * Only the record of the latest failed assertion is held back until its
+ * failure details have arrived, so memory use does not depend on the
+ * number of assertions.
+ */
+class JsonLinesObserver : public Observer
+{
+public:
+    /** Throws std::runtime_error if the file cannot be opened. */
+    explicit JsonLinesObserver(const std::string& path,
+            bool includePassingAssertions = true);
+
+    explicit JsonLinesObserver(std::ostream& out,
+            bool includePassingAssertions = true);
+
+    virtual ~JsonLinesObserver();
+
+    virtual void onTestSuiteBegin(const std::string& testSuiteLabel,
+            int testSuiteNum, int testSuitesNumTotal);
+
+    virtual void onTestSuiteEnd(int numErrs);
+    virtual void onTestSuiteEndWithStdException(int numErrs, const std::exception& e);
+    virtual void onTestSuiteEndWithEllipsisException(int numErrs);
+
+    virtual void onTestSuiteStats(const TestSuiteStats& stats);
+    virtual void onTestSuiteAllocations(const AllocationStats& stats);
+
+    virtual void onAssertBegin(const AssertSite& site);
+
+    virtual void onAssertEnd(bool ok);
+    virtual void onAssertExceptionEndWithExpectedException(const std::exception& e);
+    virtual void onAssertExceptionEndWithUnexpectedException(const std::exception& e);
+    virtual void onAssertExceptionEndWithEllipsisException();
+    virtual void onAssertNoExceptionEndWithStdException(const std::exception& e);
+    virtual void onAssertNoExceptionEndWithEllipsisException();
+
+    virtual void onAllTestSuitesBegin(int testSuitesNumTotal);
+    virtual void onAllTestSuitesEnd(int lastTestSuiteNum, int testSuitesNumTotal, int numErrs, int numExcepts);
+
+    virtual void onAssertFailureDetail(const std::string& detail);
+
+    virtual void onBenchmarkBegin(const std::string& benchmarkLabel,
+            int benchmarkNum, int benchmarksNumTotal);
+    virtual void onBenchmarkEnd(const BenchmarkResult& result);
+    virtual void onBenchmarkEndWithStdException(const std::exception& e);
+    virtual void onBenchmarkEndWithEllipsisException();
+
+    virtual void onTimingRegression(const TimingRegression& regression);
+
+private:
+    void endAssert(bool ok, const std::string& exceptionType,
+            const std::string& exceptionWhat);
+    void endSuite(int numErrs, bool exception, const std::string& exceptionType,
+            const std::string& exceptionWhat);
+    void endBenchmark(const std::string& exceptionType,
+            const std::string& exceptionWhat);
+    void writePendingAssert();
+
+    std::ofstream _file;
+    std::ostream& _out;
+    bool _includePassingAssertions;
+
+    std::string _suiteLabel;
+    TestSuiteStats _suiteStats;
+    AllocationStats _suiteAllocations;
+    bool _hasSuiteAllocations;
+    std::string _benchmarkLabel;
+
+    AssertSite _site;
+    std::string _pendingAssert;
+    bool _pendingHasDetails;
+};
+
+}
+
+#endif /* TESTCPP_JSONLINESOBSERVER_H */
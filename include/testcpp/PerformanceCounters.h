@@ -0,0 +1,109 @@
+#ifndef TESTCPP_PERFORMANCECOUNTERS_H__
+#define TESTCPP_PERFORMANCECOUNTERS_H__
+
+#include <utilcpp/disable_copy.h>
+
+namespace Test
+{
+
+/**
+ * CPU event counts of the thread that ran a test suite, or of one
+ * benchmark iteration. Counted with perf_event_open on Linux, nothing is
+ * counted elsewhere.
+ *
+ * When the kernel does not allow hardware counters, for example because
+ * of perf_event_paranoid or in a container, the software counters are
+ * counted instead. Counts are estimates when the kernel multiplexes more
+ * counters than the CPU has.
+ */
+struct PerformanceCounters
+{
+    enum Counter
+    {
+        CYCLES = 1 << 0,
+        INSTRUCTIONS = 1 << 1,
+        BRANCH_MISSES = 1 << 2,
+        L1D_READ_MISSES = 1 << 3,
+        LLC_MISSES = 1 << 4,
+
+        TASK_CLOCK = 1 << 5,
+        CONTEXT_SWITCHES = 1 << 6,
+        PAGE_FAULTS = 1 << 7
+    };
+
+    PerformanceCounters() :
+        counted(0),
+        cycles(0),
+        instructions(0),
+        branchMisses(0),
+        l1dReadMisses(0),
+        llcMisses(0),
+        taskClockSeconds(0),
+        contextSwitches(0),
+        pageFaults(0)
+    { }
+
+    /** The Counter flags of the values that were counted. */
+    unsigned counted;
+
+    double cycles;
+    double instructions;
+    double branchMisses;
+    double l1dReadMisses;
+    double llcMisses;
+
+    double taskClockSeconds;
+    double contextSwitches;
+    double pageFaults;
+
+    bool has(Counter counter) const
+    { return (counted & counter) != 0; }
+
+    /** Instructions per cycle, 0 when either was not counted. */
+    double instructionsPerCycle() const
+    {
+        return has(CYCLES) && has(INSTRUCTIONS) && cycles > 0
+            ? instructions / cycles : 0;
+    }
+
+    PerformanceCounters dividedBy(double iterations) const
+    {
+        PerformanceCounters result(*this);
+        result.cycles /= iterations;
+        result.instructions /= iterations;
+        result.branchMisses /= iterations;
+        result.l1dReadMisses /= iterations;
+        result.llcMisses /= iterations;
+        result.taskClockSeconds /= iterations;
+        result.contextSwitches /= iterations;
+        result.pageFaults /= iterations;
+        return result;
+    }
+};
+
+/**
+ * Counts the CPU events of the calling thread for the lifetime of the
+ * scope. Events of other threads are not counted.
+ */
+class PerformanceCounterScope
+{
+    UTILCPP_DISABLE_COPY(PerformanceCounterScope)
+
+public:
+    /** Counts nothing when not enabled. */
+    explicit PerformanceCounterScope(bool enabled = true);
+    ~PerformanceCounterScope();
+
+    /** The counts since the scope began. */
+    PerformanceCounters counters() const;
+
+private:
+    enum { MAX_COUNTERS = 8 };
+
+    int _fds[MAX_COUNTERS];
+    unsigned _counters[MAX_COUNTERS];
+};
+
+}
+
+#endif /* TESTCPP_PERFORMANCECOUNTERS_H */
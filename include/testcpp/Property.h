@@ -0,0 +1,695 @@
+#ifndef TESTCPP_PROPERTY_H__
+#define TESTCPP_PROPERTY_H__
+
+#include <testcpp/testcpp.h>
+
+#include <utilcpp/disable_copy.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Test
+{
+
+/** SplitMix64, a small and fast generator with a 64-bit state. */
+class Random
+{
+public:
+    explicit Random(unsigned long long seed) :
+        _state(seed)
+    { }
+
+    unsigned long long next()
+    {
+        unsigned long long z = (_state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    /** Uniform in [0, bound), bound must not be 0. */
+    unsigned long long below(unsigned long long bound)
+    {
+        // rejects the low values that would make the remainders uneven
+        const unsigned long long threshold = (0 - bound) % bound;
+        for (;;) {
+            const unsigned long long value = next();
+            if (value >= threshold)
+                return value % bound;
+        }
+    }
+
+    /** Uniform in [0, 1). */
+    double unit()
+    { return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0); }
+
+private:
+    unsigned long long _state;
+};
+
+/**
+ * Generators create the inputs of properties, see checkProperty(). A
+ * generator is any class with the members of the generators below:
+ *
+ *   typedef ... value_type;
+ *
+ *   // overwrites value, reusing its storage
+ *   void generate(Random& random, value_type& value) const;
+ *
+ *   // appends simpler values than value, simplest first
+ *   void shrink(const value_type& value,
+ *           std::vector<value_type>& candidates) const;
+ *
+ *   void describe(std::ostream& out, const value_type& value) const;
+ *
+ * Shrinking must converge: every candidate must be strictly simpler than
+ * the value it was shrunk from.
+ */
+template <typename T>
+class IntegerGenerator
+{
+public:
+    typedef T value_type;
+
+    IntegerGenerator(T min, T max) :
+        _min(min),
+        _max(max)
+    {
+        if (max < min)
+            throw std::invalid_argument("Integer generator range is empty");
+    }
+
+    void generate(Random& random, T& value) const
+    {
+        // bugs gather at the boundaries, generate them every 8th time
+        if (random.below(8) == 0) {
+            const T origin = this->origin();
+            switch (random.below(5)) {
+                case 0: value = _min; return;
+                case 1: value = _max; return;
+                case 2: value = origin; return;
+                case 3: value = origin != _max ? T(origin + 1) : origin; return;
+                default: value = origin != _min ? T(origin - 1) : origin; return;
+            }
+        }
+
+        // modulo 2^64 arithmetic covers signed and unsigned types
+        const unsigned long long span = static_cast<unsigned long long>(_max)
+            - static_cast<unsigned long long>(_min);
+        const unsigned long long offset =
+            span == ~0ull ? random.next() : random.below(span + 1);
+        value = static_cast<T>(static_cast<unsigned long long>(_min) + offset);
+    }
+
+    /** The origin, then halfway there and closer to the value. */
+    void shrink(const T& value, std::vector<T>& candidates) const
+    {
+        const T origin = this->origin();
+        if (value == origin)
+            return;
+
+        candidates.push_back(origin);
+        const T distance = T(value - origin);
+        for (T step = T(distance / 2); step != 0; step = T(step / 2))
+            candidates.push_back(T(value - step));
+    }
+
+    void describe(std::ostream& out, const T& value) const
+    { out << +value; }
+
+private:
+    /** Zero, or the bound nearest to zero if zero is out of range. */
+    T origin() const
+    {
+        const T zero = T();
+        if (zero < _min)
+            return _min;
+        if (_max < zero)
+            return _max;
+        return zero;
+    }
+
+    T _min;
+    T _max;
+};
+
+template <typename T>
+IntegerGenerator<T> integers(T min, T max)
+{ return IntegerGenerator<T>(min, max); }
+
+template <typename T>
+IntegerGenerator<T> integers()
+{
+    return IntegerGenerator<T>(std::numeric_limits<T>::min(),
+            std::numeric_limits<T>::max());
+}
+
+/** Finite values in a range, NaN and infinities are not generated. */
+template <typename T>
+class FloatGenerator
+{
+public:
+    typedef T value_type;
+
+    FloatGenerator(T min, T max) :
+        _min(min),
+        _max(max)
+    {
+        if (!(min <= max))
+            throw std::invalid_argument("Float generator range is empty");
+    }
+
+    void generate(Random& random, T& value) const
+    {
+        if (random.below(8) == 0) {
+            switch (random.below(3)) {
+                case 0: value = _min; return;
+                case 1: value = _max; return;
+                default: value = origin(); return;
+            }
+        }
+
+        // interpolates without overflowing on ranges wider than the type
+        const T u = static_cast<T>(random.unit());
+        value = _min * (1 - u) + _max * u;
+        if (value < _min || value > _max)
+            value = _min;
+    }
+
+    /** The origin, the integer towards the origin, then halfway there. */
+    void shrink(const T& value, std::vector<T>& candidates) const
+    {
+        const T origin = this->origin();
+        if (value == origin || value != value)
+            return;
+
+        candidates.push_back(origin);
+
+        const T truncated = value < 0 ? std::ceil(value) : std::floor(value);
+        if (truncated != value && truncated != origin
+                && truncated >= _min && truncated <= _max)
+            candidates.push_back(truncated);
+
+        T step = (value - origin) / 2;
+        for (int i = 0; i < 16 && value - step != value; ++i, step /= 2)
+            candidates.push_back(value - step);
+    }
+
+    void describe(std::ostream& out, const T& value) const
+    {
+        const std::streamsize precision =
+            out.precision(std::numeric_limits<T>::digits10 + 3);
+        out << value;
+        out.precision(precision);
+    }
+
+private:
+    T origin() const
+    {
+        if (_min > 0)
+            return _min;
+        if (_max < 0)
+            return _max;
+        return 0;
+    }
+
+    T _min;
+    T _max;
+};
+
+template <typename T>
+FloatGenerator<T> floats(T min, T max)
+{ return FloatGenerator<T>(min, max); }
+
+namespace detail
+{
+    /** Quotes str and escapes quotes, backslashes and non-printables. */
+    void describeString(std::ostream& out, const std::string& str);
+
+    /**
+     * Appends the sequence without each chunk, halving the chunk size from
+     * half of the sequence down to single elements.
+     */
+    template <typename Sequence>
+    void appendRemovals(const Sequence& sequence,
+            std::vector<Sequence>& candidates)
+    {
+        const size_t size = sequence.size();
+        for (size_t chunk = size / 2; chunk > 0; chunk /= 2)
+            for (size_t start = 0; start < size; start += chunk) {
+                const size_t end = std::min(size, start + chunk);
+                candidates.push_back(Sequence());
+                Sequence& candidate = candidates.back();
+                candidate.reserve(size - (end - start));
+                candidate.insert(candidate.end(),
+                        sequence.begin(), sequence.begin() + start);
+                candidate.insert(candidate.end(),
+                        sequence.begin() + end, sequence.end());
+            }
+    }
+}
+
+/** Strings of characters of the alphabet, printable ASCII by default. */
+class StringGenerator
+{
+public:
+    typedef std::string value_type;
+
+    explicit StringGenerator(size_t maxLength = 32,
+            const std::string& alphabet = printableAscii());
+
+    void generate(Random& random, std::string& value) const
+    {
+        const size_t length = random.below(8) == 0
+            ? 0 : static_cast<size_t>(random.below(_maxLength + 1));
+
+        // resizing keeps the capacity, so cases reuse the buffer
+        value.resize(length);
+        for (size_t i = 0; i < length; ++i)
+            value[i] = _alphabet[static_cast<size_t>(random.below(_alphabet.size()))];
+    }
+
+    /**
+     * The empty string, shorter strings, then characters replaced with the
+     * first character of the alphabet.
+     */
+    void shrink(const std::string& value,
+            std::vector<std::string>& candidates) const;
+
+    void describe(std::ostream& out, const std::string& value) const
+    { detail::describeString(out, value); }
+
+    static std::string printableAscii();
+
+private:
+    size_t _maxLength;
+    std::string _alphabet;
+};
+
+inline StringGenerator strings(size_t maxLength = 32)
+{ return StringGenerator(maxLength); }
+
+inline StringGenerator strings(size_t maxLength, const std::string& alphabet)
+{ return StringGenerator(maxLength, alphabet); }
+
+/** Vectors of values of the element generator. */
+template <class ElementGenerator>
+class VectorGenerator
+{
+public:
+    typedef typename ElementGenerator::value_type element_type;
+    typedef std::vector<element_type> value_type;
+
+    VectorGenerator(const ElementGenerator& element, size_t maxSize) :
+        _element(element),
+        _maxSize(maxSize)
+    { }
+
+    void generate(Random& random, value_type& value) const
+    {
+        const size_t size = random.below(8) == 0
+            ? 0 : static_cast<size_t>(random.below(_maxSize + 1));
+
+        // the elements that are kept are overwritten in place
+        value.resize(size);
+        for (size_t i = 0; i < size; ++i)
+            _element.generate(random, value[i]);
+    }
+
+    /** The empty vector, shorter vectors, then each element shrunk. */
+    void shrink(const value_type& value,
+            std::vector<value_type>& candidates) const
+    {
+        if (value.empty())
+            return;
+
+        candidates.push_back(value_type());
+        detail::appendRemovals(value, candidates);
+
+        std::vector<element_type> elementCandidates;
+        for (size_t i = 0; i < value.size(); ++i) {
+            elementCandidates.clear();
+            _element.shrink(value[i], elementCandidates);
+            for (size_t k = 0; k < elementCandidates.size(); ++k) {
+                candidates.push_back(value);
+                candidates.back()[i] = elementCandidates[k];
+            }
+        }
+    }
+
+    void describe(std::ostream& out, const value_type& value) const
+    {
+        out << "[";
+        for (size_t i = 0; i < value.size(); ++i) {
+            if (i)
+                out << ", ";
+            _element.describe(out, value[i]);
+        }
+        out << "]";
+    }
+
+private:
+    ElementGenerator _element;
+    size_t _maxSize;
+};
+
+template <class ElementGenerator>
+VectorGenerator<ElementGenerator> vectorsOf(const ElementGenerator& element,
+        size_t maxSize = 32)
+{ return VectorGenerator<ElementGenerator>(element, maxSize); }
+
+/** Pairs of values, for properties of more than one input. */
+template <class FirstGenerator, class SecondGenerator>
+class PairGenerator
+{
+public:
+    typedef std::pair<typename FirstGenerator::value_type,
+                      typename SecondGenerator::value_type> value_type;
+
+    PairGenerator(const FirstGenerator& first, const SecondGenerator& second) :
+        _first(first),
+        _second(second)
+    { }
+
+    void generate(Random& random, value_type& value) const
+    {
+        _first.generate(random, value.first);
+        _second.generate(random, value.second);
+    }
+
+    /** The first value shrunk, then the second. */
+    void shrink(const value_type& value,
+            std::vector<value_type>& candidates) const
+    {
+        std::vector<typename FirstGenerator::value_type> firsts;
+        _first.shrink(value.first, firsts);
+        for (size_t i = 0; i < firsts.size(); ++i)
+            candidates.push_back(value_type(firsts[i], value.second));
+
+        std::vector<typename SecondGenerator::value_type> seconds;
+        _second.shrink(value.second, seconds);
+        for (size_t i = 0; i < seconds.size(); ++i)
+            candidates.push_back(value_type(value.first, seconds[i]));
+    }
+
+    void describe(std::ostream& out, const value_type& value) const
+    {
+        out << "(";
+        _first.describe(out, value.first);
+        out << ", ";
+        _second.describe(out, value.second);
+        out << ")";
+    }
+
+private:
+    FirstGenerator _first;
+    SecondGenerator _second;
+};
+
+template <class FirstGenerator, class SecondGenerator>
+PairGenerator<FirstGenerator, SecondGenerator> pairsOf(
+        const FirstGenerator& first, const SecondGenerator& second)
+{ return PairGenerator<FirstGenerator, SecondGenerator>(first, second); }
+
+/** Controls how a property is checked. */
+struct PropertyOptions
+{
+    PropertyOptions() :
+        cases(100),
+        seed(0),
+        maxShrinkChecks(10000),
+        threads(1)
+    { }
+
+    unsigned long cases;
+
+    /** 0 derives the seed from the seed of the run and the label. */
+    unsigned long seed;
+
+    /** Shrinking stops after checking this many candidates. */
+    unsigned long maxShrinkChecks;
+
+    /**
+     * Threads that check the cases, 0 means one per hardware thread. The
+     * property must be safe to check concurrently when not 1. Requires
+     * C++11 threads.
+     */
+    unsigned threads;
+};
+
+namespace detail
+{
+
+/** Discards all events, for checking properties silently. */
+class SilentObserver : public Observer
+{
+public:
+    virtual unsigned subscribedEvents() const
+    { return 0; }
+
+    virtual void onTestSuiteBegin(const std::string&, int, int) { }
+    virtual void onTestSuiteEnd(int) { }
+    virtual void onTestSuiteEndWithStdException(int, const std::exception&) { }
+    virtual void onTestSuiteEndWithEllipsisException(int) { }
+    virtual void onAssertBegin(const AssertSite&) { }
+    virtual void onAssertEnd(bool) { }
+    virtual void onAssertExceptionEndWithExpectedException(const std::exception&) { }
+    virtual void onAssertExceptionEndWithUnexpectedException(const std::exception&) { }
+    virtual void onAssertExceptionEndWithEllipsisException() { }
+    virtual void onAssertNoExceptionEndWithStdException(const std::exception&) { }
+    virtual void onAssertNoExceptionEndWithEllipsisException() { }
+    virtual void onAllTestSuitesBegin(int) { }
+    virtual void onAllTestSuitesEnd(int, int, int, int) { }
+};
+
+/**
+ * Makes a silent assertion context current on this thread for the
+ * lifetime of the probe, so that failing assertions in the property only
+ * count.
+ */
+class PropertyProbe
+{
+    UTILCPP_DISABLE_COPY(PropertyProbe)
+
+public:
+    PropertyProbe() :
+        _observer(),
+        _context(&_observer, 0),
+        _scope(_context)
+    { }
+
+    /** True if the property neither failed an assertion nor threw. */
+    template <class Property, typename T>
+    bool holds(Property& property, const T& value)
+    {
+        _context.resetErrs();
+        try {
+            property(value);
+        } catch (...) {
+            return false;
+        }
+        return _context.errs() == 0;
+    }
+
+private:
+    SilentObserver _observer;
+    AssertionContext _context;
+    Controller::CurrentContextScope _scope;
+};
+
+/** Generates and checks the cases of a property. */
+class PropertyCases
+{
+    UTILCPP_DECLARE_INTERFACE(PropertyCases)
+
+public:
+    /** Checks the case on a probe of the worker thread. */
+    virtual bool holds(PropertyProbe& probe, unsigned worker,
+            unsigned long caseNumber) = 0;
+};
+
+/** The number of workers for the threads option and the case count. */
+unsigned propertyWorkers(unsigned threads, unsigned long cases);
+
+/**
+ * Checks the cases in batches on the workers, returns the number of the
+ * first case that fails or cases if all hold. The result does not depend
+ * on the number of workers.
+ */
+unsigned long findFailingCase(PropertyCases& cases, unsigned long count,
+        unsigned workers);
+
+/** The seed of the cases of a property. */
+unsigned long long propertyCaseSeed(unsigned long seed,
+        const std::string& label, unsigned long caseNumber);
+
+template <class Generator, class Property>
+class GeneratedCases : public PropertyCases
+{
+    UTILCPP_DISABLE_COPY(GeneratedCases)
+
+public:
+    typedef typename Generator::value_type value_type;
+
+    GeneratedCases(const Generator& generator, Property& property,
+            unsigned long seed, const std::string& label, unsigned workers) :
+        _generator(generator),
+        _property(property),
+        _seed(seed),
+        _label(label),
+        _values(workers)
+    { }
+
+    virtual bool holds(PropertyProbe& probe, unsigned worker,
+            unsigned long caseNumber)
+    {
+        value_type& value = _values[worker];
+        generate(caseNumber, value);
+        return probe.holds(_property, value);
+    }
+
+    /** Every case is generated from its own seed, on any worker. */
+    void generate(unsigned long caseNumber, value_type& value) const
+    {
+        Random random(propertyCaseSeed(_seed, _label, caseNumber));
+        _generator.generate(random, value);
+    }
+
+private:
+    const Generator& _generator;
+    Property& _property;
+    unsigned long _seed;
+    const std::string& _label;
+
+    /** Storage of each worker, reused by its cases. */
+    std::vector<value_type> _values;
+};
+
+/**
+ * Replaces value with the simplest candidate that still fails, returns
+ * the number of times it was replaced.
+ */
+template <class Generator, class Property>
+unsigned long shrinkCounterexample(const Generator& generator,
+        Property& property, typename Generator::value_type& value,
+        unsigned long maxChecks)
+{
+    PropertyProbe probe;
+    std::vector<typename Generator::value_type> candidates;
+    unsigned long shrinks = 0;
+    unsigned long checks = 0;
+
+    for (bool shrunk = true; shrunk && checks < maxChecks; ) {
+        shrunk = false;
+        candidates.clear();
+        generator.shrink(value, candidates);
+
+        for (size_t i = 0; i < candidates.size() && checks < maxChecks; ++i) {
+            ++checks;
+            if (!probe.holds(property, candidates[i])) {
+                std::swap(value, candidates[i]);
+                ++shrinks;
+                shrunk = true;
+                break;
+            }
+        }
+    }
+
+    return shrinks;
+}
+
+void reportPropertyFailure(AssertionContext& context, const AssertSite& site,
+        unsigned long seed, unsigned long failedCase, unsigned long cases,
+        unsigned long shrinks, const std::string& counterexample);
+
+}
+
+/**
+ * Checks that a property of the generated values holds, for example:
+ *
+ *   void reverseTwiceIsIdentity(const std::vector<int>& v)
+ *   {
+ *       std::vector<int> w(v.rbegin(), v.rend());
+ *       std::reverse(w.begin(), w.end());
+ *       assertEqual(w == v, true);
+ *   }
+ *
+ *   Test::checkProperty("reversing twice", Test::vectorsOf(
+ *           Test::integers<int>()), &reverseTwiceIsIdentity);
+ *
+ * The property is a function or function object that takes the value and
+ * fails by failing an assertion or by throwing. Cases are checked silently
+ * until one fails. The failing value is then shrunk to the simplest value
+ * that still fails, and the property is checked once more with it in the
+ * current context, so that its failed assertions are reported as usual.
+ * The property itself is reported as an assertion that fails with the
+ * seed and the counterexample as failure details.
+ *
+ * Generated values reuse the storage of the previous case, so cases do not
+ * allocate once the values have grown to their size. Properties must be
+ * deterministic for shrinking to work.
+ *
+ * checkProperty() is a macro that passes the call site to this function.
+ */
+template <class Generator, class Property>
+void checkPropertyImpl(const AssertSite& site, const Generator& generator,
+        Property property, const PropertyOptions& options = PropertyOptions())
+{
+    AssertionContext& context = Controller::currentContext();
+    const std::string label(site.label);
+
+    const unsigned long seed = options.seed
+        ? options.seed : Controller::instance().propertySeed();
+    const unsigned workers = detail::propertyWorkers(options.threads,
+            options.cases);
+
+    detail::GeneratedCases<Generator, Property> cases(generator, property,
+            seed, label, workers);
+    const unsigned long failedCase =
+        detail::findFailingCase(cases, options.cases, workers);
+
+    if (failedCase == options.cases) {
+        context.beforeAssert(site);
+        context.afterAssert(true);
+        return;
+    }
+
+    typename Generator::value_type counterexample;
+    cases.generate(failedCase, counterexample);
+    const unsigned long shrinks = detail::shrinkCounterexample(generator,
+            property, counterexample, options.maxShrinkChecks);
+
+    // reports the failed assertions of the counterexample
+    AssertSite throwSite = site;
+    throwSite.label = "property does not throw";
+    try {
+        property(counterexample);
+    } catch (const std::exception& e) {
+        context.beforeAssert(throwSite);
+        context.onAssertNoExceptionEndWithException(&e);
+    } catch (...) {
+        context.beforeAssert(throwSite);
+        context.onAssertNoExceptionEndWithException();
+    }
+
+    std::ostringstream description;
+    generator.describe(description, counterexample);
+    detail::reportPropertyFailure(context, site, seed, failedCase,
+            options.cases, shrinks, description.str());
+}
+
+}
+
+// a macro, so that failures are reported at the call site; qualified calls
+// such as Test::checkProperty(...) expand to Test::checkPropertyImpl(...)
+#define checkProperty(label__, ...) \
+    checkPropertyImpl(TESTCPP_ASSERT_SITE("checkProperty", label__), __VA_ARGS__)
+
+#endif /* TESTCPP_PROPERTY_H */
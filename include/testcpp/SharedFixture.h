@@ -0,0 +1,148 @@
+#ifndef TESTCPP_SHAREDFIXTURE_H__
+#define TESTCPP_SHAREDFIXTURE_H__
+
+#include <testcpp/testcpp.h>
+
+#include <utilcpp/disable_copy.h>
+
+#include <string>
+
+namespace Test
+{
+
+namespace detail
+{
+
+/**
+ * The state of a shared fixture type: the fixture, if it exists, the
+ * handles to it and the planned suites that have yet to use it.
+ */
+class SharedFixtureEntry
+{
+    UTILCPP_DISABLE_COPY(SharedFixtureEntry)
+
+public:
+    typedef void* (*CreateFunction)();
+    typedef void (*DestroyFunction)(void*);
+
+    SharedFixtureEntry(CreateFunction create, DestroyFunction destroy);
+    ~SharedFixtureEntry();
+
+    /**
+     * Creates the fixture on first use, other threads wait for it. Throws
+     * what the fixture constructor throws.
+     */
+    void* acquire();
+    void release();
+
+    /**
+     * Keeps the fixture until the given number of planned suites have
+     * finished, or until the end of the run if the users are not declared.
+     */
+    void beginRun(unsigned long plannedUsers, bool usersDeclared);
+    void userFinished();
+    void endRun();
+
+private:
+    void destroyIfUnused();
+
+#ifdef TESTCPP_HAVE_THREADS
+    std::mutex _lock;
+#endif
+    CreateFunction _create;
+    DestroyFunction _destroy;
+    void* _fixture;
+    unsigned long _handles;
+    unsigned long _pendingUsers;
+    bool _keepUntilRunEnd;
+};
+
+/** The fixtures that have been used or declared, in that order. */
+void sharedFixtureEntries(std::vector<SharedFixtureEntry*>& entries);
+
+template <class FixtureType>
+void* createSharedFixture()
+{ return new FixtureType(); }
+
+template <class FixtureType>
+void destroySharedFixture(void* fixture)
+{ delete static_cast<FixtureType*>(fixture); }
+
+template <class FixtureType>
+SharedFixtureEntry& sharedFixtureEntry()
+{
+    static SharedFixtureEntry entry(&createSharedFixture<FixtureType>,
+            &destroySharedFixture<FixtureType>);
+    return entry;
+}
+
+}
+
+/**
+ * A fixture that suites share instead of building their own, such as a
+ * large index loaded from disk. Suites hold a handle as a member:
+ *
+ *   class LookupTest : public Test::Suite
+ *   {
+ *       Test::SharedFixture<ReferenceIndex> _index;
+ *
+ *       void test()
+ *       {
+ *           assertEqual(_index->lookup("key"), 42);
+ *       }
+ *   };
+ *
+ *   Test::addSharedFixtureUsers<ReferenceIndex>("lookup*");
+ *
+ * There is one fixture per type, default-constructed when the first handle
+ * is created. Construction is serialized, so suites that run in parallel
+ * wait for it and share the result, and access to the fixture must be
+ * thread-safe in parallel runs. Its allocations are not counted as
+ * allocations of the suite.
+ *
+ * The controller keeps the fixture until the last planned suite that is
+ * declared as its user has finished, see addSharedFixtureUsers(), or until
+ * the end of the run when no users are declared. In isolated runs every
+ * worker process builds its own fixture and keeps it until it exits.
+ */
+template <class FixtureType>
+class SharedFixture
+{
+    UTILCPP_DISABLE_COPY(SharedFixture)
+
+public:
+    SharedFixture() :
+        _fixture(static_cast<FixtureType*>(entry().acquire()))
+    { }
+
+    ~SharedFixture()
+    { entry().release(); }
+
+    FixtureType& operator*() const
+    { return *_fixture; }
+
+    FixtureType* operator->() const
+    { return _fixture; }
+
+private:
+    static detail::SharedFixtureEntry& entry()
+    { return detail::sharedFixtureEntry<FixtureType>(); }
+
+    FixtureType* _fixture;
+};
+
+/**
+ * Declares that the suites with labels that match the glob use the fixture,
+ * so that the controller tears it down after the last of them and can run
+ * them next to each other, see Controller::setGroupBySharedFixture().
+ */
+template <class FixtureType>
+void addSharedFixtureUsers(const std::string& glob)
+{
+    Controller::instance().addSharedFixtureUsers(
+            detail::sharedFixtureEntry<FixtureType>(), glob);
+}
+
+}
+
+#endif /* TESTCPP_SHAREDFIXTURE_H */
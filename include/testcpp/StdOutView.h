@@ -21,6 +21,9 @@ public:
     virtual TextStreamTestView& operator<< (const std::string& msg)
     { std::cout << msg; return *this; }
 
+    virtual TextStreamTestView& operator<< (const char* msg)
+    { std::cout << msg; return *this; }
+
     virtual TextStreamTestView& operator<< (int msg)
     { std::cout << msg; return *this; }
 
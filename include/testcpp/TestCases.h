@@ -0,0 +1,160 @@
+#ifndef TESTCPP_TESTCASES_H__
+#define TESTCPP_TESTCASES_H__
+
+#include <testcpp/testcpp.h>
+#include <testcpp/SharedFixture.h>
+
+#include <cstddef>
+#include <string>
+
+namespace Test
+{
+
+/** A named test case method of a fixture class. */
+template <class FixtureType>
+struct TestCase
+{
+    const char* name;
+    void (FixtureType::*method)();
+};
+
+enum TestCaseFixture
+{
+    /** Every case constructs and destroys a fixture of its own. */
+    FRESH_FIXTURE,
+
+    /**
+     * The cases share a fixture, constructed for the first case that runs
+     * and destroyed after the last planned one, see SharedFixture.
+     */
+    SHARED_FIXTURE
+};
+
+namespace detail
+{
+
+/** Runs a test case as a suite. */
+template <class FixtureType>
+class FreshFixtureCase : public Suite
+{
+    UTILCPP_DISABLE_COPY(FreshFixtureCase)
+
+public:
+    explicit FreshFixtureCase(const TestCase<FixtureType>& testCase) :
+        _testCase(testCase)
+    { }
+
+    virtual void test()
+    {
+        FixtureType fixture;
+        (fixture.*_testCase.method)();
+    }
+
+    static suite_transferable_ptr instance(const void* testCase)
+    {
+        return suite_transferable_ptr(new FreshFixtureCase(
+                    *static_cast<const TestCase<FixtureType>*>(testCase)));
+    }
+
+private:
+    const TestCase<FixtureType>& _testCase;
+};
+
+template <class FixtureType>
+class SharedFixtureCase : public Suite
+{
+    UTILCPP_DISABLE_COPY(SharedFixtureCase)
+
+public:
+    explicit SharedFixtureCase(const TestCase<FixtureType>& testCase) :
+        _testCase(testCase),
+        _fixture()
+    { }
+
+    virtual void test()
+    { ((*_fixture).*_testCase.method)(); }
+
+    static suite_transferable_ptr instance(const void* testCase)
+    {
+        return suite_transferable_ptr(new SharedFixtureCase(
+                    *static_cast<const TestCase<FixtureType>*>(testCase)));
+    }
+
+private:
+    const TestCase<FixtureType>& _testCase;
+    SharedFixture<FixtureType> _fixture;
+};
+
+}
+
+/**
+ * Adds the test case methods of a fixture class to the controller, each
+ * as a suite of its own labelled "label/name":
+ *
+ *   class ParserTest
+ *   {
+ *   public:
+ *       TESTCPP_TYPEDEFS(ParserTest)
+ *
+ *       void testEmpty() { assertEqual(parse("").size(), 0u); }
+ *       void testNested() { assertEqual(parse("[[]]").depth(), 2); }
+ *   };
+ *
+ *   const Test::TestCase<ParserTest> parserCases[] = {
+ *       { "empty", &ParserTest::testEmpty },
+ *       { "nested", &ParserTest::testNested }
+ *   };
+ *
+ *   Test::addTestCases("parser", parserCases);
+ *
+ * The cases are reported, filtered, sharded and run in parallel like any
+ * other suites, and an exception ends only the case that threw it. The
+ * fixture class is default-constructed for each case, or once for all of
+ * them with SHARED_FIXTURE. Cases that share a fixture may run at the same
+ * time in parallel runs. The array must outlive the run.
+ */
+template <class FixtureType, size_t CaseCount>
+void addTestCases(const std::string& label,
+        const TestCase<FixtureType> (&cases)[CaseCount],
+        TestCaseFixture fixture = FRESH_FIXTURE)
+{
+    Controller& controller = Controller::instance();
+
+    for (size_t i = 0; i < CaseCount; ++i) {
+        const std::string caseLabel = label + "/" + cases[i].name;
+
+        if (fixture == SHARED_FIXTURE) {
+            controller.addTestSuite(caseLabel,
+                    &detail::SharedFixtureCase<FixtureType>::instance, &cases[i],
+                    detail::sharedFixtureEntry<FixtureType>());
+        } else {
+            controller.addTestSuite(caseLabel,
+                    &detail::FreshFixtureCase<FixtureType>::instance, &cases[i]);
+        }
+    }
+}
+
+}
+
+#define TESTCPP_TEST_CASE_IMPL(fixtureclass__, method__, id__) \
+    namespace { \
+        const ::Test::TestCase<fixtureclass__> TESTCPP_CONCAT(testcpp_case_, id__) = \
+            { #method__, &fixtureclass__::method__ }; \
+        const ::Test::SuiteDescriptor TESTCPP_CONCAT(testcpp_suite_, id__) = \
+            { #fixtureclass__ "/" #method__, 0, \
+              &::Test::detail::FreshFixtureCase<fixtureclass__>::instance, \
+              &TESTCPP_CONCAT(testcpp_case_, id__) }; \
+        TESTCPP_REGISTER_SUITE_DESCRIPTOR(TESTCPP_CONCAT(testcpp_suite_, id__), id__) \
+    }
+
+/**
+ * Registers a test case method at namespace scope like TESTCPP_SUITE,
+ * labelled "FixtureClass/method" and run with a fresh fixture:
+ *
+ *   TESTCPP_TEST_CASE(ParserTest, testEmpty)
+ *   TESTCPP_TEST_CASE(ParserTest, testNested)
+ */
+#define TESTCPP_TEST_CASE(fixtureclass__, method__) \
+    TESTCPP_TEST_CASE_IMPL(fixtureclass__, method__, TESTCPP_UNIQUE_ID)
+
+#endif /* TESTCPP_TESTCASES_H */
@@ -0,0 +1,53 @@
+#ifndef TESTCPP_THREADASSERTIONCONTEXT_H__
+#define TESTCPP_THREADASSERTIONCONTEXT_H__
+
+#include <testcpp/testcpp.h>
+#include <testcpp/detail/EventRecorder.h>
+
+#include <utilcpp/disable_copy.h>
+
+namespace Test
+{
+
+/**
+ * Assertion context for threads that a test suite starts. Assertions made
+ * on the thread are counted and recorded locally without locking. When the
+ * context is destroyed, the results are handed over to the context of the
+ * suite and reported as part of the suite when it ends.
+ *
+ * Take the suite context on the suite thread and create the thread context
+ * at the start of the thread function:
+ *
+ *   Test::AssertionContext& suiteContext = Test::Controller::currentContext();
+ *   std::thread worker([&suiteContext]() {
+ *       Test::ThreadAssertionContext context(suiteContext);
+ *       assertEqual(compute(), 42);
+ *   });
+ *   worker.join();
+ *
+ * The thread must end before the test suite does.
+ */
+class ThreadAssertionContext : public AssertionContext
+{
+    UTILCPP_DISABLE_COPY(ThreadAssertionContext)
+
+public:
+    explicit ThreadAssertionContext(AssertionContext& suiteContext) :
+        AssertionContext(&_recorder, suiteContext.subscribedEvents()),
+        _recorder(),
+        _suiteContext(suiteContext),
+        _scope(*this)
+    { }
+
+    ~ThreadAssertionContext()
+    { _suiteContext.adopt(errs(), _recorder.buffer()); }
+
+private:
+    EventRecorder _recorder;
+    AssertionContext& _suiteContext;
+    Controller::CurrentContextScope _scope;
+};
+
+}
+
+#endif /* TESTCPP_THREADASSERTIONCONTEXT_H */
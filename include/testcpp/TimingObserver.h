@@ -0,0 +1,106 @@
+#ifndef TESTCPP_TIMINGOBSERVER_H__
+#define TESTCPP_TIMINGOBSERVER_H__
+
+#include <testcpp/detail/ForwardingObserver.h>
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+namespace Test
+{
+
+/**
+ * TimingObserver decorates another observer with timing. It collects the
+ * wall time, CPU time and peak RSS of each test suite and prints the
+ * slowest suites before the summary of the decorated observer:
+ *
+ *   c.setObserver(new Test::TimingObserver(new Test::ColoredStdOutView));
+ *
+ * Assertion timing is off by default as it reads the clock twice per
+ * assertion. The assertion time is measured when the events arrive, so it
+ * is only meaningful when suites run sequentially in the process.
+ */
+class TimingObserver : public ForwardingObserver
+{
+public:
+    /** Takes ownership of observer. */
+    explicit TimingObserver(Observer* observer, size_t slowestCount = 10,
+            bool timeAssertions = false, std::ostream& out = std::cout);
+
+    explicit TimingObserver(Observer& observer, size_t slowestCount = 10,
+            bool timeAssertions = false, std::ostream& out = std::cout);
+
+    struct SuiteTiming
+    {
+        std::string label;
+        TestSuiteStats stats;
+    };
+
+    struct AssertTiming
+    {
+        std::string location;
+        std::string assertType;
+        double seconds;
+    };
+
+    /** Timings of all suites in the order they ended. */
+    const std::vector<SuiteTiming>& suiteTimings() const
+    { return _suiteTimings; }
+
+    /**
+     * Writes the wall time of every suite to path as "label<TAB>seconds"
+     * lines, the input of Controller::setShardDurationsFile(). Files
+     * written by different shards can be concatenated.
+     *
+     * Throws std::runtime_error if the file cannot be written.
+     */
+    void writeDurations(const std::string& path) const;
+
+    /** The slowest assertions, slowest first. */
+    const std::vector<AssertTiming>& slowestAssertions() const
+    { return _slowestAssertions; }
+
+    virtual unsigned subscribedEvents() const
+    {
+        if (_timeAssertions)
+            return ALL_EVENTS;
+        return ForwardingObserver::subscribedEvents();
+    }
+
+    virtual void onTestSuiteBegin(const std::string& testSuiteLabel,
+            int testSuiteNum, int testSuitesNumTotal);
+
+    virtual void onTestSuiteStats(const TestSuiteStats& stats);
+
+    virtual void onAssertBegin(const AssertSite& site);
+
+    virtual void onAssertEnd(bool ok);
+    virtual void onAssertExceptionEndWithExpectedException(const std::exception& e);
+    virtual void onAssertExceptionEndWithUnexpectedException(const std::exception& e);
+    virtual void onAssertExceptionEndWithEllipsisException();
+    virtual void onAssertNoExceptionEndWithStdException(const std::exception& e);
+    virtual void onAssertNoExceptionEndWithEllipsisException();
+
+    virtual void onAllTestSuitesEnd(int lastTestSuiteNum,
+            int testSuitesNumTotal, int numErrs, int numExcepts);
+
+private:
+    void assertEnded();
+    void printSummary();
+
+    size_t _slowestCount;
+    bool _timeAssertions;
+    std::ostream& _out;
+
+    std::string _currentSuiteLabel;
+    std::vector<SuiteTiming> _suiteTimings;
+
+    AssertSite _currentSite;
+    double _assertStart;
+    std::vector<AssertTiming> _slowestAssertions;
+};
+
+}
+
+#endif /* TESTCPP_TIMINGOBSERVER_H */
@@ -1,51 +1,117 @@
 #ifndef TESTCPP_ASSERT_IMPL_H__
 #define TESTCPP_ASSERT_IMPL_H__
 
-inline void assertTrueImpl(const std::string& label, bool ok,
-        const char* const function, const char* const file, int line)
+namespace detail
 {
-    Controller &c = Controller::instance();
-    c.beforeAssert("assertTrue", label, function, file, line);
+
+// detects if operator<<(std::ostream&, const T&) exists, C++03-compatible
+namespace streamable
+{
+    typedef char yes[1];
+    typedef char no[2];
+
+    struct any
+    {
+        template <typename T>
+        any(const T&);
+    };
+
+    no& operator<< (std::ostream&, const any&);
+
+    yes& check(std::ostream&);
+    no& check(no&);
+
+    template <typename T>
+    struct is_streamable
+    {
+        static std::ostream& stream;
+        static const T& value;
+        static const bool result =
+            sizeof(check(stream << value)) == sizeof(yes);
+    };
+}
+
+template <bool IsStreamable>
+struct ValueFormatter
+{
+    template <typename T>
+    static void format(std::ostream& out, const T& value)
+    { out << "'" << value << "'"; }
+};
+
+template <>
+struct ValueFormatter<false>
+{
+    template <typename T>
+    static void format(std::ostream& out, const T&)
+    { out << "<" << sizeof(T) << "-byte object>"; }
+};
+
+template <typename T>
+void formatValue(std::ostream& out, const T& value)
+{
+    ValueFormatter<streamable::is_streamable<T>::result>::format(out, value);
+}
+
+/** Only called on failure, so that passing assertions do not format. */
+template <typename FirstCompareType, typename SecondCompareType>
+std::string formatValues(const FirstCompareType& a, const SecondCompareType& b)
+{
+    std::ostringstream out;
+    out << std::boolalpha << "values: ";
+    formatValue(out, a);
+    out << " and ";
+    formatValue(out, b);
+    return out.str();
+}
+
+}
+
+inline void assertTrueImpl(const AssertSite& site, bool ok)
+{
+    AssertionContext& c = Controller::currentContext();
+    c.beforeAssert(site);
     c.afterAssert(ok);
 }
 
 template <typename FirstCompareType, typename SecondCompareType>
-void assertEqualImpl(const std::string& label,
-        const FirstCompareType& a, const SecondCompareType& b,
-        const char* const function, const char* const file, int line)
+void assertEqualImpl(const AssertSite& site,
+        const FirstCompareType& a, const SecondCompareType& b)
 {
-    Controller &c = Controller::instance();
-    c.beforeAssert("assertEqual", label, function, file, line);
+    AssertionContext& c = Controller::currentContext();
+    c.beforeAssert(site);
 
     bool ok = (a == b);
 
     c.afterAssert(ok);
+    if (!ok)
+        c.onAssertFailureDetail(detail::formatValues(a, b));
 }
 
 // need separate assertNotEqual because operator!= may be overriden
 template <typename FirstCompareType, typename SecondCompareType>
-void assertNotEqualImpl(const std::string& label,
-        const FirstCompareType& a, const SecondCompareType& b,
-        const char* const function, const char* const file, int line)
+void assertNotEqualImpl(const AssertSite& site,
+        const FirstCompareType& a, const SecondCompareType& b)
 {
-    Controller &c = Controller::instance();
-    c.beforeAssert("assertNotEqual", label, function, file, line);
+    AssertionContext& c = Controller::currentContext();
+    c.beforeAssert(site);
 
     bool ok = (a != b);
 
     c.afterAssert(ok);
+    if (!ok)
+        c.onAssertFailureDetail(detail::formatValues(a, b));
 }
 
 template <class TestSuiteType,
           typename TestMethodType,
           typename ExceptionType>
-void assertThrowsImpl(const std::string &label,
+void assertThrowsImpl(const AssertSite& site,
                   TestSuiteType& testSuiteObject,
-                  TestMethodType testFunction,
-        const char* const function, const char* const file, int line)
+                  TestMethodType testFunction)
 {
-    Controller& c = Controller::instance();
-    c.beforeAssert("assertThrows", label, function, file, line);
+    AssertionContext& c = Controller::currentContext();
+    c.beforeAssert(site);
 
     try {
         // call object method
@@ -62,12 +128,11 @@ void assertThrowsImpl(const std::string &label,
 
 template <class TestSuiteType,
           typename TestMethodType>
-void assertWontThrowImpl(const std::string &label,
-        TestSuiteType& testSuiteObject, TestMethodType testFunction,
-        const char* const function, const char* const file, int line)
+void assertWontThrowImpl(const AssertSite& site,
+        TestSuiteType& testSuiteObject, TestMethodType testFunction)
 {
-    Controller& c = Controller::instance();
-    c.beforeAssert("assertWontThrow", label, function, file, line);
+    AssertionContext& c = Controller::currentContext();
+    c.beforeAssert(site);
 
     try {
         ((testSuiteObject).*(testFunction))();
@@ -79,4 +144,23 @@ void assertWontThrowImpl(const std::string &label,
     }
 }
 
+inline void assertNoAllocationsImpl(const AssertSite& site,
+        const AllocationStats& stats)
+{
+    AssertionContext& c = Controller::currentContext();
+    c.beforeAssert(site);
+
+    const bool tracked = AllocationScope::trackingEnabled();
+    c.afterAssert(tracked && stats.allocations == 0);
+
+    if (!tracked) {
+        c.onAssertFailureDetail("allocations are not tracked, link testcpp-alloc");
+    } else if (stats.allocations > 0) {
+        std::ostringstream detail;
+        detail << stats.allocations << " allocations of "
+               << stats.allocatedBytes << " bytes";
+        c.onAssertFailureDetail(detail.str());
+    }
+}
+
 #endif /* TESTCPP_THROWS_H */
@@ -0,0 +1,72 @@
+#ifndef TESTCPP_ALLOCATIONCOUNTERS_H__
+#define TESTCPP_ALLOCATIONCOUNTERS_H__
+
+#include <utilcpp/disable_copy.h>
+
+#include <cstddef>
+
+namespace Test
+{
+
+namespace detail
+{
+
+/**
+ * Heap allocations made on a thread, counted by the global allocation
+ * functions of the testcpp-alloc library.
+ */
+struct AllocationCounters
+{
+    unsigned long allocations;
+    unsigned long deallocations;
+    unsigned long allocatedBytes;
+    long liveAllocations;
+    long liveBytes;
+    long peakLiveBytes;
+
+    /** Allocations and deallocations are not counted while positive. */
+    int untrackedDepth;
+};
+
+/** Set when testcpp-alloc is linked into the program. */
+extern bool allocationTrackingLinked;
+
+AllocationCounters& threadAllocationCounters();
+
+/** Returns false if the allocation was not counted. */
+bool countAllocation(size_t size);
+
+void countDeallocation(size_t size);
+
+/**
+ * Keeps the allocations and deallocations of the framework, e.g. of
+ * observers, out of the counts of the test code on this thread for the
+ * lifetime of the scope.
+ */
+class UntrackedAllocations
+{
+    UTILCPP_DISABLE_COPY(UntrackedAllocations)
+
+public:
+    UntrackedAllocations() :
+        _counters(allocationTrackingLinked ? &threadAllocationCounters() : 0)
+    {
+        if (_counters)
+            ++_counters->untrackedDepth;
+    }
+
+    ~UntrackedAllocations()
+    {
+        if (_counters)
+            --_counters->untrackedDepth;
+    }
+
+private:
+    AllocationCounters* _counters;
+};
+
+}
+
+}
+
+#endif /* TESTCPP_ALLOCATIONCOUNTERS_H */
@@ -0,0 +1,61 @@
+#ifndef TESTCPP_ARRAYCOMPARE_H__
+#define TESTCPP_ARRAYCOMPARE_H__
+
+#include <cstddef>
+
+namespace Test
+{
+
+struct Tolerance;
+
+namespace detail
+{
+
+/** Mismatching elements found by the array comparison kernels. */
+struct ArrayMismatches
+{
+    enum { MAX_INDICES = 10 };
+
+    ArrayMismatches() :
+        count(0),
+        maxError(0)
+    { }
+
+    void add(size_t index)
+    {
+        if (count < MAX_INDICES)
+            indices[count] = index;
+        ++count;
+    }
+
+    size_t numIndices() const
+    { return count < MAX_INDICES ? count : static_cast<size_t>(MAX_INDICES); }
+
+    size_t count;
+
+    /** The first mismatching indices in increasing order. */
+    size_t indices[MAX_INDICES];
+
+    /** Largest absolute difference of all elements, floating point only. */
+    double maxError;
+};
+
+/**
+ * Compares elements bitwise, for integer types. The kernels use SSE2 or
+ * AVX2 when the processor supports them, see the TESTCPP_SIMD environment
+ * variable.
+ */
+void compareBytes(const void* a, const void* b, size_t elementSize,
+        size_t count, ArrayMismatches& mismatches);
+
+void compareFloats(const float* a, const float* b, size_t count,
+        const Tolerance& tolerance, ArrayMismatches& mismatches);
+
+void compareDoubles(const double* a, const double* b, size_t count,
+        const Tolerance& tolerance, ArrayMismatches& mismatches);
+
+}
+
+}
+
+#endif /* TESTCPP_ARRAYCOMPARE_H */
@@ -0,0 +1,26 @@
+#ifndef TESTCPP_CLOCK_H__
+#define TESTCPP_CLOCK_H__
+
+namespace Test
+{
+
+namespace detail
+{
+
+/**
+ * Monotonic high-resolution clock for timing, in seconds since an
+ * unspecified starting point.
+ */
+double monotonicSeconds();
+
+/** CPU time used by the calling thread, by the process where unsupported. */
+double threadCpuSeconds();
+
+/** Peak resident set size of the process in kilobytes, 0 if unsupported. */
+long peakResidentSetKilobytes();
+
+}
+
+}
+
+#endif /* TESTCPP_CLOCK_H */
@@ -0,0 +1,172 @@
+#ifndef TESTCPP_EVENTLOOP_H__
+#define TESTCPP_EVENTLOOP_H__
+
+#include <testcpp/testcpp.h>
+
+#ifdef TESTCPP_HAVE_ASYNC_TESTS
+
+#include <coroutine>
+#include <map>
+#include <vector>
+
+namespace Test
+{
+
+namespace detail
+{
+
+class EventLoop;
+
+/**
+ * An async test case in flight: the context that its assertions report to
+ * and the CPU time that its coroutines have used.
+ */
+struct AsyncCaseState
+{
+    explicit AsyncCaseState(AssertionContext& context_) :
+        context(&context_),
+        cpuSeconds(0),
+        done(false)
+    { }
+
+    AssertionContext* context;
+    double cpuSeconds;
+    bool done;
+};
+
+/**
+ * A coroutine suspended on the event loop. Kept in the awaiter, so that
+ * it lives in the coroutine frame, and cancelled if the frame is destroyed
+ * before the loop resumes the coroutine.
+ */
+class AsyncWait
+{
+    UTILCPP_DISABLE_COPY(AsyncWait)
+
+public:
+    AsyncWait() :
+        handle(),
+        caseState(0),
+        loop(0),
+        timer(),
+        hasTimer(false),
+        fd(-1),
+        timedOut(false)
+    { }
+
+    ~AsyncWait();
+
+    std::coroutine_handle<> handle;
+    AsyncCaseState* caseState;
+
+    /** The loop that the coroutine waits on, null when not waiting. */
+    EventLoop* loop;
+
+    std::multimap<double, AsyncWait*>::iterator timer;
+    bool hasTimer;
+    int fd;
+    bool timedOut;
+};
+
+/**
+ * Single-threaded event loop that resumes the coroutines of async test
+ * cases when their timers expire, their file descriptors become ready or
+ * their futures are set. Coroutines resume in the assertion context of
+ * their case. Waits on epoll, futures are polled every millisecond.
+ */
+class EventLoop
+{
+    UTILCPP_DISABLE_COPY(EventLoop)
+
+public:
+    enum FdEvent { READABLE, WRITABLE };
+
+    /**
+     * Becomes the loop of the calling thread until destroyed. Throws
+     * std::runtime_error if epoll is not available.
+     */
+    EventLoop();
+    ~EventLoop();
+
+    /**
+     * The loop of the calling thread. Throws std::logic_error when there
+     * is none, i.e. when awaited outside of an async test case.
+     */
+    static EventLoop& current();
+
+    /** Runs the coroutine of the case until it first suspends. */
+    void start(std::coroutine_handle<> handle, AsyncCaseState& caseState);
+
+    void waitUntil(double deadline, AsyncWait& wait,
+            std::coroutine_handle<> handle);
+
+    /**
+     * Waits for the file descriptor, or until the deadline when it is not
+     * 0. Regular files are always ready. Throws std::runtime_error if the
+     * descriptor cannot be waited for or another coroutine waits for the
+     * same event on it.
+     */
+    void waitForFd(int fd, FdEvent event, double deadline, AsyncWait& wait,
+            std::coroutine_handle<> handle);
+
+    typedef bool (*FutureReadyFunction)(const void* future);
+
+    void waitForFuture(FutureReadyFunction isReady, const void* future,
+            AsyncWait& wait, std::coroutine_handle<> handle);
+
+    void cancel(AsyncWait& wait);
+
+    /**
+     * Waits until coroutines are ready and resumes them. Returns false
+     * without waiting if no coroutine waits on the loop.
+     */
+    bool runOnce();
+
+private:
+    void suspend(AsyncWait& wait, std::coroutine_handle<> handle);
+    void resume(std::coroutine_handle<> handle, AsyncCaseState& caseState);
+
+    void addTimer(double deadline, AsyncWait& wait);
+    void removeFd(AsyncWait& wait);
+    void updateFd(int fd);
+
+    /** Stops waiting and queues the coroutine for resumption. */
+    void wake(AsyncWait& wait, std::vector<AsyncWait*>& ready);
+
+    struct FdWaiters
+    {
+        FdWaiters() :
+            reader(0),
+            writer(0),
+            registered(false)
+        { }
+
+        AsyncWait* reader;
+        AsyncWait* writer;
+        bool registered;
+    };
+
+    struct FutureWait
+    {
+        AsyncWait* wait;
+        FutureReadyFunction isReady;
+        const void* future;
+    };
+
+    int _epoll;
+    std::multimap<double, AsyncWait*> _timers;
+    std::map<int, FdWaiters> _fds;
+    std::vector<FutureWait> _futures;
+
+    /** The case of the coroutine that is running, null between resumptions. */
+    AsyncCaseState* _currentCase;
+    EventLoop* _previous;
+};
+
+}
+
+}
+
+#endif
+
+#endif /* TESTCPP_EVENTLOOP_H */
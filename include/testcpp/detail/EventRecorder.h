@@ -0,0 +1,103 @@
+#ifndef TESTCPP_EVENTRECORDER_H__
+#define TESTCPP_EVENTRECORDER_H__
+
+#include <testcpp/testcpp.h>
+
+#include <string>
+#include <cstddef>
+
+namespace Test
+{
+
+/**
+ * EventRecorder is an observer that encodes the events it receives into a
+ * compact byte buffer instead of handling them. The buffer can be replayed
+ * to another observer later, e.g. after a suite that ran on a worker thread
+ * has finished.
+ *
+ * Encoding: every event is a one-byte tag followed by its arguments,
+ * integers as variable-length unsigned LEB128 (zigzag for signed values)
+ * and strings as length-prefixed, zero-terminated bytes.
+ */
+class EventRecorder : public Observer
+{
+public:
+    EventRecorder() :
+        Observer(),
+        _buffer()
+    { }
+
+    const std::string& buffer() const
+    { return _buffer; }
+
+    void clear()
+    { _buffer.clear(); }
+
+    /**
+     * Replays the events encoded in data to observer. Exceptions are
+     * replayed as RecordedException.
+     *
+     * Throws std::runtime_error if data is malformed.
+     */
+    static void replay(const char* data, size_t size, Observer& observer);
+
+    static void replay(const std::string& buffer, Observer& observer)
+    { replay(buffer.data(), buffer.size(), observer); }
+
+    /**
+     * Replays the complete events at the start of data, e.g. the events
+     * received from a process that crashed while sending them. Returns the
+     * number of bytes replayed.
+     *
+     * Throws std::runtime_error if data is malformed.
+     */
+    static size_t replayComplete(const char* data, size_t size,
+            Observer& observer);
+
+    virtual void onTestSuiteBegin(const std::string& testSuiteLabel,
+            int testSuiteNum, int testSuitesNumTotal);
+
+    virtual void onTestSuiteEnd(int numErrs);
+    virtual void onTestSuiteEndWithStdException(int numErrs, const std::exception& e);
+    virtual void onTestSuiteEndWithEllipsisException(int numErrs);
+
+    virtual void onTestSuiteStats(const TestSuiteStats& stats);
+    virtual void onTestSuiteAllocations(const AllocationStats& stats);
+
+    virtual void onAssertBegin(const AssertSite& site);
+
+    virtual void onAssertEnd(bool ok);
+    virtual void onAssertExceptionEndWithExpectedException(const std::exception& e);
+    virtual void onAssertExceptionEndWithUnexpectedException(const std::exception& e);
+    virtual void onAssertExceptionEndWithEllipsisException();
+    virtual void onAssertNoExceptionEndWithStdException(const std::exception& e);
+    virtual void onAssertNoExceptionEndWithEllipsisException();
+
+    virtual void onAllTestSuitesBegin(int testSuitesNumTotal);
+    virtual void onAllTestSuitesEnd(int lastTestSuiteNum, int testSuitesNumTotal, int numErrs, int numExcepts);
+
+    virtual void onAssertFailureDetail(const std::string& detail);
+
+    virtual void onBenchmarkBegin(const std::string& benchmarkLabel,
+            int benchmarkNum, int benchmarksNumTotal);
+    virtual void onBenchmarkEnd(const BenchmarkResult& result);
+    virtual void onBenchmarkEndWithStdException(const std::exception& e);
+    virtual void onBenchmarkEndWithEllipsisException();
+
+    virtual void onTimingRegression(const TimingRegression& regression);
+
+protected:
+    /** Called after each event, override to stream the buffer out. */
+    virtual void eventRecorded()
+    { }
+
+    std::string& mutableBuffer()
+    { return _buffer; }
+
+private:
+    std::string _buffer;
+};
+
+}
+
+#endif /* TESTCPP_EVENTRECORDER_H */
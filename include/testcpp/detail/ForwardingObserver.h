@@ -0,0 +1,121 @@
+#ifndef TESTCPP_FORWARDINGOBSERVER_H__
+#define TESTCPP_FORWARDINGOBSERVER_H__
+
+#include <testcpp/testcpp.h>
+
+namespace Test
+{
+
+/**
+ * ForwardingObserver passes all events on to another observer. Derive from
+ * it to decorate an observer with additional behaviour by overriding only
+ * the events of interest.
+ */
+class ForwardingObserver : public Observer
+{
+public:
+    explicit ForwardingObserver(Observer& observer) :
+        Observer(),
+        _observer(&observer),
+        _doesOwnObserver(false)
+    { }
+
+    /** Takes ownership of observer. */
+    explicit ForwardingObserver(Observer* observer) :
+        Observer(),
+        _observer(observer),
+        _doesOwnObserver(true)
+    {
+        if (!observer)
+            throw std::runtime_error("Observer cannot be null");
+    }
+
+    virtual ~ForwardingObserver()
+    {
+        if (_doesOwnObserver)
+            delete _observer;
+    }
+
+    Observer& forwardedTo()
+    { return *_observer; }
+
+    virtual unsigned subscribedEvents() const
+    { return _observer->subscribedEvents(); }
+
+    virtual void onTestSuiteBegin(const std::string& testSuiteLabel,
+            int testSuiteNum, int testSuitesNumTotal)
+    { _observer->onTestSuiteBegin(testSuiteLabel, testSuiteNum, testSuitesNumTotal); }
+
+    virtual void onTestSuiteEnd(int numErrs)
+    { _observer->onTestSuiteEnd(numErrs); }
+
+    virtual void onTestSuiteEndWithStdException(int numErrs, const std::exception& e)
+    { _observer->onTestSuiteEndWithStdException(numErrs, e); }
+
+    virtual void onTestSuiteEndWithEllipsisException(int numErrs)
+    { _observer->onTestSuiteEndWithEllipsisException(numErrs); }
+
+    virtual void onTestSuiteStats(const TestSuiteStats& stats)
+    { _observer->onTestSuiteStats(stats); }
+
+    virtual void onTestSuiteAllocations(const AllocationStats& stats)
+    { _observer->onTestSuiteAllocations(stats); }
+
+    virtual void onAssertBegin(const AssertSite& site)
+    { _observer->onAssertBegin(site); }
+
+    virtual void onAssertEnd(bool ok)
+    { _observer->onAssertEnd(ok); }
+
+    virtual void onAssertExceptionEndWithExpectedException(const std::exception& e)
+    { _observer->onAssertExceptionEndWithExpectedException(e); }
+
+    virtual void onAssertExceptionEndWithUnexpectedException(const std::exception& e)
+    { _observer->onAssertExceptionEndWithUnexpectedException(e); }
+
+    virtual void onAssertExceptionEndWithEllipsisException()
+    { _observer->onAssertExceptionEndWithEllipsisException(); }
+
+    virtual void onAssertNoExceptionEndWithStdException(const std::exception& e)
+    { _observer->onAssertNoExceptionEndWithStdException(e); }
+
+    virtual void onAssertNoExceptionEndWithEllipsisException()
+    { _observer->onAssertNoExceptionEndWithEllipsisException(); }
+
+    virtual void onAllTestSuitesBegin(int testSuitesNumTotal)
+    { _observer->onAllTestSuitesBegin(testSuitesNumTotal); }
+
+    virtual void onAllTestSuitesEnd(int lastTestSuiteNum,
+            int testSuitesNumTotal, int numErrs, int numExcepts)
+    {
+        _observer->onAllTestSuitesEnd(lastTestSuiteNum,
+                testSuitesNumTotal, numErrs, numExcepts);
+    }
+
+    virtual void onAssertFailureDetail(const std::string& detail)
+    { _observer->onAssertFailureDetail(detail); }
+
+    virtual void onBenchmarkBegin(const std::string& benchmarkLabel,
+            int benchmarkNum, int benchmarksNumTotal)
+    { _observer->onBenchmarkBegin(benchmarkLabel, benchmarkNum, benchmarksNumTotal); }
+
+    virtual void onBenchmarkEnd(const BenchmarkResult& result)
+    { _observer->onBenchmarkEnd(result); }
+
+    virtual void onBenchmarkEndWithStdException(const std::exception& e)
+    { _observer->onBenchmarkEndWithStdException(e); }
+
+    virtual void onBenchmarkEndWithEllipsisException()
+    { _observer->onBenchmarkEndWithEllipsisException(); }
+
+    virtual void onTimingRegression(const TimingRegression& regression)
+    { _observer->onTimingRegression(regression); }
+
+private:
+    Observer* _observer;
+    bool _doesOwnObserver;
+};
+
+}
+
+#endif /* TESTCPP_FORWARDINGOBSERVER_H */
@@ -0,0 +1,115 @@
+#ifndef TESTCPP_SUITEREGISTRY_H__
+#define TESTCPP_SUITEREGISTRY_H__
+
+#include <testcpp/testcpp.h>
+
+#include <vector>
+
+namespace Test
+{
+
+namespace detail
+{
+
+/** Appends the descriptors of TESTCPP_SUITE registrations to suites. */
+void collectRegisteredSuites(std::vector<const SuiteDescriptor*>& suites);
+
+#ifndef TESTCPP_HAVE_SUITE_SECTION
+
+/**
+ * Fallback for toolchains without linker-section support: registrations
+ * are linked into an intrusive list during static initialization. The
+ * list head is zero-initialized before any constructor runs, so the
+ * initialization order of translation units does not matter.
+ */
+struct SuiteRegistration
+{
+    const SuiteDescriptor* descriptor;
+    SuiteRegistration* next;
+};
+
+class SuiteRegistrar
+{
+public:
+    explicit SuiteRegistrar(SuiteRegistration& registration)
+    {
+        registration.next = _head;
+        _head = &registration;
+    }
+
+    static const SuiteRegistration* head()
+    { return _head; }
+
+private:
+    static SuiteRegistration* _head;
+};
+
+#endif
+
+}
+
+}
+
+#define TESTCPP_CONCAT_IMPL(a__, b__) a__##b__
+#define TESTCPP_CONCAT(a__, b__) TESTCPP_CONCAT_IMPL(a__, b__)
+
+#ifdef __COUNTER__
+  #define TESTCPP_UNIQUE_ID __COUNTER__
+#else
+  #define TESTCPP_UNIQUE_ID __LINE__
+#endif
+
+#ifdef TESTCPP_HAVE_SUITE_SECTION
+
+// keep the entries even when the linker garbage-collects sections
+#if defined(__has_attribute)
+  #if __has_attribute(retain)
+    #define TESTCPP_RETAIN __attribute__((retain))
+  #endif
+#endif
+#ifndef TESTCPP_RETAIN
+  #define TESTCPP_RETAIN
+#endif
+
+// the linker collects the descriptor pointers of all translation units
+// into the testcpp_suites section and defines its start and stop symbols
+#define TESTCPP_REGISTER_SUITE_DESCRIPTOR(descriptor__, id__) \
+    __attribute__((used, section("testcpp_suites"))) TESTCPP_RETAIN \
+    const ::Test::SuiteDescriptor* const \
+        TESTCPP_CONCAT(testcpp_suite_entry_, id__) = &descriptor__;
+
+#else
+
+#define TESTCPP_REGISTER_SUITE_DESCRIPTOR(descriptor__, id__) \
+    ::Test::detail::SuiteRegistration \
+        TESTCPP_CONCAT(testcpp_suite_registration_, id__) = { &descriptor__, 0 }; \
+    const ::Test::detail::SuiteRegistrar \
+        TESTCPP_CONCAT(testcpp_suite_registrar_, id__)( \
+            TESTCPP_CONCAT(testcpp_suite_registration_, id__));
+
+#endif
+
+#define TESTCPP_SUITE_IMPL(suiteclass__, label__, id__) \
+    namespace { \
+        const ::Test::SuiteDescriptor TESTCPP_CONCAT(testcpp_suite_, id__) = \
+            { label__, &::Test::Suite::instance<suiteclass__>, 0, 0 }; \
+        TESTCPP_REGISTER_SUITE_DESCRIPTOR(TESTCPP_CONCAT(testcpp_suite_, id__), id__) \
+    }
+
+/**
+ * Registers a test suite class at namespace scope, labelled with the class
+ * name, or with the given label in TESTCPP_SUITE_LABELLED:
+ *
+ *   class MyTest : public Test::Suite { ... };
+ *   TESTCPP_SUITE(MyTest)
+ *
+ * Registered suites are added to the controller when it first runs, sorted
+ * by label, after the suites added with Controller::addTestSuite().
+ */
+#define TESTCPP_SUITE(suiteclass__) \
+    TESTCPP_SUITE_IMPL(suiteclass__, #suiteclass__, TESTCPP_UNIQUE_ID)
+
+#define TESTCPP_SUITE_LABELLED(suiteclass__, label__) \
+    TESTCPP_SUITE_IMPL(suiteclass__, label__, TESTCPP_UNIQUE_ID)
+
+#endif /* TESTCPP_SUITEREGISTRY_H */
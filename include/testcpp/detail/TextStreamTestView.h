@@ -4,7 +4,7 @@
 #include <testcpp/testcpp.h>
 
 #include <string>
-#include <typeinfo>
+#include <sstream>
 
 namespace Test
 {
@@ -26,6 +26,11 @@ public:
 
     virtual void flush() = 0;
     virtual TextStreamTestView& operator<< (const std::string& msg) = 0;
+
+    /** Override to avoid creating temporary strings. */
+    virtual TextStreamTestView& operator<< (const char* msg)
+    { return *this << std::string(msg); }
+
     virtual TextStreamTestView& operator<< (int msg) = 0;
     virtual TextStreamTestView& operator<< (EndLine) = 0;
     virtual TextStreamTestView& operator<< (Tab) = 0;
@@ -63,6 +68,17 @@ public:
               << "/" << total << "):" << END_LINE;
     }
 
+    virtual void onTestSuiteAllocations(const AllocationStats& stats)
+    {
+        if (stats.leakedBytes <= 0)
+            return;
+
+        std::ostringstream leak;
+        leak << "Leaked " << stats.leakedBytes << " bytes in "
+             << stats.leakedAllocations << " allocations";
+        *this << TAB << FAIL << leak.str() << NORMAL << END_LINE;
+    }
+
     virtual void onTestSuiteEnd(int numErrs)
     {
         *this << TAB << "---" << END_LINE;
@@ -101,15 +117,10 @@ public:
               << numErrs << " non-exception errors" << END_LINE;
     }
 
-    virtual void onAssertBegin(const std::string& assertType,
-        const std::string& testlabel,
-        const char* const function, const char* const file, int line)
+    virtual void onAssertBegin(const AssertSite& site)
     {
-        _assertType = assertType;
-        _function = function;
-        _file = file;
-        _line = line;
-        *this << TAB << "test '" << testlabel << "': ... ";
+        _site = site;
+        *this << TAB << "test '" << site.label << "': ... ";
     }
 
     virtual void onAssertEnd(bool ok)
@@ -146,6 +157,66 @@ public:
         onAssertExceptionEndWithEllipsisException();
     }
 
+    virtual void onAssertFailureDetail(const std::string& detail)
+    { *this << TAB << TAB << "(" << detail << ")" << END_LINE; }
+
+    virtual void onBenchmarkBegin(const std::string& benchmarkLabel,
+            int num, int total)
+    {
+        *this << "Benchmark '" << benchmarkLabel << "' (#" << num
+              << "/" << total << "):" << END_LINE;
+    }
+
+    virtual void onBenchmarkEnd(const BenchmarkResult& result)
+    {
+        *this << TAB << "median " << formatNanos(result.median)
+              << ", min " << formatNanos(result.min)
+              << ", p90 " << formatNanos(result.p90)
+              << ", p99 " << formatNanos(result.p99)
+              << ", mean " << formatNanos(result.mean)
+              << " per iteration" << END_LINE;
+
+        std::ostringstream iterations;
+        iterations << result.iterationsPerSample;
+
+        *this << TAB << static_cast<int>(result.samples.size())
+              << " samples of " << iterations.str() << " iterations, "
+              << result.rejectedSamples << " outliers rejected" << END_LINE;
+
+        if (result.counters.counted)
+            *this << TAB << formatCounters(result.counters)
+                  << " per iteration" << END_LINE;
+    }
+
+    virtual void onBenchmarkEndWithStdException(const std::exception& e)
+    {
+        *this << TAB << FAIL << "Unhandled exception" << NORMAL;
+        outputException(e);
+        *this << TAB << "Benchmark " << FAIL << "FAIL" << NORMAL
+              << " due to exception" << END_LINE;
+    }
+
+    virtual void onBenchmarkEndWithEllipsisException()
+    {
+        *this << TAB << FAIL << "Unhandled non-standard exception" << NORMAL
+              << END_LINE;
+        *this << TAB << "Benchmark " << FAIL << "FAIL" << NORMAL
+              << " due to exception" << END_LINE;
+    }
+
+    virtual void onTimingRegression(const TimingRegression& regression)
+    {
+        // suite times are in seconds
+        const double scale = regression.benchmark ? 1 : 1e9;
+
+        *this << FAIL << "Timing regression" << NORMAL << " in "
+              << (regression.benchmark ? "benchmark '" : "test suite '")
+              << regression.label << "': median "
+              << formatNanos(scale * regression.median) << ", baseline "
+              << formatNanos(scale * regression.baselineMedian) << ", limit "
+              << formatNanos(scale * regression.threshold) << END_LINE;
+    }
+
 private:
 
     void outputSeparator()
@@ -155,7 +226,7 @@ private:
 
     void outputException(const std::exception& e)
     {
-        const std::string &exceptionType(typeid(e).name());
+        const std::string &exceptionType(exceptionTypeName(e));
         *this << " '" << exceptionType << "'";
 
         const std::string& exceptionMsg(e.what());
@@ -184,7 +255,7 @@ private:
         *this << outputOkOrFail(ok);
 
         if (!ok) {
-            const std::string &exceptionType(typeid(e).name());
+            const std::string &exceptionType(exceptionTypeName(e));
             *this << ": unexpected exception '" + exceptionType + "'";
         }
 
@@ -196,20 +267,68 @@ private:
             outputFailureLocation();
     }
 
+    static std::string formatNanos(double nanos)
+    {
+        static const char* const units[] = { "ns", "us", "ms", "s" };
+        size_t unit = 0;
+        for (; nanos >= 1000 && unit < 3; ++unit)
+            nanos /= 1000;
+
+        std::ostringstream out;
+        out.precision(3);
+        out << nanos << " " << units[unit];
+        return out.str();
+    }
+
+    static std::string formatCounters(const PerformanceCounters& counters)
+    {
+        typedef PerformanceCounters PC;
+
+        std::ostringstream out;
+        out.precision(3);
+        const char* separator = "";
+
+        if (counters.has(PC::CYCLES) && counters.has(PC::INSTRUCTIONS)) {
+            out << "IPC " << counters.instructionsPerCycle();
+            separator = ", ";
+        }
+        if (counters.has(PC::TASK_CLOCK)) {
+            out << separator << formatNanos(1e9 * counters.taskClockSeconds)
+                << " task clock";
+            separator = ", ";
+        }
+
+        const struct { PC::Counter counter; double value; const char* name; }
+        values[] = {
+            { PC::CYCLES, counters.cycles, "cycles" },
+            { PC::INSTRUCTIONS, counters.instructions, "instructions" },
+            { PC::BRANCH_MISSES, counters.branchMisses, "branch misses" },
+            { PC::L1D_READ_MISSES, counters.l1dReadMisses, "L1D read misses" },
+            { PC::LLC_MISSES, counters.llcMisses, "LLC misses" },
+            { PC::CONTEXT_SWITCHES, counters.contextSwitches, "context switches" },
+            { PC::PAGE_FAULTS, counters.pageFaults, "page faults" }
+        };
+
+        for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i)
+            if (counters.has(values[i].counter)) {
+                out << separator << values[i].value << " " << values[i].name;
+                separator = ", ";
+            }
+
+        return out.str();
+    }
+
     void outputExceptionMessage(const std::string& exceptionMsg)
     { *this << TAB << TAB << "(message: '" << exceptionMsg << "')"; }
 
     void outputFailureLocation()
     {
         *this << TAB << TAB
-              << _file << "(" << _line << "): error: "
-              << _assertType << " failed in " << _function << END_LINE;
+              << _site.file << "(" << _site.line << "): error: "
+              << _site.assertType << " failed in " << _site.function << END_LINE;
     }
 
-    std::string _assertType;
-    std::string _function;
-    std::string _file;
-    int _line;
+    AssertSite _site;
 };
 
 }
@@ -0,0 +1,36 @@
+#ifndef TESTCPP_WATCHDOG_H__
+#define TESTCPP_WATCHDOG_H__
+
+#include <testcpp/testcpp.h>
+
+#include <string>
+
+namespace Test
+{
+
+namespace detail
+{
+
+/**
+ * Describes a test suite that ran out of time. lastAssertFile is null when
+ * the suite did not begin any assertions.
+ */
+RecordedException timeoutException(const std::string& reason,
+        const char* lastAssertFile, int lastAssertLine);
+
+std::string timeoutReason(const char* what, double seconds);
+
+/** Loads what writeStackTrace() needs, so that signal handlers can call it. */
+void prepareStackTrace();
+
+/**
+ * Writes the stack of the calling thread to the file descriptor where
+ * supported. Async-signal-safe after prepareStackTrace().
+ */
+void writeStackTrace(int fd);
+
+}
+
+}
+
+#endif /* TESTCPP_WATCHDOG_H */
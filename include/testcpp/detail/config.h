@@ -0,0 +1,38 @@
+#ifndef TESTCPP_CONFIG_H__
+#define TESTCPP_CONFIG_H__
+
+#include <utilcpp/detect_cpp11.h>
+
+// std::thread and friends are available in C++11 mode, except for
+// Visual Studio 2010 that lacks <thread>.
+#if defined(UTILCPP_HAVE_CPP11) && (!defined(_MSC_VER) || _MSC_VER >= 1700)
+  #define TESTCPP_HAVE_THREADS
+#endif
+
+// thread_local is not supported before Visual Studio 2015,
+// __declspec(thread) is sufficient for plain pointers.
+#if defined(_MSC_VER) && _MSC_VER < 1900
+  #define TESTCPP_THREAD_LOCAL __declspec(thread)
+#elif defined(UTILCPP_HAVE_CPP11)
+  #define TESTCPP_THREAD_LOCAL thread_local
+#elif defined(__GNUC__)
+  #define TESTCPP_THREAD_LOCAL __thread
+#else
+  #define TESTCPP_THREAD_LOCAL
+#endif
+
+// GCC and Clang on ELF platforms define __start_ and __stop_ symbols for
+// sections named like C identifiers, used for the static suite registry.
+#if defined(__ELF__) && defined(__GNUC__)
+  #define TESTCPP_HAVE_SUITE_SECTION
+#endif
+
+// C++20 coroutines for async test cases, driven by an epoll event loop.
+#if defined(TESTCPP_HAVE_THREADS) && defined(__linux__) \
+    && defined(__cpp_impl_coroutine) && defined(__has_include)
+  #if __has_include(<coroutine>)
+    #define TESTCPP_HAVE_ASYNC_TESTS
+  #endif
+#endif
+
+#endif /* TESTCPP_CONFIG_H */
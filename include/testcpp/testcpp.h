@@ -15,17 +15,33 @@
 #define TESTCPP_H__
 
 #include <utilcpp/declarations.h>
+#include <utilcpp/disable_copy.h>
 #include <utilcpp/detect_cpp11.h>
 #ifndef UTILCPP_HAVE_CPP11
   #include <utilcpp/scoped_ptr.h>
 #endif
 
+#include <testcpp/detail/config.h>
+#include <testcpp/detail/AllocationCounters.h>
+#include <testcpp/Benchmark.h>
+
+#ifdef TESTCPP_HAVE_THREADS
+  #include <atomic>
+  #include <mutex>
+#endif
+
 #include <string>
 #include <vector>
+#include <deque>
+#include <map>
 #include <memory>
 #include <utility>
 
 #include <exception>
+#include <stdexcept>
+#include <typeinfo>
+#include <sstream>
+#include <ios>
 
 namespace Test
 {
@@ -63,31 +79,81 @@ public:
     }
 };
 
-void assertTrueImpl(const std::string& label, bool ok,
-        const char* const function, const char* const file, int line);
+typedef suite_transferable_ptr (*SuiteFactoryFunction)();
+
+/** Creates a suite for the parameter it was registered with. */
+typedef suite_transferable_ptr (*ParameterizedSuiteFactoryFunction)(
+        const void* parameter);
+
+/**
+ * Describes a registered test suite. Descriptors of suites registered with
+ * TESTCPP_SUITE are constant-initialized, so registration runs no code and
+ * allocates nothing, see SuiteRegistry.h.
+ */
+struct SuiteDescriptor
+{
+    const char* label;
+    SuiteFactoryFunction factory;
+
+    /** Used instead of factory when set. */
+    ParameterizedSuiteFactoryFunction parameterizedFactory;
+    const void* parameter;
+
+    suite_transferable_ptr create() const
+    { return parameterizedFactory ? parameterizedFactory(parameter) : factory(); }
+};
+
+/**
+ * Describes an assertion call site. The macros define the descriptors as
+ * static constants where possible, so that passing assertions neither
+ * allocate nor copy strings.
+ */
+struct AssertSite
+{
+    const char* assertType;
+    const char* label;
+    const char* function;
+    const char* file;
+    int line;
+};
+
+inline AssertSite assertSite(const char* assertType, const char* label,
+        const char* function, const char* file, int line)
+{
+    AssertSite site = { assertType, label, function, file, line };
+    return site;
+}
+
+// the label string must outlive the assertion, see the macros below
+inline AssertSite assertSite(const char* assertType, const std::string& label,
+        const char* function, const char* file, int line)
+{ return assertSite(assertType, label.c_str(), function, file, line); }
+
+void assertTrueImpl(const AssertSite& site, bool ok);
 
 template <typename FirstCompareType, typename SecondCompareType>
-void assertEqualImpl(const std::string& label,
-        const FirstCompareType& a, const SecondCompareType& b,
-        const char* const function, const char* const file, int line);
+void assertEqualImpl(const AssertSite& site,
+        const FirstCompareType& a, const SecondCompareType& b);
 
 template <typename FirstCompareType, typename SecondCompareType>
-void assertNotEqualImpl(const std::string& label,
-        const FirstCompareType& a, const SecondCompareType& b,
-        const char* const function, const char* const file, int line);
+void assertNotEqualImpl(const AssertSite& site,
+        const FirstCompareType& a, const SecondCompareType& b);
 
 template <class TestSuiteType,
           typename TestMethodType,
           typename ExceptionType>
-void assertThrowsImpl(const std::string &label,
-        TestSuiteType& testSuiteObject, TestMethodType testFunction,
-        const char* const function, const char* const file, int line);
+void assertThrowsImpl(const AssertSite& site,
+        TestSuiteType& testSuiteObject, TestMethodType testFunction);
 
 template <class TestSuiteType,
           typename TestMethodType>
-void assertWontThrowImpl(const std::string &label,
-        TestSuiteType& testSuiteObject, TestMethodType testFunction,
-        const char* const function, const char* const file, int line);
+void assertWontThrowImpl(const AssertSite& site,
+        TestSuiteType& testSuiteObject, TestMethodType testFunction);
+
+struct AllocationStats;
+
+void assertNoAllocationsImpl(const AssertSite& site,
+        const AllocationStats& stats);
 }
 
 // macros are in the global namespace
@@ -106,11 +172,27 @@ void assertWontThrowImpl(const std::string &label,
 #define EXPAND_MACRO(x__) x__
 #define GET_MACRO_OVERLOAD(_1, _2, _3, NAME, ...) NAME
 
+// Assertions with generated labels use static call site descriptors,
+// assertions with custom labels construct the descriptor in the same full
+// expression as the call, so that temporary label strings stay valid.
+#define TESTCPP_STATIC_ASSERT_SITE(assertType__, label__) \
+    static const Test::AssertSite site__ = \
+        { assertType__, label__, function__, __FILE__, __LINE__ }
+
+#define TESTCPP_ASSERT_SITE(assertType__, label__) \
+    Test::assertSite(assertType__, label__, function__, __FILE__, __LINE__)
+
+// (void)0 avoids the constant condition warning in Visual Studio
+#define TESTCPP_STATEMENT(...) \
+    do { __VA_ARGS__ } while ((void)0, 0)
+
 #define assertTrue1(ok__) \
-    Test::assertTrueImpl(#ok__, (ok__), function__, __FILE__, __LINE__)
+    TESTCPP_STATEMENT( \
+        TESTCPP_STATIC_ASSERT_SITE("assertTrue", #ok__); \
+        Test::assertTrueImpl(site__, (ok__)); )
 
 #define assertTrue2(label__, ok__) \
-    Test::assertTrueImpl(label__, (ok__), function__, __FILE__, __LINE__)
+    Test::assertTrueImpl(TESTCPP_ASSERT_SITE("assertTrue", label__), (ok__))
 
 #define assertTrue(...) \
     EXPAND_MACRO(GET_MACRO_OVERLOAD(__VA_ARGS__, _, \
@@ -118,10 +200,12 @@ void assertWontThrowImpl(const std::string &label,
 
 
 #define assertFalse1(ok__) \
-    Test::assertTrueImpl("!("#ok__")", !(ok__), function__, __FILE__, __LINE__)
+    TESTCPP_STATEMENT( \
+        TESTCPP_STATIC_ASSERT_SITE("assertTrue", "!("#ok__")"); \
+        Test::assertTrueImpl(site__, !(ok__)); )
 
 #define assertFalse2(label__, ok__) \
-    Test::assertTrueImpl(label__, !(ok__), function__, __FILE__, __LINE__)
+    Test::assertTrueImpl(TESTCPP_ASSERT_SITE("assertTrue", label__), !(ok__))
 
 #define assertFalse(...) \
     EXPAND_MACRO(GET_MACRO_OVERLOAD(__VA_ARGS__, _, \
@@ -129,11 +213,13 @@ void assertWontThrowImpl(const std::string &label,
 
 
 #define assertEqual1(a__, b__) \
-    Test::assertEqualImpl(#a__ " == " #b__, (a__), (b__), \
-            function__, __FILE__, __LINE__)
+    TESTCPP_STATEMENT( \
+        TESTCPP_STATIC_ASSERT_SITE("assertEqual", #a__ " == " #b__); \
+        Test::assertEqualImpl(site__, (a__), (b__)); )
 
 #define assertEqual2(label__, a__, b__) \
-    Test::assertEqualImpl(label__, (a__), (b__), function__, __FILE__, __LINE__)
+    Test::assertEqualImpl(TESTCPP_ASSERT_SITE("assertEqual", label__), \
+            (a__), (b__))
 
 #define assertEqual(...) \
     EXPAND_MACRO(GET_MACRO_OVERLOAD(__VA_ARGS__, \
@@ -141,25 +227,29 @@ void assertWontThrowImpl(const std::string &label,
 
 
 #define assertNotEqual1(a__, b__) \
-    Test::assertNotEqualImpl(#a__ " != " #b__, (a__), (b__), \
-            function__, __FILE__, __LINE__)
+    TESTCPP_STATEMENT( \
+        TESTCPP_STATIC_ASSERT_SITE("assertNotEqual", #a__ " != " #b__); \
+        Test::assertNotEqualImpl(site__, (a__), (b__)); )
 
 #define assertNotEqual2(label__, a__, b__) \
-    Test::assertNotEqualImpl(label__, (a__), (b__), \
-            function__, __FILE__, __LINE__)
+    Test::assertNotEqualImpl(TESTCPP_ASSERT_SITE("assertNotEqual", label__), \
+            (a__), (b__))
 
 #define assertNotEqual(...) \
     EXPAND_MACRO(GET_MACRO_OVERLOAD(__VA_ARGS__, \
             assertNotEqual2, assertNotEqual1)(__VA_ARGS__))
 
 #define assertThrows1(functionname__, exceptiontype__) \
-    Test::assertThrowsImpl<testsuite_class_type__, testmethod_type__, exceptiontype__> \
-    (#functionname__ " throws " #exceptiontype__, \
-     *this, &testsuite_class_type__::functionname__, function__, __FILE__, __LINE__)
+    TESTCPP_STATEMENT( \
+        TESTCPP_STATIC_ASSERT_SITE("assertThrows", \
+            #functionname__ " throws " #exceptiontype__); \
+        Test::assertThrowsImpl<testsuite_class_type__, testmethod_type__, exceptiontype__> \
+        (site__, *this, &testsuite_class_type__::functionname__); )
 
 #define assertThrows2(label__, functionname__, exceptiontype__) \
     Test::assertThrowsImpl<testsuite_class_type__, testmethod_type__, exceptiontype__> \
-    (label__, *this, &testsuite_class_type__::functionname__, function__, __FILE__, __LINE__)
+    (TESTCPP_ASSERT_SITE("assertThrows", label__), \
+     *this, &testsuite_class_type__::functionname__)
 
 #define assertThrows(...) \
     EXPAND_MACRO(GET_MACRO_OVERLOAD(__VA_ARGS__, \
@@ -167,21 +257,170 @@ void assertWontThrowImpl(const std::string &label,
 
 
 #define assertWontThrow1(functionname__) \
-    Test::assertWontThrowImpl<testsuite_class_type__, testmethod_type__> \
-    (#functionname__ " won't throw exceptions", \
-     *this, &testsuite_class_type__::functionname__, function__, __FILE__, __LINE__)
+    TESTCPP_STATEMENT( \
+        TESTCPP_STATIC_ASSERT_SITE("assertWontThrow", \
+            #functionname__ " won't throw exceptions"); \
+        Test::assertWontThrowImpl<testsuite_class_type__, testmethod_type__> \
+        (site__, *this, &testsuite_class_type__::functionname__); )
 
 #define assertWontThrow2(label__, functionname__) \
     Test::assertWontThrowImpl<testsuite_class_type__, testmethod_type__> \
-    (label__, *this, &testsuite_class_type__::functionname__, function__, __FILE__, __LINE__)
+    (TESTCPP_ASSERT_SITE("assertWontThrow", label__), \
+     *this, &testsuite_class_type__::functionname__)
 
 #define assertWontThrow(...) \
     EXPAND_MACRO(GET_MACRO_OVERLOAD(__VA_ARGS__, _, \
             assertWontThrow2, assertWontThrow1)(__VA_ARGS__))
 
+// runs the statements and fails if they allocated on the heap, requires
+// the testcpp-alloc library
+#define assertNoAllocations(...) \
+    TESTCPP_STATEMENT( \
+        TESTCPP_STATIC_ASSERT_SITE("assertNoAllocations", \
+            #__VA_ARGS__ " does not allocate"); \
+        Test::AllocationScope allocationScope__; \
+        __VA_ARGS__; \
+        Test::assertNoAllocationsImpl(site__, allocationScope__.stats()); )
+
 namespace Test
 {
 
+/**
+ * Stands in for an exception that was thrown in another thread or process
+ * and reached the observer through a recorded event. Keeps the type name
+ * and message of the original exception.
+ */
+class RecordedException : public std::exception
+{
+public:
+    RecordedException(const std::string& typeName, const std::string& what) :
+        std::exception(),
+        _typeName(typeName),
+        _what(what)
+    { }
+
+    virtual ~RecordedException() throw()
+    { }
+
+    virtual const char* what() const throw()
+    { return _what.c_str(); }
+
+    const std::string& typeName() const
+    { return _typeName; }
+
+private:
+    std::string _typeName;
+    std::string _what;
+};
+
+/** Returns the type name of the exception, see RecordedException. */
+inline std::string exceptionTypeName(const std::exception& e)
+{
+    const RecordedException* recorded =
+        dynamic_cast<const RecordedException*>(&e);
+    return recorded ? recorded->typeName() : typeid(e).name();
+}
+
+/** Resource usage of a test suite, measured where the suite runs. */
+struct TestSuiteStats
+{
+    TestSuiteStats() :
+        wallSeconds(0),
+        cpuSeconds(0),
+        peakResidentSetKilobytes(0),
+        counters()
+    { }
+
+    /** Time from construction to destruction of the suite. */
+    double wallSeconds;
+
+    /** CPU time of the thread that ran the suite. */
+    double cpuSeconds;
+
+    /** Peak resident set size of the process at the end of the suite. */
+    long peakResidentSetKilobytes;
+
+    /**
+     * CPU events of the thread that ran the suite, when the controller
+     * counts them, see Controller::setPerformanceCounters().
+     */
+    PerformanceCounters counters;
+};
+
+/**
+ * Heap allocations made through operator new on one thread while a test
+ * suite or an AllocationScope ran. Counted only when the testcpp-alloc
+ * library is linked, allocations of other threads and over-aligned
+ * allocations are not counted.
+ */
+struct AllocationStats
+{
+    AllocationStats() :
+        allocations(0),
+        deallocations(0),
+        allocatedBytes(0),
+        peakLiveBytes(0),
+        leakedAllocations(0),
+        leakedBytes(0)
+    { }
+
+    unsigned long allocations;
+    unsigned long deallocations;
+    unsigned long allocatedBytes;
+
+    /** Most bytes allocated and not yet freed at any time. */
+    unsigned long peakLiveBytes;
+
+    /** Allocations that were not freed, negative if more were freed. */
+    long leakedAllocations;
+    long leakedBytes;
+};
+
+/** Counts the allocations on this thread for the lifetime of the scope. */
+class AllocationScope
+{
+    UTILCPP_DISABLE_COPY(AllocationScope)
+
+public:
+    AllocationScope();
+    ~AllocationScope();
+
+    /** The allocations since the scope began. */
+    AllocationStats stats() const;
+
+    /** True if testcpp-alloc is linked and allocations are counted. */
+    static bool trackingEnabled()
+    { return detail::allocationTrackingLinked; }
+
+private:
+    detail::AllocationCounters _start;
+};
+
+/**
+ * A test suite or benchmark that ran significantly slower than its
+ * baseline, see Controller::setBaselineFile(). Times are in seconds for
+ * suites and in nanoseconds per iteration for benchmarks.
+ */
+struct TimingRegression
+{
+    TimingRegression() :
+        label(),
+        benchmark(false),
+        baselineMedian(0),
+        median(0),
+        threshold(0)
+    { }
+
+    std::string label;
+    bool benchmark;
+
+    double baselineMedian;
+    double median;
+
+    /** Medians above this are regressions. */
+    double threshold;
+};
+
 /**
  * Interface for observing test progress. Suitable for displaying results,
  * timing etc.
@@ -191,6 +430,28 @@ class Observer
     UTILCPP_DECLARE_INTERFACE(Observer)
 
 public:
+    /** Assertion events that an observer can opt out of. */
+    enum SubscribedEvents
+    {
+        /** onAssertBegin() of every assertion. */
+        ASSERT_BEGIN_EVENTS = 1,
+
+        /** The end events of passing assertions. */
+        PASSED_ASSERT_END_EVENTS = 2,
+
+        ALL_EVENTS = ASSERT_BEGIN_EVENTS | PASSED_ASSERT_END_EVENTS
+    };
+
+    /**
+     * The assertion events to dispatch to the observer, queried when the
+     * observer is set. Ends of failed assertions, failure details, suite
+     * and run events are always dispatched. Observers that ignore assertion
+     * begins or passing assertions opt out of them to take them off the
+     * assertion path.
+     */
+    virtual unsigned subscribedEvents() const
+    { return ALL_EVENTS; }
+
     virtual void onTestSuiteBegin(const std::string& testSuiteLabel,
             int testSuiteNum, int testSuitesNumTotal) = 0;
 
@@ -198,9 +459,11 @@ public:
     virtual void onTestSuiteEndWithStdException(int numErrs, const std::exception& e) = 0;
     virtual void onTestSuiteEndWithEllipsisException(int numErrs) = 0;
 
-    virtual void onAssertBegin(const std::string& assertType,
-        const std::string& testlabel,
-        const char* const function, const char* const file, int line) = 0;
+    /**
+     * The strings in site are valid until the assertion has ended, copy
+     * the site (not the strings) to use it in the end events.
+     */
+    virtual void onAssertBegin(const AssertSite& site) = 0;
 
     virtual void onAssertEnd(bool ok) = 0;
     virtual void onAssertExceptionEndWithExpectedException(const std::exception& e) = 0;
@@ -211,65 +474,779 @@ public:
 
     virtual void onAllTestSuitesBegin(int testSuitesNumTotal) = 0;
     virtual void onAllTestSuitesEnd(int lastTestSuiteNum, int testSuitesNumTotal, int numErrs, int numExcepts) = 0;
+
+    /**
+     * Details of a failed assertion, e.g. the compared values of
+     * assertEqual, follow the end of the assertion. Only formatted and
+     * reported on failure.
+     */
+    virtual void onAssertFailureDetail(const std::string&)
+    { }
+
+    /** Resource usage of the suite, reported before the suite ends. */
+    virtual void onTestSuiteStats(const TestSuiteStats&)
+    { }
+
+    /**
+     * Heap allocations of the suite from construction to destruction,
+     * reported before the suite ends when testcpp-alloc is linked. Leaked
+     * allocations were not freed by the time the suite was destroyed.
+     */
+    virtual void onTestSuiteAllocations(const AllocationStats&)
+    { }
+
+    virtual void onBenchmarkBegin(const std::string&, int, int)
+    { }
+
+    virtual void onBenchmarkEnd(const BenchmarkResult&)
+    { }
+
+    virtual void onBenchmarkEndWithStdException(const std::exception&)
+    { }
+
+    virtual void onBenchmarkEndWithEllipsisException()
+    { }
+
+    /**
+     * A suite or benchmark got slower than its baseline. Reported after
+     * the benchmarks and counted as an error.
+     */
+    virtual void onTimingRegression(const TimingRegression&)
+    { }
 };
 
+namespace detail
+{
 
-/** The singleton control class registers tests and controls execution. */
-class Controller
+/** Locks the observer of a context that threads share, if any. */
+class SharedObserverLock
 {
+    UTILCPP_DISABLE_COPY(SharedObserverLock)
+
 public:
-    static Controller& instance();
+#ifdef TESTCPP_HAVE_THREADS
+    explicit SharedObserverLock(std::mutex* lock) :
+        _lock(lock)
+    {
+        if (_lock)
+            _lock->lock();
+    }
+
+    ~SharedObserverLock()
+    {
+        if (_lock)
+            _lock->unlock();
+    }
 
-    typedef suite_transferable_ptr (*TestSuiteFactoryFunction)();
-    typedef std::pair<std::string, TestSuiteFactoryFunction> LabelAndFactoryFunctionPair;
+private:
+    std::mutex* _lock;
+#else
+    explicit SharedObserverLock(void*)
+    { }
+#endif
+};
 
-    void addTestSuite(const std::string &label, TestSuiteFactoryFunction ffn)
-    { _testSuiteFactories.push_back(LabelAndFactoryFunctionPair(label, ffn)); }
+}
 
-    void setObserver(Observer* observer, bool takeOwnership = true)
+#ifdef TESTCPP_STATIC_OBSERVER
+
+#ifndef TESTCPP_STATIC_OBSERVER_HEADER
+  #error TESTCPP_STATIC_OBSERVER requires TESTCPP_STATIC_OBSERVER_HEADER
+#endif
+
+class TESTCPP_STATIC_OBSERVER;
+
+namespace detail
+{
+
+/**
+ * Calls the assertion events of the observer type chosen at build time
+ * without virtual dispatch, so that they can be inlined. A template, as
+ * the observer type is only complete at the end of the header.
+ */
+template <class StaticObserverType>
+struct StaticObserverDispatch
+{
+    static bool matches(const Observer& observer)
+    { return typeid(observer) == typeid(StaticObserverType); }
+
+    static void onAssertBegin(Observer& observer, const AssertSite& site)
+    {
+        static_cast<StaticObserverType&>(observer)
+            .StaticObserverType::onAssertBegin(site);
+    }
+
+    static void onAssertEnd(Observer& observer, bool ok)
+    {
+        static_cast<StaticObserverType&>(observer)
+            .StaticObserverType::onAssertEnd(ok);
+    }
+};
+
+typedef StaticObserverDispatch<TESTCPP_STATIC_OBSERVER> StaticDispatch;
+
+}
+
+#endif
+
+/**
+ * Describes what a test works on, such as the record of a DataSuite. Added
+ * as a failure detail to the assertions that fail while it is set, see
+ * AssertionContext::setFailureNote(). Only called on failure.
+ */
+class FailureNote
+{
+    UTILCPP_DECLARE_INTERFACE(FailureNote)
+
+public:
+    virtual std::string describe() const = 0;
+};
+
+/**
+ * Assertion context collects the results of assertions made on a thread:
+ * the error count and the observer that receives the assertion events.
+ *
+ * Every running test suite has its own context, so suites that run in
+ * parallel never share error counters.
+ */
+class AssertionContext
+{
+    UTILCPP_DISABLE_COPY(AssertionContext)
+
+public:
+    explicit AssertionContext(Observer* observer) :
+#ifdef TESTCPP_HAVE_THREADS
+        _adoptedLock(),
+#endif
+        _observer(observer),
+        _subscribedEvents(observer->subscribedEvents()),
+        _isStaticObserver(isStaticObserver(*observer)),
+#ifdef TESTCPP_HAVE_THREADS
+        _lastAssertFile(0),
+        _lastAssertLine(0),
+#endif
+        _errs(0),
+        _adoptedErrs(0),
+        _adoptedEvents(),
+        _failureNote(0),
+        _sharedObserverLock(0)
+    { }
+
+    /**
+     * For contexts that record events on behalf of another observer,
+     * dispatches only the events that it subscribes to. The observer is
+     * not accessed during construction.
+     */
+    AssertionContext(Observer* observer, unsigned subscribedEvents) :
+#ifdef TESTCPP_HAVE_THREADS
+        _adoptedLock(),
+#endif
+        _observer(observer),
+        _subscribedEvents(subscribedEvents),
+        _isStaticObserver(false),
+#ifdef TESTCPP_HAVE_THREADS
+        _lastAssertFile(0),
+        _lastAssertLine(0),
+#endif
+        _errs(0),
+        _adoptedErrs(0),
+        _adoptedEvents(),
+        _failureNote(0),
+        _sharedObserverLock(0)
+    { }
+
+    Observer& observer()
+    { return *_observer; }
+
+    void setObserver(Observer* observer)
     {
-        if (!observer)
-            throw std::runtime_error("Observer cannot be null");
-        deleteObserverIfOwningIt();
-        _doesOwnObserver = takeOwnership;
         _observer = observer;
+        _subscribedEvents = observer->subscribedEvents();
+        _isStaticObserver = isStaticObserver(*observer);
+    }
+
+    unsigned subscribedEvents() const
+    { return _subscribedEvents; }
+
+#ifdef TESTCPP_HAVE_THREADS
+    /**
+     * Location of the last assertion that began in this context, null if
+     * none has. Safe to call from any thread, see the suite timeouts.
+     */
+    const char* lastAssertFile() const
+    { return _lastAssertFile.load(std::memory_order_relaxed); }
+
+    int lastAssertLine() const
+    { return _lastAssertLine.load(std::memory_order_relaxed); }
+#endif
+
+    int errs() const
+    { return _errs; }
+
+    void resetErrs()
+    { _errs = 0; }
+
+    /** Returns the error count and resets it. Safe to call from any thread. */
+    int takeErrs()
+    {
+#ifdef TESTCPP_HAVE_THREADS
+        return _errs.exchange(0);
+#else
+        const int errs = _errs;
+        _errs = 0;
+        return errs;
+#endif
     }
 
-    int run();
+#ifdef TESTCPP_HAVE_THREADS
+    /**
+     * Makes the context safe to share between threads: errors are counted
+     * atomically and the observer is called under the given lock.
+     */
+    void shareBetweenThreads(std::mutex& observerLock)
+    { _sharedObserverLock = &observerLock; }
+#endif
+
+    /** Adds the note to failed assertions until reset with null. */
+    void setFailureNote(const FailureNote* note)
+    { _failureNote = note; }
+
+    const FailureNote* failureNote() const
+    { return _failureNote; }
+
+    /**
+     * Takes over the results of an assertion context of another thread,
+     * see ThreadAssertionContext. Safe to call from any thread.
+     */
+    void adopt(int errs, const std::string& events);
 
-    void beforeAssert(const std::string& assertType,
-        const std::string& testlabel,
-        const char* const function, const char* const file, int line)
-    { _observer->onAssertBegin(assertType, testlabel, function, file, line); }
+    /**
+     * Adds the adopted errors to the error count and passes the adopted
+     * events on to the observer. Called when the test suite ends.
+     */
+    void mergeAdopted();
+
+    void beforeAssert(const AssertSite& site)
+    {
+#ifdef TESTCPP_HAVE_THREADS
+        // file names are string literals
+        _lastAssertFile.store(site.file, std::memory_order_relaxed);
+        _lastAssertLine.store(site.line, std::memory_order_relaxed);
+#endif
+        if (!(_subscribedEvents & Observer::ASSERT_BEGIN_EVENTS))
+            return;
+        // observers may allocate, the test code is counted
+        detail::UntrackedAllocations untracked;
+        detail::SharedObserverLock lock(_sharedObserverLock);
+#ifdef TESTCPP_STATIC_OBSERVER
+        if (_isStaticObserver) {
+            detail::StaticDispatch::onAssertBegin(*_observer, site);
+            return;
+        }
+#endif
+        _observer->onAssertBegin(site);
+    }
 
     void afterAssert(bool ok)
     {
         if (!ok)
-            ++_curTestSuiteErrs;
-        _observer->onAssertEnd(ok);
+            ++_errs;
+        else if (!(_subscribedEvents & Observer::PASSED_ASSERT_END_EVENTS))
+            return;
+        detail::UntrackedAllocations untracked;
+        detail::SharedObserverLock lock(_sharedObserverLock);
+#ifdef TESTCPP_STATIC_OBSERVER
+        if (_isStaticObserver)
+            detail::StaticDispatch::onAssertEnd(*_observer, ok);
+        else
+#endif
+            _observer->onAssertEnd(ok);
+        if (!ok && _failureNote)
+            _observer->onAssertFailureDetail(_failureNote->describe());
     }
 
     void onAssertExceptionEndWithExpectedException(const std::exception& e)
-    { _observer->onAssertExceptionEndWithExpectedException(e); }
+    {
+        if (_subscribedEvents & Observer::PASSED_ASSERT_END_EVENTS) {
+            detail::UntrackedAllocations untracked;
+            detail::SharedObserverLock lock(_sharedObserverLock);
+            _observer->onAssertExceptionEndWithExpectedException(e);
+        }
+    }
 
     void onAssertExceptionEndWithUnexpectedException(const std::exception* e = 0)
     {
-        ++_curTestSuiteErrs;
+        ++_errs;
+        detail::UntrackedAllocations untracked;
+        detail::SharedObserverLock lock(_sharedObserverLock);
         if (e)
             _observer->onAssertExceptionEndWithUnexpectedException(*e);
         else
             _observer->onAssertExceptionEndWithEllipsisException();
+        if (_failureNote)
+            _observer->onAssertFailureDetail(_failureNote->describe());
     }
 
     void onAssertNoExceptionEndWithException(const std::exception* e = 0)
     {
-        ++_curTestSuiteErrs;
+        ++_errs;
+        detail::UntrackedAllocations untracked;
+        detail::SharedObserverLock lock(_sharedObserverLock);
         if (e)
             _observer->onAssertNoExceptionEndWithStdException(*e);
         else
             _observer->onAssertNoExceptionEndWithEllipsisException();
+        if (_failureNote)
+            _observer->onAssertFailureDetail(_failureNote->describe());
+    }
+
+    void onAssertFailureDetail(const std::string& detail)
+    {
+        Test::detail::UntrackedAllocations untracked;
+        Test::detail::SharedObserverLock lock(_sharedObserverLock);
+        _observer->onAssertFailureDetail(detail);
     }
 
+private:
+    static bool isStaticObserver(const Observer& observer)
+    {
+#ifdef TESTCPP_STATIC_OBSERVER
+        return detail::StaticDispatch::matches(observer);
+#else
+        (void)observer;
+        return false;
+#endif
+    }
+
+#ifdef TESTCPP_HAVE_THREADS
+    std::mutex _adoptedLock;
+#endif
+    Observer* _observer;
+    unsigned _subscribedEvents;
+    bool _isStaticObserver;
+#ifdef TESTCPP_HAVE_THREADS
+    std::atomic<const char*> _lastAssertFile;
+    std::atomic<int> _lastAssertLine;
+#endif
+#ifdef TESTCPP_HAVE_THREADS
+    std::atomic<int> _errs;
+#else
+    int _errs;
+#endif
+    int _adoptedErrs;
+    std::vector<std::string> _adoptedEvents;
+    const FailureNote* _failureNote;
+#ifdef TESTCPP_HAVE_THREADS
+    std::mutex* _sharedObserverLock;
+#else
+    void* _sharedObserverLock;
+#endif
+};
+
+namespace detail
+{
+    class SharedFixtureEntry;
+    struct WorkerProcess;
+}
+
+/** The singleton control class registers tests and controls execution. */
+class Controller
+{
+public:
+    static Controller& instance();
+
+    typedef SuiteFactoryFunction TestSuiteFactoryFunction;
+
+    void addTestSuite(const std::string &label, TestSuiteFactoryFunction ffn)
+    {
+        // a deque does not move its elements, so label pointers stay valid
+        _ownedLabels.push_back(label);
+        SuiteDescriptor descriptor = { _ownedLabels.back().c_str(), ffn, 0, 0 };
+        _testSuites.push_back(descriptor);
+    }
+
+    /**
+     * Adds a suite that the factory creates for the given parameter, for
+     * suite types that take arguments, see DataSuite. The parameter must
+     * stay valid while the controller runs.
+     */
+    void addTestSuite(const std::string &label,
+            ParameterizedSuiteFactoryFunction ffn, const void* parameter)
+    {
+        _ownedLabels.push_back(label);
+        SuiteDescriptor descriptor = { _ownedLabels.back().c_str(), 0,
+            ffn, parameter };
+        _testSuites.push_back(descriptor);
+    }
+
+    /**
+     * Adds a suite that uses the shared fixture, as if declared with
+     * Test::addSharedFixtureUsers() but without matching its label.
+     */
+    void addTestSuite(const std::string &label,
+            ParameterizedSuiteFactoryFunction ffn, const void* parameter,
+            detail::SharedFixtureEntry& fixture)
+    {
+        _sharedFixtureSuites.push_back(std::make_pair(_testSuites.size(), &fixture));
+        addTestSuite(label, ffn, parameter);
+    }
+
+    typedef benchmark_transferable_ptr (*BenchmarkFactoryFunction)();
+
+    /**
+     * Benchmarks run one at a time on the calling thread after the test
+     * suites, regardless of the execution mode. Filters, exclusions and
+     * the shard select benchmarks like suites, a failed benchmark counts
+     * towards setMaxFailures() and no benchmark starts after the run
+     * timeout has expired.
+     */
+    void addBenchmark(const std::string& label, BenchmarkFactoryFunction ffn,
+            const BenchmarkOptions& options = BenchmarkOptions())
+    { _benchmarks.push_back(BenchmarkRegistration(label, ffn, options)); }
+
+    /**
+     * Runs only the given shard of the registered test suites, for
+     * splitting a test run across machines. Shards are numbered from 0.
+     * When not set, the TESTCPP_SHARD_INDEX and TESTCPP_SHARD_COUNT
+     * environment variables are used if present.
+     *
+     * Suites and benchmarks are assigned to shards by a hash of the label,
+     * so that the assignment is stable across runs and machines. See
+     * setShardDurationsFile() for balancing the suites by time.
+     *
+     * Throws std::runtime_error if index is not less than count.
+     */
+    void setShard(unsigned index, unsigned count);
+
+    /**
+     * Balances the shards by the suite durations in the given file instead
+     * of hashing the labels. Each line of the file contains a suite label
+     * and its duration in seconds separated by a tab, as written by
+     * TimingObserver::writeDurations(). Suites missing from the file are
+     * assumed to take the average time, a missing file falls back to
+     * hashing. The TESTCPP_SHARD_DURATIONS environment variable is used
+     * when not set.
+     */
+    void setShardDurationsFile(const std::string& path)
+    { _shardDurationsPath = path; }
+
+    /** A glob or an extended regular expression matched against labels. */
+    struct LabelPattern
+    {
+        LabelPattern(const std::string& pattern_, bool regex_) :
+            pattern(pattern_),
+            regex(regex_)
+        { }
+
+        std::string pattern;
+        bool regex;
+    };
+
+    /**
+     * Runs only the suites and benchmarks with a label that matches one of
+     * the filters. Globs with * and ? must match the whole label, regular
+     * expressions may match any part of it. Suites that are filtered out
+     * are never constructed.
+     */
+    void addFilter(const std::string& glob)
+    { _filters.push_back(LabelPattern(glob, false)); }
+
+    void addFilterRegex(const std::string& regex)
+    { _filters.push_back(LabelPattern(regex, true)); }
+
+    /** Skips the suites and benchmarks with a label that matches an exclusion. */
+    void addExclude(const std::string& glob)
+    { _excludes.push_back(LabelPattern(glob, false)); }
+
+    void addExcludeRegex(const std::string& regex)
+    { _excludes.push_back(LabelPattern(regex, true)); }
+
+    /**
+     * Labels of the suites that would run with the current filters and
+     * shard, in run order. No suites are constructed.
+     */
+    std::vector<std::string> plannedTestSuiteLabels();
+
+    /**
+     * Declares that the suites with labels that match the glob use the
+     * shared fixture, see Test::addSharedFixtureUsers().
+     */
+    void addSharedFixtureUsers(detail::SharedFixtureEntry& fixture,
+            const std::string& glob)
+    { _sharedFixtureUsers.push_back(SharedFixtureUsers(fixture, glob)); }
+
+    /**
+     * Runs the suites that use the same shared fixture one after another,
+     * from the position of the first of them, so that the fixture is not
+     * torn down and built again in between. Applied after ordering.
+     */
+    void setGroupBySharedFixture(bool group)
+    { _groupBySharedFixture = group; }
+
+    /**
+     * Keeps at most the given number of async test cases in flight at a
+     * time in sequential runs, 0 means no limit, see addAsyncTestCases().
+     * 64 by default.
+     */
+    void setAsyncTestCaseConcurrency(unsigned cases)
+    { _asyncTestCaseConcurrency = cases; }
+
+    /**
+     * Keeps the result and duration of every suite in the given file
+     * across runs, for ordering the suites with setTestSuiteOrder(). Each
+     * line contains a suite label, its duration in seconds and "passed" or
+     * "failed" separated by tabs. The file is rewritten at the end of the
+     * run, suites that did not run keep their entries. It can also be used
+     * as the durations file of setShardDurationsFile().
+     */
+    void setHistoryFile(const std::string& path)
+    { _historyPath = path; }
+
+    /** The last result of a suite in the history file. */
+    struct TestSuiteHistory
+    {
+        TestSuiteHistory() :
+            seconds(0),
+            failed(false)
+        { }
+
+        double seconds;
+        bool failed;
+    };
+
+    typedef std::map<std::string, TestSuiteHistory> History;
+
+    enum TestSuiteOrder
+    {
+        REGISTRATION_ORDER,
+
+        /** Suites that failed in the previous run first, then new suites. */
+        FAILED_FIRST,
+
+        FASTEST_FIRST,
+
+        /**
+         * Longest processing time first, the shortest total time for
+         * suites that run in parallel.
+         */
+        LONGEST_FIRST
+    };
+
+    /**
+     * Orders the selected suites by their history, see setHistoryFile().
+     * Suites without history take the average duration, suites with equal
+     * history keep their registration order.
+     */
+    void setTestSuiteOrder(TestSuiteOrder order)
+    { _testSuiteOrder = order; }
+
+    /**
+     * Stops starting suites after the given number of suites have failed,
+     * 0 (the default) means no limit. Suites that have already started
+     * still finish.
+     */
+    void setMaxFailures(unsigned maxFailedTestSuites)
+    { _maxFailedTestSuites = maxFailedTestSuites; }
+
+    /**
+     * Fails a test suite that runs longer than the given number of seconds,
+     * 0 (the default) means no limit. The timed out suite is reported with
+     * the location of the last assertion it began.
+     *
+     * A watchdog thread enforces the timeout when suites run in this
+     * process: it writes the stack of the hung thread to standard error
+     * where supported, reports the hung suite and the results so far to
+     * the observer and exits the process with EXIT_FAILURE, as a hung
+     * suite cannot be stopped. Run with runIsolated() to abandon the
+     * suite instead and continue with the remaining suites. Requires C++11
+     * threads unless the suites run in processes.
+     */
+    void setTestSuiteTimeout(double seconds)
+    { _testSuiteTimeout = seconds; }
+
+    /**
+     * Limits the time of the whole run in the same manner, the suites that
+     * are running when it expires are reported as timed out. In isolated
+     * runs the remaining suites are skipped.
+     */
+    void setRunTimeout(double seconds)
+    { _runTimeout = seconds; }
+
+    /**
+     * Counts the CPU events of every test suite and benchmark, reported in
+     * TestSuiteStats and BenchmarkResult. Off by default, as opening the
+     * counters costs a few system calls per suite. Linux only.
+     */
+    void setPerformanceCounters(bool enabled)
+    { _countPerformance = enabled; }
+
+    /**
+     * Compares the times of the suites and benchmarks with the baseline
+     * in the given file at the end of the run. A suite or benchmark with
+     * a median time that exceeds the baseline median by both the relative
+     * threshold and the given number of median absolute deviations of the
+     * baseline is reported with Observer::onTimingRegression() and counted
+     * as an error. Suites must also be at least 5 ms slower. Suites and
+     * benchmarks missing from the baseline are not compared.
+     *
+     * Each line of the file contains "suite" or "benchmark", the label and
+     * the space-separated samples, separated by tabs. Suites have one
+     * sample per run, benchmarks the kept samples.
+     */
+    void setBaselineFile(const std::string& path)
+    { _baselinePath = path; }
+
+    /**
+     * Adds the samples of the run to the baseline instead of comparing,
+     * keeping the most recent ones. Suites that fail are not added.
+     */
+    void setBaselineUpdate(bool update)
+    { _updateBaseline = update; }
+
+    void setRegressionThreshold(double relative, double deviations = 3)
+    {
+        _regressionThreshold = relative;
+        _regressionDeviations = deviations;
+    }
+
+    /**
+     * Seeds the properties of the run, see checkProperty(). When not set,
+     * TESTCPP_PROPERTY_SEED is used if present, a random seed otherwise.
+     * Failed properties report the seed so that the run can be repeated
+     * with it, 0 means not set.
+     */
+    void setPropertySeed(unsigned long seed)
+    { _propertySeed = seed; }
+
+    /** The seed of the run, chosen on first use when not set. */
+    unsigned long propertySeed();
+
+    /** Samples of a suite or benchmark, keyed by label. */
+    typedef std::map<std::string, std::vector<double> > Timings;
+
+    void setObserver(Observer* observer, bool takeOwnership = true)
+    {
+        if (!observer)
+            throw std::runtime_error("Observer cannot be null");
+        deleteObserverIfOwningIt();
+        _doesOwnObserver = takeOwnership;
+        _observer = observer;
+        _defaultContext.setObserver(observer);
+    }
+
+    int run()
+    { return runTestSuites(SEQUENTIAL, 1); }
+
+    /**
+     * Configures the run from command line arguments, for forwarding the
+     * arguments of main():
+     *
+     *   --filter=GLOB             run suites with a matching label
+     *   --filter-regex=REGEX      run suites with a label matching REGEX
+     *   --exclude=GLOB            skip suites with a matching label
+     *   --exclude-regex=REGEX     skip suites with a label matching REGEX
+     *   --list                    list the selected suites and exit
+     *   --jobs=N                  run on N threads, 0 for all hardware threads
+     *   --isolate                 run the suites in worker processes
+     *   --shard=INDEX/COUNT       run one shard, see setShard()
+     *   --shard-durations=PATH    balance shards by time
+     *   --timeout=SECONDS         fail suites that run longer
+     *   --run-timeout=SECONDS     limit the time of the whole run
+     *   --history=PATH            keep suite results and durations in PATH
+     *   --order=ORDER             registration, failed-first, fastest-first
+     *                             or longest-first
+     *   --fail-fast               stop after the first failed suite
+     *   --max-failures=N          stop after N failed suites
+     *   --perf-counters           count CPU events, see setPerformanceCounters()
+     *   --baseline=PATH           fail on timing regressions against PATH
+     *   --update-baseline         add the run to the baseline instead
+     *   --regression-threshold=F  relative slowdown that fails, 0.1 for 10%
+     *   --property-seed=N         seed of the property cases, see setPropertySeed()
+     *   --group-fixtures          run suites that share a fixture together
+     *   --async-cases=N           async test cases in flight, 0 for no limit
+     *
+     * Filters can be given multiple times. Prints usage and returns
+     * non-zero on invalid arguments.
+     */
+    int run(int argc, char* argv[]);
+
+    /**
+     * Runs the test suites on the given number of threads, 0 means one
+     * thread per hardware thread. The observer receives the events of a
+     * suite as an uninterrupted block after the suite has finished, so
+     * output of parallel suites is never interleaved.
+     *
+     * Falls back to running the suites sequentially when threads are not
+     * supported by the compiler.
+     */
+    int run(unsigned threads)
+    { return runTestSuites(threads == 1 ? SEQUENTIAL : THREADS, threads); }
+
+    /**
+     * Runs the test suites in a pool of forked worker processes, the given
+     * number of them, 0 means one per hardware thread. Workers run one
+     * suite after another and send the suite events back through a
+     * socket. A suite that crashes or exits is reported as failed with the
+     * cause, its worker is replaced and the run continues with the
+     * remaining suites.
+     *
+     * Process isolation is available on POSIX systems only, the suites are
+     * run on threads elsewhere.
+     */
+    int runIsolated(unsigned processes)
+    { return runTestSuites(PROCESSES, processes); }
+
+    /**
+     * The context that assertions made on the current thread report to:
+     * the context of the suite running on this thread or the default
+     * context when called outside of test suites.
+     *
+     * Threads share the default context, so it counts errors atomically and
+     * calls the observer under the lock of parallel runs. Its errors during
+     * a run are added to the next suite that ends, or to the run if none
+     * does, use ThreadAssertionContext to report them with the right suite.
+     */
+    static AssertionContext& currentContext()
+    {
+        return _currentContext ? *_currentContext
+                               : instance()._defaultContext;
+    }
+
+    /** Makes context current on this thread for the lifetime of the scope. */
+    class CurrentContextScope
+    {
+        UTILCPP_DISABLE_COPY(CurrentContextScope)
+
+    public:
+        explicit CurrentContextScope(AssertionContext& context) :
+            _previous(_currentContext)
+        { _currentContext = &context; }
+
+        ~CurrentContextScope()
+        { _currentContext = _previous; }
+
+    private:
+        AssertionContext* _previous;
+    };
+
+    void beforeAssert(const AssertSite& site)
+    { currentContext().beforeAssert(site); }
+
+    void afterAssert(bool ok)
+    { currentContext().afterAssert(ok); }
+
+    void onAssertExceptionEndWithExpectedException(const std::exception& e)
+    { currentContext().onAssertExceptionEndWithExpectedException(e); }
+
+    void onAssertExceptionEndWithUnexpectedException(const std::exception* e = 0)
+    { currentContext().onAssertExceptionEndWithUnexpectedException(e); }
+
+    void onAssertNoExceptionEndWithException(const std::exception* e = 0)
+    { currentContext().onAssertNoExceptionEndWithException(e); }
+
+    void onAssertFailureDetail(const std::string& detail)
+    { currentContext().onAssertFailureDetail(detail); }
+
 private:
     Controller();
     Controller(const Controller&);
@@ -285,13 +1262,244 @@ private:
             delete _observer;
     }
 
+    enum ExecutionMode { SEQUENTIAL, THREADS, PROCESSES };
+
+    int runTestSuites(ExecutionMode mode, unsigned concurrency);
+
+    /**
+     * Runs a single test suite, reporting to the context's observer.
+     * Returns true if the suite ended with an unhandled exception.
+     */
+    bool runTestSuite(const SuiteDescriptor& testSuite,
+            int testSuiteNum, int testSuitesNumTotal,
+            AssertionContext& context);
+
+    struct BenchmarkRegistration
+    {
+        BenchmarkRegistration(const std::string& label_,
+                BenchmarkFactoryFunction factory_,
+                const BenchmarkOptions& options_) :
+            label(label_),
+            factory(factory_),
+            options(options_)
+        { }
+
+        std::string label;
+        BenchmarkFactoryFunction factory;
+        BenchmarkOptions options;
+    };
+
+    /** Measures the resources a test suite uses while it runs. */
+    class SuiteStatsMeasurement
+    {
+    public:
+        explicit SuiteStatsMeasurement(bool countPerformance);
+        TestSuiteStats stop() const;
+
+        AllocationStats allocations() const
+        { return _allocations.stats(); }
+
+    private:
+        double _wallStart;
+        double _cpuStart;
+        AllocationScope _allocations;
+        PerformanceCounterScope _counters;
+    };
+
+    class Watchdog;
+
+    /** Makes the watchdog watch a suite for the lifetime of the scope. */
+    class WatchedTestSuiteScope
+    {
+        UTILCPP_DISABLE_COPY(WatchedTestSuiteScope)
+
+    public:
+        WatchedTestSuiteScope(Watchdog* watchdog,
+                const SuiteDescriptor& testSuite, int testSuiteNum,
+                int testSuitesNumTotal, AssertionContext& context);
+        ~WatchedTestSuiteScope();
+
+    private:
+        Watchdog* _watchdog;
+        size_t _id;
+    };
+
+    /** Starts the watchdog when timeouts are set and suites run in process. */
+    void startWatchdog(ExecutionMode mode);
+    void stopWatchdog();
+
+    /**
+     * Held while the results of the run are updated and while benchmarks
+     * report. The watchdog keeps it from when it expires until the process
+     * exits, so that the controller thread stops there.
+     */
+#ifdef TESTCPP_HAVE_THREADS
+    std::mutex* runStateLock()
+    { return &_observerLock; }
+#else
+    void* runStateLock()
+    { return 0; }
+#endif
+
+    /**
+     * Reports the suite results that precede the suite end event. Leaks
+     * are not reported for suites that ended with an exception.
+     */
+    void endTestSuite(AssertionContext& context,
+            const SuiteStatsMeasurement& measurement, bool endedWithException);
+
+    /**
+     * Adds the errors of threads that asserted without a context of their
+     * own to the suite that ends, see currentContext().
+     */
+    void adoptUnattributedErrs(AssertionContext& context);
+
+    /** Adds the suites registered with TESTCPP_SUITE on first use. */
+    void addRegisteredSuites();
+
+    /** Selects the suites to run into _plan and the benchmarks into _benchmarkPlan. */
+    void planTestSuites();
+    void selectFiltered();
+    void selectShard();
+    void orderByHistory();
+
+    /** Indices of the suites in _testSuites that match the pattern. */
+    std::vector<bool> matchTestSuites(const LabelPattern& pattern) const;
+
+    /** Finds the shared fixtures of the planned suites. */
+    void mapSharedFixtures();
+    void groupBySharedFixture();
+
+    /** Keeps the shared fixtures until their planned users have finished. */
+    void beginSharedFixtures();
+    void endSharedFixtureUse(const SuiteDescriptor& testSuite);
+    void endSharedFixtures();
+
+    /**
+     * Counts failed suites for setMaxFailures() and keeps the result for
+     * the history file.
+     */
+    void recordTestSuiteResult(const char* label, bool failed, double seconds);
+
+    bool maxFailuresReached() const
+    {
+        return _maxFailedTestSuites > 0
+            && _failedTestSuites >= _maxFailedTestSuites;
+    }
+
+    void saveHistory();
+
+    /** Compares with or updates the baseline, see setBaselineFile(). */
+    void checkBaseline();
+
+    void runBenchmarks();
+
+    void runSequentially();
+#ifdef TESTCPP_HAVE_ASYNC_TESTS
+    struct AsyncTestCaseRun;
+
+    /**
+     * Runs the async test cases that follow each other in the plan from
+     * the given position together, returns the position after them.
+     */
+    size_t runAsyncTestCases(size_t first);
+    void endAsyncTestCase(AsyncTestCaseRun& run);
+#endif
+    void runInParallel(unsigned threads);
+    void runInProcesses(unsigned processes);
+#ifndef _WIN32
+    detail::WorkerProcess startWorkerProcess(
+            const std::vector<detail::WorkerProcess>& workers);
+    void sendTestSuite(detail::WorkerProcess& worker, size_t testSuite,
+            int testSuiteNum);
+    void receiveMessages(detail::WorkerProcess& worker);
+
+    /**
+     * Reports the suite of the worker from the events received, status is
+     * the exit status of the worker if it has ended before the suite did,
+     * -1 otherwise.
+     */
+    void endWorkerTestSuite(detail::WorkerProcess& worker, int status);
+
+    /** Runs the suites that the runner sends, until it sends no more. */
+    void runWorkerProcess(int fd);
+#endif
+
     Observer* _observer;
     bool _doesOwnObserver;
 
-    std::vector<LabelAndFactoryFunctionPair> _testSuiteFactories;
+    AssertionContext _defaultContext;
+    static TESTCPP_THREAD_LOCAL AssertionContext* _currentContext;
+
+    std::vector<SuiteDescriptor> _testSuites;
+    std::deque<std::string> _ownedLabels;
+    bool _registeredSuitesAdded;
+    std::vector<BenchmarkRegistration> _benchmarks;
+
+    /** Indices of the suites to run in _testSuites, in run order. */
+    std::vector<size_t> _plan;
+    std::vector<size_t> _benchmarkPlan;
+
+    std::vector<LabelPattern> _filters;
+    std::vector<LabelPattern> _excludes;
+
+    unsigned _shardIndex;
+    unsigned _shardCount;
+    std::string _shardDurationsPath;
+
+    std::string _historyPath;
+    History _history;
+    History _results;
+    TestSuiteOrder _testSuiteOrder;
+    unsigned _maxFailedTestSuites;
+    unsigned _failedTestSuites;
+
+    double _testSuiteTimeout;
+    double _runTimeout;
+    /** Monotonic time when the run times out, 0 when there is no limit. */
+    double _runDeadline;
+    Watchdog* _watchdog;
+
+    bool _countPerformance;
+
+    std::string _baselinePath;
+    bool _updateBaseline;
+    double _regressionThreshold;
+    double _regressionDeviations;
+    Timings _suiteTimings;
+    Timings _benchmarkTimings;
+
+    unsigned long _propertySeed;
+
+    struct SharedFixtureUsers
+    {
+        SharedFixtureUsers(detail::SharedFixtureEntry& fixture_,
+                const std::string& glob) :
+            fixture(&fixture_),
+            users(glob, false)
+        { }
+
+        detail::SharedFixtureEntry* fixture;
+        LabelPattern users;
+    };
+
+    std::vector<SharedFixtureUsers> _sharedFixtureUsers;
+
+    /** Suites added with their shared fixture, by index in _testSuites. */
+    std::vector<std::pair<size_t, detail::SharedFixtureEntry*> > _sharedFixtureSuites;
+
+    /** The shared fixtures of the planned suites, by index in _testSuites. */
+    std::vector<std::vector<detail::SharedFixtureEntry*> > _suiteFixtures;
+    bool _groupBySharedFixture;
+
+    unsigned _asyncTestCaseConcurrency;
+
+#ifdef TESTCPP_HAVE_THREADS
+    /** Serializes observer events of suites that run in parallel. */
+    std::mutex _observerLock;
+#endif
 
     int _curTestSuite;
-    int _curTestSuiteErrs;
     int _allTestErrs;
     int _allTestExcepts;
 };
@@ -301,4 +1509,12 @@ private:
 
 }
 
+#include <testcpp/detail/SuiteRegistry.h>
+
+// completes the observer type that assertions are bound to, see
+// StaticObserverDispatch
+#ifdef TESTCPP_STATIC_OBSERVER
+  #include TESTCPP_STATIC_OBSERVER_HEADER
+#endif
+
 #endif /* TESTCPP_H */
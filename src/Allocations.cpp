@@ -0,0 +1,84 @@
+#include <testcpp/testcpp.h>
+
+#include <algorithm>
+
+namespace Test
+{
+
+namespace detail
+{
+
+bool allocationTrackingLinked = false;
+
+namespace
+{
+
+// constant-initialized, the allocation functions may run before main()
+TESTCPP_THREAD_LOCAL AllocationCounters counters;
+
+}
+
+AllocationCounters& threadAllocationCounters()
+{ return counters; }
+
+bool countAllocation(size_t size)
+{
+    AllocationCounters& c = counters;
+    if (c.untrackedDepth > 0)
+        return false;
+
+    ++c.allocations;
+    c.allocatedBytes += static_cast<unsigned long>(size);
+    ++c.liveAllocations;
+    c.liveBytes += static_cast<long>(size);
+    if (c.liveBytes > c.peakLiveBytes)
+        c.peakLiveBytes = c.liveBytes;
+    return true;
+}
+
+void countDeallocation(size_t size)
+{
+    // the framework frees its blocks, e.g. when a recorder buffer grows
+    // during an assertion, whether or not they were counted
+    AllocationCounters& c = counters;
+    if (c.untrackedDepth > 0)
+        return;
+
+    ++c.deallocations;
+    --c.liveAllocations;
+    c.liveBytes -= static_cast<long>(size);
+}
+
+}
+
+AllocationScope::AllocationScope() :
+    _start(detail::threadAllocationCounters())
+{
+    // the peak of the scope starts from the current live bytes, the peak
+    // of enclosing scopes is restored when the scope ends
+    detail::AllocationCounters& counters = detail::threadAllocationCounters();
+    counters.peakLiveBytes = counters.liveBytes;
+}
+
+AllocationScope::~AllocationScope()
+{
+    detail::AllocationCounters& counters = detail::threadAllocationCounters();
+    counters.peakLiveBytes = std::max(counters.peakLiveBytes, _start.peakLiveBytes);
+}
+
+AllocationStats AllocationScope::stats() const
+{
+    const detail::AllocationCounters& counters = detail::threadAllocationCounters();
+
+    AllocationStats stats;
+    stats.allocations = counters.allocations - _start.allocations;
+    stats.deallocations = counters.deallocations - _start.deallocations;
+    stats.allocatedBytes = counters.allocatedBytes - _start.allocatedBytes;
+    stats.peakLiveBytes = static_cast<unsigned long>(
+            std::max(counters.peakLiveBytes - _start.liveBytes, 0L));
+    stats.leakedAllocations = counters.liveAllocations - _start.liveAllocations;
+    stats.leakedBytes = counters.liveBytes - _start.liveBytes;
+    return stats;
+}
+
+} // namespace
@@ -0,0 +1,516 @@
+#include <testcpp/ArrayAssertions.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) \
+    || (defined(__i386__) && defined(__SSE2__)) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define TESTCPP_HAVE_SSE2
+  #include <emmintrin.h>
+#endif
+
+// AVX2 kernels are compiled for the target with function attributes and
+// only called when the processor supports AVX2
+#if defined(TESTCPP_HAVE_SSE2) && (defined(__clang__) \
+    || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+  #define TESTCPP_HAVE_AVX2
+  #define TESTCPP_TARGET_AVX2 __attribute__((target("avx2")))
+  #include <immintrin.h>
+#elif defined(TESTCPP_HAVE_SSE2) && defined(_MSC_VER) && _MSC_VER >= 1700
+  #define TESTCPP_HAVE_AVX2
+  #define TESTCPP_TARGET_AVX2
+  #include <immintrin.h>
+  #include <intrin.h>
+#endif
+
+namespace Test
+{
+
+namespace detail
+{
+
+namespace
+{
+
+enum SimdLevel { SCALAR, SSE2, AVX2 };
+
+#ifdef TESTCPP_HAVE_AVX2
+bool processorSupportsAvx2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    // the operating system must save the AVX registers
+    __cpuid(info, 1);
+    if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+/** TESTCPP_SIMD=scalar or sse2 limits the kernels, e.g. for testing. */
+SimdLevel detectSimdLevel()
+{
+    SimdLevel level = SCALAR;
+#ifdef TESTCPP_HAVE_SSE2
+    level = SSE2;
+#endif
+#ifdef TESTCPP_HAVE_AVX2
+    if (processorSupportsAvx2())
+        level = AVX2;
+#endif
+
+    const char* limit = std::getenv("TESTCPP_SIMD");
+    if (limit && std::strcmp(limit, "scalar") == 0)
+        level = SCALAR;
+    else if (limit && std::strcmp(limit, "sse2") == 0)
+        level = std::min(level, SSE2);
+
+    return level;
+}
+
+SimdLevel simdLevel()
+{
+    static const SimdLevel level = detectSimdLevel();
+    return level;
+}
+
+// --- bitwise comparison
+
+void compareElements(const unsigned char* a, const unsigned char* b,
+        size_t elementSize, size_t from, size_t to, ArrayMismatches& mismatches)
+{
+    for (size_t i = from; i < to; ++i)
+        if (std::memcmp(a + i * elementSize, b + i * elementSize, elementSize) != 0)
+            mismatches.add(i);
+}
+
+/** Compares blocks with memcmp(), which is vectorized by the C library. */
+size_t compareBytesInBlocks(const unsigned char* a, const unsigned char* b,
+        size_t elementSize, size_t count, ArrayMismatches& mismatches)
+{
+    const size_t blockElements = std::max<size_t>(4096 / elementSize, 1);
+    size_t i = 0;
+
+    for (; i + blockElements <= count; i += blockElements)
+        if (std::memcmp(a + i * elementSize, b + i * elementSize,
+                    blockElements * elementSize) != 0)
+            compareElements(a, b, elementSize, i, i + blockElements, mismatches);
+
+    return i;
+}
+
+/**
+ * The vector kernels compare blocks of bytes and compare the elements of
+ * a block that differs one by one. Returns the first element that has not
+ * been compared as a whole.
+ */
+#ifdef TESTCPP_HAVE_SSE2
+size_t compareBytesSse2(const unsigned char* a, const unsigned char* b,
+        size_t elementSize, size_t count, ArrayMismatches& mismatches)
+{
+    const size_t bytes = elementSize * count;
+    size_t next = 0;
+    size_t i = 0;
+
+    for (; i + 16 <= bytes; i += 16) {
+        const __m128i equal = _mm_cmpeq_epi8(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        if (_mm_movemask_epi8(equal) == 0xffff)
+            continue;
+
+        const size_t end = (i + 16 + elementSize - 1) / elementSize;
+        compareElements(a, b, elementSize, std::max(next, i / elementSize),
+                end, mismatches);
+        next = std::max(next, end);
+    }
+
+    return std::max(next, i / elementSize);
+}
+#endif
+
+#ifdef TESTCPP_HAVE_AVX2
+TESTCPP_TARGET_AVX2
+size_t compareBytesAvx2(const unsigned char* a, const unsigned char* b,
+        size_t elementSize, size_t count, ArrayMismatches& mismatches)
+{
+    const size_t bytes = elementSize * count;
+    size_t next = 0;
+    size_t i = 0;
+
+    for (; i + 32 <= bytes; i += 32) {
+        const __m256i equal = _mm256_cmpeq_epi8(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+        if (_mm256_movemask_epi8(equal) == -1)
+            continue;
+
+        const size_t end = (i + 32 + elementSize - 1) / elementSize;
+        compareElements(a, b, elementSize, std::max(next, i / elementSize),
+                end, mismatches);
+        next = std::max(next, end);
+    }
+
+    return std::max(next, i / elementSize);
+}
+#endif
+
+// --- floating point comparison
+
+template <typename T>
+struct FloatBits;
+
+template <>
+struct FloatBits<float>
+{
+    typedef unsigned int Type;
+    enum { MANTISSA_BITS = 24 };
+};
+
+template <>
+struct FloatBits<double>
+{
+    typedef unsigned long long Type;
+    enum { MANTISSA_BITS = 53 };
+};
+
+/** Maps the bits of floating point values to integers in value order. */
+template <typename T>
+typename FloatBits<T>::Type orderedBits(T value)
+{
+    typedef typename FloatBits<T>::Type Bits;
+    const Bits sign = Bits(1) << (sizeof(Bits) * 8 - 1);
+
+    Bits bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return (bits & sign) ? ~bits + 1 : bits | sign;
+}
+
+template <typename T>
+bool withinUlps(T a, T b, unsigned ulps)
+{
+    const typename FloatBits<T>::Type x = orderedBits(a);
+    const typename FloatBits<T>::Type y = orderedBits(b);
+    return (x > y ? x - y : y - x) <= ulps;
+}
+
+/** The tolerance in the precision of the elements. */
+template <typename T>
+struct Bounds
+{
+    explicit Bounds(const Tolerance& tolerance) :
+        absolute(static_cast<T>(std::min<double>(tolerance.absolute,
+                        std::numeric_limits<T>::max()))),
+        relative(static_cast<T>(tolerance.relative)),
+        ulps(tolerance.ulps),
+        ulpScale(0)
+    {
+        // elements within ulps * 2^-MANTISSA_BITS of the smaller magnitude
+        // are within ulps units in the last place, used by the vector
+        // kernels to skip the exact check
+        const T scale = std::ldexp(static_cast<T>(ulps),
+                -static_cast<int>(FloatBits<T>::MANTISSA_BITS));
+        if (scale < T(0.5))
+            ulpScale = scale;
+    }
+
+    T absolute;
+    T relative;
+    unsigned ulps;
+    T ulpScale;
+};
+
+template <typename T>
+bool isClose(T a, T b, const Bounds<T>& bounds)
+{
+    if (a == b)
+        return true;
+
+    // NaN or infinite
+    const T diff = std::fabs(a - b);
+    if (!(diff <= std::numeric_limits<T>::max()))
+        return false;
+
+    return diff <= bounds.absolute
+        || diff <= bounds.relative * std::max(std::fabs(a), std::fabs(b))
+        || (bounds.ulps > 0 && withinUlps(a, b, bounds.ulps));
+}
+
+template <typename T>
+void compareClose(const T* a, const T* b, size_t from, size_t to,
+        const Bounds<T>& bounds, ArrayMismatches& mismatches, T& maxError)
+{
+    for (size_t i = from; i < to; ++i) {
+        if (!isClose(a[i], b[i], bounds))
+            mismatches.add(i);
+
+        const T diff = std::fabs(a[i] - b[i]);
+        if (diff > maxError)
+            maxError = diff;
+    }
+}
+
+/**
+ * The vector kernels test a sufficient condition for closeness: equal, or
+ * a finite difference within the absolute, relative or scaled ulp bound.
+ * Blocks with other elements get the exact check. Return the number of
+ * elements compared.
+ */
+#ifdef TESTCPP_HAVE_SSE2
+size_t compareFloatsSse2(const float* a, const float* b, size_t count,
+        const Bounds<float>& bounds, ArrayMismatches& mismatches, float& maxError)
+{
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 finite = _mm_set1_ps(std::numeric_limits<float>::max());
+    const __m128 absolute = _mm_set1_ps(bounds.absolute);
+    const __m128 relative = _mm_set1_ps(bounds.relative);
+    const __m128 ulpScale = _mm_set1_ps(bounds.ulpScale);
+    __m128 maxDiff = _mm_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 x = _mm_loadu_ps(a + i);
+        const __m128 y = _mm_loadu_ps(b + i);
+        const __m128 diff = _mm_andnot_ps(signMask, _mm_sub_ps(x, y));
+        const __m128 absX = _mm_andnot_ps(signMask, x);
+        const __m128 absY = _mm_andnot_ps(signMask, y);
+
+        const __m128 withinBounds = _mm_or_ps(_mm_or_ps(
+                _mm_cmple_ps(diff, absolute),
+                _mm_cmple_ps(diff, _mm_mul_ps(relative, _mm_max_ps(absX, absY)))),
+                _mm_cmple_ps(diff, _mm_mul_ps(ulpScale, _mm_min_ps(absX, absY))));
+        const __m128 close = _mm_or_ps(_mm_cmpeq_ps(x, y),
+                _mm_and_ps(_mm_cmple_ps(diff, finite), withinBounds));
+
+        // NaN differences keep the previous maximum
+        maxDiff = _mm_max_ps(diff, maxDiff);
+
+        if (_mm_movemask_ps(close) != 0xf)
+            compareClose(a, b, i, i + 4, bounds, mismatches, maxError);
+    }
+
+    float lanes[4];
+    _mm_storeu_ps(lanes, maxDiff);
+    maxError = std::max(maxError, *std::max_element(lanes, lanes + 4));
+    return i;
+}
+
+size_t compareDoublesSse2(const double* a, const double* b, size_t count,
+        const Bounds<double>& bounds, ArrayMismatches& mismatches, double& maxError)
+{
+    const __m128d signMask = _mm_set1_pd(-0.0);
+    const __m128d finite = _mm_set1_pd(std::numeric_limits<double>::max());
+    const __m128d absolute = _mm_set1_pd(bounds.absolute);
+    const __m128d relative = _mm_set1_pd(bounds.relative);
+    const __m128d ulpScale = _mm_set1_pd(bounds.ulpScale);
+    __m128d maxDiff = _mm_setzero_pd();
+
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        const __m128d x = _mm_loadu_pd(a + i);
+        const __m128d y = _mm_loadu_pd(b + i);
+        const __m128d diff = _mm_andnot_pd(signMask, _mm_sub_pd(x, y));
+        const __m128d absX = _mm_andnot_pd(signMask, x);
+        const __m128d absY = _mm_andnot_pd(signMask, y);
+
+        const __m128d withinBounds = _mm_or_pd(_mm_or_pd(
+                _mm_cmple_pd(diff, absolute),
+                _mm_cmple_pd(diff, _mm_mul_pd(relative, _mm_max_pd(absX, absY)))),
+                _mm_cmple_pd(diff, _mm_mul_pd(ulpScale, _mm_min_pd(absX, absY))));
+        const __m128d close = _mm_or_pd(_mm_cmpeq_pd(x, y),
+                _mm_and_pd(_mm_cmple_pd(diff, finite), withinBounds));
+
+        maxDiff = _mm_max_pd(diff, maxDiff);
+
+        if (_mm_movemask_pd(close) != 0x3)
+            compareClose(a, b, i, i + 2, bounds, mismatches, maxError);
+    }
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, maxDiff);
+    maxError = std::max(maxError, std::max(lanes[0], lanes[1]));
+    return i;
+}
+#endif
+
+#ifdef TESTCPP_HAVE_AVX2
+TESTCPP_TARGET_AVX2
+size_t compareFloatsAvx2(const float* a, const float* b, size_t count,
+        const Bounds<float>& bounds, ArrayMismatches& mismatches, float& maxError)
+{
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    const __m256 finite = _mm256_set1_ps(std::numeric_limits<float>::max());
+    const __m256 absolute = _mm256_set1_ps(bounds.absolute);
+    const __m256 relative = _mm256_set1_ps(bounds.relative);
+    const __m256 ulpScale = _mm256_set1_ps(bounds.ulpScale);
+    __m256 maxDiff = _mm256_setzero_ps();
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 x = _mm256_loadu_ps(a + i);
+        const __m256 y = _mm256_loadu_ps(b + i);
+        const __m256 diff = _mm256_andnot_ps(signMask, _mm256_sub_ps(x, y));
+        const __m256 absX = _mm256_andnot_ps(signMask, x);
+        const __m256 absY = _mm256_andnot_ps(signMask, y);
+
+        const __m256 withinBounds = _mm256_or_ps(_mm256_or_ps(
+                _mm256_cmp_ps(diff, absolute, _CMP_LE_OQ),
+                _mm256_cmp_ps(diff, _mm256_mul_ps(relative,
+                        _mm256_max_ps(absX, absY)), _CMP_LE_OQ)),
+                _mm256_cmp_ps(diff, _mm256_mul_ps(ulpScale,
+                        _mm256_min_ps(absX, absY)), _CMP_LE_OQ));
+        const __m256 close = _mm256_or_ps(_mm256_cmp_ps(x, y, _CMP_EQ_OQ),
+                _mm256_and_ps(_mm256_cmp_ps(diff, finite, _CMP_LE_OQ),
+                    withinBounds));
+
+        maxDiff = _mm256_max_ps(diff, maxDiff);
+
+        if (_mm256_movemask_ps(close) != 0xff)
+            compareClose(a, b, i, i + 8, bounds, mismatches, maxError);
+    }
+
+    float lanes[8];
+    _mm256_storeu_ps(lanes, maxDiff);
+    maxError = std::max(maxError, *std::max_element(lanes, lanes + 8));
+    return i;
+}
+
+TESTCPP_TARGET_AVX2
+size_t compareDoublesAvx2(const double* a, const double* b, size_t count,
+        const Bounds<double>& bounds, ArrayMismatches& mismatches, double& maxError)
+{
+    const __m256d signMask = _mm256_set1_pd(-0.0);
+    const __m256d finite = _mm256_set1_pd(std::numeric_limits<double>::max());
+    const __m256d absolute = _mm256_set1_pd(bounds.absolute);
+    const __m256d relative = _mm256_set1_pd(bounds.relative);
+    const __m256d ulpScale = _mm256_set1_pd(bounds.ulpScale);
+    __m256d maxDiff = _mm256_setzero_pd();
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m256d x = _mm256_loadu_pd(a + i);
+        const __m256d y = _mm256_loadu_pd(b + i);
+        const __m256d diff = _mm256_andnot_pd(signMask, _mm256_sub_pd(x, y));
+        const __m256d absX = _mm256_andnot_pd(signMask, x);
+        const __m256d absY = _mm256_andnot_pd(signMask, y);
+
+        const __m256d withinBounds = _mm256_or_pd(_mm256_or_pd(
+                _mm256_cmp_pd(diff, absolute, _CMP_LE_OQ),
+                _mm256_cmp_pd(diff, _mm256_mul_pd(relative,
+                        _mm256_max_pd(absX, absY)), _CMP_LE_OQ)),
+                _mm256_cmp_pd(diff, _mm256_mul_pd(ulpScale,
+                        _mm256_min_pd(absX, absY)), _CMP_LE_OQ));
+        const __m256d close = _mm256_or_pd(_mm256_cmp_pd(x, y, _CMP_EQ_OQ),
+                _mm256_and_pd(_mm256_cmp_pd(diff, finite, _CMP_LE_OQ),
+                    withinBounds));
+
+        maxDiff = _mm256_max_pd(diff, maxDiff);
+
+        if (_mm256_movemask_pd(close) != 0xf)
+            compareClose(a, b, i, i + 4, bounds, mismatches, maxError);
+    }
+
+    double lanes[4];
+    _mm256_storeu_pd(lanes, maxDiff);
+    maxError = std::max(maxError, *std::max_element(lanes, lanes + 4));
+    return i;
+}
+#endif
+
+}
+
+void compareBytes(const void* a, const void* b, size_t elementSize,
+        size_t count, ArrayMismatches& mismatches)
+{
+    const unsigned char* x = static_cast<const unsigned char*>(a);
+    const unsigned char* y = static_cast<const unsigned char*>(b);
+    size_t done = 0;
+
+    switch (simdLevel()) {
+#ifdef TESTCPP_HAVE_AVX2
+    case AVX2:
+        done = compareBytesAvx2(x, y, elementSize, count, mismatches);
+        break;
+#endif
+#ifdef TESTCPP_HAVE_SSE2
+    case SSE2:
+        done = compareBytesSse2(x, y, elementSize, count, mismatches);
+        break;
+#endif
+    default:
+        done = compareBytesInBlocks(x, y, elementSize, count, mismatches);
+        break;
+    }
+
+    compareElements(x, y, elementSize, done, count, mismatches);
+}
+
+void compareFloats(const float* a, const float* b, size_t count,
+        const Tolerance& tolerance, ArrayMismatches& mismatches)
+{
+    const Bounds<float> bounds(tolerance);
+    float maxError = 0;
+    size_t done = 0;
+
+    switch (simdLevel()) {
+#ifdef TESTCPP_HAVE_AVX2
+    case AVX2:
+        done = compareFloatsAvx2(a, b, count, bounds, mismatches, maxError);
+        break;
+#endif
+#ifdef TESTCPP_HAVE_SSE2
+    case SSE2:
+        done = compareFloatsSse2(a, b, count, bounds, mismatches, maxError);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    compareClose(a, b, done, count, bounds, mismatches, maxError);
+    mismatches.maxError = maxError;
+}
+
+void compareDoubles(const double* a, const double* b, size_t count,
+        const Tolerance& tolerance, ArrayMismatches& mismatches)
+{
+    const Bounds<double> bounds(tolerance);
+    double maxError = 0;
+    size_t done = 0;
+
+    switch (simdLevel()) {
+#ifdef TESTCPP_HAVE_AVX2
+    case AVX2:
+        done = compareDoublesAvx2(a, b, count, bounds, mismatches, maxError);
+        break;
+#endif
+#ifdef TESTCPP_HAVE_SSE2
+    case SSE2:
+        done = compareDoublesSse2(a, b, count, bounds, mismatches, maxError);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    compareClose(a, b, done, count, bounds, mismatches, maxError);
+    mismatches.maxError = maxError;
+}
+
+}
+
+} // namespace
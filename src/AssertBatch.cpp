@@ -0,0 +1,89 @@
+#include <testcpp/AssertBatch.h>
+
+#include <algorithm>
+#include <sstream>
+
+namespace Test
+{
+
+AssertBatch::AssertBatch(size_t maxRecordedFailures) :
+    _context(Controller::currentContext()),
+    _maxRecordedFailures(static_cast<unsigned long>(maxRecordedFailures)),
+    _results()
+{ clearSiteCache(); }
+
+AssertBatch::~AssertBatch()
+{ report(); }
+
+void AssertBatch::report()
+{
+    for (size_t i = 0; i < _results.size(); ++i) {
+        const SiteResult& result = _results[i];
+
+        std::ostringstream label;
+        label << result.site->label << " for " << result.checks
+              << (result.checks == 1 ? " index" : " indices");
+        const std::string labelString = label.str();
+
+        AssertSite site = *result.site;
+        site.label = labelString.c_str();
+
+        _context.beforeAssert(site);
+        _context.afterAssert(result.failures == 0);
+        if (result.failures == 0)
+            continue;
+
+        std::ostringstream summary;
+        summary << result.failures << " of " << result.checks << " failed";
+        if (result.failures > result.recordedFailures.size())
+            summary << ", the first " << result.recordedFailures.size() << " follow";
+        _context.onAssertFailureDetail(summary.str());
+
+        for (size_t j = 0; j < result.recordedFailures.size(); ++j) {
+            const RecordedFailure& failure = result.recordedFailures[j];
+            std::ostringstream detail;
+            detail << "index " << failure.index;
+            if (!failure.values.empty())
+                detail << ", " << failure.values;
+            _context.onAssertFailureDetail(detail.str());
+        }
+    }
+
+    _results.clear();
+    clearSiteCache();
+}
+
+AssertBatch::SiteResult& AssertBatch::findSiteResult(const AssertSite& site)
+{
+    SiteResult*& cached = _siteCache[siteCacheSlot(site)];
+
+    for (size_t i = 0; i < _results.size(); ++i) {
+        if (_results[i].site == &site) {
+            cached = &_results[i];
+            return *cached;
+        }
+    }
+
+    SiteResult result;
+    result.site = &site;
+    result.checks = 0;
+    result.failures = 0;
+    _results.push_back(result);
+
+    cached = &_results.back();
+    return *cached;
+}
+
+void AssertBatch::clearSiteCache()
+{ std::fill(_siteCache, _siteCache + SITE_CACHE_SIZE, static_cast<SiteResult*>(0)); }
+
+void AssertBatch::recordFailure(SiteResult& result, size_t index,
+        const std::string& values)
+{
+    RecordedFailure failure;
+    failure.index = index;
+    failure.values = values;
+    result.recordedFailures.push_back(failure);
+}
+
+} // namespace
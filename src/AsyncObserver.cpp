@@ -0,0 +1,379 @@
+#include <testcpp/AsyncObserver.h>
+
+#ifdef TESTCPP_HAVE_THREADS
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+  #include <unistd.h>
+#endif
+
+namespace Test
+{
+
+namespace
+{
+
+const size_t CACHE_LINE_SIZE = 64;
+const size_t RECORD_HEADER_SIZE = sizeof(unsigned int);
+
+// waiters also wake up periodically, a missed notification costs latency
+// but never hangs
+const std::chrono::milliseconds WAIT_SLICE(1);
+
+size_t roundUpToPowerOfTwo(size_t value)
+{
+    size_t result = 1;
+    while (result < value)
+        result <<= 1;
+    return result;
+}
+
+}
+
+/**
+ * Owns the ring and the thread that delivers records to the observer.
+ *
+ * Records are a length header followed by encoded events. Head and tail
+ * are free-running byte counters: only the producer advances the head,
+ * only the consumer advances the tail.
+ */
+class AsyncObserver::Worker
+{
+public:
+    Worker(Observer& observer, size_t capacity) :
+        _observer(observer),
+        _capacity(roundUpToPowerOfTwo(std::max<size_t>(capacity, 64))),
+        _ring(_capacity),
+        _head(0),
+        _tail(0),
+        _published(0),
+        _delivered(0),
+        _stop(false),
+        _consumerWaiting(false),
+        _producerWaiting(false),
+        _thread()
+#ifndef _WIN32
+        , _pid(getpid())
+#endif
+    {
+        _thread = std::thread(&Worker::run, this);
+    }
+
+    ~Worker()
+    {
+        drain();
+        _stop.store(true);
+        wake(_consumerWaiting, _wakeConsumer);
+        _thread.join();
+    }
+
+    /**
+     * True in a process forked from the one that started the thread, like
+     * the workers of isolated runs, where the thread does not exist.
+     */
+    bool forked() const
+    {
+#ifndef _WIN32
+        return getpid() != _pid;
+#else
+        return false;
+#endif
+    }
+
+    bool fits(size_t size) const
+    { return size + RECORD_HEADER_SIZE <= _capacity; }
+
+    bool tryPush(const std::string& record)
+    {
+        const size_t needed = record.size() + RECORD_HEADER_SIZE;
+        const size_t head = _head.load(std::memory_order_relaxed);
+        if (_capacity - (head - _tail.load(std::memory_order_acquire)) < needed)
+            return false;
+
+        const unsigned int size = static_cast<unsigned int>(record.size());
+        copyIn(head, reinterpret_cast<const char*>(&size), RECORD_HEADER_SIZE);
+        copyIn(head + RECORD_HEADER_SIZE, record.data(), record.size());
+        _head.store(head + needed, std::memory_order_release);
+
+        _published.fetch_add(1, std::memory_order_relaxed);
+        wake(_consumerWaiting, _wakeConsumer);
+        return true;
+    }
+
+    void push(const std::string& record)
+    {
+        while (!tryPush(record))
+            waitFor(_producerWaiting, _wakeProducer, [&]() {
+                return _capacity - (_head.load() - _tail.load())
+                    >= record.size() + RECORD_HEADER_SIZE;
+            });
+    }
+
+    void drain()
+    {
+        while (_delivered.load(std::memory_order_acquire)
+                != _published.load(std::memory_order_relaxed))
+            waitFor(_producerWaiting, _wakeProducer, [&]() {
+                return _delivered.load() == _published.load();
+            });
+    }
+
+private:
+    void run()
+    {
+        // the previous record stays alive while the next one is replayed,
+        // observers may hold on to assertion sites of the previous record
+        std::string record;
+        std::string previous;
+
+        for (;;) {
+            if (pop(record)) {
+                deliver(record);
+                record.swap(previous);
+                _delivered.fetch_add(1, std::memory_order_release);
+                wake(_producerWaiting, _wakeProducer);
+                continue;
+            }
+
+            if (_stop.load())
+                return;
+
+            waitFor(_consumerWaiting, _wakeConsumer, [&]() {
+                return _head.load() != _tail.load() || _stop.load();
+            });
+        }
+    }
+
+    bool pop(std::string& record)
+    {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        if (_head.load(std::memory_order_acquire) == tail)
+            return false;
+
+        unsigned int size = 0;
+        copyOut(tail, reinterpret_cast<char*>(&size), RECORD_HEADER_SIZE);
+        record.resize(size);
+        if (size)
+            copyOut(tail + RECORD_HEADER_SIZE, &record[0], size);
+
+        // the space is released before the events are delivered
+        _tail.store(tail + RECORD_HEADER_SIZE + size, std::memory_order_release);
+        return true;
+    }
+
+    void deliver(const std::string& record)
+    {
+        try {
+            EventRecorder::replay(record, _observer);
+        } catch (const std::exception& e) {
+            std::cerr << "AsyncObserver: observer failed: " << e.what() << std::endl;
+        } catch (...) {
+            std::cerr << "AsyncObserver: observer failed" << std::endl;
+        }
+    }
+
+    void copyIn(size_t pos, const char* data, size_t size)
+    {
+        const size_t offset = pos & (_capacity - 1);
+        const size_t first = std::min(size, _capacity - offset);
+        std::memcpy(&_ring[offset], data, first);
+        std::memcpy(&_ring[0], data + first, size - first);
+    }
+
+    void copyOut(size_t pos, char* data, size_t size) const
+    {
+        const size_t offset = pos & (_capacity - 1);
+        const size_t first = std::min(size, _capacity - offset);
+        std::memcpy(data, &_ring[offset], first);
+        std::memcpy(data + first, &_ring[0], size - first);
+    }
+
+    template <typename Predicate>
+    void waitFor(std::atomic<bool>& waiting, std::condition_variable& wakeup,
+            Predicate ready)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        waiting.store(true);
+        wakeup.wait_for(lock, WAIT_SLICE, ready);
+        waiting.store(false);
+    }
+
+    void wake(std::atomic<bool>& waiting, std::condition_variable& wakeup)
+    {
+        // the lock is only taken when the other side is about to sleep
+        if (waiting.load()) {
+            std::lock_guard<std::mutex> guard(_mutex);
+            wakeup.notify_all();
+        }
+    }
+
+    Observer& _observer;
+
+    const size_t _capacity;
+    std::vector<char> _ring;
+
+    char _padding0[CACHE_LINE_SIZE];
+    std::atomic<size_t> _head;
+    char _padding1[CACHE_LINE_SIZE];
+    std::atomic<size_t> _tail;
+    char _padding2[CACHE_LINE_SIZE];
+
+    std::atomic<unsigned long> _published;
+    std::atomic<unsigned long> _delivered;
+
+    std::atomic<bool> _stop;
+    std::atomic<bool> _consumerWaiting;
+    std::atomic<bool> _producerWaiting;
+    std::mutex _mutex;
+    std::condition_variable _wakeConsumer;
+    std::condition_variable _wakeProducer;
+
+    std::thread _thread;
+#ifndef _WIN32
+    const pid_t _pid;
+#endif
+};
+
+AsyncObserver::AsyncObserver(Observer* observer, BackpressurePolicy policy,
+        size_t ringBytes) :
+    EventRecorder(),
+    _observer(observer),
+    _policy(policy),
+    _deferPublish(false),
+    _assertPending(false),
+    _droppedAssertions(0),
+    _worker()
+{
+    if (!observer)
+        throw std::runtime_error("Observer cannot be null");
+    _worker.reset(new Worker(*_observer, ringBytes));
+}
+
+AsyncObserver::~AsyncObserver()
+{
+    // the observer and the events belong to the parent process, a forked
+    // copy would wait for the missing thread forever
+    if (_worker->forked()) {
+        _worker.release();
+        _observer.release();
+        return;
+    }
+
+    publish(false);
+    // joins the thread before the observer is destroyed
+    _worker.reset();
+}
+
+unsigned long AsyncObserver::droppedAssertions() const
+{ return _droppedAssertions; }
+
+void AsyncObserver::drain()
+{ _worker->drain(); }
+
+void AsyncObserver::eventRecorded()
+{
+    if (!_deferPublish)
+        publish(false);
+}
+
+void AsyncObserver::onAssertBegin(const AssertSite& site)
+{
+    // held back until the assertion ends, so that a passing assertion can
+    // be dropped as a whole
+    _deferPublish = true;
+    EventRecorder::onAssertBegin(site);
+    _deferPublish = false;
+    _assertPending = true;
+}
+
+void AsyncObserver::onAssertEnd(bool ok)
+{
+    _deferPublish = true;
+    EventRecorder::onAssertEnd(ok);
+    endAssert(ok);
+}
+
+void AsyncObserver::onAssertExceptionEndWithExpectedException(const std::exception& e)
+{
+    _deferPublish = true;
+    EventRecorder::onAssertExceptionEndWithExpectedException(e);
+    endAssert(true);
+}
+
+void AsyncObserver::onAssertExceptionEndWithUnexpectedException(const std::exception& e)
+{
+    _deferPublish = true;
+    EventRecorder::onAssertExceptionEndWithUnexpectedException(e);
+    endAssert(false);
+}
+
+void AsyncObserver::onAssertExceptionEndWithEllipsisException()
+{
+    _deferPublish = true;
+    EventRecorder::onAssertExceptionEndWithEllipsisException();
+    endAssert(false);
+}
+
+void AsyncObserver::onAssertNoExceptionEndWithStdException(const std::exception& e)
+{
+    _deferPublish = true;
+    EventRecorder::onAssertNoExceptionEndWithStdException(e);
+    endAssert(false);
+}
+
+void AsyncObserver::onAssertNoExceptionEndWithEllipsisException()
+{
+    _deferPublish = true;
+    EventRecorder::onAssertNoExceptionEndWithEllipsisException();
+    endAssert(false);
+}
+
+void AsyncObserver::onAllTestSuitesEnd(int lastTestSuiteNum,
+        int testSuitesNumTotal, int numErrs, int numExcepts)
+{
+    EventRecorder::onAllTestSuitesEnd(lastTestSuiteNum,
+            testSuitesNumTotal, numErrs, numExcepts);
+    drain();
+}
+
+void AsyncObserver::endAssert(bool ok)
+{
+    _deferPublish = false;
+    publish(ok && _assertPending && _policy == DROP_PASSING_EVENTS);
+}
+
+void AsyncObserver::publish(bool droppable)
+{
+    _assertPending = false;
+
+    const std::string& record = buffer();
+    if (record.empty())
+        return;
+
+    if (!_worker->fits(record.size())) {
+        // too large for the ring, deliver on this thread once the
+        // background thread is idle
+        _worker->drain();
+        EventRecorder::replay(record, *_observer);
+    } else if (droppable) {
+        if (!_worker->tryPush(record))
+            ++_droppedAssertions;
+    } else {
+        _worker->push(record);
+    }
+
+    clear();
+}
+
+} // namespace
+
+#endif /* TESTCPP_HAVE_THREADS */
@@ -0,0 +1,225 @@
+#include <testcpp/AsyncTest.h>
+
+#ifdef TESTCPP_HAVE_ASYNC_TESTS
+
+#include <testcpp/detail/Clock.h>
+#include <testcpp/detail/EventRecorder.h>
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+namespace Test
+{
+
+namespace
+{
+
+std::runtime_error neverResumedError()
+{
+    return std::runtime_error("Async test case waits for something other "
+            "than the test event loop and can never resume");
+}
+
+/** Runs an async test case to completion on an event loop of its own. */
+class AsyncTestCaseSuite : public Suite
+{
+    UTILCPP_DISABLE_COPY(AsyncTestCaseSuite)
+
+public:
+    explicit AsyncTestCaseSuite(const detail::AsyncTestCaseDescriptor& descriptor) :
+        _descriptor(descriptor)
+    { }
+
+    virtual void test()
+    {
+        detail::EventLoop loop;
+        detail::AsyncCaseState caseState(Controller::currentContext());
+        AsyncTask task = _descriptor.run(_descriptor.testCase);
+
+        task.start(loop, caseState);
+        while (!caseState.done && loop.runOnce())
+            ;
+
+        if (!caseState.done)
+            throw neverResumedError();
+        if (task.exception())
+            std::rethrow_exception(task.exception());
+    }
+
+private:
+    const detail::AsyncTestCaseDescriptor& _descriptor;
+};
+
+}
+
+namespace detail
+{
+
+suite_transferable_ptr createAsyncTestCase(const void* descriptor)
+{
+    return suite_transferable_ptr(new AsyncTestCaseSuite(
+                *static_cast<const AsyncTestCaseDescriptor*>(descriptor)));
+}
+
+const AsyncTestCaseDescriptor* keepAsyncTestCase(
+        const AsyncTestCaseDescriptor& descriptor)
+{
+    static std::mutex lock;
+    // a deque does not move its elements
+    static std::deque<AsyncTestCaseDescriptor> descriptors;
+
+    std::lock_guard<std::mutex> guard(lock);
+    descriptors.push_back(descriptor);
+    return &descriptors.back();
+}
+
+}
+
+/**
+ * An async test case in flight. Its events are recorded until it is
+ * reported, so that they reach the observer as an uninterrupted block.
+ */
+struct Controller::AsyncTestCaseRun
+{
+    AsyncTestCaseRun(Controller& controller, const SuiteDescriptor& testSuite_,
+            int testSuiteNum, int testSuitesNumTotal) :
+        testSuite(testSuite_),
+        recorder(),
+        context(&recorder, controller._observer->subscribedEvents()),
+        caseState(context),
+        watchedScope(new WatchedTestSuiteScope(controller._watchdog,
+                    testSuite_, testSuiteNum, testSuitesNumTotal, context)),
+        start(detail::monotonicSeconds()),
+        end(0),
+        ended(false),
+        task()
+    { }
+
+    /** Stops the clock and the watchdog of a case that is done or stuck. */
+    void endRun()
+    {
+        end = detail::monotonicSeconds();
+        ended = true;
+        watchedScope.reset();
+    }
+
+    const SuiteDescriptor& testSuite;
+    EventRecorder recorder;
+    AssertionContext context;
+    detail::AsyncCaseState caseState;
+    std::unique_ptr<WatchedTestSuiteScope> watchedScope;
+    double start;
+    double end;
+    bool ended;
+    AsyncTask task;
+};
+
+size_t Controller::runAsyncTestCases(size_t first)
+{
+    const size_t testSuiteCount = _plan.size();
+
+    size_t last = first;
+    while (last < testSuiteCount
+            && detail::isAsyncTestCase(_testSuites[_plan[last]]))
+        ++last;
+
+    detail::EventLoop loop;
+    // in plan order, so that the cases are reported in the order of their
+    // numbers; cases that wait to be reported count towards the limit
+    std::deque<std::unique_ptr<AsyncTestCaseRun> > running;
+    size_t next = first;
+
+    for (;;) {
+        while (next < last && !maxFailuresReached()
+                && (_asyncTestCaseConcurrency == 0
+                    || running.size() < _asyncTestCaseConcurrency)) {
+            const SuiteDescriptor& testSuite = _testSuites[_plan[next++]];
+            int testSuiteNum;
+            {
+                detail::SharedObserverLock lock(runStateLock());
+                testSuiteNum = ++_curTestSuite;
+            }
+
+            running.push_back(std::unique_ptr<AsyncTestCaseRun>(
+                        new AsyncTestCaseRun(*this, testSuite,
+                            testSuiteNum, testSuiteCount)));
+            AsyncTestCaseRun& run = *running.back();
+
+            run.recorder.onTestSuiteBegin(testSuite.label, testSuiteNum,
+                    testSuiteCount);
+            const detail::AsyncTestCaseDescriptor& descriptor =
+                *static_cast<const detail::AsyncTestCaseDescriptor*>(
+                        testSuite.parameter);
+            run.task = descriptor.run(descriptor.testCase);
+            run.task.start(loop, run.caseState);
+        }
+
+        if (running.empty())
+            break;
+
+        // cases that are neither done nor waiting on the loop are stuck
+        const bool waiting = loop.runOnce();
+
+        for (size_t i = 0; i < running.size(); ++i)
+            if (!running[i]->ended && (running[i]->caseState.done || !waiting))
+                running[i]->endRun();
+
+        while (!running.empty() && running.front()->ended) {
+            endAsyncTestCase(*running.front());
+            running.pop_front();
+        }
+    }
+
+    return last;
+}
+
+void Controller::endAsyncTestCase(AsyncTestCaseRun& run)
+{
+    Observer& observer = run.context.observer();
+
+    TestSuiteStats stats;
+    stats.wallSeconds = run.end - run.start;
+    stats.cpuSeconds = run.caseState.cpuSeconds;
+    stats.peakResidentSetKilobytes = detail::peakResidentSetKilobytes();
+
+    const std::exception_ptr exception = run.caseState.done
+        ? run.task.exception() : std::make_exception_ptr(neverResumedError());
+    {
+        // a stuck case destroys its fixture here
+        CurrentContextScope currentContextScope(run.context);
+        run.task = AsyncTask();
+    }
+
+    adoptUnattributedErrs(run.context);
+    run.context.mergeAdopted();
+    observer.onTestSuiteStats(stats);
+
+    bool endedWithException = true;
+    try {
+        if (exception)
+            std::rethrow_exception(exception);
+        observer.onTestSuiteEnd(run.context.errs());
+        endedWithException = false;
+    } catch (const std::exception& e) {
+        observer.onTestSuiteEndWithStdException(run.context.errs(), e);
+    } catch (...) {
+        observer.onTestSuiteEndWithEllipsisException(run.context.errs());
+    }
+
+    endSharedFixtureUse(run.testSuite);
+
+    detail::SharedObserverLock lock(runStateLock());
+    EventRecorder::replay(run.recorder.buffer(), *_observer);
+    _allTestErrs += run.context.errs();
+    if (endedWithException)
+        ++_allTestExcepts;
+
+    recordTestSuiteResult(run.testSuite.label,
+            endedWithException || run.context.errs() > 0, stats.wallSeconds);
+}
+
+} // namespace
+
+#endif
@@ -0,0 +1,181 @@
+#include <testcpp/testcpp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+namespace Test
+{
+
+namespace
+{
+
+const char* const SUITE = "suite";
+const char* const BENCHMARK = "benchmark";
+
+/** Enough samples for the deviation of a suite to settle. */
+const size_t MAX_BASELINE_SAMPLES = 30;
+
+/** Suites slow down by less than this due to scheduling alone. */
+const double MIN_SUITE_SLOWDOWN_SECONDS = 0.005;
+
+typedef Controller::Timings Timings;
+
+/** Reads "suite|benchmark<TAB>label<TAB>samples" lines. */
+void loadBaseline(const std::string& path, Timings& suites, Timings& benchmarks)
+{
+    std::ifstream in(path.c_str());
+
+    std::string line;
+    while (std::getline(in, line)) {
+        const size_t labelTab = line.find('\t');
+        const size_t samplesTab = line.rfind('\t');
+        if (labelTab == std::string::npos || samplesTab == labelTab)
+            continue;
+
+        const std::string kind = line.substr(0, labelTab);
+        if (kind != SUITE && kind != BENCHMARK)
+            continue;
+
+        std::vector<double> samples;
+        const char* pos = line.c_str() + samplesTab + 1;
+        for (;;) {
+            char* end = 0;
+            const double value = std::strtod(pos, &end);
+            if (end == pos)
+                break;
+            if (value >= 0)
+                samples.push_back(value);
+            pos = end;
+        }
+        if (samples.empty())
+            continue;
+
+        Timings& timings = kind == SUITE ? suites : benchmarks;
+        timings[line.substr(labelTab + 1, samplesTab - labelTab - 1)].swap(samples);
+    }
+}
+
+void saveBaseline(const std::string& path, const Timings& suites,
+        const Timings& benchmarks)
+{
+    // replace the file at once, readers never see a partial baseline
+    const std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath.c_str(), std::ios::out | std::ios::trunc);
+        out.precision(std::numeric_limits<double>::digits10);
+
+        for (int k = 0; k < 2; ++k) {
+            const Timings& timings = k == 0 ? suites : benchmarks;
+            for (Timings::const_iterator i = timings.begin(); i != timings.end(); ++i) {
+                out << (k == 0 ? SUITE : BENCHMARK) << "\t" << i->first << "\t";
+                for (size_t s = 0; s < i->second.size(); ++s)
+                    out << (s ? " " : "") << i->second[s];
+                out << "\n";
+            }
+        }
+
+        if (!out.flush()) {
+            std::cerr << "Cannot write baseline to '" << tmpPath << "'" << std::endl;
+            return;
+        }
+    }
+
+#ifdef _WIN32
+    std::remove(path.c_str());
+#endif
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "Cannot replace baseline file '" << path << "'" << std::endl;
+        std::remove(tmpPath.c_str());
+    }
+}
+
+/** Appends the samples of the run, keeping the most recent ones. */
+void addSamples(const Timings& run, Timings& baseline)
+{
+    for (Timings::const_iterator i = run.begin(); i != run.end(); ++i) {
+        std::vector<double>& samples = baseline[i->first];
+        samples.insert(samples.end(), i->second.begin(), i->second.end());
+
+        const size_t keep = std::max(MAX_BASELINE_SAMPLES, i->second.size());
+        if (samples.size() > keep)
+            samples.erase(samples.begin(), samples.end() - keep);
+    }
+}
+
+double median(std::vector<double> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    const size_t middle = samples.size() / 2;
+    return samples.size() % 2
+        ? samples[middle] : (samples[middle - 1] + samples[middle]) / 2;
+}
+
+/** Median absolute deviation, scaled to estimate the standard deviation. */
+double deviation(const std::vector<double>& samples, double center)
+{
+    std::vector<double> deviations;
+    for (size_t i = 0; i < samples.size(); ++i)
+        deviations.push_back(std::fabs(samples[i] - center));
+    return 1.4826 * median(deviations);
+}
+
+}
+
+void Controller::checkBaseline()
+{
+    if (_baselinePath.empty())
+        return;
+
+    Timings suites;
+    Timings benchmarks;
+    loadBaseline(_baselinePath, suites, benchmarks);
+
+    if (_updateBaseline) {
+        addSamples(_suiteTimings, suites);
+        addSamples(_benchmarkTimings, benchmarks);
+        saveBaseline(_baselinePath, suites, benchmarks);
+        _suiteTimings.clear();
+        _benchmarkTimings.clear();
+        return;
+    }
+
+    for (int k = 0; k < 2; ++k) {
+        const bool benchmark = k == 1;
+        const Timings& run = benchmark ? _benchmarkTimings : _suiteTimings;
+        const Timings& baseline = benchmark ? benchmarks : suites;
+
+        for (Timings::const_iterator i = run.begin(); i != run.end(); ++i) {
+            Timings::const_iterator found = baseline.find(i->first);
+            if (found == baseline.end() || i->second.empty())
+                continue;
+
+            TimingRegression regression;
+            regression.label = i->first;
+            regression.benchmark = benchmark;
+            regression.baselineMedian = median(found->second);
+            regression.median = median(i->second);
+
+            const double slowdown = std::max(
+                    _regressionThreshold * regression.baselineMedian,
+                    _regressionDeviations
+                        * deviation(found->second, regression.baselineMedian));
+            regression.threshold = regression.baselineMedian + (benchmark
+                    ? slowdown : std::max(slowdown, MIN_SUITE_SLOWDOWN_SECONDS));
+
+            if (regression.median > regression.threshold) {
+                _observer->onTimingRegression(regression);
+                ++_allTestErrs;
+            }
+        }
+    }
+
+    _suiteTimings.clear();
+    _benchmarkTimings.clear();
+}
+
+} // namespace
@@ -0,0 +1,244 @@
+#include <testcpp/testcpp.h>
+#include <testcpp/detail/Clock.h>
+#include <testcpp/detail/Watchdog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(_WIN32)
+  #include <windows.h>
+#elif defined(__linux__)
+  #include <sched.h>
+#endif
+
+namespace Test
+{
+
+namespace detail
+{
+
+// out of line so that the compiler cannot see that the pointer is unused
+void useCharPointer(const volatile char*)
+{ }
+
+}
+
+namespace
+{
+
+/** Pins the calling thread to a CPU for the lifetime of the scope. */
+class CpuPinning
+{
+    UTILCPP_DISABLE_COPY(CpuPinning)
+
+public:
+    explicit CpuPinning(int cpu) :
+        _pinned(false)
+    {
+        if (cpu < 0)
+            return;
+
+#if defined(_WIN32)
+        _previous = SetThreadAffinityMask(GetCurrentThread(),
+                static_cast<DWORD_PTR>(1) << cpu);
+        _pinned = _previous != 0;
+#elif defined(__linux__)
+        if (sched_getaffinity(0, sizeof(_previous), &_previous) != 0)
+            return;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        _pinned = sched_setaffinity(0, sizeof(set), &set) == 0;
+#endif
+    }
+
+    ~CpuPinning()
+    {
+        if (!_pinned)
+            return;
+
+#if defined(_WIN32)
+        SetThreadAffinityMask(GetCurrentThread(), _previous);
+#elif defined(__linux__)
+        sched_setaffinity(0, sizeof(_previous), &_previous);
+#endif
+    }
+
+private:
+    bool _pinned;
+#if defined(_WIN32)
+    DWORD_PTR _previous;
+#elif defined(__linux__)
+    cpu_set_t _previous;
+#endif
+};
+
+double timeIterations(Benchmark& benchmark, size_t iterations)
+{
+    const double start = detail::monotonicSeconds();
+    benchmark.benchmark(iterations);
+    return detail::monotonicSeconds() - start;
+}
+
+void warmUp(Benchmark& benchmark, double seconds)
+{
+    double elapsed = 0;
+    for (size_t iterations = 1; elapsed < seconds; iterations *= 2)
+        elapsed += timeIterations(benchmark, iterations);
+}
+
+/** Finds the iteration count that makes a sample take at least seconds. */
+size_t calibrate(Benchmark& benchmark, double seconds)
+{
+    size_t iterations = 1;
+
+    for (;;) {
+        const double elapsed = timeIterations(benchmark, iterations);
+        if (elapsed >= seconds)
+            return iterations;
+
+        // aim a bit over the target, grow at most tenfold per round
+        double factor = elapsed > 0 ? 1.2 * seconds / elapsed : 10;
+        factor = std::min(std::max(factor, 2.0), 10.0);
+        iterations = static_cast<size_t>(iterations * factor);
+    }
+}
+
+double percentile(const std::vector<double>& sorted, double p)
+{
+    const double rank = p * (sorted.size() - 1);
+    const size_t lower = static_cast<size_t>(rank);
+    if (lower + 1 >= sorted.size())
+        return sorted.back();
+    return sorted[lower] + (rank - lower) * (sorted[lower + 1] - sorted[lower]);
+}
+
+/** Keeps the samples within threshold median absolute deviations. */
+std::vector<double> rejectOutliers(const std::vector<double>& samples,
+        double threshold)
+{
+    std::vector<double> sorted(samples);
+    std::sort(sorted.begin(), sorted.end());
+    const double median = percentile(sorted, 0.5);
+
+    std::vector<double> deviations;
+    for (size_t i = 0; i < samples.size(); ++i)
+        deviations.push_back(std::fabs(samples[i] - median));
+    std::sort(deviations.begin(), deviations.end());
+
+    // scaled to estimate the standard deviation of normal data
+    const double mad = 1.4826 * percentile(deviations, 0.5);
+
+    if (threshold <= 0 || mad == 0)
+        return samples;
+
+    std::vector<double> kept;
+    for (size_t i = 0; i < samples.size(); ++i)
+        if (std::fabs(samples[i] - median) <= threshold * mad)
+            kept.push_back(samples[i]);
+    return kept;
+}
+
+BenchmarkResult measure(Benchmark& benchmark, const std::string& label,
+        const BenchmarkOptions& options, bool countPerformance)
+{
+    CpuPinning pinning(options.cpu);
+
+    warmUp(benchmark, options.warmupSeconds);
+
+    BenchmarkResult result;
+    result.label = label;
+    result.iterationsPerSample = calibrate(benchmark, options.minSampleSeconds);
+
+    std::vector<double> samples;
+    samples.reserve(std::max(options.samples, 1));
+    {
+        PerformanceCounterScope counterScope(countPerformance);
+        for (int i = 0; i < std::max(options.samples, 1); ++i)
+            samples.push_back(1e9 * timeIterations(benchmark,
+                        result.iterationsPerSample) / result.iterationsPerSample);
+        result.counters = counterScope.counters().dividedBy(
+                static_cast<double>(samples.size()) * result.iterationsPerSample);
+    }
+
+    result.samples = rejectOutliers(samples, options.outlierThreshold);
+    result.rejectedSamples = static_cast<int>(samples.size() - result.samples.size());
+
+    std::vector<double> sorted(result.samples);
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum = 0;
+    for (size_t i = 0; i < sorted.size(); ++i)
+        sum += sorted[i];
+
+    result.min = sorted.front();
+    result.median = percentile(sorted, 0.5);
+    result.mean = sum / sorted.size();
+    result.p90 = percentile(sorted, 0.9);
+    result.p99 = percentile(sorted, 0.99);
+    result.max = sorted.back();
+
+    return result;
+}
+
+}
+
+void Controller::runBenchmarks()
+{
+    const int benchmarkCount = static_cast<int>(_benchmarkPlan.size());
+
+    for (int i = 0; i < benchmarkCount; ++i) {
+        const BenchmarkRegistration& registration = _benchmarks[_benchmarkPlan[i]];
+
+        AssertionContext context(_observer);
+        CurrentContextScope currentContextScope(context);
+
+        {
+            detail::SharedObserverLock lock(runStateLock());
+            if (maxFailuresReached())
+                break;
+
+            _observer->onBenchmarkBegin(registration.label, i + 1, benchmarkCount);
+
+            // the watchdog stops a benchmark that runs past the deadline,
+            // the rest are not started
+            if (_runDeadline > 0 && detail::monotonicSeconds() >= _runDeadline) {
+                _observer->onBenchmarkEndWithStdException(detail::timeoutException(
+                            detail::timeoutReason("Test run", _runTimeout), 0, 0));
+                ++_allTestExcepts;
+                ++_failedTestSuites;
+                break;
+            }
+        }
+
+        bool endedWithException = true;
+        try {
+            benchmark_scoped_ptr benchmark(registration.factory());
+            BenchmarkResult result = measure(*benchmark,
+                    registration.label, registration.options, _countPerformance);
+
+            detail::SharedObserverLock lock(runStateLock());
+            _observer->onBenchmarkEnd(result);
+            if (!_baselinePath.empty())
+                _benchmarkTimings[registration.label] = result.samples;
+            endedWithException = false;
+        } catch (const std::exception& e) {
+            detail::SharedObserverLock lock(runStateLock());
+            _observer->onBenchmarkEndWithStdException(e);
+        } catch (...) {
+            detail::SharedObserverLock lock(runStateLock());
+            _observer->onBenchmarkEndWithEllipsisException();
+        }
+
+        detail::SharedObserverLock lock(runStateLock());
+        if (endedWithException)
+            ++_allTestExcepts;
+        // assertions in benchmarks count like assertions in suites
+        _allTestErrs += context.errs();
+        if (endedWithException || context.errs() > 0)
+            ++_failedTestSuites;
+    }
+}
+
+} // namespace
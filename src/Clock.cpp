@@ -0,0 +1,85 @@
+#include <testcpp/detail/Clock.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <time.h>
+  #include <sys/resource.h>
+#endif
+
+namespace Test
+{
+
+namespace detail
+{
+
+#ifdef _WIN32
+
+double monotonicSeconds()
+{
+    static LARGE_INTEGER frequency;
+    if (!frequency.QuadPart)
+        QueryPerformanceFrequency(&frequency);
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return static_cast<double>(now.QuadPart) / frequency.QuadPart;
+}
+
+double threadCpuSeconds()
+{
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+        return 0;
+
+    // 100-nanosecond intervals
+    const double ticks =
+        (static_cast<double>(kernel.dwHighDateTime) + user.dwHighDateTime) * 4294967296.0
+        + kernel.dwLowDateTime + user.dwLowDateTime;
+    return ticks * 1e-7;
+}
+
+long peakResidentSetKilobytes()
+{
+    return 0;
+}
+
+#else
+
+double monotonicSeconds()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+double threadCpuSeconds()
+{
+    rusage usage;
+#ifdef RUSAGE_THREAD
+    if (getrusage(RUSAGE_THREAD, &usage) != 0)
+#endif
+        getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+        + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+}
+
+long peakResidentSetKilobytes()
+{
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+#endif
+
+}
+
+} // namespace
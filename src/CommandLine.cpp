@@ -0,0 +1,286 @@
+#include <testcpp/testcpp.h>
+
+#include <iostream>
+#include <stdexcept>
+#include <cctype>
+#include <cerrno>
+#include <cfloat>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+namespace Test
+{
+
+namespace
+{
+
+const char* const USAGE =
+    "Options:\n"
+    "  --filter=GLOB             run suites with a matching label\n"
+    "  --filter-regex=REGEX      run suites with a label matching REGEX\n"
+    "  --exclude=GLOB            skip suites with a matching label\n"
+    "  --exclude-regex=REGEX     skip suites with a label matching REGEX\n"
+    "  --list                    list the selected suites and exit\n"
+    "  --jobs=N                  run on N threads, 0 for all hardware threads\n"
+    "  --isolate                 run the suites in worker processes\n"
+    "  --shard=INDEX/COUNT       run one shard of the suites and benchmarks\n"
+    "  --shard-durations=PATH    balance shards by suite durations in PATH\n"
+    "  --timeout=SECONDS         fail suites that run longer than SECONDS\n"
+    "  --run-timeout=SECONDS     limit the time of the whole run\n"
+    "  --history=PATH            keep suite results and durations in PATH\n"
+    "  --order=ORDER             registration, failed-first, fastest-first\n"
+    "                            or longest-first, by the history\n"
+    "  --fail-fast               stop starting suites after the first failure\n"
+    "  --max-failures=N          stop starting suites after N failures\n"
+    "  --perf-counters           count CPU events of suites and benchmarks\n"
+    "  --baseline=PATH           fail when suites or benchmarks got slower\n"
+    "                            than in the baseline in PATH\n"
+    "  --update-baseline         add the times of the run to the baseline\n"
+    "  --regression-threshold=F  slowdown that fails, 0.1 (10%) by default\n"
+    "  --property-seed=N         seed of the property cases, random by default\n"
+    "  --group-fixtures          run suites that share a fixture one after another\n"
+    "  --async-cases=N           async test cases in flight at a time, 0 for\n"
+    "                            no limit, 64 by default\n"
+    "  --help                    show this help\n";
+
+class UsageError : public std::runtime_error
+{
+public:
+    explicit UsageError(const std::string& msg) :
+        std::runtime_error(msg)
+    { }
+};
+
+class Arguments
+{
+public:
+    Arguments(int argc, char* argv[]) :
+        _argc(argc),
+        _argv(argv),
+        _pos(1),
+        _value()
+    { }
+
+    bool atEnd() const
+    { return _pos >= _argc; }
+
+    const char* current() const
+    { return _argv[_pos]; }
+
+    bool flag(const char* name)
+    {
+        if (std::strcmp(current(), name) != 0)
+            return false;
+        ++_pos;
+        return true;
+    }
+
+    /** Accepts both --name=value and --name value. */
+    bool option(const char* name)
+    {
+        const size_t length = std::strlen(name);
+        const char* arg = current();
+
+        if (std::strncmp(arg, name, length) != 0)
+            return false;
+
+        if (arg[length] == '=') {
+            _value = arg + length + 1;
+            ++_pos;
+            return true;
+        }
+
+        if (arg[length] == '\0') {
+            if (_pos + 1 >= _argc)
+                throw UsageError(std::string("Missing value for ") + name);
+            _value = _argv[_pos + 1];
+            _pos += 2;
+            return true;
+        }
+
+        return false;
+    }
+
+    const std::string& value() const
+    { return _value; }
+
+private:
+    int _argc;
+    char** _argv;
+    int _pos;
+    std::string _value;
+};
+
+/**
+ * Parses decimal digits only, as strtoul() skips spaces, accepts a sign
+ * and negates. Returns false on overflow.
+ */
+bool parseDigits(const std::string& str, unsigned long& value)
+{
+    if (str.empty() || !std::isdigit(static_cast<unsigned char>(str[0])))
+        return false;
+
+    char* end = 0;
+    errno = 0;
+    value = std::strtoul(str.c_str(), &end, 10);
+    return *end == '\0' && errno != ERANGE;
+}
+
+unsigned parseUnsigned(const std::string& str, const char* option)
+{
+    unsigned long value = 0;
+    if (!parseDigits(str, value) || value > UINT_MAX)
+        throw UsageError(std::string("Invalid number for ") + option + ": " + str);
+    return static_cast<unsigned>(value);
+}
+
+unsigned long parseSeed(const std::string& str)
+{
+    unsigned long value = 0;
+    if (!parseDigits(str, value))
+        throw UsageError("Invalid seed for --property-seed: " + str);
+    return value;
+}
+
+Controller::TestSuiteOrder parseOrder(const std::string& str)
+{
+    if (str == "registration")
+        return Controller::REGISTRATION_ORDER;
+    if (str == "failed-first")
+        return Controller::FAILED_FIRST;
+    if (str == "fastest-first")
+        return Controller::FASTEST_FIRST;
+    if (str == "longest-first")
+        return Controller::LONGEST_FIRST;
+    throw UsageError("Invalid --order: " + str);
+}
+
+/**
+ * Parses a finite number that is not negative, strtod() also accepts nan
+ * and inf. NaN fails both comparisons.
+ */
+bool parseNonNegative(const std::string& str, double& value)
+{
+    char* end = 0;
+    value = std::strtod(str.c_str(), &end);
+    return !str.empty() && *end == '\0' && value >= 0 && value <= DBL_MAX;
+}
+
+double parseSeconds(const std::string& str, const char* option)
+{
+    double value = 0;
+    if (!parseNonNegative(str, value))
+        throw UsageError(std::string("Invalid number of seconds for ") + option + ": " + str);
+    return value;
+}
+
+double parseFraction(const std::string& str, const char* option)
+{
+    double value = 0;
+    if (!parseNonNegative(str, value))
+        throw UsageError(std::string("Invalid fraction for ") + option + ": " + str);
+    return value;
+}
+
+}
+
+int Controller::run(int argc, char* argv[])
+{
+    bool list = false;
+    bool isolate = false;
+    bool jobsGiven = false;
+    unsigned jobs = 1;
+
+    try {
+        Arguments args(argc, argv);
+
+        while (!args.atEnd()) {
+            if (args.flag("--help")) {
+                std::cout << "Usage: " << (argc > 0 ? argv[0] : "test")
+                          << " [options]\n" << USAGE;
+                return 0;
+            } else if (args.flag("--list")) {
+                list = true;
+            } else if (args.flag("--isolate")) {
+                isolate = true;
+            } else if (args.option("--filter")) {
+                addFilter(args.value());
+            } else if (args.option("--filter-regex")) {
+                addFilterRegex(args.value());
+            } else if (args.option("--exclude")) {
+                addExclude(args.value());
+            } else if (args.option("--exclude-regex")) {
+                addExcludeRegex(args.value());
+            } else if (args.option("--jobs")) {
+                jobs = parseUnsigned(args.value(), "--jobs");
+                jobsGiven = true;
+            } else if (args.option("--shard")) {
+                const std::string& shard = args.value();
+                const size_t slash = shard.find('/');
+                if (slash == std::string::npos)
+                    throw UsageError("Invalid --shard, expected INDEX/COUNT: " + shard);
+                const unsigned index = parseUnsigned(shard.substr(0, slash), "--shard");
+                const unsigned count = parseUnsigned(shard.substr(slash + 1), "--shard");
+                if (index >= count)
+                    throw UsageError("Shard index must be less than shard count: " + shard);
+                setShard(index, count);
+            } else if (args.option("--shard-durations")) {
+                setShardDurationsFile(args.value());
+            } else if (args.option("--timeout")) {
+                setTestSuiteTimeout(parseSeconds(args.value(), "--timeout"));
+            } else if (args.option("--run-timeout")) {
+                setRunTimeout(parseSeconds(args.value(), "--run-timeout"));
+            } else if (args.option("--history")) {
+                setHistoryFile(args.value());
+            } else if (args.option("--order")) {
+                setTestSuiteOrder(parseOrder(args.value()));
+            } else if (args.flag("--fail-fast")) {
+                setMaxFailures(1);
+            } else if (args.option("--max-failures")) {
+                setMaxFailures(parseUnsigned(args.value(), "--max-failures"));
+            } else if (args.flag("--perf-counters")) {
+                setPerformanceCounters(true);
+            } else if (args.option("--baseline")) {
+                setBaselineFile(args.value());
+            } else if (args.flag("--update-baseline")) {
+                setBaselineUpdate(true);
+            } else if (args.option("--regression-threshold")) {
+                setRegressionThreshold(parseFraction(args.value(),
+                            "--regression-threshold"), _regressionDeviations);
+            } else if (args.flag("--group-fixtures")) {
+                setGroupBySharedFixture(true);
+            } else if (args.option("--async-cases")) {
+                setAsyncTestCaseConcurrency(parseUnsigned(args.value(),
+                            "--async-cases"));
+            } else if (args.option("--property-seed")) {
+                setPropertySeed(parseSeed(args.value()));
+            } else {
+                throw UsageError(std::string("Unknown argument: ") + args.current());
+            }
+        }
+
+        // reports invalid patterns and shard settings before the run
+        const std::vector<std::string> labels = plannedTestSuiteLabels();
+
+        if (list) {
+            for (size_t i = 0; i < labels.size(); ++i)
+                std::cout << labels[i] << "\n";
+            std::cout.flush();
+            return 0;
+        }
+    } catch (const UsageError& e) {
+        std::cerr << e.what() << "\n" << USAGE;
+        return 1;
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+
+    if (isolate)
+        return runIsolated(jobsGiven ? jobs : 0);
+
+    return run(jobs);
+}
+
+} // namespace
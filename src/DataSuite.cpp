@@ -0,0 +1,505 @@
+#include <testcpp/DataSuite.h>
+
+#include <cstring>
+#include <deque>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+namespace Test
+{
+
+namespace
+{
+
+// the ranges of the parts cover the file, a record belongs to the part
+// that its first byte is in
+size_t partBoundary(size_t size, unsigned part, unsigned parts)
+{
+    return part == parts
+        ? size : static_cast<size_t>(static_cast<double>(size) * part / parts);
+}
+
+}
+
+bool VectorField::equals(const void* bytes, size_t byteCount) const
+{ return size == byteCount && (size == 0 || std::memcmp(data, bytes, size) == 0); }
+
+bool operator==(const VectorField& a, const VectorField& b)
+{ return a.equals(b.data, b.size); }
+
+bool operator==(const VectorField& field, const std::string& str)
+{ return field.equals(str.data(), str.size()); }
+
+bool operator==(const std::string& str, const VectorField& field)
+{ return field.equals(str.data(), str.size()); }
+
+std::ostream& operator<<(std::ostream& out, const VectorField& field)
+{
+    static const char hex[] = "0123456789abcdef";
+    const size_t MAX_PRINTED = 64;
+
+    std::string printed;
+    for (size_t i = 0; i < field.size && i < MAX_PRINTED; ++i) {
+        const unsigned char c = static_cast<unsigned char>(field.data[i]);
+        if (c >= 0x20 && c < 0x7F && c != '\\') {
+            printed += static_cast<char>(c);
+        } else {
+            printed += "\\x";
+            printed += hex[c >> 4];
+            printed += hex[c & 0xF];
+        }
+    }
+    out << printed;
+    if (field.size > MAX_PRINTED)
+        out << "... (" << field.size << " bytes)";
+    return out;
+}
+
+const VectorField& TestVector::field(size_t i) const
+{
+    if (i >= _fieldCount) {
+        std::ostringstream msg;
+        msg << "Test vector at offset " << _offset << " has " << _fieldCount
+            << " fields, field " << i << " requested";
+        throw std::out_of_range(msg.str());
+    }
+    return _fields[i];
+}
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path) :
+    _data(0),
+    _size(0),
+    _mapping(0)
+{
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("Cannot open test vector file '" + path + "'");
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        throw std::runtime_error("Cannot get the size of '" + path + "'");
+    }
+    _size = static_cast<size_t>(size.QuadPart);
+
+    // empty files cannot be mapped
+    if (_size > 0) {
+        _mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+        if (_mapping)
+            _data = static_cast<const char*>(
+                    MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    CloseHandle(file);
+
+    if (_size > 0 && !_data) {
+        if (_mapping)
+            CloseHandle(_mapping);
+        throw std::runtime_error("Cannot map test vector file '" + path + "'");
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (_data)
+        UnmapViewOfFile(_data);
+    if (_mapping)
+        CloseHandle(_mapping);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) :
+    _data(0),
+    _size(0)
+{
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Cannot open test vector file '" + path + "'");
+
+    struct stat status;
+    if (fstat(fd, &status) != 0) {
+        close(fd);
+        throw std::runtime_error("Cannot get the size of '" + path + "'");
+    }
+    _size = static_cast<size_t>(status.st_size);
+
+    // empty files cannot be mapped
+    if (_size > 0) {
+        void* data = mmap(0, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            _data = static_cast<const char*>(data);
+  #ifdef MADV_SEQUENTIAL
+            madvise(data, _size, MADV_SEQUENTIAL);
+  #endif
+        }
+    }
+    close(fd);
+
+    if (_size > 0 && !_data)
+        throw std::runtime_error("Cannot map test vector file '" + path + "'");
+}
+
+MappedFile::~MappedFile()
+{
+    if (_data)
+        munmap(const_cast<char*>(_data), _size);
+}
+
+#endif
+
+VectorFileReader::VectorFileReader(const MappedFile& file,
+        VectorFileFormat format, unsigned part, unsigned parts) :
+    _data(file.data()),
+    _size(file.size()),
+    _format(format),
+    _pos(0),
+    _end(0)
+{
+    setPartRange(part, parts);
+
+    if (_format == LINE_VECTORS) {
+        // skip the line that began in the previous part
+        if (_pos > 0 && _data[_pos - 1] != '\n') {
+            const void* newline = std::memchr(_data + _pos, '\n', _size - _pos);
+            _pos = newline ? static_cast<const char*>(newline) - _data + 1 : _size;
+        }
+    } else {
+        // records can only be found from the start, hop over the headers
+        const size_t start = _pos;
+        _pos = 0;
+        while (_pos < start && skipBinary())
+            ;
+    }
+}
+
+VectorFileReader::VectorFileReader(const MappedFile& file, unsigned part,
+        unsigned parts, size_t partOffset) :
+    _data(file.data()),
+    _size(file.size()),
+    _format(BINARY_VECTORS),
+    _pos(0),
+    _end(0)
+{
+    setPartRange(part, parts);
+    _pos = partOffset;
+}
+
+std::vector<size_t> VectorFileReader::binaryPartOffsets(const MappedFile& file,
+        unsigned parts)
+{
+    VectorFileReader reader(file, BINARY_VECTORS);
+    std::vector<size_t> offsets;
+
+    for (unsigned part = 0; part < parts; ++part) {
+        const size_t start = partBoundary(file.size(), part, parts);
+        try {
+            while (reader._pos < start && reader.skipBinary())
+                ;
+        } catch (const std::runtime_error&) {
+            // the reader stays at the malformed record
+        }
+        offsets.push_back(reader._pos);
+    }
+
+    return offsets;
+}
+
+void VectorFileReader::setPartRange(unsigned part, unsigned parts)
+{
+    if (parts == 0 || part >= parts)
+        throw std::invalid_argument("Invalid test vector file part");
+
+    _pos = partBoundary(_size, part, parts);
+    _end = partBoundary(_size, part + 1, parts);
+}
+
+bool VectorFileReader::next(TestVector& vector)
+{
+    return _format == LINE_VECTORS ? nextLine(vector) : nextBinary(vector);
+}
+
+bool VectorFileReader::nextLine(TestVector& vector)
+{
+    for (;;) {
+        if (_pos >= _end)
+            return false;
+
+        const char* begin = _data + _pos;
+        const void* newline = std::memchr(begin, '\n', _size - _pos);
+        const char* lineEnd = newline ? static_cast<const char*>(newline) : _data + _size;
+
+        vector._offset = _pos;
+        _pos = lineEnd - _data + (newline ? 1 : 0);
+
+        if (lineEnd > begin && lineEnd[-1] == '\r')
+            --lineEnd;
+        if (lineEnd == begin)
+            continue;
+
+        // the last field takes the rest of the line
+        size_t count = 0;
+        const char* field = begin;
+        for (;;) {
+            const void* tab = count + 1 < TestVector::MAX_FIELDS
+                ? std::memchr(field, '\t', lineEnd - field) : 0;
+            const char* fieldEnd = tab ? static_cast<const char*>(tab) : lineEnd;
+            vector._fields[count].data = field;
+            vector._fields[count].size = fieldEnd - field;
+            ++count;
+            if (!tab)
+                break;
+            field = fieldEnd + 1;
+        }
+        vector._fieldCount = count;
+        return true;
+    }
+}
+
+bool VectorFileReader::skipBinary()
+{
+    if (_pos >= _end)
+        return false;
+
+    size_t pos = _pos;
+    const unsigned long count = readLength(pos, _pos);
+    if (count > TestVector::MAX_FIELDS)
+        malformed(_pos);
+    pos += 4;
+
+    for (unsigned long i = 0; i < count; ++i) {
+        const unsigned long size = readLength(pos, _pos);
+        pos += 4;
+        if (size > _size - pos)
+            malformed(_pos);
+        pos += size;
+    }
+
+    _pos = pos;
+    return true;
+}
+
+bool VectorFileReader::nextBinary(TestVector& vector)
+{
+    if (_pos >= _end)
+        return false;
+
+    const size_t offset = _pos;
+    const unsigned long count = readLength(_pos, offset);
+    if (count > TestVector::MAX_FIELDS)
+        malformed(offset);
+    _pos += 4;
+
+    for (unsigned long i = 0; i < count; ++i) {
+        const unsigned long size = readLength(_pos, offset);
+        _pos += 4;
+        if (size > _size - _pos)
+            malformed(offset);
+        vector._fields[i].data = _data + _pos;
+        vector._fields[i].size = size;
+        _pos += size;
+    }
+
+    vector._offset = offset;
+    vector._fieldCount = count;
+    return true;
+}
+
+unsigned long VectorFileReader::readLength(size_t pos, size_t offset) const
+{
+    // a cut length is reported at the record it belongs to
+    if (_size - pos < 4)
+        malformed(offset);
+
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(_data + pos);
+    return static_cast<unsigned long>(bytes[0])
+        | static_cast<unsigned long>(bytes[1]) << 8
+        | static_cast<unsigned long>(bytes[2]) << 16
+        | static_cast<unsigned long>(bytes[3]) << 24;
+}
+
+void VectorFileReader::malformed(size_t offset) const
+{
+    std::ostringstream msg;
+    msg << "Malformed test vector at offset " << offset;
+    throw std::runtime_error(msg.str());
+}
+
+namespace
+{
+
+/** Adds the record that is being tested to failed assertions. */
+class RecordNote : public FailureNote
+{
+public:
+    RecordNote(const std::string& path, const TestVector& vector) :
+        _path(path),
+        _vector(vector)
+    { }
+
+    virtual std::string describe() const
+    {
+        std::ostringstream note;
+        note << "test vector at offset " << _vector.offset()
+             << " of '" << _path << "'";
+        return note.str();
+    }
+
+private:
+    const std::string& _path;
+    const TestVector& _vector;
+};
+
+/** Sets the failure note of the context for the lifetime of the scope. */
+class FailureNoteScope
+{
+    UTILCPP_DISABLE_COPY(FailureNoteScope)
+
+public:
+    FailureNoteScope(AssertionContext& context, const FailureNote* note) :
+        _context(context),
+        _previous(context.failureNote())
+    { _context.setFailureNote(note); }
+
+    ~FailureNoteScope()
+    { _context.setFailureNote(_previous); }
+
+private:
+    AssertionContext& _context;
+    const FailureNote* _previous;
+};
+
+}
+
+namespace detail
+{
+
+/** The part offsets of a binary file, found by the first part that runs. */
+class VectorFileIndex
+{
+    UTILCPP_DISABLE_COPY(VectorFileIndex)
+
+public:
+    VectorFileIndex() :
+#ifdef TESTCPP_HAVE_THREADS
+        _lock(),
+#endif
+        _fileSize(0),
+        _offsets()
+    { }
+
+    size_t partOffset(const MappedFile& file, unsigned part, unsigned parts)
+    {
+#ifdef TESTCPP_HAVE_THREADS
+        std::lock_guard<std::mutex> guard(_lock);
+#endif
+        if (_offsets.size() != parts || _fileSize != file.size()) {
+            // kept for the rest of the process, like the parts
+            UntrackedAllocations untracked;
+            _offsets = VectorFileReader::binaryPartOffsets(file, parts);
+            _fileSize = file.size();
+        }
+        return _offsets[part];
+    }
+
+private:
+#ifdef TESTCPP_HAVE_THREADS
+    std::mutex _lock;
+#endif
+    size_t _fileSize;
+    std::vector<size_t> _offsets;
+};
+
+}
+
+void DataSuite::test()
+{
+    if (!_part)
+        throw std::logic_error("Add data suites with Test::addDataSuite()");
+
+    MappedFile file(_part->path);
+
+    if (_part->format == BINARY_VECTORS && _part->index) {
+        VectorFileReader reader(file, _part->part, _part->parts,
+                _part->index->partOffset(file, _part->part, _part->parts));
+        testVectors(reader);
+    } else {
+        VectorFileReader reader(file, _part->format, _part->part, _part->parts);
+        testVectors(reader);
+    }
+}
+
+void DataSuite::testVectors(VectorFileReader& reader)
+{
+    TestVector vector;
+    RecordNote note(_part->path, vector);
+    AssertionContext& context = Controller::currentContext();
+    FailureNoteScope noteScope(context, &note);
+
+    static const AssertSite site = { "DataSuite", "testVector() does not throw",
+        "Test::DataSuite::test", __FILE__, __LINE__ };
+
+    while (reader.next(vector)) {
+        try {
+            testVector(vector);
+        } catch (const std::exception& e) {
+            context.beforeAssert(site);
+            context.onAssertNoExceptionEndWithException(&e);
+        } catch (...) {
+            context.beforeAssert(site);
+            context.onAssertNoExceptionEndWithException();
+        }
+    }
+}
+
+namespace detail
+{
+
+VectorFileIndex* addVectorFileIndex()
+{
+    // referenced by the parts, which are never freed either
+    return new VectorFileIndex();
+}
+
+const DataSuitePart* addDataSuitePart(const std::string& path,
+        VectorFileFormat format, unsigned part, unsigned parts,
+        VectorFileIndex* index)
+{
+    // a deque does not move its elements, so part pointers stay valid
+    static std::deque<DataSuitePart> dataSuiteParts;
+
+    DataSuitePart dataSuitePart;
+    dataSuitePart.path = path;
+    dataSuitePart.format = format;
+    dataSuitePart.part = part;
+    dataSuitePart.parts = parts;
+    dataSuitePart.index = index;
+    dataSuiteParts.push_back(dataSuitePart);
+    return &dataSuiteParts.back();
+}
+
+std::string dataSuitePartLabel(const std::string& label,
+        unsigned part, unsigned parts)
+{
+    if (parts == 1)
+        return label;
+
+    std::ostringstream partLabel;
+    partLabel << label << " [" << part + 1 << "/" << parts << "]";
+    return partLabel.str();
+}
+
+}
+
+} // namespace
@@ -0,0 +1,307 @@
+#include <testcpp/detail/EventLoop.h>
+
+#ifdef TESTCPP_HAVE_ASYNC_TESTS
+
+#include <testcpp/detail/Clock.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+namespace Test
+{
+
+namespace detail
+{
+
+namespace
+{
+
+TESTCPP_THREAD_LOCAL EventLoop* currentLoop = 0;
+
+const int MAX_EVENTS = 64;
+
+/** Futures cannot notify the loop, so it checks them this often. */
+const int FUTURE_POLL_MILLISECONDS = 1;
+
+std::runtime_error fdError(const char* what, int fd, int error)
+{
+    std::ostringstream msg;
+    msg << what << " " << fd << ": " << std::strerror(error);
+    return std::runtime_error(msg.str());
+}
+
+}
+
+AsyncWait::~AsyncWait()
+{
+    if (loop)
+        loop->cancel(*this);
+}
+
+EventLoop::EventLoop() :
+    _epoll(epoll_create1(EPOLL_CLOEXEC)),
+    _timers(),
+    _fds(),
+    _futures(),
+    _currentCase(0),
+    _previous(currentLoop)
+{
+    if (_epoll < 0)
+        throw std::runtime_error(std::string("Cannot create event loop: ")
+                + std::strerror(errno));
+    currentLoop = this;
+}
+
+EventLoop::~EventLoop()
+{
+    currentLoop = _previous;
+    close(_epoll);
+}
+
+EventLoop& EventLoop::current()
+{
+    if (!currentLoop || !currentLoop->_currentCase)
+        throw std::logic_error("Awaited the test event loop outside of an "
+                "async test case");
+    return *currentLoop;
+}
+
+void EventLoop::start(std::coroutine_handle<> handle,
+        AsyncCaseState& caseState)
+{ resume(handle, caseState); }
+
+void EventLoop::resume(std::coroutine_handle<> handle,
+        AsyncCaseState& caseState)
+{
+    Controller::CurrentContextScope contextScope(*caseState.context);
+    AsyncCaseState* const previous = _currentCase;
+    _currentCase = &caseState;
+
+    const double cpuStart = threadCpuSeconds();
+    handle.resume();
+    caseState.cpuSeconds += threadCpuSeconds() - cpuStart;
+
+    _currentCase = previous;
+}
+
+void EventLoop::suspend(AsyncWait& wait, std::coroutine_handle<> handle)
+{
+    wait.handle = handle;
+    wait.caseState = _currentCase;
+    wait.loop = this;
+    wait.hasTimer = false;
+    wait.fd = -1;
+    wait.timedOut = false;
+}
+
+void EventLoop::addTimer(double deadline, AsyncWait& wait)
+{
+    wait.timer = _timers.insert(std::make_pair(deadline, &wait));
+    wait.hasTimer = true;
+}
+
+void EventLoop::waitUntil(double deadline, AsyncWait& wait,
+        std::coroutine_handle<> handle)
+{
+    suspend(wait, handle);
+    addTimer(deadline, wait);
+}
+
+void EventLoop::waitForFd(int fd, FdEvent event, double deadline,
+        AsyncWait& wait, std::coroutine_handle<> handle)
+{
+    FdWaiters& waiters = _fds[fd];
+    AsyncWait*& waiter = event == READABLE ? waiters.reader : waiters.writer;
+    if (waiter)
+        throw fdError("Another coroutine waits for file descriptor", fd, EBUSY);
+
+    suspend(wait, handle);
+    waiter = &wait;
+    wait.fd = fd;
+
+    try {
+        updateFd(fd);
+    } catch (...) {
+        waiter = 0;
+        wait.loop = 0;
+        if (!waiters.reader && !waiters.writer)
+            _fds.erase(fd);
+        throw;
+    }
+
+    if (deadline > 0)
+        addTimer(deadline, wait);
+}
+
+void EventLoop::waitForFuture(FutureReadyFunction isReady, const void* future,
+        AsyncWait& wait, std::coroutine_handle<> handle)
+{
+    suspend(wait, handle);
+    FutureWait futureWait = { &wait, isReady, future };
+    _futures.push_back(futureWait);
+}
+
+void EventLoop::updateFd(int fd)
+{
+    std::map<int, FdWaiters>::iterator found = _fds.find(fd);
+    FdWaiters& waiters = found->second;
+
+    struct epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    if (waiters.reader)
+        event.events |= EPOLLIN;
+    if (waiters.writer)
+        event.events |= EPOLLOUT;
+    event.data.fd = fd;
+
+    if (!event.events) {
+        // the descriptor may have been closed already
+        if (waiters.registered)
+            epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, &event);
+        _fds.erase(found);
+        return;
+    }
+
+    if (epoll_ctl(_epoll, waiters.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+                fd, &event) == 0) {
+        waiters.registered = true;
+        return;
+    }
+
+    // regular files do not support epoll and never block
+    if (errno == EPERM && !waiters.registered)
+        return;
+
+    throw fdError("Cannot wait for file descriptor", fd, errno);
+}
+
+void EventLoop::removeFd(AsyncWait& wait)
+{
+    std::map<int, FdWaiters>::iterator found = _fds.find(wait.fd);
+    if (found == _fds.end())
+        return;
+
+    if (found->second.reader == &wait)
+        found->second.reader = 0;
+    if (found->second.writer == &wait)
+        found->second.writer = 0;
+
+    try {
+        updateFd(wait.fd);
+    } catch (const std::runtime_error&) {
+        // the other waiter is woken with the error below
+    }
+    wait.fd = -1;
+}
+
+void EventLoop::cancel(AsyncWait& wait)
+{
+    if (wait.hasTimer) {
+        _timers.erase(wait.timer);
+        wait.hasTimer = false;
+    }
+
+    if (wait.fd >= 0)
+        removeFd(wait);
+
+    for (size_t i = 0; i < _futures.size(); ++i)
+        if (_futures[i].wait == &wait) {
+            _futures[i] = _futures.back();
+            _futures.pop_back();
+            break;
+        }
+
+    wait.loop = 0;
+}
+
+void EventLoop::wake(AsyncWait& wait, std::vector<AsyncWait*>& ready)
+{
+    if (!wait.loop)
+        return;
+    cancel(wait);
+    ready.push_back(&wait);
+}
+
+bool EventLoop::runOnce()
+{
+    if (_timers.empty() && _fds.empty() && _futures.empty())
+        return false;
+
+    std::vector<AsyncWait*> ready;
+
+    // descriptors of regular files are ready without waiting, waking the
+    // last waiter erases the entry
+    for (std::map<int, FdWaiters>::iterator i = _fds.begin(); i != _fds.end(); ) {
+        std::map<int, FdWaiters>::iterator fd = i++;
+        if (!fd->second.registered) {
+            AsyncWait* const reader = fd->second.reader;
+            AsyncWait* const writer = fd->second.writer;
+            if (reader)
+                wake(*reader, ready);
+            if (writer)
+                wake(*writer, ready);
+        }
+    }
+
+    int timeout = -1;
+    if (!ready.empty()) {
+        timeout = 0;
+    } else if (!_timers.empty()) {
+        const double seconds = _timers.begin()->first - monotonicSeconds();
+        timeout = seconds > 0 ? static_cast<int>(std::ceil(seconds * 1000)) : 0;
+    }
+    if (!_futures.empty() && (timeout < 0 || timeout > FUTURE_POLL_MILLISECONDS))
+        timeout = FUTURE_POLL_MILLISECONDS;
+
+    struct epoll_event events[MAX_EVENTS];
+    const int count = epoll_wait(_epoll, events, MAX_EVENTS, timeout);
+    if (count < 0 && errno != EINTR)
+        throw std::runtime_error(std::string("Event loop wait failed: ")
+                + std::strerror(errno));
+
+    for (int i = 0; i < count; ++i) {
+        std::map<int, FdWaiters>::iterator found = _fds.find(events[i].data.fd);
+        if (found == _fds.end())
+            continue;
+
+        // errors and hangups wake both, reads and writes report them
+        const unsigned failed = EPOLLERR | EPOLLHUP;
+        AsyncWait* const writer = found->second.writer;
+        if (found->second.reader && (events[i].events & (EPOLLIN | failed)))
+            wake(*found->second.reader, ready);
+        if (writer && (events[i].events & (EPOLLOUT | failed)))
+            wake(*writer, ready);
+    }
+
+    const double now = monotonicSeconds();
+    while (!_timers.empty() && _timers.begin()->first <= now) {
+        AsyncWait& wait = *_timers.begin()->second;
+        wait.timedOut = wait.fd >= 0;
+        wake(wait, ready);
+    }
+
+    for (size_t i = 0; i < _futures.size(); ) {
+        AsyncWait& wait = *_futures[i].wait;
+        if (_futures[i].isReady(_futures[i].future))
+            wake(wait, ready);
+        else
+            ++i;
+    }
+
+    for (size_t i = 0; i < ready.size(); ++i)
+        resume(ready[i]->handle, *ready[i]->caseState);
+
+    return true;
+}
+
+}
+
+}
+
+#endif
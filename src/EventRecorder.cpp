@@ -0,0 +1,557 @@
+#include <testcpp/detail/EventRecorder.h>
+
+#include <stdexcept>
+#include <cstring>
+
+namespace Test
+{
+
+namespace
+{
+
+enum EventTag
+{
+    TEST_SUITE_BEGIN = 1,
+    TEST_SUITE_END,
+    TEST_SUITE_END_WITH_STD_EXCEPTION,
+    TEST_SUITE_END_WITH_ELLIPSIS_EXCEPTION,
+    ASSERT_BEGIN,
+    ASSERT_END,
+    ASSERT_EXCEPTION_END_WITH_EXPECTED_EXCEPTION,
+    ASSERT_EXCEPTION_END_WITH_UNEXPECTED_EXCEPTION,
+    ASSERT_EXCEPTION_END_WITH_ELLIPSIS_EXCEPTION,
+    ASSERT_NO_EXCEPTION_END_WITH_STD_EXCEPTION,
+    ASSERT_NO_EXCEPTION_END_WITH_ELLIPSIS_EXCEPTION,
+    ALL_TEST_SUITES_BEGIN,
+    ALL_TEST_SUITES_END,
+    ASSERT_FAILURE_DETAIL,
+    TEST_SUITE_STATS,
+    BENCHMARK_BEGIN,
+    BENCHMARK_END,
+    BENCHMARK_END_WITH_STD_EXCEPTION,
+    BENCHMARK_END_WITH_ELLIPSIS_EXCEPTION,
+    TEST_SUITE_ALLOCATIONS,
+    TIMING_REGRESSION
+};
+
+void putTag(std::string& out, EventTag tag)
+{ out.push_back(static_cast<char>(tag)); }
+
+void putUnsigned(std::string& out, unsigned long value)
+{
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void putLong(std::string& out, long value)
+{
+    // zigzag encoding keeps small negative values short
+    if (value < 0)
+        putUnsigned(out, (static_cast<unsigned long>(-(value + 1)) << 1) | 1);
+    else
+        putUnsigned(out, static_cast<unsigned long>(value) << 1);
+}
+
+void putInt(std::string& out, int value)
+{ putLong(out, value); }
+
+void putDouble(std::string& out, double value)
+{
+    // the recorder and the replayer always run on the same machine
+    char bytes[sizeof(double)];
+    std::memcpy(bytes, &value, sizeof(bytes));
+    out.append(bytes, sizeof(bytes));
+}
+
+void putString(std::string& out, const char* str, size_t size)
+{
+    putUnsigned(out, size);
+    out.append(str, size);
+    out.push_back('\0');
+}
+
+void putString(std::string& out, const std::string& str)
+{ putString(out, str.data(), str.size()); }
+
+void putCString(std::string& out, const char* str)
+{
+    if (!str)
+        str = "";
+    putString(out, str, std::strlen(str));
+}
+
+void putException(std::string& out, const std::exception& e)
+{
+    putString(out, exceptionTypeName(e));
+    putCString(out, e.what());
+}
+
+void putCounters(std::string& out, const PerformanceCounters& counters)
+{
+    putUnsigned(out, counters.counted);
+    if (!counters.counted)
+        return;
+    putDouble(out, counters.cycles);
+    putDouble(out, counters.instructions);
+    putDouble(out, counters.branchMisses);
+    putDouble(out, counters.l1dReadMisses);
+    putDouble(out, counters.llcMisses);
+    putDouble(out, counters.taskClockSeconds);
+    putDouble(out, counters.contextSwitches);
+    putDouble(out, counters.pageFaults);
+}
+
+struct TruncatedBuffer { };
+
+class Reader
+{
+public:
+    Reader(const char* data, size_t size) :
+        _pos(data),
+        _end(data + size)
+    { }
+
+    bool atEnd() const
+    { return _pos == _end; }
+
+    const char* pos() const
+    { return _pos; }
+
+    EventTag tag()
+    { return static_cast<EventTag>(static_cast<unsigned char>(byte())); }
+
+    unsigned long getUnsigned()
+    {
+        unsigned long value = 0;
+        for (unsigned shift = 0; ; shift += 7) {
+            if (shift >= sizeof(unsigned long) * 8)
+                malformed();
+            const unsigned char b = static_cast<unsigned char>(byte());
+            value |= static_cast<unsigned long>(b & 0x7F) << shift;
+            if (!(b & 0x80))
+                return value;
+        }
+    }
+
+    long getLong()
+    {
+        const unsigned long v = getUnsigned();
+        if (v & 1)
+            return -static_cast<long>(v >> 1) - 1;
+        return static_cast<long>(v >> 1);
+    }
+
+    int getInt()
+    { return static_cast<int>(getLong()); }
+
+    bool getBool()
+    { return getUnsigned() != 0; }
+
+    double getDouble()
+    {
+        if (static_cast<size_t>(_end - _pos) < sizeof(double))
+            throw TruncatedBuffer();
+        double value;
+        std::memcpy(&value, _pos, sizeof(value));
+        _pos += sizeof(value);
+        return value;
+    }
+
+    /** Returns a pointer to the zero-terminated string inside the buffer. */
+    const char* getCString()
+    {
+        const unsigned long size = getUnsigned();
+        if (static_cast<unsigned long>(_end - _pos) < size + 1)
+            throw TruncatedBuffer();
+        if (_pos[size] != '\0')
+            malformed();
+        const char* str = _pos;
+        _pos += size + 1;
+        return str;
+    }
+
+    PerformanceCounters getCounters()
+    {
+        PerformanceCounters counters;
+        counters.counted = static_cast<unsigned>(getUnsigned());
+        if (!counters.counted)
+            return counters;
+        counters.cycles = getDouble();
+        counters.instructions = getDouble();
+        counters.branchMisses = getDouble();
+        counters.l1dReadMisses = getDouble();
+        counters.llcMisses = getDouble();
+        counters.taskClockSeconds = getDouble();
+        counters.contextSwitches = getDouble();
+        counters.pageFaults = getDouble();
+        return counters;
+    }
+
+    RecordedException getException()
+    {
+        const char* typeName = getCString();
+        const char* what = getCString();
+        return RecordedException(typeName, what);
+    }
+
+private:
+    char byte()
+    {
+        if (_pos == _end)
+            throw TruncatedBuffer();
+        return *_pos++;
+    }
+
+    void malformed()
+    { throw std::runtime_error("Malformed test event buffer"); }
+
+    const char* _pos;
+    const char* _end;
+};
+
+void replayEvent(Reader& in, Observer& observer)
+{
+    switch (in.tag()) {
+        case TEST_SUITE_BEGIN: {
+            const char* label = in.getCString();
+            int num = in.getInt();
+            int total = in.getInt();
+            observer.onTestSuiteBegin(label, num, total);
+            break;
+        }
+        case TEST_SUITE_END:
+            observer.onTestSuiteEnd(in.getInt());
+            break;
+        case TEST_SUITE_END_WITH_STD_EXCEPTION: {
+            int numErrs = in.getInt();
+            observer.onTestSuiteEndWithStdException(numErrs, in.getException());
+            break;
+        }
+        case TEST_SUITE_END_WITH_ELLIPSIS_EXCEPTION:
+            observer.onTestSuiteEndWithEllipsisException(in.getInt());
+            break;
+        case ASSERT_BEGIN: {
+            // the strings stay valid in the buffer for the whole replay
+            AssertSite site;
+            site.assertType = in.getCString();
+            site.label = in.getCString();
+            site.function = in.getCString();
+            site.file = in.getCString();
+            site.line = in.getInt();
+            observer.onAssertBegin(site);
+            break;
+        }
+        case ASSERT_END:
+            observer.onAssertEnd(in.getBool());
+            break;
+        case ASSERT_EXCEPTION_END_WITH_EXPECTED_EXCEPTION:
+            observer.onAssertExceptionEndWithExpectedException(in.getException());
+            break;
+        case ASSERT_EXCEPTION_END_WITH_UNEXPECTED_EXCEPTION:
+            observer.onAssertExceptionEndWithUnexpectedException(in.getException());
+            break;
+        case ASSERT_EXCEPTION_END_WITH_ELLIPSIS_EXCEPTION:
+            observer.onAssertExceptionEndWithEllipsisException();
+            break;
+        case ASSERT_NO_EXCEPTION_END_WITH_STD_EXCEPTION:
+            observer.onAssertNoExceptionEndWithStdException(in.getException());
+            break;
+        case ASSERT_NO_EXCEPTION_END_WITH_ELLIPSIS_EXCEPTION:
+            observer.onAssertNoExceptionEndWithEllipsisException();
+            break;
+        case ALL_TEST_SUITES_BEGIN:
+            observer.onAllTestSuitesBegin(in.getInt());
+            break;
+        case ALL_TEST_SUITES_END: {
+            int lastTestSuiteNum = in.getInt();
+            int testSuitesNumTotal = in.getInt();
+            int numErrs = in.getInt();
+            int numExcepts = in.getInt();
+            observer.onAllTestSuitesEnd(lastTestSuiteNum,
+                    testSuitesNumTotal, numErrs, numExcepts);
+            break;
+        }
+        case ASSERT_FAILURE_DETAIL:
+            observer.onAssertFailureDetail(in.getCString());
+            break;
+        case TEST_SUITE_STATS: {
+            TestSuiteStats stats;
+            stats.wallSeconds = in.getDouble();
+            stats.cpuSeconds = in.getDouble();
+            stats.peakResidentSetKilobytes = static_cast<long>(in.getUnsigned());
+            stats.counters = in.getCounters();
+            observer.onTestSuiteStats(stats);
+            break;
+        }
+        case TEST_SUITE_ALLOCATIONS: {
+            AllocationStats stats;
+            stats.allocations = in.getUnsigned();
+            stats.deallocations = in.getUnsigned();
+            stats.allocatedBytes = in.getUnsigned();
+            stats.peakLiveBytes = in.getUnsigned();
+            stats.leakedAllocations = in.getLong();
+            stats.leakedBytes = in.getLong();
+            observer.onTestSuiteAllocations(stats);
+            break;
+        }
+        case BENCHMARK_BEGIN: {
+            const char* label = in.getCString();
+            int benchmarkNum = in.getInt();
+            int benchmarksNumTotal = in.getInt();
+            observer.onBenchmarkBegin(label, benchmarkNum, benchmarksNumTotal);
+            break;
+        }
+        case BENCHMARK_END: {
+            BenchmarkResult result;
+            result.label = in.getCString();
+            result.iterationsPerSample = in.getUnsigned();
+            result.rejectedSamples = in.getInt();
+            result.min = in.getDouble();
+            result.median = in.getDouble();
+            result.mean = in.getDouble();
+            result.p90 = in.getDouble();
+            result.p99 = in.getDouble();
+            result.max = in.getDouble();
+            const unsigned long sampleCount = in.getUnsigned();
+            for (unsigned long i = 0; i < sampleCount; ++i)
+                result.samples.push_back(in.getDouble());
+            result.counters = in.getCounters();
+            observer.onBenchmarkEnd(result);
+            break;
+        }
+        case BENCHMARK_END_WITH_STD_EXCEPTION:
+            observer.onBenchmarkEndWithStdException(in.getException());
+            break;
+        case BENCHMARK_END_WITH_ELLIPSIS_EXCEPTION:
+            observer.onBenchmarkEndWithEllipsisException();
+            break;
+        case TIMING_REGRESSION: {
+            TimingRegression regression;
+            regression.label = in.getCString();
+            regression.benchmark = in.getBool();
+            regression.baselineMedian = in.getDouble();
+            regression.median = in.getDouble();
+            regression.threshold = in.getDouble();
+            observer.onTimingRegression(regression);
+            break;
+        }
+        default:
+            throw std::runtime_error("Unknown test event in buffer");
+    }
+}
+
+}
+
+void EventRecorder::replay(const char* data, size_t size, Observer& observer)
+{
+    if (replayComplete(data, size, observer) != size)
+        throw std::runtime_error("Truncated test event buffer");
+}
+
+size_t EventRecorder::replayComplete(const char* data, size_t size,
+        Observer& observer)
+{
+    Reader in(data, size);
+    const char* eventStart = data;
+
+    // all arguments of an event are decoded before the observer is called,
+    // so a truncated event is never passed on
+    try {
+        while (!in.atEnd()) {
+            eventStart = in.pos();
+            replayEvent(in, observer);
+        }
+    } catch (const TruncatedBuffer&) {
+        return eventStart - data;
+    }
+
+    return size;
+}
+
+void EventRecorder::onTestSuiteBegin(const std::string& testSuiteLabel,
+        int testSuiteNum, int testSuitesNumTotal)
+{
+    putTag(_buffer, TEST_SUITE_BEGIN);
+    putString(_buffer, testSuiteLabel);
+    putInt(_buffer, testSuiteNum);
+    putInt(_buffer, testSuitesNumTotal);
+    eventRecorded();
+}
+
+void EventRecorder::onTestSuiteEnd(int numErrs)
+{
+    putTag(_buffer, TEST_SUITE_END);
+    putInt(_buffer, numErrs);
+    eventRecorded();
+}
+
+void EventRecorder::onTestSuiteEndWithStdException(int numErrs, const std::exception& e)
+{
+    putTag(_buffer, TEST_SUITE_END_WITH_STD_EXCEPTION);
+    putInt(_buffer, numErrs);
+    putException(_buffer, e);
+    eventRecorded();
+}
+
+void EventRecorder::onTestSuiteEndWithEllipsisException(int numErrs)
+{
+    putTag(_buffer, TEST_SUITE_END_WITH_ELLIPSIS_EXCEPTION);
+    putInt(_buffer, numErrs);
+    eventRecorded();
+}
+
+void EventRecorder::onTestSuiteStats(const TestSuiteStats& stats)
+{
+    putTag(_buffer, TEST_SUITE_STATS);
+    putDouble(_buffer, stats.wallSeconds);
+    putDouble(_buffer, stats.cpuSeconds);
+    putUnsigned(_buffer, static_cast<unsigned long>(stats.peakResidentSetKilobytes));
+    putCounters(_buffer, stats.counters);
+    eventRecorded();
+}
+
+void EventRecorder::onTestSuiteAllocations(const AllocationStats& stats)
+{
+    putTag(_buffer, TEST_SUITE_ALLOCATIONS);
+    putUnsigned(_buffer, stats.allocations);
+    putUnsigned(_buffer, stats.deallocations);
+    putUnsigned(_buffer, stats.allocatedBytes);
+    putUnsigned(_buffer, stats.peakLiveBytes);
+    putLong(_buffer, stats.leakedAllocations);
+    putLong(_buffer, stats.leakedBytes);
+    eventRecorded();
+}
+
+void EventRecorder::onAssertBegin(const AssertSite& site)
+{
+    putTag(_buffer, ASSERT_BEGIN);
+    putCString(_buffer, site.assertType);
+    putCString(_buffer, site.label);
+    putCString(_buffer, site.function);
+    putCString(_buffer, site.file);
+    putInt(_buffer, site.line);
+    eventRecorded();
+}
+
+void EventRecorder::onAssertEnd(bool ok)
+{
+    putTag(_buffer, ASSERT_END);
+    putUnsigned(_buffer, ok);
+    eventRecorded();
+}
+
+void EventRecorder::onAssertExceptionEndWithExpectedException(const std::exception& e)
+{
+    putTag(_buffer, ASSERT_EXCEPTION_END_WITH_EXPECTED_EXCEPTION);
+    putException(_buffer, e);
+    eventRecorded();
+}
+
+void EventRecorder::onAssertExceptionEndWithUnexpectedException(const std::exception& e)
+{
+    putTag(_buffer, ASSERT_EXCEPTION_END_WITH_UNEXPECTED_EXCEPTION);
+    putException(_buffer, e);
+    eventRecorded();
+}
+
+void EventRecorder::onAssertExceptionEndWithEllipsisException()
+{
+    putTag(_buffer, ASSERT_EXCEPTION_END_WITH_ELLIPSIS_EXCEPTION);
+    eventRecorded();
+}
+
+void EventRecorder::onAssertNoExceptionEndWithStdException(const std::exception& e)
+{
+    putTag(_buffer, ASSERT_NO_EXCEPTION_END_WITH_STD_EXCEPTION);
+    putException(_buffer, e);
+    eventRecorded();
+}
+
+void EventRecorder::onAssertNoExceptionEndWithEllipsisException()
+{
+    putTag(_buffer, ASSERT_NO_EXCEPTION_END_WITH_ELLIPSIS_EXCEPTION);
+    eventRecorded();
+}
+
+void EventRecorder::onAllTestSuitesBegin(int testSuitesNumTotal)
+{
+    putTag(_buffer, ALL_TEST_SUITES_BEGIN);
+    putInt(_buffer, testSuitesNumTotal);
+    eventRecorded();
+}
+
+void EventRecorder::onAllTestSuitesEnd(int lastTestSuiteNum,
+        int testSuitesNumTotal, int numErrs, int numExcepts)
+{
+    putTag(_buffer, ALL_TEST_SUITES_END);
+    putInt(_buffer, lastTestSuiteNum);
+    putInt(_buffer, testSuitesNumTotal);
+    putInt(_buffer, numErrs);
+    putInt(_buffer, numExcepts);
+    eventRecorded();
+}
+
+void EventRecorder::onAssertFailureDetail(const std::string& detail)
+{
+    putTag(_buffer, ASSERT_FAILURE_DETAIL);
+    putString(_buffer, detail);
+    eventRecorded();
+}
+
+void EventRecorder::onBenchmarkBegin(const std::string& benchmarkLabel,
+        int benchmarkNum, int benchmarksNumTotal)
+{
+    putTag(_buffer, BENCHMARK_BEGIN);
+    putString(_buffer, benchmarkLabel);
+    putInt(_buffer, benchmarkNum);
+    putInt(_buffer, benchmarksNumTotal);
+    eventRecorded();
+}
+
+void EventRecorder::onBenchmarkEnd(const BenchmarkResult& result)
+{
+    putTag(_buffer, BENCHMARK_END);
+    putString(_buffer, result.label);
+    putUnsigned(_buffer, result.iterationsPerSample);
+    putInt(_buffer, result.rejectedSamples);
+    putDouble(_buffer, result.min);
+    putDouble(_buffer, result.median);
+    putDouble(_buffer, result.mean);
+    putDouble(_buffer, result.p90);
+    putDouble(_buffer, result.p99);
+    putDouble(_buffer, result.max);
+    putUnsigned(_buffer, result.samples.size());
+    for (size_t i = 0; i < result.samples.size(); ++i)
+        putDouble(_buffer, result.samples[i]);
+    putCounters(_buffer, result.counters);
+    eventRecorded();
+}
+
+void EventRecorder::onBenchmarkEndWithStdException(const std::exception& e)
+{
+    putTag(_buffer, BENCHMARK_END_WITH_STD_EXCEPTION);
+    putException(_buffer, e);
+    eventRecorded();
+}
+
+void EventRecorder::onBenchmarkEndWithEllipsisException()
+{
+    putTag(_buffer, BENCHMARK_END_WITH_ELLIPSIS_EXCEPTION);
+    eventRecorded();
+}
+
+void EventRecorder::onTimingRegression(const TimingRegression& regression)
+{
+    putTag(_buffer, TIMING_REGRESSION);
+    putString(_buffer, regression.label);
+    putUnsigned(_buffer, regression.benchmark);
+    putDouble(_buffer, regression.baselineMedian);
+    putDouble(_buffer, regression.median);
+    putDouble(_buffer, regression.threshold);
+    eventRecorded();
+}
+
+} // namespace
@@ -0,0 +1,189 @@
+#include <testcpp/testcpp.h>
+
+#include <stdexcept>
+
+#if defined(UTILCPP_HAVE_CPP11)
+  #include <regex>
+#elif !defined(_WIN32)
+  #include <sys/types.h>
+  #include <regex.h>
+#endif
+
+namespace Test
+{
+
+namespace
+{
+
+/** Glob match supporting * and ?, backtracks only to the last star. */
+bool globMatch(const char* pattern, const char* str)
+{
+    const char* starPattern = 0;
+    const char* starStr = 0;
+
+    while (*str) {
+        if (*pattern == '*') {
+            starPattern = ++pattern;
+            starStr = str;
+        } else if (*pattern == '?' || *pattern == *str) {
+            ++pattern;
+            ++str;
+        } else if (starPattern) {
+            pattern = starPattern;
+            str = ++starStr;
+        } else {
+            return false;
+        }
+    }
+
+    while (*pattern == '*')
+        ++pattern;
+
+    return *pattern == '\0';
+}
+
+/** A compiled label pattern. */
+class LabelMatcher
+{
+    UTILCPP_DISABLE_COPY(LabelMatcher)
+
+public:
+    explicit LabelMatcher(const Controller::LabelPattern& pattern) :
+        _pattern(pattern)
+    {
+        if (!_pattern.regex)
+            return;
+
+#if defined(UTILCPP_HAVE_CPP11)
+        try {
+            _regex = std::regex(_pattern.pattern, std::regex::extended);
+        } catch (const std::regex_error&) {
+            invalidRegex();
+        }
+#elif !defined(_WIN32)
+        if (regcomp(&_regex, _pattern.pattern.c_str(), REG_EXTENDED | REG_NOSUB) != 0)
+            invalidRegex();
+#else
+        throw std::runtime_error("Regular expression filters require C++11");
+#endif
+    }
+
+    ~LabelMatcher()
+    {
+#if !defined(UTILCPP_HAVE_CPP11) && !defined(_WIN32)
+        if (_pattern.regex)
+            regfree(&_regex);
+#endif
+    }
+
+    /** Regular expressions match anywhere in the label, globs whole labels. */
+    bool matches(const char* label) const
+    {
+        if (!_pattern.regex)
+            return globMatch(_pattern.pattern.c_str(), label);
+
+#if defined(UTILCPP_HAVE_CPP11)
+        return std::regex_search(label, _regex);
+#elif !defined(_WIN32)
+        return regexec(&_regex, label, 0, 0, 0) == 0;
+#else
+        return false;
+#endif
+    }
+
+private:
+    void invalidRegex()
+    { throw std::runtime_error("Invalid regular expression '" + _pattern.pattern + "'"); }
+
+    const Controller::LabelPattern& _pattern;
+#if defined(UTILCPP_HAVE_CPP11)
+    std::regex _regex;
+#elif !defined(_WIN32)
+    regex_t _regex;
+#endif
+};
+
+class LabelMatchers
+{
+    UTILCPP_DISABLE_COPY(LabelMatchers)
+
+public:
+    explicit LabelMatchers(const std::vector<Controller::LabelPattern>& patterns) :
+        _matchers()
+    {
+        try {
+            for (size_t i = 0; i < patterns.size(); ++i)
+                _matchers.push_back(new LabelMatcher(patterns[i]));
+        } catch (...) {
+            clear();
+            throw;
+        }
+    }
+
+    ~LabelMatchers()
+    { clear(); }
+
+    bool empty() const
+    { return _matchers.empty(); }
+
+    bool anyMatches(const char* label) const
+    {
+        for (size_t i = 0; i < _matchers.size(); ++i)
+            if (_matchers[i]->matches(label))
+                return true;
+        return false;
+    }
+
+private:
+    void clear()
+    {
+        for (size_t i = 0; i < _matchers.size(); ++i)
+            delete _matchers[i];
+        _matchers.clear();
+    }
+
+    std::vector<LabelMatcher*> _matchers;
+};
+
+bool isSelected(const LabelMatchers& filters, const LabelMatchers& excludes,
+        const char* label)
+{
+    return (filters.empty() || filters.anyMatches(label))
+        && !excludes.anyMatches(label);
+}
+
+}
+
+std::vector<bool> Controller::matchTestSuites(const LabelPattern& pattern) const
+{
+    const LabelMatcher matcher(pattern);
+
+    std::vector<bool> matches(_testSuites.size());
+    for (size_t i = 0; i < _testSuites.size(); ++i)
+        matches[i] = matcher.matches(_testSuites[i].label);
+    return matches;
+}
+
+void Controller::selectFiltered()
+{
+    if (_filters.empty() && _excludes.empty())
+        return;
+
+    const LabelMatchers filters(_filters);
+    const LabelMatchers excludes(_excludes);
+
+    std::vector<size_t> plan;
+    for (size_t i = 0; i < _plan.size(); ++i)
+        if (isSelected(filters, excludes, _testSuites[_plan[i]].label))
+            plan.push_back(_plan[i]);
+    _plan.swap(plan);
+
+    std::vector<size_t> benchmarkPlan;
+    for (size_t i = 0; i < _benchmarkPlan.size(); ++i)
+        if (isSelected(filters, excludes,
+                    _benchmarks[_benchmarkPlan[i]].label.c_str()))
+            benchmarkPlan.push_back(_benchmarkPlan[i]);
+    _benchmarkPlan.swap(benchmarkPlan);
+}
+
+} // namespace
@@ -0,0 +1,180 @@
+#include <testcpp/testcpp.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace Test
+{
+
+namespace
+{
+
+const char* const PASSED = "passed";
+const char* const FAILED = "failed";
+
+typedef Controller::History History;
+
+/** Reads "label<TAB>seconds<TAB>passed|failed" lines. */
+void loadHistory(const std::string& path, History& history)
+{
+    std::ifstream in(path.c_str());
+
+    std::string line;
+    while (std::getline(in, line)) {
+        const size_t secondsTab = line.find('\t');
+        const size_t resultTab = line.find('\t', secondsTab + 1);
+        if (secondsTab == std::string::npos || resultTab == std::string::npos)
+            continue;
+
+        const char* seconds = line.c_str() + secondsTab + 1;
+        char* end = 0;
+        const double value = std::strtod(seconds, &end);
+        if (end == seconds || value < 0)
+            continue;
+
+        Controller::TestSuiteHistory& entry = history[line.substr(0, secondsTab)];
+        entry.seconds = value;
+        entry.failed = line.compare(resultTab + 1, std::string::npos, FAILED) == 0;
+    }
+}
+
+/** Orders plan positions by the history of the suites at them. */
+class HistoryOrder
+{
+public:
+    HistoryOrder(Controller::TestSuiteOrder order,
+            const std::vector<const Controller::TestSuiteHistory*>& history,
+            double averageSeconds) :
+        _order(order),
+        _history(history),
+        _averageSeconds(averageSeconds)
+    { }
+
+    bool operator()(size_t a, size_t b) const
+    {
+        if (_order == Controller::FAILED_FIRST)
+            return failedRank(a) < failedRank(b);
+
+        if (_order == Controller::FASTEST_FIRST)
+            return seconds(a) < seconds(b);
+
+        return seconds(a) > seconds(b);
+    }
+
+private:
+    // failed, then new, then passed suites
+    int failedRank(size_t pos) const
+    {
+        if (!_history[pos])
+            return 1;
+        return _history[pos]->failed ? 0 : 2;
+    }
+
+    double seconds(size_t pos) const
+    { return _history[pos] ? _history[pos]->seconds : _averageSeconds; }
+
+    Controller::TestSuiteOrder _order;
+    const std::vector<const Controller::TestSuiteHistory*>& _history;
+    double _averageSeconds;
+};
+
+}
+
+void Controller::orderByHistory()
+{
+    _history.clear();
+    if (_historyPath.empty())
+        return;
+
+    loadHistory(_historyPath, _history);
+
+    if (_testSuiteOrder == REGISTRATION_ORDER || _history.empty())
+        return;
+
+    std::vector<const TestSuiteHistory*> history(_plan.size());
+    double totalSeconds = 0;
+    size_t known = 0;
+    for (size_t i = 0; i < _plan.size(); ++i) {
+        History::const_iterator found = _history.find(_testSuites[_plan[i]].label);
+        if (found == _history.end())
+            continue;
+        history[i] = &found->second;
+        totalSeconds += found->second.seconds;
+        ++known;
+    }
+
+    std::vector<size_t> positions(_plan.size());
+    for (size_t i = 0; i < positions.size(); ++i)
+        positions[i] = i;
+
+    // stable, so that suites with equal history keep registration order
+    std::stable_sort(positions.begin(), positions.end(),
+            HistoryOrder(_testSuiteOrder, history,
+                known ? totalSeconds / known : 0));
+
+    std::vector<size_t> plan(_plan.size());
+    for (size_t i = 0; i < positions.size(); ++i)
+        plan[i] = _plan[positions[i]];
+    _plan.swap(plan);
+}
+
+void Controller::recordTestSuiteResult(const char* label, bool failed,
+        double seconds)
+{
+    if (failed)
+        ++_failedTestSuites;
+
+    if (!_baselinePath.empty() && !failed)
+        _suiteTimings[label].push_back(seconds);
+
+    if (_historyPath.empty())
+        return;
+
+    TestSuiteHistory& result = _results[label];
+    result.seconds = seconds;
+    result.failed = failed;
+}
+
+void Controller::saveHistory()
+{
+    if (_historyPath.empty() || _results.empty())
+        return;
+
+    // reload to keep what other runs have written since the run started
+    History history;
+    loadHistory(_historyPath, history);
+    for (History::const_iterator i = _results.begin(); i != _results.end(); ++i)
+        history[i->first] = i->second;
+    _results.clear();
+
+    // replace the file at once, readers never see a partial history;
+    // losing the history does not fail the run
+    const std::string tmpPath = _historyPath + ".tmp";
+    {
+        std::ofstream out(tmpPath.c_str(), std::ios::out | std::ios::trunc);
+        out << std::fixed << std::setprecision(6);
+
+        for (History::const_iterator i = history.begin(); i != history.end(); ++i)
+            out << i->first << "\t" << i->second.seconds << "\t"
+                << (i->second.failed ? FAILED : PASSED) << "\n";
+
+        if (!out.flush()) {
+            std::cerr << "Cannot write history to '" << tmpPath << "'" << std::endl;
+            return;
+        }
+    }
+
+#ifdef _WIN32
+    std::remove(_historyPath.c_str());
+#endif
+    if (std::rename(tmpPath.c_str(), _historyPath.c_str()) != 0) {
+        std::cerr << "Cannot replace history file '" << _historyPath << "'" << std::endl;
+        std::remove(tmpPath.c_str());
+    }
+}
+
+} // namespace
@@ -0,0 +1,721 @@
+#include <testcpp/testcpp.h>
+
+#ifndef _WIN32
+
+#include <testcpp/detail/Clock.h>
+#include <testcpp/detail/EventRecorder.h>
+#include <testcpp/detail/ForwardingObserver.h>
+#include <testcpp/detail/Watchdog.h>
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace Test
+{
+
+namespace
+{
+
+const size_t PIPE_CHUNK_SIZE = 64 * 1024;
+
+/** The runner sends the worker the suites to run one at a time. */
+struct WorkerTask
+{
+    size_t testSuite;
+    int testSuiteNum;
+};
+
+/**
+ * Workers send the events of a suite in chunks, each preceded by a
+ * header, and a header without events when the suite has ended.
+ */
+struct MessageHeader
+{
+    enum Kind { EVENTS, SUITE_END };
+
+    unsigned kind;
+    unsigned size;
+};
+
+// time for a timed out worker to write its stack and events before it is
+// killed
+const double TIMEOUT_GRACE_SECONDS = 2;
+
+// async-signal-safe, used from crash handlers
+bool writeAll(int fd, const char* data, size_t size)
+{
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+bool readAll(int fd, void* data, size_t size)
+{
+    char* bytes = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t received = read(fd, bytes, size);
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+            return false;
+        bytes += received;
+        size -= received;
+    }
+    return true;
+}
+
+// async-signal-safe
+bool writeMessage(int fd, MessageHeader::Kind kind, const char* data,
+        size_t size)
+{
+    MessageHeader header;
+    header.kind = kind;
+    header.size = static_cast<unsigned>(size);
+    return writeAll(fd, reinterpret_cast<const char*>(&header), sizeof(header))
+        && writeAll(fd, data, size);
+}
+
+/**
+ * Records the events of a test suite running in a worker process and sends
+ * them to the runner through the socket of the worker in chunks.
+ */
+class PipeRecorder : public EventRecorder
+{
+public:
+    explicit PipeRecorder(int fd) :
+        EventRecorder(),
+        _fd(fd),
+        _sending(0)
+    { }
+
+    void send()
+    {
+        if (buffer().empty())
+            return;
+        _sending = 1;
+        writeMessage(_fd, MessageHeader::EVENTS, buffer().data(),
+                buffer().size());
+        clear();
+        _sending = 0;
+    }
+
+    /**
+     * Sends the buffer without modifying it, for crash handlers. Skipped
+     * if the handler interrupted send(), a partial message would garble
+     * the events that the runner has received.
+     */
+    void sendFromSignalHandler() const
+    {
+        if (!_sending && !buffer().empty())
+            writeMessage(_fd, MessageHeader::EVENTS, buffer().data(),
+                    buffer().size());
+    }
+
+protected:
+    virtual void eventRecorded()
+    {
+        if (buffer().size() >= PIPE_CHUNK_SIZE)
+            send();
+    }
+
+private:
+    int _fd;
+    volatile sig_atomic_t _sending;
+};
+
+// the recorder of the suite running in this worker process
+PipeRecorder* childRecorder = 0;
+
+extern "C" void sendRecordedEventsOnCrash(int signum)
+{
+    detail::writeStackTrace(STDERR_FILENO);
+
+    if (childRecorder) {
+        childRecorder->sendFromSignalHandler();
+        childRecorder = 0;
+    }
+    // the handler was reset to default by SA_RESETHAND
+    raise(signum);
+}
+
+void sendRecordedEventsAndExit(int status)
+{
+    if (childRecorder) {
+        childRecorder->send();
+        childRecorder = 0;
+    }
+
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(0);
+
+    // skip destructors that belong to the parent, like runWorkerProcess()
+    _exit(status);
+}
+
+#ifdef __GLIBC__
+extern "C" void sendRecordedEventsOnExit(int status, void*)
+{ sendRecordedEventsAndExit(status); }
+#else
+// the status of exit() is not known, the suite has failed anyway
+extern "C" void sendRecordedEventsOnExit()
+{ sendRecordedEventsAndExit(EXIT_FAILURE); }
+#endif
+
+void installCrashHandlers()
+{
+    // handle stack overflows on an alternate stack
+    static char alternateStack[64 * 1024];
+    stack_t stack;
+    stack.ss_sp = alternateStack;
+    stack.ss_size = sizeof(alternateStack);
+    stack.ss_flags = 0;
+    sigaltstack(&stack, 0);
+
+    detail::prepareStackTrace();
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = sendRecordedEventsOnCrash;
+    action.sa_flags = SA_RESETHAND | SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+
+    // the parent sends SIGQUIT when the suite times out
+    const int crashSignals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT,
+                                 SIGTRAP, SIGSYS, SIGQUIT };
+    for (size_t i = 0; i < sizeof(crashSignals) / sizeof(crashSignals[0]); ++i)
+        sigaction(crashSignals[i], &action, 0);
+
+#ifdef __GLIBC__
+    on_exit(sendRecordedEventsOnExit, 0);
+#else
+    std::atexit(sendRecordedEventsOnExit);
+#endif
+}
+
+const char* signalName(int signum)
+{
+    switch (signum) {
+        case SIGABRT: return "SIGABRT";
+        case SIGALRM: return "SIGALRM";
+        case SIGBUS:  return "SIGBUS";
+        case SIGFPE:  return "SIGFPE";
+        case SIGHUP:  return "SIGHUP";
+        case SIGILL:  return "SIGILL";
+        case SIGINT:  return "SIGINT";
+        case SIGKILL: return "SIGKILL";
+        case SIGPIPE: return "SIGPIPE";
+        case SIGQUIT: return "SIGQUIT";
+        case SIGSEGV: return "SIGSEGV";
+        case SIGSYS:  return "SIGSYS";
+        case SIGTERM: return "SIGTERM";
+        case SIGTRAP: return "SIGTRAP";
+        case SIGUSR1: return "SIGUSR1";
+        case SIGUSR2: return "SIGUSR2";
+        default:      return "signal";
+    }
+}
+
+/** Describes why the process of a suite ended before the suite did. */
+RecordedException processTermination(int status)
+{
+    std::ostringstream msg;
+
+    if (status < 0)
+        return RecordedException("events",
+                "Test suite process sent incomplete events");
+
+    if (WIFSIGNALED(status)) {
+        const int signum = WTERMSIG(status);
+        msg << "Test suite process was killed by signal "
+            << signalName(signum) << " (" << strsignal(signum) << ")";
+        return RecordedException(signalName(signum), msg.str());
+    }
+
+    msg << "Test suite process exited with status "
+        << WEXITSTATUS(status) << " before the test suite ended";
+    return RecordedException("exit", msg.str());
+}
+
+/**
+ * Passes the events of a worker process on and keeps track of the suite
+ * result, including the errors so far in case the suite does not end.
+ */
+class SuiteResultTracker : public ForwardingObserver
+{
+public:
+    explicit SuiteResultTracker(Observer& observer) :
+        ForwardingObserver(observer),
+        began(false),
+        ended(false),
+        endedWithException(false),
+        numErrs(0),
+        lastAssertFile(0),
+        lastAssertLine(0)
+    { }
+
+    virtual void onTestSuiteBegin(const std::string& testSuiteLabel,
+            int testSuiteNum, int testSuitesNumTotal)
+    {
+        began = true;
+        ForwardingObserver::onTestSuiteBegin(testSuiteLabel,
+                testSuiteNum, testSuitesNumTotal);
+    }
+
+    virtual void onTestSuiteEnd(int errs)
+    {
+        end(errs, false);
+        ForwardingObserver::onTestSuiteEnd(errs);
+    }
+
+    virtual void onTestSuiteEndWithStdException(int errs, const std::exception& e)
+    {
+        end(errs, true);
+        ForwardingObserver::onTestSuiteEndWithStdException(errs, e);
+    }
+
+    virtual void onTestSuiteEndWithEllipsisException(int errs)
+    {
+        end(errs, true);
+        ForwardingObserver::onTestSuiteEndWithEllipsisException(errs);
+    }
+
+    virtual void onAssertBegin(const AssertSite& site)
+    {
+        // the site strings stay valid in the events of the child
+        lastAssertFile = site.file;
+        lastAssertLine = site.line;
+        ForwardingObserver::onAssertBegin(site);
+    }
+
+    virtual void onAssertEnd(bool ok)
+    {
+        if (!ok)
+            ++numErrs;
+        ForwardingObserver::onAssertEnd(ok);
+    }
+
+    virtual void onAssertExceptionEndWithUnexpectedException(const std::exception& e)
+    {
+        ++numErrs;
+        ForwardingObserver::onAssertExceptionEndWithUnexpectedException(e);
+    }
+
+    virtual void onAssertExceptionEndWithEllipsisException()
+    {
+        ++numErrs;
+        ForwardingObserver::onAssertExceptionEndWithEllipsisException();
+    }
+
+    virtual void onAssertNoExceptionEndWithStdException(const std::exception& e)
+    {
+        ++numErrs;
+        ForwardingObserver::onAssertNoExceptionEndWithStdException(e);
+    }
+
+    virtual void onAssertNoExceptionEndWithEllipsisException()
+    {
+        ++numErrs;
+        ForwardingObserver::onAssertNoExceptionEndWithEllipsisException();
+    }
+
+    bool began;
+    bool ended;
+    bool endedWithException;
+    int numErrs;
+    const char* lastAssertFile;
+    int lastAssertLine;
+
+private:
+    void end(int errs, bool withException)
+    {
+        ended = true;
+        endedWithException = withException;
+        numErrs = errs;
+    }
+};
+
+/** Milliseconds until the deadline for poll(), -1 for no deadline. */
+int pollTimeout(double deadline, double now)
+{
+    if (deadline <= 0)
+        return -1;
+    if (deadline <= now)
+        return 0;
+    // round up so that the deadline has passed when poll returns
+    return static_cast<int>((deadline - now) * 1000) + 1;
+}
+
+unsigned hardwareThreads()
+{
+    const long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? static_cast<unsigned>(n) : 1;
+}
+
+}
+
+namespace detail
+{
+
+/** A worker process and the suite that it runs, if any. */
+struct WorkerProcess
+{
+    WorkerProcess() :
+        pid(-1),
+        fd(-1),
+        received(),
+        busy(false),
+        closed(false),
+        testSuite(0),
+        testSuiteNum(0),
+        events(),
+        start(0),
+        timeoutReason(),
+        killTime(0)
+    { }
+
+    pid_t pid;
+    int fd;
+
+    /** Bytes of a message that has not been received completely. */
+    std::string received;
+
+    bool busy;
+
+    /** No more suites are sent, the worker exits. */
+    bool closed;
+
+    size_t testSuite;
+    int testSuiteNum;
+    std::string events;
+    double start;
+
+    /** Empty unless the suite has timed out. */
+    std::string timeoutReason;
+    double killTime;
+};
+
+}
+
+namespace
+{
+
+void timeOut(detail::WorkerProcess& worker, const std::string& reason,
+        double now)
+{
+    if (!worker.timeoutReason.empty())
+        return;
+    worker.timeoutReason = reason;
+    worker.killTime = now + TIMEOUT_GRACE_SECONDS;
+    kill(worker.pid, SIGQUIT);
+}
+
+void closeWorker(detail::WorkerProcess& worker)
+{
+    // the worker reads the end of the tasks and exits
+    shutdown(worker.fd, SHUT_WR);
+    worker.closed = true;
+}
+
+}
+
+void Controller::runInProcesses(unsigned processes)
+{
+    const size_t testSuiteCount = _plan.size();
+
+    if (processes == 0)
+        processes = hardwareThreads();
+
+    std::vector<detail::WorkerProcess> workers;
+    std::vector<char> readBuffer(PIPE_CHUNK_SIZE);
+    size_t nextTestSuite = 0;
+
+    for (;;) {
+        // idle workers take the next suites, new workers are started for
+        // the rest up to the limit
+        for (size_t i = 0; i <= workers.size(); ++i) {
+            const bool moreTestSuites = nextTestSuite < testSuiteCount
+                && !maxFailuresReached();
+
+            if (i == workers.size()) {
+                if (!moreTestSuites || workers.size() >= processes)
+                    break;
+                workers.push_back(startWorkerProcess(workers));
+            }
+
+            detail::WorkerProcess& worker = workers[i];
+            if (worker.busy || worker.closed)
+                continue;
+
+            if (moreTestSuites)
+                sendTestSuite(worker, _plan[nextTestSuite++], ++_curTestSuite);
+            else
+                closeWorker(worker);
+        }
+
+        if (workers.empty())
+            break;
+
+        std::vector<pollfd> pollfds(workers.size());
+        for (size_t i = 0; i < workers.size(); ++i) {
+            pollfds[i].fd = workers[i].fd;
+            pollfds[i].events = POLLIN;
+            pollfds[i].revents = 0;
+        }
+
+        double deadline = _runDeadline;
+        for (size_t i = 0; i < workers.size(); ++i) {
+            if (!workers[i].busy)
+                continue;
+            const double workerDeadline = workers[i].timeoutReason.empty()
+                ? (_testSuiteTimeout > 0 ? workers[i].start + _testSuiteTimeout : 0)
+                : workers[i].killTime;
+            if (workerDeadline > 0 && (deadline <= 0 || workerDeadline < deadline))
+                deadline = workerDeadline;
+        }
+
+        const int ready = poll(&pollfds[0], pollfds.size(),
+                pollTimeout(deadline, detail::monotonicSeconds()));
+        if (ready < 0) {
+            if (errno == EINTR)
+                continue;
+            throw std::runtime_error("Cannot poll test suite processes");
+        }
+
+        const double now = detail::monotonicSeconds();
+
+        if (_runDeadline > 0 && now >= _runDeadline) {
+            // skip the suites that have not started
+            nextTestSuite = testSuiteCount;
+            for (size_t i = 0; i < workers.size(); ++i)
+                if (workers[i].busy)
+                    timeOut(workers[i],
+                            detail::timeoutReason("Test run", _runTimeout), now);
+        }
+
+        for (size_t i = 0; i < workers.size(); ++i) {
+            detail::WorkerProcess& worker = workers[i];
+            if (!worker.busy)
+                continue;
+            if (_testSuiteTimeout > 0 && now >= worker.start + _testSuiteTimeout)
+                timeOut(worker, detail::timeoutReason("Test suite", _testSuiteTimeout), now);
+            // the events end when the process is gone
+            if (!worker.timeoutReason.empty() && now >= worker.killTime) {
+                kill(worker.pid, SIGKILL);
+                worker.killTime = now + TIMEOUT_GRACE_SECONDS;
+            }
+        }
+
+        for (size_t i = workers.size(); i-- > 0; ) {
+            if (!pollfds[i].revents)
+                continue;
+
+            detail::WorkerProcess& worker = workers[i];
+
+            ssize_t received = read(worker.fd, &readBuffer[0], readBuffer.size());
+            if (received > 0) {
+                worker.received.append(&readBuffer[0], received);
+                receiveMessages(worker);
+                continue;
+            }
+            if (received < 0 && errno == EINTR)
+                continue;
+
+            // end of messages, the worker has exited or is about to
+            close(worker.fd);
+            int status = 0;
+            while (waitpid(worker.pid, &status, 0) < 0 && errno == EINTR)
+                ;
+
+            if (worker.busy)
+                endWorkerTestSuite(worker, status);
+
+            workers.erase(workers.begin() + i);
+        }
+    }
+}
+
+detail::WorkerProcess Controller::startWorkerProcess(
+        const std::vector<detail::WorkerProcess>& workers)
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        throw std::runtime_error("Cannot create socket for test suite process");
+#ifdef SO_NOSIGPIPE
+    const int noSigPipe = 1;
+    setsockopt(fds[0], SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+
+    // unflushed output would be written twice otherwise
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(0);
+
+    detail::WorkerProcess worker;
+    worker.pid = fork();
+    if (worker.pid < 0)
+        throw std::runtime_error("Cannot fork test suite process");
+
+    if (worker.pid == 0) {
+        close(fds[0]);
+        for (size_t i = 0; i < workers.size(); ++i)
+            close(workers[i].fd);
+        runWorkerProcess(fds[1]);
+    }
+
+    close(fds[1]);
+    worker.fd = fds[0];
+    return worker;
+}
+
+void Controller::sendTestSuite(detail::WorkerProcess& worker, size_t testSuite,
+        int testSuiteNum)
+{
+    worker.busy = true;
+    worker.testSuite = testSuite;
+    worker.testSuiteNum = testSuiteNum;
+    worker.events.clear();
+    worker.start = detail::monotonicSeconds();
+    worker.timeoutReason.clear();
+    worker.killTime = 0;
+
+    WorkerTask task;
+    task.testSuite = testSuite;
+    task.testSuiteNum = testSuiteNum;
+
+    int flags = 0;
+#ifdef MSG_NOSIGNAL
+    flags = MSG_NOSIGNAL;
+#endif
+    // a worker that is gone is reported when its socket is closed
+    while (::send(worker.fd, &task, sizeof(task), flags) < 0 && errno == EINTR)
+        ;
+}
+
+void Controller::receiveMessages(detail::WorkerProcess& worker)
+{
+    size_t used = 0;
+    MessageHeader header;
+
+    while (worker.received.size() - used >= sizeof(header)) {
+        std::memcpy(&header, worker.received.data() + used, sizeof(header));
+        if (worker.received.size() - used - sizeof(header) < header.size)
+            break;
+
+        used += sizeof(header);
+        worker.events.append(worker.received, used, header.size);
+        used += header.size;
+
+        if (header.kind == MessageHeader::SUITE_END && worker.busy) {
+            endWorkerTestSuite(worker, -1);
+            worker.busy = false;
+            // it may be hit by the signal of the timeout any moment
+            if (!worker.timeoutReason.empty())
+                closeWorker(worker);
+        }
+    }
+
+    worker.received.erase(0, used);
+}
+
+void Controller::endWorkerTestSuite(detail::WorkerProcess& worker, int status)
+{
+    SuiteResultTracker tracker(*_observer);
+    try {
+        EventRecorder::replayComplete(worker.events.data(),
+                worker.events.size(), tracker);
+    } catch (const std::exception&) {
+        // report what was received, the suite has failed anyway
+    }
+
+    if (!tracker.began)
+        _observer->onTestSuiteBegin(_testSuites[worker.testSuite].label,
+                worker.testSuiteNum, _plan.size());
+
+    if (!tracker.ended) {
+        _observer->onTestSuiteEndWithStdException(tracker.numErrs,
+                worker.timeoutReason.empty()
+                    ? processTermination(status)
+                    : detail::timeoutException(worker.timeoutReason,
+                        tracker.lastAssertFile, tracker.lastAssertLine));
+        tracker.endedWithException = true;
+    }
+
+    _allTestErrs += tracker.numErrs;
+    if (tracker.endedWithException)
+        ++_allTestExcepts;
+
+    recordTestSuiteResult(_testSuites[worker.testSuite].label,
+            tracker.endedWithException || tracker.numErrs > 0,
+            detail::monotonicSeconds() - worker.start);
+
+    worker.events.clear();
+}
+
+void Controller::runWorkerProcess(int fd)
+{
+    installCrashHandlers();
+
+    WorkerTask task;
+    while (readAll(fd, &task, sizeof(task))) {
+        PipeRecorder recorder(fd);
+        childRecorder = &recorder;
+
+        AssertionContext context(&recorder, _observer->subscribedEvents());
+        runTestSuite(_testSuites[task.testSuite], task.testSuiteNum,
+                _plan.size(), context);
+
+        recorder.send();
+        childRecorder = 0;
+
+        std::cout.flush();
+        std::cerr.flush();
+        std::fflush(0);
+
+        writeMessage(fd, MessageHeader::SUITE_END, 0, 0);
+    }
+
+    // skip destructors and atexit handlers that belong to the parent,
+    // shared fixtures that the worker built included
+    _exit(0);
+}
+
+} // namespace
+
+#else
+
+namespace Test
+{
+
+void Controller::runInProcesses(unsigned processes)
+{
+    runInParallel(processes);
+}
+
+} // namespace
+
+#endif
@@ -0,0 +1,295 @@
+#include <testcpp/JUnitXmlObserver.h>
+#include <testcpp/detail/Clock.h>
+
+#include <stdexcept>
+#include <sstream>
+#include <iomanip>
+
+namespace Test
+{
+
+namespace
+{
+
+const int COUNT_WIDTH = 10;
+const int TIME_WIDTH = 14;
+
+std::string escape(const std::string& str)
+{
+    std::string out;
+    out.reserve(str.size());
+
+    for (size_t i = 0; i < str.size(); ++i) {
+        const char c = str[i];
+        switch (c) {
+            case '&':  out += "&amp;"; break;
+            case '<':  out += "&lt;"; break;
+            case '>':  out += "&gt;"; break;
+            case '"':  out += "&quot;"; break;
+            case '\'': out += "&apos;"; break;
+            case '\t':
+            case '\n':
+            case '\r':
+                out += c;
+                break;
+            default:
+                // other control characters are not allowed in XML 1.0
+                out += static_cast<unsigned char>(c) < 0x20 ? '?' : c;
+        }
+    }
+
+    return out;
+}
+
+std::string formatCount(int count)
+{
+    std::ostringstream out;
+    out << std::setfill('0') << std::setw(COUNT_WIDTH) << count;
+    return out.str();
+}
+
+std::string formatTime(double seconds)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(6) << std::setfill('0')
+        << std::setw(TIME_WIDTH) << seconds;
+    return out.str();
+}
+
+std::string failureMessage(const AssertSite& site, const std::string& what)
+{
+    std::ostringstream out;
+    out << (site.assertType ? site.assertType : "assertion") << " failed";
+    if (!what.empty())
+        out << ": " << what;
+    out << " (" << (site.file ? site.file : "") << ":" << site.line;
+    if (site.function)
+        out << ", in " << site.function;
+    out << ")";
+    return out.str();
+}
+
+const AssertSite emptySite = { 0, 0, 0, 0, 0 };
+
+}
+
+JUnitXmlObserver::JUnitXmlObserver(const std::string& path) :
+    Observer(),
+    _out(path.c_str(), std::ios::out | std::ios::trunc | std::ios::binary),
+    _suiteLabel(),
+    _suitePlaceholders(),
+    _suiteCounts(),
+    _allPlaceholders(),
+    _allCounts(),
+    _allStart(0),
+    _site(emptySite),
+    _inSuite(false),
+    _failureOpen(false)
+{
+    if (!_out)
+        throw std::runtime_error("Cannot open JUnit XML file '" + path + "'");
+}
+
+JUnitXmlObserver::~JUnitXmlObserver()
+{ _out.flush(); }
+
+JUnitXmlObserver::CountPlaceholders JUnitXmlObserver::writePlaceholders()
+{
+    CountPlaceholders placeholders;
+
+    _out << " tests=\"";
+    placeholders.tests = _out.tellp();
+    _out << formatCount(0) << "\" failures=\"";
+    placeholders.failures = _out.tellp();
+    _out << formatCount(0) << "\" errors=\"";
+    placeholders.errors = _out.tellp();
+    _out << formatCount(0) << "\" time=\"";
+    placeholders.time = _out.tellp();
+    _out << formatTime(0) << "\"";
+
+    return placeholders;
+}
+
+void JUnitXmlObserver::patch(const CountPlaceholders& placeholders,
+        const Counts& counts)
+{
+    patchValue(placeholders.tests, formatCount(counts.tests));
+    patchValue(placeholders.failures, formatCount(counts.failures));
+    patchValue(placeholders.errors, formatCount(counts.errors));
+    patchValue(placeholders.time, formatTime(counts.seconds));
+}
+
+void JUnitXmlObserver::patchValue(std::streampos pos, const std::string& value)
+{
+    const std::streampos end = _out.tellp();
+    _out.seekp(pos);
+    _out << value;
+    _out.seekp(end);
+}
+
+void JUnitXmlObserver::onAllTestSuitesBegin(int)
+{
+    _allStart = detail::monotonicSeconds();
+
+    _out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+         << "<testsuites name=\"testcpp\"";
+    _allPlaceholders = writePlaceholders();
+    _out << ">\n";
+
+    // forked workers of isolated runs must not inherit a buffered header
+    _out.flush();
+}
+
+void JUnitXmlObserver::onAllTestSuitesEnd(int, int, int, int)
+{
+    _allCounts.seconds = detail::monotonicSeconds() - _allStart;
+
+    _out << "</testsuites>\n";
+    patch(_allPlaceholders, _allCounts);
+    _out.flush();
+}
+
+void JUnitXmlObserver::onTestSuiteBegin(const std::string& testSuiteLabel,
+        int, int)
+{
+    _suiteLabel = testSuiteLabel;
+    _suiteCounts = Counts();
+    _inSuite = true;
+
+    _out << "  <testsuite name=\"" << escape(testSuiteLabel) << "\"";
+    _suitePlaceholders = writePlaceholders();
+    _out << ">\n";
+}
+
+void JUnitXmlObserver::onTestSuiteStats(const TestSuiteStats& stats)
+{ _suiteCounts.seconds = stats.wallSeconds; }
+
+void JUnitXmlObserver::onTestSuiteEnd(int)
+{ endSuite(false, "", ""); }
+
+void JUnitXmlObserver::onTestSuiteEndWithStdException(int, const std::exception& e)
+{ endSuite(true, exceptionTypeName(e), e.what()); }
+
+void JUnitXmlObserver::onTestSuiteEndWithEllipsisException(int)
+{ endSuite(true, "...", "Unhandled non-standard exception"); }
+
+void JUnitXmlObserver::endSuite(bool exception, const std::string& type,
+        const std::string& message)
+{
+    closeOpenTestCase();
+
+    if (exception) {
+        ++_suiteCounts.tests;
+        ++_suiteCounts.errors;
+        beginTestCase("(unhandled exception)", "", 0);
+        _out << ">\n      <error type=\"" << escape(type)
+             << "\" message=\"" << escape(message) << "\"/>\n"
+             << "    </testcase>\n";
+    }
+
+    _out << "  </testsuite>\n";
+    patch(_suitePlaceholders, _suiteCounts);
+    _inSuite = false;
+
+    _allCounts.tests += _suiteCounts.tests;
+    _allCounts.failures += _suiteCounts.failures;
+    _allCounts.errors += _suiteCounts.errors;
+
+    // keep the file useful if the run is killed later
+    _out.flush();
+}
+
+void JUnitXmlObserver::onAssertBegin(const AssertSite& site)
+{
+    closeOpenTestCase();
+    _site = site;
+}
+
+void JUnitXmlObserver::onAssertEnd(bool ok)
+{
+    if (ok)
+        passTestCase();
+    else
+        failTestCase(_site.assertType ? _site.assertType : "",
+                failureMessage(_site, ""));
+}
+
+void JUnitXmlObserver::onAssertExceptionEndWithExpectedException(const std::exception&)
+{ passTestCase(); }
+
+void JUnitXmlObserver::onAssertExceptionEndWithUnexpectedException(const std::exception& e)
+{
+    failTestCase(exceptionTypeName(e),
+            failureMessage(_site, std::string("unexpected exception ") + e.what()));
+}
+
+void JUnitXmlObserver::onAssertExceptionEndWithEllipsisException()
+{
+    failTestCase("...",
+            failureMessage(_site, "unexpected non-standard exception"));
+}
+
+void JUnitXmlObserver::onAssertNoExceptionEndWithStdException(const std::exception& e)
+{
+    failTestCase(exceptionTypeName(e),
+            failureMessage(_site, std::string("unexpected exception ") + e.what()));
+}
+
+void JUnitXmlObserver::onAssertNoExceptionEndWithEllipsisException()
+{ onAssertExceptionEndWithEllipsisException(); }
+
+void JUnitXmlObserver::onAssertFailureDetail(const std::string& detail)
+{
+    if (_failureOpen)
+        _out << escape(detail) << "\n";
+}
+
+void JUnitXmlObserver::beginTestCase(const std::string& name,
+        const std::string& file, int line)
+{
+    _out << "    <testcase classname=\"" << escape(_suiteLabel)
+         << "\" name=\"" << escape(name) << "\"";
+    if (!file.empty())
+        _out << " file=\"" << escape(file) << "\" line=\"" << line << "\"";
+}
+
+void JUnitXmlObserver::passTestCase()
+{
+    if (!_inSuite)
+        return;
+
+    ++_suiteCounts.tests;
+    beginTestCase(_site.label ? _site.label : "", _site.file ? _site.file : "",
+            _site.line);
+    _out << "/>\n";
+}
+
+void JUnitXmlObserver::failTestCase(const std::string& type,
+        const std::string& message)
+{
+    if (!_inSuite)
+        return;
+
+    ++_suiteCounts.tests;
+    ++_suiteCounts.failures;
+
+    beginTestCase(_site.label ? _site.label : "", _site.file ? _site.file : "",
+            _site.line);
+    _out << ">\n      <failure type=\"" << escape(type)
+         << "\" message=\"" << escape(message) << "\">";
+
+    // failure details follow the end of the assertion, the element is
+    // closed by the next event
+    _failureOpen = true;
+}
+
+void JUnitXmlObserver::closeOpenTestCase()
+{
+    if (!_failureOpen)
+        return;
+
+    _out << "</failure>\n    </testcase>\n";
+    _failureOpen = false;
+}
+
+} // namespace
@@ -0,0 +1,421 @@
+#include <testcpp/JsonLinesObserver.h>
+
+#include <stdexcept>
+#include <sstream>
+#include <iomanip>
+
+namespace Test
+{
+
+namespace
+{
+
+void appendEscaped(std::string& out, const char* str, size_t size)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    out += '"';
+    for (size_t i = 0; i < size; ++i) {
+        const unsigned char c = static_cast<unsigned char>(str[i]);
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    out += "\\u00";
+                    out += hex[c >> 4];
+                    out += hex[c & 0xF];
+                } else {
+                    out += static_cast<char>(c);
+                }
+        }
+    }
+    out += '"';
+}
+
+void appendEscaped(std::string& out, const std::string& str)
+{ appendEscaped(out, str.data(), str.size()); }
+
+void appendEscaped(std::string& out, const char* str)
+{
+    if (!str)
+        str = "";
+    appendEscaped(out, str, std::char_traits<char>::length(str));
+}
+
+template <typename T>
+void appendNumber(std::string& out, const T& value)
+{
+    std::ostringstream str;
+    str << std::setprecision(9) << value;
+    out += str.str();
+}
+
+void appendException(std::string& out, const std::string& type,
+        const std::string& what)
+{
+    out += ",\"exception\":{\"type\":";
+    appendEscaped(out, type);
+    out += ",\"what\":";
+    appendEscaped(out, what);
+    out += "}";
+}
+
+void appendCounter(std::string& out, const PerformanceCounters& counters,
+        PerformanceCounters::Counter counter, const char* name, double value)
+{
+    if (!counters.has(counter))
+        return;
+    if (out[out.size() - 1] != '{')
+        out += ',';
+    out += '"';
+    out += name;
+    out += "\":";
+    appendNumber(out, value);
+}
+
+/** Appends the counted CPU events as an object named name, if any. */
+void appendCounters(std::string& out, const char* name,
+        const PerformanceCounters& counters)
+{
+    typedef PerformanceCounters PC;
+
+    if (!counters.counted)
+        return;
+
+    out += ",\"";
+    out += name;
+    out += "\":{";
+    appendCounter(out, counters, PC::CYCLES, "cycles", counters.cycles);
+    appendCounter(out, counters, PC::INSTRUCTIONS, "instructions",
+            counters.instructions);
+    if (counters.has(PC::CYCLES))
+        appendCounter(out, counters, PC::INSTRUCTIONS, "ipc",
+                counters.instructionsPerCycle());
+    appendCounter(out, counters, PC::BRANCH_MISSES, "branch_misses",
+            counters.branchMisses);
+    appendCounter(out, counters, PC::L1D_READ_MISSES, "l1d_read_misses",
+            counters.l1dReadMisses);
+    appendCounter(out, counters, PC::LLC_MISSES, "llc_misses",
+            counters.llcMisses);
+    appendCounter(out, counters, PC::TASK_CLOCK, "task_clock_seconds",
+            counters.taskClockSeconds);
+    appendCounter(out, counters, PC::CONTEXT_SWITCHES, "context_switches",
+            counters.contextSwitches);
+    appendCounter(out, counters, PC::PAGE_FAULTS, "page_faults",
+            counters.pageFaults);
+    out += '}';
+}
+
+const AssertSite emptySite = { 0, 0, 0, 0, 0 };
+
+}
+
+JsonLinesObserver::JsonLinesObserver(const std::string& path,
+        bool includePassingAssertions) :
+    Observer(),
+    _file(path.c_str(), std::ios::out | std::ios::trunc | std::ios::binary),
+    _out(_file),
+    _includePassingAssertions(includePassingAssertions),
+    _suiteLabel(),
+    _suiteStats(),
+    _suiteAllocations(),
+    _hasSuiteAllocations(false),
+    _benchmarkLabel(),
+    _site(emptySite),
+    _pendingAssert(),
+    _pendingHasDetails(false)
+{
+    if (!_file)
+        throw std::runtime_error("Cannot open JSON lines file '" + path + "'");
+}
+
+JsonLinesObserver::JsonLinesObserver(std::ostream& out,
+        bool includePassingAssertions) :
+    Observer(),
+    _file(),
+    _out(out),
+    _includePassingAssertions(includePassingAssertions),
+    _suiteLabel(),
+    _suiteStats(),
+    _suiteAllocations(),
+    _hasSuiteAllocations(false),
+    _benchmarkLabel(),
+    _site(emptySite),
+    _pendingAssert(),
+    _pendingHasDetails(false)
+{ }
+
+JsonLinesObserver::~JsonLinesObserver()
+{
+    writePendingAssert();
+    _out.flush();
+}
+
+void JsonLinesObserver::onAllTestSuitesBegin(int testSuitesNumTotal)
+{
+    std::string line("{\"event\":\"run_begin\",\"suites\":");
+    appendNumber(line, testSuitesNumTotal);
+    line += "}\n";
+    _out << line;
+
+    // forked workers of isolated runs must not inherit a buffered line
+    _out.flush();
+}
+
+void JsonLinesObserver::onAllTestSuitesEnd(int lastTestSuiteNum,
+        int testSuitesNumTotal, int numErrs, int numExcepts)
+{
+    writePendingAssert();
+
+    std::string line("{\"event\":\"run_end\",\"suites_run\":");
+    appendNumber(line, lastTestSuiteNum);
+    line += ",\"suites\":";
+    appendNumber(line, testSuitesNumTotal);
+    line += ",\"errors\":";
+    appendNumber(line, numErrs);
+    line += ",\"exceptions\":";
+    appendNumber(line, numExcepts);
+    line += "}\n";
+    _out << line;
+    _out.flush();
+}
+
+void JsonLinesObserver::onTestSuiteBegin(const std::string& testSuiteLabel,
+        int testSuiteNum, int testSuitesNumTotal)
+{
+    writePendingAssert();
+
+    _suiteLabel = testSuiteLabel;
+    _suiteStats = TestSuiteStats();
+    _hasSuiteAllocations = false;
+
+    std::string line("{\"event\":\"suite_begin\",\"suite\":");
+    appendEscaped(line, testSuiteLabel);
+    line += ",\"num\":";
+    appendNumber(line, testSuiteNum);
+    line += ",\"total\":";
+    appendNumber(line, testSuitesNumTotal);
+    line += "}\n";
+    _out << line;
+}
+
+void JsonLinesObserver::onTestSuiteStats(const TestSuiteStats& stats)
+{ _suiteStats = stats; }
+
+void JsonLinesObserver::onTestSuiteAllocations(const AllocationStats& stats)
+{
+    _suiteAllocations = stats;
+    _hasSuiteAllocations = true;
+}
+
+void JsonLinesObserver::onTestSuiteEnd(int numErrs)
+{ endSuite(numErrs, false, "", ""); }
+
+void JsonLinesObserver::onTestSuiteEndWithStdException(int numErrs,
+        const std::exception& e)
+{ endSuite(numErrs, true, exceptionTypeName(e), e.what()); }
+
+void JsonLinesObserver::onTestSuiteEndWithEllipsisException(int numErrs)
+{ endSuite(numErrs, true, "...", "Unhandled non-standard exception"); }
+
+void JsonLinesObserver::endSuite(int numErrs, bool exception,
+        const std::string& exceptionType, const std::string& exceptionWhat)
+{
+    writePendingAssert();
+
+    std::string line("{\"event\":\"suite_end\",\"suite\":");
+    appendEscaped(line, _suiteLabel);
+    line += ",\"ok\":";
+    line += numErrs == 0 && !exception ? "true" : "false";
+    line += ",\"errors\":";
+    appendNumber(line, numErrs);
+    line += ",\"wall_seconds\":";
+    appendNumber(line, _suiteStats.wallSeconds);
+    line += ",\"cpu_seconds\":";
+    appendNumber(line, _suiteStats.cpuSeconds);
+    line += ",\"peak_rss_kb\":";
+    appendNumber(line, _suiteStats.peakResidentSetKilobytes);
+    if (_hasSuiteAllocations) {
+        line += ",\"allocations\":";
+        appendNumber(line, _suiteAllocations.allocations);
+        line += ",\"allocated_bytes\":";
+        appendNumber(line, _suiteAllocations.allocatedBytes);
+        line += ",\"peak_live_bytes\":";
+        appendNumber(line, _suiteAllocations.peakLiveBytes);
+        line += ",\"leaked_allocations\":";
+        appendNumber(line, _suiteAllocations.leakedAllocations);
+        line += ",\"leaked_bytes\":";
+        appendNumber(line, _suiteAllocations.leakedBytes);
+    }
+    appendCounters(line, "counters", _suiteStats.counters);
+    if (exception)
+        appendException(line, exceptionType, exceptionWhat);
+    line += "}\n";
+    _out << line;
+
+    // keep the file useful if the run is killed later
+    _out.flush();
+}
+
+void JsonLinesObserver::onAssertBegin(const AssertSite& site)
+{
+    writePendingAssert();
+    _site = site;
+}
+
+void JsonLinesObserver::onAssertEnd(bool ok)
+{ endAssert(ok, "", ""); }
+
+void JsonLinesObserver::onAssertExceptionEndWithExpectedException(const std::exception&)
+{ endAssert(true, "", ""); }
+
+void JsonLinesObserver::onAssertExceptionEndWithUnexpectedException(const std::exception& e)
+{ endAssert(false, exceptionTypeName(e), e.what()); }
+
+void JsonLinesObserver::onAssertExceptionEndWithEllipsisException()
+{ endAssert(false, "...", "Unexpected non-standard exception"); }
+
+void JsonLinesObserver::onAssertNoExceptionEndWithStdException(const std::exception& e)
+{ endAssert(false, exceptionTypeName(e), e.what()); }
+
+void JsonLinesObserver::onAssertNoExceptionEndWithEllipsisException()
+{ onAssertExceptionEndWithEllipsisException(); }
+
+void JsonLinesObserver::endAssert(bool ok, const std::string& exceptionType,
+        const std::string& exceptionWhat)
+{
+    if (ok && !_includePassingAssertions)
+        return;
+
+    std::string& line = _pendingAssert;
+    line = "{\"event\":\"assert\",\"suite\":";
+    appendEscaped(line, _suiteLabel);
+    line += ",\"type\":";
+    appendEscaped(line, _site.assertType);
+    line += ",\"label\":";
+    appendEscaped(line, _site.label);
+    line += ",\"file\":";
+    appendEscaped(line, _site.file);
+    line += ",\"line\":";
+    appendNumber(line, _site.line);
+    line += ",\"function\":";
+    appendEscaped(line, _site.function);
+    line += ",\"ok\":";
+    line += ok ? "true" : "false";
+    if (!exceptionType.empty())
+        appendException(line, exceptionType, exceptionWhat);
+
+    // failure details follow the end of the assertion, the record is
+    // written by the next event
+    if (ok)
+        writePendingAssert();
+}
+
+void JsonLinesObserver::onAssertFailureDetail(const std::string& detail)
+{
+    if (_pendingAssert.empty())
+        return;
+
+    _pendingAssert += _pendingHasDetails ? "," : ",\"details\":[";
+    appendEscaped(_pendingAssert, detail);
+    _pendingHasDetails = true;
+}
+
+void JsonLinesObserver::writePendingAssert()
+{
+    if (_pendingAssert.empty())
+        return;
+
+    if (_pendingHasDetails)
+        _pendingAssert += "]";
+    _pendingAssert += "}\n";
+    _out << _pendingAssert;
+
+    // keep the capacity for the next record
+    _pendingAssert.clear();
+    _pendingHasDetails = false;
+}
+
+void JsonLinesObserver::onBenchmarkBegin(const std::string& benchmarkLabel,
+        int, int)
+{
+    writePendingAssert();
+    _benchmarkLabel = benchmarkLabel;
+}
+
+void JsonLinesObserver::onBenchmarkEnd(const BenchmarkResult& result)
+{
+    writePendingAssert();
+
+    std::string line("{\"event\":\"benchmark\",\"benchmark\":");
+    appendEscaped(line, result.label);
+    line += ",\"ok\":true,\"iterations_per_sample\":";
+    appendNumber(line, result.iterationsPerSample);
+    line += ",\"samples\":";
+    appendNumber(line, result.samples.size());
+    line += ",\"rejected_samples\":";
+    appendNumber(line, result.rejectedSamples);
+    line += ",\"min_ns\":";
+    appendNumber(line, result.min);
+    line += ",\"median_ns\":";
+    appendNumber(line, result.median);
+    line += ",\"mean_ns\":";
+    appendNumber(line, result.mean);
+    line += ",\"p90_ns\":";
+    appendNumber(line, result.p90);
+    line += ",\"p99_ns\":";
+    appendNumber(line, result.p99);
+    line += ",\"max_ns\":";
+    appendNumber(line, result.max);
+    appendCounters(line, "counters_per_iteration", result.counters);
+    line += "}\n";
+    _out << line;
+}
+
+void JsonLinesObserver::onBenchmarkEndWithStdException(const std::exception& e)
+{ endBenchmark(exceptionTypeName(e), e.what()); }
+
+void JsonLinesObserver::onBenchmarkEndWithEllipsisException()
+{ endBenchmark("...", "Unhandled non-standard exception"); }
+
+void JsonLinesObserver::endBenchmark(const std::string& exceptionType,
+        const std::string& exceptionWhat)
+{
+    writePendingAssert();
+
+    std::string line("{\"event\":\"benchmark\",\"benchmark\":");
+    appendEscaped(line, _benchmarkLabel);
+    line += ",\"ok\":false";
+    appendException(line, exceptionType, exceptionWhat);
+    line += "}\n";
+    _out << line;
+}
+
+void JsonLinesObserver::onTimingRegression(const TimingRegression& regression)
+{
+    writePendingAssert();
+
+    const char* unit = regression.benchmark ? "_ns\":" : "_seconds\":";
+
+    std::string line("{\"event\":\"timing_regression\",\"");
+    line += regression.benchmark ? "benchmark" : "suite";
+    line += "\":";
+    appendEscaped(line, regression.label);
+    line += ",\"median";
+    line += unit;
+    appendNumber(line, regression.median);
+    line += ",\"baseline_median";
+    line += unit;
+    appendNumber(line, regression.baselineMedian);
+    line += ",\"threshold";
+    line += unit;
+    appendNumber(line, regression.threshold);
+    line += "}\n";
+    _out << line;
+}
+
+} // namespace
@@ -0,0 +1,160 @@
+#include <testcpp/testcpp.h>
+
+#ifdef TESTCPP_HAVE_THREADS
+
+#include <testcpp/detail/Clock.h>
+#include <testcpp/detail/EventRecorder.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace Test
+{
+
+namespace
+{
+
+/**
+ * Queue of test suite indices. The owning worker takes suites from the
+ * front, idle workers steal from the back.
+ */
+class WorkQueue
+{
+    UTILCPP_DISABLE_COPY(WorkQueue)
+
+public:
+    WorkQueue() :
+        _lock(),
+        _items()
+    { }
+
+    void push(size_t item)
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _items.push_back(item);
+    }
+
+    bool pop(size_t& item)
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        if (_items.empty())
+            return false;
+        item = _items.front();
+        _items.pop_front();
+        return true;
+    }
+
+    bool steal(size_t& item)
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        if (_items.empty())
+            return false;
+        item = _items.back();
+        _items.pop_back();
+        return true;
+    }
+
+private:
+    std::mutex _lock;
+    std::deque<size_t> _items;
+};
+
+bool takeWork(std::vector<WorkQueue>& queues, size_t worker, size_t& item)
+{
+    if (queues[worker].pop(item))
+        return true;
+
+    // no work is added during the run, so all queues empty means done
+    for (size_t i = 1; i < queues.size(); ++i)
+        if (queues[(worker + i) % queues.size()].steal(item))
+            return true;
+
+    return false;
+}
+
+}
+
+void Controller::runInParallel(unsigned threads)
+{
+    const size_t testSuiteCount = _plan.size();
+
+    if (testSuiteCount < 2) {
+        runSequentially();
+        return;
+    }
+
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    if (threads > testSuiteCount)
+        threads = static_cast<unsigned>(testSuiteCount);
+
+    // contiguous blocks keep registration order within a worker, longest
+    // first order is dealt out so that every worker starts with a long
+    // suite and steals the short ones last
+    std::vector<WorkQueue> queues(threads);
+    for (size_t i = 0; i < testSuiteCount; ++i)
+        queues[_testSuiteOrder == LONGEST_FIRST
+            ? i % threads : i * threads / testSuiteCount].push(i);
+
+    std::atomic<int> testSuitesStarted(0);
+    std::atomic<bool> stopping(false);
+
+    auto worker = [&](size_t workerNum)
+    {
+        EventRecorder recorder;
+        size_t i;
+
+        while (!stopping && takeWork(queues, workerNum, i)) {
+            const SuiteDescriptor& testSuite = _testSuites[_plan[i]];
+            recorder.clear();
+            AssertionContext context(&recorder, _observer->subscribedEvents());
+            const double start = detail::monotonicSeconds();
+
+            const int testSuiteNum = ++testSuitesStarted;
+            const bool endedWithException = runTestSuite(testSuite,
+                    testSuiteNum, testSuiteCount, context);
+            const double seconds = detail::monotonicSeconds() - start;
+
+            std::lock_guard<std::mutex> guard(_observerLock);
+            EventRecorder::replay(recorder.buffer(), *_observer);
+            // the watchdog reports up to the last suite that ended
+            _curTestSuite = std::max(_curTestSuite, testSuiteNum);
+            _allTestErrs += context.errs();
+            if (endedWithException)
+                ++_allTestExcepts;
+
+            recordTestSuiteResult(testSuite.label,
+                    endedWithException || context.errs() > 0, seconds);
+            if (maxFailuresReached())
+                stopping = true;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned w = 1; w < threads; ++w)
+        workers.push_back(std::thread(worker, w));
+
+    worker(0);
+
+    for (size_t w = 0; w < workers.size(); ++w)
+        workers[w].join();
+}
+
+} // namespace
+
+#else
+
+namespace Test
+{
+
+void Controller::runInParallel(unsigned)
+{
+    runSequentially();
+}
+
+} // namespace
+
+#endif
@@ -0,0 +1,175 @@
+#include <testcpp/PerformanceCounters.h>
+
+#ifdef __linux__
+  #include <linux/perf_event.h>
+  #include <sys/syscall.h>
+  #include <string.h>
+  #include <unistd.h>
+#endif
+
+namespace Test
+{
+
+namespace
+{
+
+#ifdef __linux__
+
+#ifndef PERF_FLAG_FD_CLOEXEC
+  #define PERF_FLAG_FD_CLOEXEC 0
+#endif
+
+struct CounterEvent
+{
+    PerformanceCounters::Counter counter;
+    unsigned type;
+    unsigned long config;
+};
+
+const CounterEvent hardwareEvents[] = {
+    { PerformanceCounters::CYCLES,
+        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PerformanceCounters::INSTRUCTIONS,
+        PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PerformanceCounters::BRANCH_MISSES,
+        PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { PerformanceCounters::L1D_READ_MISSES,
+        PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D
+            | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+            | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { PerformanceCounters::LLC_MISSES,
+        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES }
+};
+
+const CounterEvent softwareEvents[] = {
+    { PerformanceCounters::TASK_CLOCK,
+        PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+    { PerformanceCounters::CONTEXT_SWITCHES,
+        PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+    { PerformanceCounters::PAGE_FAULTS,
+        PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS }
+};
+
+/** Starts counting an event of the calling thread, -1 on failure. */
+int openCounter(const CounterEvent& event)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = event.type;
+    attr.config = event.config;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+        | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // user space only, as allowed with perf_event_paranoid 2
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return static_cast<int>(syscall(__NR_perf_event_open, &attr,
+                0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+}
+
+/** Reads a count scaled by the time the event was scheduled on the CPU. */
+bool readCounter(int fd, double& value)
+{
+    struct
+    {
+        unsigned long long value;
+        unsigned long long timeEnabled;
+        unsigned long long timeRunning;
+    } data;
+
+    if (read(fd, &data, sizeof(data)) != static_cast<ssize_t>(sizeof(data))
+            || data.timeRunning == 0)
+        return false;
+
+    value = static_cast<double>(data.value);
+    if (data.timeRunning < data.timeEnabled)
+        value *= static_cast<double>(data.timeEnabled) / data.timeRunning;
+    return true;
+}
+
+double* counterValue(PerformanceCounters& counters,
+        PerformanceCounters::Counter counter)
+{
+    switch (counter) {
+    case PerformanceCounters::CYCLES:           return &counters.cycles;
+    case PerformanceCounters::INSTRUCTIONS:     return &counters.instructions;
+    case PerformanceCounters::BRANCH_MISSES:    return &counters.branchMisses;
+    case PerformanceCounters::L1D_READ_MISSES:  return &counters.l1dReadMisses;
+    case PerformanceCounters::LLC_MISSES:       return &counters.llcMisses;
+    case PerformanceCounters::TASK_CLOCK:       return &counters.taskClockSeconds;
+    case PerformanceCounters::CONTEXT_SWITCHES: return &counters.contextSwitches;
+    case PerformanceCounters::PAGE_FAULTS:      return &counters.pageFaults;
+    }
+    return 0;
+}
+
+#endif
+
+}
+
+PerformanceCounterScope::PerformanceCounterScope(bool enabled)
+{
+    for (int i = 0; i < MAX_COUNTERS; ++i) {
+        _fds[i] = -1;
+        _counters[i] = 0;
+    }
+
+#ifdef __linux__
+    if (!enabled)
+        return;
+
+    size_t opened = 0;
+    for (size_t i = 0; i < sizeof(hardwareEvents) / sizeof(hardwareEvents[0]); ++i) {
+        const int fd = openCounter(hardwareEvents[i]);
+        if (fd >= 0) {
+            _fds[opened] = fd;
+            _counters[opened++] = hardwareEvents[i].counter;
+        }
+    }
+
+    // without cycles the hardware counts say little, software counters
+    // are allowed where hardware counters are not
+    if (opened == 0 || _counters[0] != PerformanceCounters::CYCLES)
+        for (size_t i = 0; i < sizeof(softwareEvents) / sizeof(softwareEvents[0]); ++i) {
+            const int fd = openCounter(softwareEvents[i]);
+            if (fd >= 0) {
+                _fds[opened] = fd;
+                _counters[opened++] = softwareEvents[i].counter;
+            }
+        }
+#else
+    (void)enabled;
+#endif
+}
+
+PerformanceCounterScope::~PerformanceCounterScope()
+{
+#ifdef __linux__
+    for (int i = 0; i < MAX_COUNTERS; ++i)
+        if (_fds[i] >= 0)
+            close(_fds[i]);
+#endif
+}
+
+PerformanceCounters PerformanceCounterScope::counters() const
+{
+    PerformanceCounters counters;
+
+#ifdef __linux__
+    for (int i = 0; i < MAX_COUNTERS && _fds[i] >= 0; ++i) {
+        const PerformanceCounters::Counter counter =
+            static_cast<PerformanceCounters::Counter>(_counters[i]);
+        double* value = counterValue(counters, counter);
+        if (value && readCounter(_fds[i], *value))
+            counters.counted |= counter;
+    }
+
+    // the task clock counts nanoseconds
+    counters.taskClockSeconds *= 1e-9;
+#endif
+
+    return counters;
+}
+
+} // namespace
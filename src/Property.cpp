@@ -0,0 +1,207 @@
+#include <testcpp/Property.h>
+#include <testcpp/detail/Clock.h>
+
+#include <cstdlib>
+#include <ctime>
+#include <sstream>
+
+#ifdef TESTCPP_HAVE_THREADS
+  #include <algorithm>
+  #include <atomic>
+  #include <thread>
+#endif
+
+namespace Test
+{
+
+namespace
+{
+
+/** The SplitMix64 finalizer, spreads the bits of nearby seeds. */
+unsigned long long mix(unsigned long long value)
+{
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+/** FNV-1a, so that a run seed reproduces properties on every platform. */
+unsigned long long hashLabel(const std::string& label)
+{
+    unsigned long long hash = 14695981039346656037ull;
+    for (size_t i = 0; i < label.size(); ++i) {
+        hash ^= static_cast<unsigned char>(label[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/** Cases that a worker takes at a time. */
+const unsigned long CASE_BATCH = 1024;
+
+}
+
+StringGenerator::StringGenerator(size_t maxLength, const std::string& alphabet) :
+    _maxLength(maxLength),
+    _alphabet(alphabet)
+{
+    if (_alphabet.empty())
+        throw std::invalid_argument("String generator alphabet is empty");
+}
+
+void StringGenerator::shrink(const std::string& value,
+        std::vector<std::string>& candidates) const
+{
+    if (value.empty())
+        return;
+
+    candidates.push_back(std::string());
+    detail::appendRemovals(value, candidates);
+
+    for (size_t i = 0; i < value.size(); ++i)
+        if (value[i] != _alphabet[0]) {
+            candidates.push_back(value);
+            candidates.back()[i] = _alphabet[0];
+        }
+}
+
+std::string StringGenerator::printableAscii()
+{
+    std::string alphabet;
+    for (char c = ' '; c <= '~'; ++c)
+        alphabet += c;
+    return alphabet;
+}
+
+unsigned long Controller::propertySeed()
+{
+    if (_propertySeed)
+        return _propertySeed;
+
+    const char* seed = std::getenv("TESTCPP_PROPERTY_SEED");
+    if (seed && *seed)
+        _propertySeed = std::strtoul(seed, 0, 10);
+
+    // 32 bits, so that the seed can be given on any platform
+    while (!_propertySeed)
+        _propertySeed = static_cast<unsigned long>(mix(
+                static_cast<unsigned long long>(std::time(0))
+                ^ static_cast<unsigned long long>(
+                    detail::monotonicSeconds() * 1e9)) & 0xFFFFFFFFul);
+
+    return _propertySeed;
+}
+
+namespace detail
+{
+
+void describeString(std::ostream& out, const std::string& str)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    out << '"';
+    for (size_t i = 0; i < str.size(); ++i) {
+        const unsigned char c = static_cast<unsigned char>(str[i]);
+        if (c == '"' || c == '\\')
+            out << '\\' << str[i];
+        else if (c >= 0x20 && c < 0x7F)
+            out << str[i];
+        else
+            out << "\\x" << hex[c >> 4] << hex[c & 0xF];
+    }
+    out << '"';
+}
+
+unsigned propertyWorkers(unsigned threads, unsigned long cases)
+{
+#ifdef TESTCPP_HAVE_THREADS
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // a worker per batch at most
+    const unsigned long batches = (cases + CASE_BATCH - 1) / CASE_BATCH;
+    if (batches < threads)
+        threads = static_cast<unsigned>(std::max(1ul, batches));
+    return threads;
+#else
+    (void)threads;
+    (void)cases;
+    return 1;
+#endif
+}
+
+unsigned long findFailingCase(PropertyCases& cases, unsigned long count,
+        unsigned workers)
+{
+#ifdef TESTCPP_HAVE_THREADS
+    if (workers > 1) {
+        std::atomic<unsigned long> nextBatch(0);
+        std::atomic<unsigned long> failedCase(count);
+
+        // cases before the first failure are all checked, so the result
+        // is the same as when checking in order
+        std::vector<std::thread> threads;
+        for (unsigned worker = 0; worker < workers; ++worker)
+            threads.push_back(std::thread([&, worker]() {
+                PropertyProbe probe;
+                for (;;) {
+                    const unsigned long begin = nextBatch.fetch_add(CASE_BATCH);
+                    if (begin >= failedCase.load())
+                        return;
+
+                    const unsigned long end = std::min(count, begin + CASE_BATCH);
+                    for (unsigned long i = begin; i < end; ++i) {
+                        if (i >= failedCase.load(std::memory_order_relaxed))
+                            break;
+                        if (!cases.holds(probe, worker, i)) {
+                            unsigned long failed = failedCase.load();
+                            while (i < failed
+                                    && !failedCase.compare_exchange_weak(failed, i))
+                                ;
+                            break;
+                        }
+                    }
+                }
+            }));
+
+        for (size_t i = 0; i < threads.size(); ++i)
+            threads[i].join();
+
+        return failedCase.load();
+    }
+#else
+    (void)workers;
+#endif
+
+    PropertyProbe probe;
+    for (unsigned long i = 0; i < count; ++i)
+        if (!cases.holds(probe, 0, i))
+            return i;
+    return count;
+}
+
+unsigned long long propertyCaseSeed(unsigned long seed,
+        const std::string& label, unsigned long caseNumber)
+{ return mix(mix(seed ^ hashLabel(label)) ^ caseNumber); }
+
+void reportPropertyFailure(AssertionContext& context, const AssertSite& site,
+        unsigned long seed, unsigned long failedCase, unsigned long cases,
+        unsigned long shrinks, const std::string& counterexample)
+{
+    context.beforeAssert(site);
+    context.afterAssert(false);
+
+    std::ostringstream falsified;
+    falsified << "falsified by case " << failedCase + 1 << " of " << cases
+              << " with seed " << seed;
+    context.onAssertFailureDetail(falsified.str());
+
+    std::ostringstream shrunk;
+    shrunk << "counterexample after " << shrinks << " shrinks: "
+           << counterexample;
+    context.onAssertFailureDetail(shrunk.str());
+}
+
+}
+
+} // namespace
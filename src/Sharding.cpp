@@ -0,0 +1,180 @@
+#include <testcpp/testcpp.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+namespace Test
+{
+
+namespace
+{
+
+/** FNV-1a, stable across platforms and standard library versions. */
+unsigned long hashLabel(const char* label)
+{
+    unsigned long hash = 2166136261ul;
+    for (; *label; ++label) {
+        hash ^= static_cast<unsigned char>(*label);
+        hash = (hash * 16777619ul) & 0xFFFFFFFFul;
+    }
+    return hash;
+}
+
+bool parseUnsigned(const char* str, unsigned& value)
+{
+    // strtoul() accepts a sign and negates, "-1" would be a huge index
+    if (!std::isdigit(static_cast<unsigned char>(*str)))
+        return false;
+
+    char* end = 0;
+    errno = 0;
+    const unsigned long parsed = std::strtoul(str, &end, 10);
+    if (*end != '\0' || errno == ERANGE || parsed > UINT_MAX)
+        return false;
+    value = static_cast<unsigned>(parsed);
+    return true;
+}
+
+typedef std::map<std::string, double> Durations;
+
+/**
+ * Reads "label<TAB>seconds" lines, later lines override earlier ones.
+ * Further fields, as in the history file, are ignored.
+ */
+bool loadDurations(const std::string& path, Durations& durations)
+{
+    std::ifstream in(path.c_str());
+    if (!in)
+        return false;
+
+    std::string line;
+    while (std::getline(in, line)) {
+        const size_t tab = line.find('\t');
+        if (tab == std::string::npos)
+            continue;
+
+        const char* seconds = line.c_str() + tab + 1;
+        char* end = 0;
+        const double value = std::strtod(seconds, &end);
+        if (end == seconds || value < 0)
+            continue;
+
+        durations[line.substr(0, tab)] = value;
+    }
+
+    return true;
+}
+
+struct ShardItem
+{
+    double seconds;
+    const char* label;
+    size_t planPos;
+};
+
+// longest first, ties broken by label and position so that all shards
+// agree on the order
+bool longerFirst(const ShardItem& a, const ShardItem& b)
+{
+    if (a.seconds != b.seconds)
+        return a.seconds > b.seconds;
+    const int labelOrder = std::strcmp(a.label, b.label);
+    if (labelOrder != 0)
+        return labelOrder < 0;
+    return a.planPos < b.planPos;
+}
+
+}
+
+void Controller::setShard(unsigned index, unsigned count)
+{
+    if (index >= count)
+        throw std::runtime_error("Shard index must be less than shard count");
+    _shardIndex = index;
+    _shardCount = count;
+}
+
+void Controller::selectShard()
+{
+    unsigned index = _shardIndex;
+    unsigned count = _shardCount;
+
+    if (count == 0) {
+        const char* indexEnv = std::getenv("TESTCPP_SHARD_INDEX");
+        const char* countEnv = std::getenv("TESTCPP_SHARD_COUNT");
+        if (!indexEnv || !countEnv)
+            return;
+        if (!parseUnsigned(indexEnv, index) || !parseUnsigned(countEnv, count)
+                || index >= count)
+            throw std::runtime_error("Invalid TESTCPP_SHARD_INDEX or TESTCPP_SHARD_COUNT");
+    }
+
+    if (count == 1)
+        return;
+
+    // benchmark durations are not in the durations file, always hashed
+    std::vector<size_t> benchmarkPlan;
+    for (size_t i = 0; i < _benchmarkPlan.size(); ++i)
+        if (hashLabel(_benchmarks[_benchmarkPlan[i]].label.c_str()) % count == index)
+            benchmarkPlan.push_back(_benchmarkPlan[i]);
+    _benchmarkPlan.swap(benchmarkPlan);
+
+    std::string durationsPath = _shardDurationsPath;
+    if (durationsPath.empty()) {
+        const char* durationsEnv = std::getenv("TESTCPP_SHARD_DURATIONS");
+        if (durationsEnv)
+            durationsPath = durationsEnv;
+    }
+
+    Durations durations;
+    const bool balance = !durationsPath.empty()
+        && loadDurations(durationsPath, durations) && !durations.empty();
+
+    std::vector<bool> selected(_plan.size(), false);
+
+    if (!balance) {
+        for (size_t i = 0; i < _plan.size(); ++i)
+            selected[i] = hashLabel(_testSuites[_plan[i]].label) % count == index;
+    } else {
+        double total = 0;
+        for (Durations::const_iterator i = durations.begin(); i != durations.end(); ++i)
+            total += i->second;
+        const double average = total / durations.size();
+
+        std::vector<ShardItem> items;
+        for (size_t i = 0; i < _plan.size(); ++i) {
+            const char* label = _testSuites[_plan[i]].label;
+            Durations::const_iterator found = durations.find(label);
+            ShardItem item = { found != durations.end() ? found->second : average,
+                label, i };
+            items.push_back(item);
+        }
+
+        std::sort(items.begin(), items.end(), longerFirst);
+
+        // greedy longest processing time first: the next longest suite
+        // goes to the shard with the least work so far
+        std::vector<double> load(count, 0.0);
+        for (size_t i = 0; i < items.size(); ++i) {
+            const size_t shard = std::min_element(load.begin(), load.end()) - load.begin();
+            load[shard] += items[i].seconds;
+            if (shard == index)
+                selected[items[i].planPos] = true;
+        }
+    }
+
+    // keep registration order within the shard
+    std::vector<size_t> plan;
+    for (size_t i = 0; i < _plan.size(); ++i)
+        if (selected[i])
+            plan.push_back(_plan[i]);
+    _plan.swap(plan);
+}
+
+} // namespace
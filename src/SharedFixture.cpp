@@ -0,0 +1,248 @@
+#include <testcpp/SharedFixture.h>
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+namespace Test
+{
+
+namespace detail
+{
+
+namespace
+{
+
+#ifdef TESTCPP_HAVE_THREADS
+std::mutex& entriesLock()
+{
+    static std::mutex lock;
+    return lock;
+}
+#endif
+
+std::vector<SharedFixtureEntry*>& entries()
+{
+    static std::vector<SharedFixtureEntry*> entries;
+    return entries;
+}
+
+}
+
+SharedFixtureEntry::SharedFixtureEntry(CreateFunction create,
+        DestroyFunction destroy) :
+#ifdef TESTCPP_HAVE_THREADS
+    _lock(),
+#endif
+    _create(create),
+    _destroy(destroy),
+    _fixture(0),
+    _handles(0),
+    _pendingUsers(0),
+    _keepUntilRunEnd(true)
+{
+#ifdef TESTCPP_HAVE_THREADS
+    std::lock_guard<std::mutex> guard(entriesLock());
+#endif
+    // entries are created on first use, inside of a suite
+    UntrackedAllocations untracked;
+    entries().push_back(this);
+}
+
+SharedFixtureEntry::~SharedFixtureEntry()
+{
+    if (_fixture) {
+        UntrackedAllocations untracked;
+        _destroy(_fixture);
+    }
+}
+
+void* SharedFixtureEntry::acquire()
+{
+#ifdef TESTCPP_HAVE_THREADS
+    std::lock_guard<std::mutex> guard(_lock);
+#endif
+    if (!_fixture) {
+        // the fixture outlives the suite that happens to create it
+        UntrackedAllocations untracked;
+        _fixture = _create();
+    }
+    ++_handles;
+    return _fixture;
+}
+
+void SharedFixtureEntry::release()
+{
+#ifdef TESTCPP_HAVE_THREADS
+    std::lock_guard<std::mutex> guard(_lock);
+#endif
+    --_handles;
+    destroyIfUnused();
+}
+
+void SharedFixtureEntry::beginRun(unsigned long plannedUsers,
+        bool usersDeclared)
+{
+#ifdef TESTCPP_HAVE_THREADS
+    std::lock_guard<std::mutex> guard(_lock);
+#endif
+    _pendingUsers = plannedUsers;
+    _keepUntilRunEnd = !usersDeclared;
+    destroyIfUnused();
+}
+
+void SharedFixtureEntry::userFinished()
+{
+#ifdef TESTCPP_HAVE_THREADS
+    std::lock_guard<std::mutex> guard(_lock);
+#endif
+    if (_pendingUsers > 0)
+        --_pendingUsers;
+    destroyIfUnused();
+}
+
+void SharedFixtureEntry::endRun()
+{
+#ifdef TESTCPP_HAVE_THREADS
+    std::lock_guard<std::mutex> guard(_lock);
+#endif
+    _pendingUsers = 0;
+    _keepUntilRunEnd = false;
+    destroyIfUnused();
+}
+
+void SharedFixtureEntry::destroyIfUnused()
+{
+    if (!_fixture || _handles > 0 || _pendingUsers > 0 || _keepUntilRunEnd)
+        return;
+
+    UntrackedAllocations untracked;
+    void* fixture = _fixture;
+    _fixture = 0;
+    _destroy(fixture);
+}
+
+void sharedFixtureEntries(std::vector<SharedFixtureEntry*>& result)
+{
+#ifdef TESTCPP_HAVE_THREADS
+    std::lock_guard<std::mutex> guard(entriesLock());
+#endif
+    result = entries();
+}
+
+}
+
+namespace
+{
+
+void addSharedFixture(std::vector<detail::SharedFixtureEntry*>& fixtures,
+        detail::SharedFixtureEntry* fixture)
+{
+    if (std::find(fixtures.begin(), fixtures.end(), fixture) == fixtures.end())
+        fixtures.push_back(fixture);
+}
+
+}
+
+void Controller::mapSharedFixtures()
+{
+    _suiteFixtures.assign(_testSuites.size(),
+            std::vector<detail::SharedFixtureEntry*>());
+
+    std::vector<bool> planned(_testSuites.size(), false);
+    for (size_t i = 0; i < _plan.size(); ++i)
+        planned[_plan[i]] = true;
+
+    for (size_t u = 0; u < _sharedFixtureUsers.size(); ++u) {
+        const SharedFixtureUsers& users = _sharedFixtureUsers[u];
+        const std::vector<bool> matches = matchTestSuites(users.users);
+
+        for (size_t i = 0; i < _plan.size(); ++i)
+            if (matches[_plan[i]])
+                addSharedFixture(_suiteFixtures[_plan[i]], users.fixture);
+    }
+
+    for (size_t s = 0; s < _sharedFixtureSuites.size(); ++s) {
+        const size_t testSuite = _sharedFixtureSuites[s].first;
+        if (planned[testSuite])
+            addSharedFixture(_suiteFixtures[testSuite],
+                    _sharedFixtureSuites[s].second);
+    }
+}
+
+void Controller::groupBySharedFixture()
+{
+    std::vector<size_t> plan;
+    std::vector<bool> taken(_plan.size());
+
+    // suites join the group of their first fixture
+    for (size_t i = 0; i < _plan.size(); ++i) {
+        if (taken[i])
+            continue;
+        taken[i] = true;
+        plan.push_back(_plan[i]);
+
+        const std::vector<detail::SharedFixtureEntry*>& fixtures =
+            _suiteFixtures[_plan[i]];
+        if (fixtures.empty())
+            continue;
+
+        for (size_t j = i + 1; j < _plan.size(); ++j) {
+            const std::vector<detail::SharedFixtureEntry*>& others =
+                _suiteFixtures[_plan[j]];
+            if (!taken[j] && !others.empty() && others[0] == fixtures[0]) {
+                taken[j] = true;
+                plan.push_back(_plan[j]);
+            }
+        }
+    }
+
+    _plan.swap(plan);
+}
+
+void Controller::beginSharedFixtures()
+{
+    std::vector<detail::SharedFixtureEntry*> entries;
+    detail::sharedFixtureEntries(entries);
+
+    std::set<detail::SharedFixtureEntry*> declared;
+    for (size_t u = 0; u < _sharedFixtureUsers.size(); ++u)
+        declared.insert(_sharedFixtureUsers[u].fixture);
+    for (size_t s = 0; s < _sharedFixtureSuites.size(); ++s)
+        declared.insert(_sharedFixtureSuites[s].second);
+
+    std::map<detail::SharedFixtureEntry*, unsigned long> plannedUsers;
+    for (size_t i = 0; i < _plan.size(); ++i) {
+        const std::vector<detail::SharedFixtureEntry*>& fixtures =
+            _suiteFixtures[_plan[i]];
+        for (size_t f = 0; f < fixtures.size(); ++f)
+            ++plannedUsers[fixtures[f]];
+    }
+
+    for (size_t e = 0; e < entries.size(); ++e)
+        entries[e]->beginRun(plannedUsers[entries[e]],
+                declared.count(entries[e]) > 0);
+}
+
+void Controller::endSharedFixtureUse(const SuiteDescriptor& testSuite)
+{
+    const size_t index = &testSuite - &_testSuites[0];
+    if (index >= _suiteFixtures.size())
+        return;
+
+    const std::vector<detail::SharedFixtureEntry*>& fixtures =
+        _suiteFixtures[index];
+    for (size_t i = 0; i < fixtures.size(); ++i)
+        fixtures[i]->userFinished();
+}
+
+void Controller::endSharedFixtures()
+{
+    std::vector<detail::SharedFixtureEntry*> entries;
+    detail::sharedFixtureEntries(entries);
+
+    for (size_t e = 0; e < entries.size(); ++e)
+        entries[e]->endRun();
+}
+
+} // namespace
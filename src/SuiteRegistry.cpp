@@ -0,0 +1,48 @@
+#include <testcpp/detail/SuiteRegistry.h>
+
+#ifdef TESTCPP_HAVE_SUITE_SECTION
+
+// weak, so that binaries without registered suites link as well
+extern "C" {
+    extern const Test::SuiteDescriptor* const __start_testcpp_suites[]
+        __attribute__((weak, visibility("hidden")));
+    extern const Test::SuiteDescriptor* const __stop_testcpp_suites[]
+        __attribute__((weak, visibility("hidden")));
+}
+
+#endif
+
+namespace Test
+{
+
+namespace detail
+{
+
+#ifdef TESTCPP_HAVE_SUITE_SECTION
+
+void collectRegisteredSuites(std::vector<const SuiteDescriptor*>& suites)
+{
+    if (!__start_testcpp_suites)
+        return;
+
+    for (const SuiteDescriptor* const* entry = __start_testcpp_suites;
+            entry != __stop_testcpp_suites; ++entry)
+        suites.push_back(*entry);
+}
+
+#else
+
+SuiteRegistration* SuiteRegistrar::_head = 0;
+
+void collectRegisteredSuites(std::vector<const SuiteDescriptor*>& suites)
+{
+    for (const SuiteRegistration* registration = SuiteRegistrar::head();
+            registration; registration = registration->next)
+        suites.push_back(registration->descriptor);
+}
+
+#endif
+
+}
+
+} // namespace
@@ -0,0 +1,223 @@
+#include <testcpp/TimingObserver.h>
+#include <testcpp/detail/Clock.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+namespace Test
+{
+
+namespace
+{
+
+bool slowerWall(const TimingObserver::SuiteTiming& a,
+        const TimingObserver::SuiteTiming& b)
+{ return a.stats.wallSeconds > b.stats.wallSeconds; }
+
+bool slowerAssert(const TimingObserver::AssertTiming& a,
+        const TimingObserver::AssertTiming& b)
+{ return a.seconds > b.seconds; }
+
+std::string location(const AssertSite& site)
+{
+    std::ostringstream out;
+    out << (site.file ? site.file : "") << ":" << site.line;
+    if (site.label && *site.label)
+        out << " '" << site.label << "'";
+    return out.str();
+}
+
+const AssertSite emptySite = { 0, 0, 0, 0, 0 };
+
+}
+
+TimingObserver::TimingObserver(Observer* observer, size_t slowestCount,
+        bool timeAssertions, std::ostream& out) :
+    ForwardingObserver(observer),
+    _slowestCount(slowestCount),
+    _timeAssertions(timeAssertions),
+    _out(out),
+    _currentSuiteLabel(),
+    _suiteTimings(),
+    _currentSite(emptySite),
+    _assertStart(0),
+    _slowestAssertions()
+{ }
+
+TimingObserver::TimingObserver(Observer& observer, size_t slowestCount,
+        bool timeAssertions, std::ostream& out) :
+    ForwardingObserver(observer),
+    _slowestCount(slowestCount),
+    _timeAssertions(timeAssertions),
+    _out(out),
+    _currentSuiteLabel(),
+    _suiteTimings(),
+    _currentSite(emptySite),
+    _assertStart(0),
+    _slowestAssertions()
+{ }
+
+void TimingObserver::writeDurations(const std::string& path) const
+{
+    std::ofstream out(path.c_str(), std::ios::out | std::ios::trunc);
+    out << std::fixed << std::setprecision(6);
+
+    for (size_t i = 0; i < _suiteTimings.size(); ++i)
+        out << _suiteTimings[i].label << "\t"
+            << _suiteTimings[i].stats.wallSeconds << "\n";
+
+    if (!out.flush())
+        throw std::runtime_error("Cannot write suite durations to '" + path + "'");
+}
+
+void TimingObserver::onTestSuiteBegin(const std::string& testSuiteLabel,
+        int testSuiteNum, int testSuitesNumTotal)
+{
+    _currentSuiteLabel = testSuiteLabel;
+    ForwardingObserver::onTestSuiteBegin(testSuiteLabel,
+            testSuiteNum, testSuitesNumTotal);
+}
+
+void TimingObserver::onTestSuiteStats(const TestSuiteStats& stats)
+{
+    SuiteTiming timing;
+    timing.label = _currentSuiteLabel;
+    timing.stats = stats;
+    _suiteTimings.push_back(timing);
+
+    ForwardingObserver::onTestSuiteStats(stats);
+}
+
+void TimingObserver::onAssertBegin(const AssertSite& site)
+{
+    ForwardingObserver::onAssertBegin(site);
+
+    if (_timeAssertions) {
+        _currentSite = site;
+        // read the clock last to leave the forwarding out of the measurement
+        _assertStart = detail::monotonicSeconds();
+    }
+}
+
+void TimingObserver::onAssertEnd(bool ok)
+{
+    assertEnded();
+    ForwardingObserver::onAssertEnd(ok);
+}
+
+void TimingObserver::onAssertExceptionEndWithExpectedException(const std::exception& e)
+{
+    assertEnded();
+    ForwardingObserver::onAssertExceptionEndWithExpectedException(e);
+}
+
+void TimingObserver::onAssertExceptionEndWithUnexpectedException(const std::exception& e)
+{
+    assertEnded();
+    ForwardingObserver::onAssertExceptionEndWithUnexpectedException(e);
+}
+
+void TimingObserver::onAssertExceptionEndWithEllipsisException()
+{
+    assertEnded();
+    ForwardingObserver::onAssertExceptionEndWithEllipsisException();
+}
+
+void TimingObserver::onAssertNoExceptionEndWithStdException(const std::exception& e)
+{
+    assertEnded();
+    ForwardingObserver::onAssertNoExceptionEndWithStdException(e);
+}
+
+void TimingObserver::onAssertNoExceptionEndWithEllipsisException()
+{
+    assertEnded();
+    ForwardingObserver::onAssertNoExceptionEndWithEllipsisException();
+}
+
+void TimingObserver::onAllTestSuitesEnd(int lastTestSuiteNum,
+        int testSuitesNumTotal, int numErrs, int numExcepts)
+{
+    printSummary();
+    ForwardingObserver::onAllTestSuitesEnd(lastTestSuiteNum,
+            testSuitesNumTotal, numErrs, numExcepts);
+}
+
+void TimingObserver::assertEnded()
+{
+    if (!_timeAssertions || _slowestCount == 0)
+        return;
+
+    const double seconds = detail::monotonicSeconds() - _assertStart;
+
+    // keep only the slowest assertions so that memory use stays bounded,
+    // strings are copied only for assertions that make it into the list
+    if (_slowestAssertions.size() == _slowestCount
+            && seconds <= _slowestAssertions.back().seconds)
+        return;
+
+    AssertTiming timing;
+    timing.location = location(_currentSite);
+    timing.assertType = _currentSite.assertType ? _currentSite.assertType : "";
+    timing.seconds = seconds;
+
+    std::vector<AssertTiming>::iterator pos = std::upper_bound(
+            _slowestAssertions.begin(), _slowestAssertions.end(),
+            timing, slowerAssert);
+    _slowestAssertions.insert(pos, timing);
+
+    if (_slowestAssertions.size() > _slowestCount)
+        _slowestAssertions.pop_back();
+}
+
+void TimingObserver::printSummary()
+{
+    if (_slowestCount == 0 || _suiteTimings.empty())
+        return;
+
+    std::vector<SuiteTiming> sorted(_suiteTimings);
+    std::stable_sort(sorted.begin(), sorted.end(), slowerWall);
+    if (sorted.size() > _slowestCount)
+        sorted.resize(_slowestCount);
+
+    double totalWall = 0;
+    double totalCpu = 0;
+    for (size_t i = 0; i < _suiteTimings.size(); ++i) {
+        totalWall += _suiteTimings[i].stats.wallSeconds;
+        totalCpu += _suiteTimings[i].stats.cpuSeconds;
+    }
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+
+    out << "Slowest " << sorted.size() << " of " << _suiteTimings.size()
+        << " test suites (" << totalWall << " s wall, "
+        << totalCpu << " s CPU in total):" << std::endl;
+
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        const TestSuiteStats& stats = sorted[i].stats;
+        out << "\t" << std::setw(9) << stats.wallSeconds << " s wall"
+            << std::setw(9) << stats.cpuSeconds << " s CPU";
+        if (stats.peakResidentSetKilobytes > 0)
+            out << std::setw(9) << stats.peakResidentSetKilobytes << " KB peak RSS";
+        out << "\t" << sorted[i].label << std::endl;
+    }
+
+    if (!_slowestAssertions.empty()) {
+        out << "Slowest " << _slowestAssertions.size()
+            << " assertions:" << std::endl;
+
+        for (size_t i = 0; i < _slowestAssertions.size(); ++i) {
+            const AssertTiming& timing = _slowestAssertions[i];
+            out << "\t" << std::setw(12) << 1e6 * timing.seconds << " us\t"
+                << timing.assertType << " at " << timing.location << std::endl;
+        }
+    }
+
+    _out << out.str();
+    _out.flush();
+}
+
+} // namespace
@@ -0,0 +1,398 @@
+#include <testcpp/detail/Watchdog.h>
+#include <testcpp/detail/Clock.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+#if defined(__GLIBC__) || defined(__APPLE__)
+  #define TESTCPP_HAVE_BACKTRACE
+  #include <execinfo.h>
+#endif
+
+#ifdef TESTCPP_HAVE_THREADS
+  #include <algorithm>
+  #include <atomic>
+  #include <chrono>
+  #include <condition_variable>
+  #include <map>
+  #include <mutex>
+  #include <thread>
+  #include <vector>
+
+  #ifndef _WIN32
+    #include <pthread.h>
+    #include <signal.h>
+    #include <string.h>
+    #include <unistd.h>
+  #endif
+#endif
+
+namespace Test
+{
+
+namespace detail
+{
+
+RecordedException timeoutException(const std::string& reason,
+        const char* lastAssertFile, int lastAssertLine)
+{
+    std::ostringstream msg;
+    msg << reason;
+    if (lastAssertFile)
+        msg << ", the last assertion began at "
+            << lastAssertFile << "(" << lastAssertLine << ")";
+    else
+        msg << " before any assertion began";
+    return RecordedException("timeout", msg.str());
+}
+
+std::string timeoutReason(const char* what, double seconds)
+{
+    std::ostringstream reason;
+    reason << what << " timed out after " << seconds << " seconds";
+    return reason.str();
+}
+
+void prepareStackTrace()
+{
+#ifdef TESTCPP_HAVE_BACKTRACE
+    // the first call loads the unwinder, which may allocate
+    void* frame;
+    backtrace(&frame, 1);
+#endif
+}
+
+void writeStackTrace(int fd)
+{
+#ifdef TESTCPP_HAVE_BACKTRACE
+    void* frames[64];
+    const int depth = backtrace(frames, sizeof(frames) / sizeof(frames[0]));
+    backtrace_symbols_fd(frames, depth, fd);
+#else
+    (void)fd;
+#endif
+}
+
+}
+
+#ifdef TESTCPP_HAVE_THREADS
+
+namespace
+{
+
+#if defined(TESTCPP_HAVE_BACKTRACE) && !defined(_WIN32)
+
+std::atomic<bool> stackWritten(false);
+
+extern "C" void writeStackOnSignal(int)
+{
+    detail::writeStackTrace(STDERR_FILENO);
+    stackWritten.store(true);
+
+    // keep the hung thread from running on while the run is reported
+    for (;;)
+        pause();
+}
+
+#endif
+
+}
+
+/**
+ * Watches the suites that run in this process from a thread of its own.
+ * A hung suite cannot be stopped, so on expiry the watchdog reports the
+ * results so far and exits the process.
+ */
+class Controller::Watchdog
+{
+    UTILCPP_DISABLE_COPY(Watchdog)
+
+public:
+    explicit Watchdog(Controller& controller) :
+        _controller(controller),
+        _runDeadline(controller._runDeadline),
+        _lock(),
+        _wakeup(),
+        _stop(false),
+        _nextId(0),
+        _suites(),
+        _thread()
+    {
+        detail::prepareStackTrace();
+        _thread = std::thread(&Watchdog::run, this);
+    }
+
+    ~Watchdog()
+    {
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            _stop = true;
+        }
+        _wakeup.notify_one();
+        _thread.join();
+    }
+
+    size_t watch(const SuiteDescriptor& testSuite, int testSuiteNum,
+            int testSuitesNumTotal, AssertionContext& context)
+    {
+        WatchedSuite suite;
+        suite.label = testSuite.label;
+        suite.testSuiteNum = testSuiteNum;
+        suite.testSuitesNumTotal = testSuitesNumTotal;
+        suite.context = &context;
+        suite.start = detail::monotonicSeconds();
+#ifndef _WIN32
+        suite.thread = pthread_self();
+#endif
+
+        std::lock_guard<std::mutex> guard(_lock);
+        _suites[_nextId] = suite;
+        _wakeup.notify_one();
+        return _nextId++;
+    }
+
+    void unwatch(size_t id)
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _suites.erase(id);
+    }
+
+private:
+    struct WatchedSuite
+    {
+        const char* label;
+        int testSuiteNum;
+        int testSuitesNumTotal;
+        AssertionContext* context;
+        double start;
+#ifndef _WIN32
+        pthread_t thread;
+#endif
+    };
+
+    typedef std::map<size_t, WatchedSuite> WatchedSuites;
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+
+        while (!_stop) {
+            const double now = detail::monotonicSeconds();
+            const double suiteTimeout = _controller._testSuiteTimeout;
+            double next = now + 1;
+
+            if (_runDeadline > 0) {
+                if (now >= _runDeadline) {
+                    std::vector<WatchedSuite> hung;
+                    for (WatchedSuites::const_iterator i = _suites.begin();
+                            i != _suites.end(); ++i)
+                        hung.push_back(i->second);
+                    expire(hung, detail::timeoutReason("Test run",
+                                _controller._runTimeout));
+                }
+                next = std::min(next, _runDeadline);
+            }
+
+            if (suiteTimeout > 0) {
+                for (WatchedSuites::const_iterator i = _suites.begin();
+                        i != _suites.end(); ++i) {
+                    const double deadline = i->second.start + suiteTimeout;
+                    if (now >= deadline)
+                        expire(std::vector<WatchedSuite>(1, i->second),
+                                detail::timeoutReason("Test suite", suiteTimeout));
+                    next = std::min(next, deadline);
+                }
+            }
+
+            _wakeup.wait_for(lock, std::chrono::duration<double>(next - now));
+        }
+    }
+
+    /**
+     * Reports the hung suites and the run so far, does not return. The
+     * hung threads are stopped by writeStacks(), the controller thread by
+     * the run state lock when it next reports or updates the results. If
+     * an observer call holds the lock for long, only a notice is written
+     * to standard error.
+     */
+    void expire(const std::vector<WatchedSuite>& hung, const std::string& reason)
+    {
+        writeStacks(hung);
+
+        // give up on the lock if a hung suite holds it in an observer
+        std::unique_lock<std::mutex> observerLock(_controller._observerLock,
+                std::defer_lock);
+        for (int i = 0; i < 100 && !observerLock.try_lock(); ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        // the observer and the results may be in use, so they are left alone
+        if (!observerLock.owns_lock()) {
+            std::cerr << reason << ", the results cannot be reported as an "
+                "observer call did not return" << std::endl;
+            for (size_t i = 0; i < hung.size(); ++i)
+                std::cerr << "Test suite '" << hung[i].label << "' did not end"
+                          << std::endl;
+            exitProcess();
+        }
+
+        Observer& observer = *_controller._observer;
+        int numErrs = _controller._allTestErrs;
+        int numExcepts = _controller._allTestExcepts;
+        int lastTestSuiteNum = _controller._curTestSuite;
+        const double now = detail::monotonicSeconds();
+
+        // the run expired between suites or in a benchmark
+        if (hung.empty()) {
+            std::cerr << reason << std::endl;
+            ++numExcepts;
+        }
+
+        for (size_t i = 0; i < hung.size(); ++i) {
+            const WatchedSuite& suite = hung[i];
+            AssertionContext& context = *suite.context;
+
+            // events of parallel suites are recorded until the suite ends
+            if (&context.observer() != &observer)
+                observer.onTestSuiteBegin(suite.label,
+                        suite.testSuiteNum, suite.testSuitesNumTotal);
+
+            TestSuiteStats stats;
+            stats.wallSeconds = now - suite.start;
+            stats.peakResidentSetKilobytes = detail::peakResidentSetKilobytes();
+            observer.onTestSuiteStats(stats);
+
+            observer.onTestSuiteEndWithStdException(context.errs(),
+                    detail::timeoutException(reason,
+                        context.lastAssertFile(), context.lastAssertLine()));
+
+            numErrs += context.errs();
+            ++numExcepts;
+            lastTestSuiteNum = std::max(lastTestSuiteNum, suite.testSuiteNum);
+
+            _controller.recordTestSuiteResult(suite.label, true, stats.wallSeconds);
+        }
+
+        _controller.saveHistory();
+
+        observer.onAllTestSuitesEnd(lastTestSuiteNum,
+                static_cast<int>(_controller._plan.size()), numErrs, numExcepts);
+
+        exitProcess();
+    }
+
+    static void exitProcess()
+    {
+        std::cout.flush();
+        std::cerr.flush();
+        std::fflush(0);
+
+        // destructors and exit handlers might wait for the hung suite; the
+        // error count would be truncated to 8 bits in the exit status
+        std::_Exit(EXIT_FAILURE);
+    }
+
+    /**
+     * Makes each hung thread write its stack to standard error and stop
+     * until the process exits.
+     */
+    void writeStacks(const std::vector<WatchedSuite>& hung)
+    {
+#if defined(TESTCPP_HAVE_BACKTRACE) && !defined(_WIN32)
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = writeStackOnSignal;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGQUIT, &action, 0);
+
+        for (size_t i = 0; i < hung.size(); ++i) {
+            // async test cases share the thread that is already stopped
+            bool stopped = false;
+            for (size_t j = 0; j < i && !stopped; ++j)
+                stopped = pthread_equal(hung[j].thread, hung[i].thread) != 0;
+            if (stopped)
+                continue;
+
+            std::cerr << "Stack of test suite '" << hung[i].label << "':"
+                      << std::endl;
+
+            stackWritten.store(false);
+            if (pthread_kill(hung[i].thread, SIGQUIT) != 0)
+                continue;
+
+            // the thread may block the signal
+            for (int wait = 0; wait < 100 && !stackWritten.load(); ++wait)
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+#else
+        (void)hung;
+#endif
+    }
+
+    Controller& _controller;
+    const double _runDeadline;
+
+    std::mutex _lock;
+    std::condition_variable _wakeup;
+    bool _stop;
+    size_t _nextId;
+    WatchedSuites _suites;
+
+    std::thread _thread;
+};
+
+#endif
+
+Controller::WatchedTestSuiteScope::WatchedTestSuiteScope(Watchdog* watchdog,
+        const SuiteDescriptor& testSuite, int testSuiteNum,
+        int testSuitesNumTotal, AssertionContext& context) :
+    _watchdog(watchdog),
+    _id(0)
+{
+#ifdef TESTCPP_HAVE_THREADS
+    if (_watchdog)
+        _id = _watchdog->watch(testSuite, testSuiteNum, testSuitesNumTotal, context);
+#else
+    (void)testSuite;
+    (void)testSuiteNum;
+    (void)testSuitesNumTotal;
+    (void)context;
+#endif
+}
+
+Controller::WatchedTestSuiteScope::~WatchedTestSuiteScope()
+{
+#ifdef TESTCPP_HAVE_THREADS
+    if (_watchdog)
+        _watchdog->unwatch(_id);
+#endif
+}
+
+void Controller::startWatchdog(ExecutionMode mode)
+{
+#ifdef TESTCPP_HAVE_THREADS
+  #ifndef _WIN32
+    // the parent process enforces the timeouts of isolated suites
+    if (mode == PROCESSES)
+        return;
+  #else
+    (void)mode;
+  #endif
+    if (_testSuiteTimeout > 0 || _runTimeout > 0)
+        _watchdog = new Watchdog(*this);
+#else
+    (void)mode;
+#endif
+}
+
+void Controller::stopWatchdog()
+{
+#ifdef TESTCPP_HAVE_THREADS
+    delete _watchdog;
+#endif
+    _watchdog = 0;
+}
+
+} // namespace
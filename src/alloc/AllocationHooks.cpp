@@ -0,0 +1,128 @@
+/**
+ * Replaces the global allocation functions to count the allocations of
+ * test suites, see AllocationStats. Built as the testcpp-alloc library,
+ * link it into the test program before testcpp.
+ */
+
+#include <testcpp/testcpp.h>
+
+#include <cstdlib>
+#include <new>
+
+#ifdef UTILCPP_HAVE_CPP11
+  #define TESTCPP_THROWS_BAD_ALLOC
+  #define TESTCPP_NOEXCEPT noexcept
+#else
+  #define TESTCPP_THROWS_BAD_ALLOC throw(std::bad_alloc)
+  #define TESTCPP_NOEXCEPT throw()
+#endif
+
+namespace
+{
+
+/** Precedes each block, keeps the block aligned like malloc() does. */
+union BlockHeader
+{
+    struct
+    {
+        size_t size;
+        bool counted;
+    } block;
+
+    // alignment only
+    long double longDouble;
+    long long longLong;
+    void* pointer;
+};
+
+void* allocate(size_t size)
+{
+    BlockHeader* header = static_cast<BlockHeader*>(
+            std::malloc(sizeof(BlockHeader) + size));
+    if (!header)
+        return 0;
+
+    header->block.size = size;
+    header->block.counted = Test::detail::countAllocation(size);
+    return header + 1;
+}
+
+void* allocateOrThrow(size_t size)
+{
+    for (;;) {
+        if (void* memory = allocate(size))
+            return memory;
+
+        // std::get_new_handler() is C++11
+        std::new_handler handler = std::set_new_handler(0);
+        std::set_new_handler(handler);
+        if (!handler)
+            throw std::bad_alloc();
+        handler();
+    }
+}
+
+void deallocate(void* memory)
+{
+    if (!memory)
+        return;
+
+    BlockHeader* header = static_cast<BlockHeader*>(memory) - 1;
+    if (header->block.counted)
+        Test::detail::countDeallocation(header->block.size);
+    std::free(header);
+}
+
+struct TrackingEnabler
+{
+    TrackingEnabler()
+    { Test::detail::allocationTrackingLinked = true; }
+};
+
+TrackingEnabler trackingEnabler;
+
+}
+
+void* operator new(std::size_t size) TESTCPP_THROWS_BAD_ALLOC
+{ return allocateOrThrow(size); }
+
+void* operator new[](std::size_t size) TESTCPP_THROWS_BAD_ALLOC
+{ return allocateOrThrow(size); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) TESTCPP_NOEXCEPT
+{
+    try {
+        return allocateOrThrow(size);
+    } catch (const std::bad_alloc&) {
+        return 0;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) TESTCPP_NOEXCEPT
+{
+    try {
+        return allocateOrThrow(size);
+    } catch (const std::bad_alloc&) {
+        return 0;
+    }
+}
+
+void operator delete(void* memory) TESTCPP_NOEXCEPT
+{ deallocate(memory); }
+
+void operator delete[](void* memory) TESTCPP_NOEXCEPT
+{ deallocate(memory); }
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void* memory, std::size_t) TESTCPP_NOEXCEPT
+{ deallocate(memory); }
+
+void operator delete[](void* memory, std::size_t) TESTCPP_NOEXCEPT
+{ deallocate(memory); }
+#endif
+
+void operator delete(void* memory, const std::nothrow_t&) TESTCPP_NOEXCEPT
+{ deallocate(memory); }
+
+void operator delete[](void* memory, const std::nothrow_t&) TESTCPP_NOEXCEPT
+{ deallocate(memory); }
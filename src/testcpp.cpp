@@ -1,18 +1,96 @@
 #include <testcpp/testcpp.h>
 #include <testcpp/StdOutView.h>
+#include <testcpp/AsyncTest.h>
+#include <testcpp/detail/EventRecorder.h>
+#include <testcpp/detail/Clock.h>
+
+#include <algorithm>
+#include <cstring>
 
 namespace Test
 {
 
+TESTCPP_THREAD_LOCAL AssertionContext* Controller::_currentContext = 0;
+
+namespace
+{
+
+bool labelLess(const SuiteDescriptor* a, const SuiteDescriptor* b)
+{ return std::strcmp(a->label, b->label) < 0; }
+
+}
+
+void AssertionContext::adopt(int errs, const std::string& events)
+{
+#ifdef TESTCPP_HAVE_THREADS
+    std::lock_guard<std::mutex> guard(_adoptedLock);
+#endif
+    _adoptedErrs += errs;
+    _adoptedEvents.push_back(events);
+}
+
+void AssertionContext::mergeAdopted()
+{
+#ifdef TESTCPP_HAVE_THREADS
+    std::lock_guard<std::mutex> guard(_adoptedLock);
+#endif
+    for (size_t i = 0; i < _adoptedEvents.size(); ++i)
+        EventRecorder::replay(_adoptedEvents[i], *_observer);
+
+    _errs += _adoptedErrs;
+    _adoptedErrs = 0;
+    _adoptedEvents.clear();
+}
+
 Controller::Controller() :
     _observer(new StdOutView),
     _doesOwnObserver(true),
-    _testSuiteFactories(),
+    _defaultContext(_observer),
+    _testSuites(),
+    _ownedLabels(),
+    _registeredSuitesAdded(false),
+    _benchmarks(),
+    _plan(),
+    _benchmarkPlan(),
+    _filters(),
+    _excludes(),
+    _shardIndex(0),
+    _shardCount(0),
+    _shardDurationsPath(),
+    _historyPath(),
+    _history(),
+    _results(),
+    _testSuiteOrder(REGISTRATION_ORDER),
+    _maxFailedTestSuites(0),
+    _failedTestSuites(0),
+    _testSuiteTimeout(0),
+    _runTimeout(0),
+    _runDeadline(0),
+    _watchdog(0),
+    _countPerformance(false),
+    _baselinePath(),
+    _updateBaseline(false),
+    _regressionThreshold(0.1),
+    _regressionDeviations(3),
+    _suiteTimings(),
+    _benchmarkTimings(),
+    _propertySeed(0),
+    _sharedFixtureUsers(),
+    _sharedFixtureSuites(),
+    _suiteFixtures(),
+    _groupBySharedFixture(false),
+    _asyncTestCaseConcurrency(64),
+#ifdef TESTCPP_HAVE_THREADS
+    _observerLock(),
+#endif
     _curTestSuite(0),
-    _curTestSuiteErrs(0),
     _allTestErrs(0),
     _allTestExcepts(0)
-{}
+{
+#ifdef TESTCPP_HAVE_THREADS
+    _defaultContext.shareBetweenThreads(_observerLock);
+#endif
+}
 
 Controller& Controller::instance()
 {
@@ -20,42 +98,221 @@ Controller& Controller::instance()
     return instance;
 }
 
-int Controller::run()
+int Controller::runTestSuites(ExecutionMode mode, unsigned concurrency)
 {
     _curTestSuite = 0;
-    size_t testSuiteCount = _testSuiteFactories.size();
+    _failedTestSuites = 0;
+    planTestSuites();
+    size_t testSuiteCount = _plan.size();
+
+    // errors of assertions outside of the run are not counted
+    _defaultContext.takeErrs();
+
+    // chosen before suites check properties in parallel
+    propertySeed();
+    beginSharedFixtures();
 
     _observer->onAllTestSuitesBegin(testSuiteCount);
 
-    typedef std::vector<LabelAndFactoryFunctionPair>::iterator TestSuiteFactoryIter;
+    _runDeadline = _runTimeout > 0 ? detail::monotonicSeconds() + _runTimeout : 0;
+    startWatchdog(mode);
 
-    for (TestSuiteFactoryIter i = _testSuiteFactories.begin(), end = _testSuiteFactories.end();
-            i != end; ++i) {
+    try {
+        switch (mode) {
+            case SEQUENTIAL:
+                runSequentially();
+                break;
+            case THREADS:
+                runInParallel(concurrency);
+                break;
+            case PROCESSES:
+                runInProcesses(concurrency);
+                break;
+        }
 
-        _curTestSuiteErrs = 0;
-        ++_curTestSuite;
+        runBenchmarks();
+    } catch (...) {
+        stopWatchdog();
+        endSharedFixtures();
+        throw;
+    }
 
-        _observer->onTestSuiteBegin(i->first, _curTestSuite, testSuiteCount);
+    stopWatchdog();
+    endSharedFixtures();
+    saveHistory();
+    checkBaseline();
 
-        try {
+    // from threads without a context that outlived the suites
+    _allTestErrs += _defaultContext.takeErrs();
+
+    _observer->onAllTestSuitesEnd(_curTestSuite, testSuiteCount, _allTestErrs, _allTestExcepts);
+
+    return _allTestErrs;
+}
+
+void Controller::addRegisteredSuites()
+{
+    if (_registeredSuitesAdded)
+        return;
+    _registeredSuitesAdded = true;
+
+    std::vector<const SuiteDescriptor*> registered;
+    detail::collectRegisteredSuites(registered);
+
+    // link order is arbitrary, sort for a stable run order
+    std::stable_sort(registered.begin(), registered.end(), labelLess);
+
+    for (size_t i = 0; i < registered.size(); ++i)
+        _testSuites.push_back(*registered[i]);
+}
+
+void Controller::planTestSuites()
+{
+    addRegisteredSuites();
+
+    _plan.clear();
+    for (size_t i = 0; i < _testSuites.size(); ++i)
+        _plan.push_back(i);
+    _benchmarkPlan.clear();
+    for (size_t i = 0; i < _benchmarks.size(); ++i)
+        _benchmarkPlan.push_back(i);
+
+    // filter first so that time balancing covers the selected suites only
+    selectFiltered();
+    selectShard();
+    orderByHistory();
+
+    mapSharedFixtures();
+    if (_groupBySharedFixture)
+        groupBySharedFixture();
+}
+
+std::vector<std::string> Controller::plannedTestSuiteLabels()
+{
+    planTestSuites();
+
+    std::vector<std::string> labels;
+    for (size_t i = 0; i < _plan.size(); ++i)
+        labels.push_back(_testSuites[_plan[i]].label);
+    return labels;
+}
+
+void Controller::runSequentially()
+{
+    size_t testSuiteCount = _plan.size();
+
+    for (size_t i = 0; i < testSuiteCount && !maxFailuresReached(); ++i) {
+
+        const SuiteDescriptor& testSuite = _testSuites[_plan[i]];
+
+#ifdef TESTCPP_HAVE_ASYNC_TESTS
+        if (detail::isAsyncTestCase(testSuite)) {
+            i = runAsyncTestCases(i) - 1;
+            continue;
+        }
+#endif
+
+        AssertionContext context(_observer);
+        const double start = detail::monotonicSeconds();
+
+        int testSuiteNum;
+        {
+            detail::SharedObserverLock lock(runStateLock());
+            testSuiteNum = ++_curTestSuite;
+        }
+
+        const bool endedWithException = runTestSuite(testSuite,
+                testSuiteNum, testSuiteCount, context);
+
+        detail::SharedObserverLock lock(runStateLock());
+        if (endedWithException)
+            ++_allTestExcepts;
+        _allTestErrs += context.errs();
+
+        recordTestSuiteResult(testSuite.label,
+                endedWithException || context.errs() > 0,
+                detail::monotonicSeconds() - start);
+    }
+}
+
+bool Controller::runTestSuite(const SuiteDescriptor& testSuite,
+        int testSuiteNum, int testSuitesNumTotal,
+        AssertionContext& context)
+{
+    Observer& observer = context.observer();
+    CurrentContextScope currentContextScope(context);
+    WatchedTestSuiteScope watchedScope(_watchdog, testSuite,
+            testSuiteNum, testSuitesNumTotal, context);
+
+    observer.onTestSuiteBegin(testSuite.label, testSuiteNum, testSuitesNumTotal);
+
+    SuiteStatsMeasurement measurement(_countPerformance);
+    bool endedWithException = false;
+
+    try {
+        {
             // create the test instance and take ownership
-            suite_scoped_ptr testsuite(i->second());
+            suite_scoped_ptr testsuite(testSuite.create());
             testsuite->test();
-            _observer->onTestSuiteEnd(_curTestSuiteErrs);
-        } catch (const std::exception &e) {
-            _observer->onTestSuiteEndWithStdException(_curTestSuiteErrs, e);
-            ++_allTestExcepts;
-        } catch (...) {
-            _observer->onTestSuiteEndWithEllipsisException(_curTestSuiteErrs);
-            ++_allTestExcepts;
         }
-
-        _allTestErrs += _curTestSuiteErrs;
+        // threads started by the suite have been joined by now
+        endTestSuite(context, measurement, false);
+        observer.onTestSuiteEnd(context.errs());
+    } catch (const std::exception &e) {
+        endTestSuite(context, measurement, true);
+        observer.onTestSuiteEndWithStdException(context.errs(), e);
+        endedWithException = true;
+    } catch (...) {
+        endTestSuite(context, measurement, true);
+        observer.onTestSuiteEndWithEllipsisException(context.errs());
+        endedWithException = true;
     }
 
-    _observer->onAllTestSuitesEnd(_curTestSuite, testSuiteCount, _allTestErrs, _allTestExcepts);
+    // fixtures are torn down outside of the suite's measurement
+    endSharedFixtureUse(testSuite);
 
-    return _allTestErrs;
+    return endedWithException;
+}
+
+Controller::SuiteStatsMeasurement::SuiteStatsMeasurement(bool countPerformance) :
+    _wallStart(detail::monotonicSeconds()),
+    _cpuStart(detail::threadCpuSeconds()),
+    _allocations(),
+    _counters(countPerformance)
+{ }
+
+TestSuiteStats Controller::SuiteStatsMeasurement::stop() const
+{
+    TestSuiteStats stats;
+    stats.wallSeconds = detail::monotonicSeconds() - _wallStart;
+    stats.cpuSeconds = detail::threadCpuSeconds() - _cpuStart;
+    stats.peakResidentSetKilobytes = detail::peakResidentSetKilobytes();
+    stats.counters = _counters.counters();
+    return stats;
+}
+
+void Controller::endTestSuite(AssertionContext& context,
+        const SuiteStatsMeasurement& measurement, bool endedWithException)
+{
+    const TestSuiteStats stats = measurement.stop();
+    AllocationStats allocations = measurement.allocations();
+    if (endedWithException) {
+        // the exception in flight holds memory that is not a leak
+        allocations.leakedAllocations = 0;
+        allocations.leakedBytes = 0;
+    }
+    adoptUnattributedErrs(context);
+    context.mergeAdopted();
+    context.observer().onTestSuiteStats(stats);
+    if (AllocationScope::trackingEnabled())
+        context.observer().onTestSuiteAllocations(allocations);
+}
+
+void Controller::adoptUnattributedErrs(AssertionContext& context)
+{
+    const int errs = _defaultContext.takeErrs();
+    if (errs)
+        context.adopt(errs, std::string());
 }
 
 } // namespace
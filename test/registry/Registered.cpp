@@ -0,0 +1,22 @@
+#include <testcpp/testcpp.h>
+
+// registered in the opposite order of their labels, and in another
+// translation unit than main(), to check that collection sorts them
+
+class ZetaTest : public Test::Suite
+{
+public:
+    void test()
+    { assertTrue("registered", true); }
+};
+
+TESTCPP_SUITE(ZetaTest)
+
+class AlphaTest : public Test::Suite
+{
+public:
+    void test()
+    { assertTrue("registered", true); }
+};
+
+TESTCPP_SUITE(AlphaTest)
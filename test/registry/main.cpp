@@ -0,0 +1,85 @@
+#include <testcpp/testcpp.h>
+#include <testcpp/StdOutView.h>
+#include <testcpp/detail/ForwardingObserver.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * Checks that suites registered with TESTCPP_SUITE are collected from all
+ * translation units, sorted by label and run after the suites added with
+ * Controller::addTestSuite(). The registered suites would run in every
+ * self test scenario, so they live in a program of their own.
+ */
+namespace
+{
+
+class AddedTest : public Test::Suite
+{
+public:
+    void test()
+    { assertTrue("added", true); }
+};
+
+class LabelledTest : public Test::Suite
+{
+public:
+    void test()
+    { assertTrue("registered", true); }
+};
+
+/** Remembers the order in which the suites began. */
+class OrderObserver : public Test::ForwardingObserver
+{
+public:
+    explicit OrderObserver(Test::Observer* observer) :
+        Test::ForwardingObserver(observer),
+        labels()
+    { }
+
+    virtual void onTestSuiteBegin(const std::string& testSuiteLabel,
+            int testSuiteNum, int testSuitesNumTotal)
+    {
+        labels.push_back(testSuiteLabel);
+        Test::ForwardingObserver::onTestSuiteBegin(testSuiteLabel,
+                testSuiteNum, testSuitesNumTotal);
+    }
+
+    std::vector<std::string> labels;
+};
+
+}
+
+TESTCPP_SUITE_LABELLED(LabelledTest, "MiddleTest")
+
+int main(int argc, char* argv[])
+{
+    Test::Controller& controller = Test::Controller::instance();
+
+    // added suites keep the order they were added in
+    controller.addTestSuite("added/second", Test::Suite::instance<AddedTest>);
+    controller.addTestSuite("added/first", Test::Suite::instance<AddedTest>);
+
+    OrderObserver* observer = new OrderObserver(new Test::ColoredStdOutView);
+    controller.setObserver(observer);
+
+    const int numErrs = controller.run(argc, argv);
+
+    const char* const expected[] = {
+        "added/second", "added/first", "AlphaTest", "MiddleTest", "ZetaTest"
+    };
+    const std::vector<std::string> expectedLabels(expected,
+            expected + sizeof(expected) / sizeof(expected[0]));
+
+    if (observer->labels != expectedLabels) {
+        std::cerr << "The suites ran in the wrong order:";
+        for (size_t i = 0; i < observer->labels.size(); ++i)
+            std::cerr << " " << observer->labels[i];
+        std::cerr << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return numErrs > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
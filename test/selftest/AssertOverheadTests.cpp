@@ -0,0 +1,164 @@
+#include "SelfTest.h"
+
+#include <testcpp/Benchmark.h>
+
+namespace
+{
+
+/** Counts assertion events, subscribed to the given events only. */
+class CountingObserver : public Test::Observer
+{
+public:
+    explicit CountingObserver(unsigned events) :
+        Test::Observer(),
+        begins(0),
+        passed(0),
+        failed(0),
+        _events(events)
+    { }
+
+    virtual unsigned subscribedEvents() const
+    { return _events; }
+
+    virtual void onTestSuiteBegin(const std::string&, int, int) { }
+    virtual void onTestSuiteEnd(int) { }
+    virtual void onTestSuiteEndWithStdException(int, const std::exception&) { }
+    virtual void onTestSuiteEndWithEllipsisException(int) { }
+
+    virtual void onAssertBegin(const Test::AssertSite&)
+    { ++begins; }
+
+    virtual void onAssertEnd(bool ok)
+    {
+        if (ok)
+            ++passed;
+        else
+            ++failed;
+    }
+
+    virtual void onAssertExceptionEndWithExpectedException(const std::exception&) { }
+    virtual void onAssertExceptionEndWithUnexpectedException(const std::exception&) { }
+    virtual void onAssertExceptionEndWithEllipsisException() { }
+    virtual void onAssertNoExceptionEndWithStdException(const std::exception&) { }
+    virtual void onAssertNoExceptionEndWithEllipsisException() { }
+
+    virtual void onAllTestSuitesBegin(int) { }
+    virtual void onAllTestSuitesEnd(int, int, int, int) { }
+
+    size_t begins;
+    size_t passed;
+    size_t failed;
+
+private:
+    unsigned _events;
+};
+
+/**
+ * Passing assertTrue calls in a context of their own, reported to a
+ * counting observer that subscribes to the given events.
+ */
+template <unsigned SubscribedEvents>
+class PassingAssertBenchmark : public Test::Benchmark
+{
+public:
+    PassingAssertBenchmark() :
+        _observer(SubscribedEvents),
+        _context(&_observer)
+    { }
+
+    virtual void benchmark(size_t iterations)
+    {
+        Test::Controller::CurrentContextScope scope(_context);
+        for (size_t i = 0; i < iterations; ++i) {
+            Test::doNotOptimize(i);
+            assertTrue(i < iterations);
+        }
+    }
+
+private:
+    CountingObserver _observer;
+    Test::AssertionContext _context;
+};
+
+/** The loop of PassingAssertBenchmark without the assertion. */
+class LoopBenchmark : public Test::Benchmark
+{
+public:
+    virtual void benchmark(size_t iterations)
+    {
+        for (size_t i = 0; i < iterations; ++i)
+            Test::doNotOptimize(i);
+    }
+};
+
+/** Events that the observer does not subscribe to are not dispatched. */
+class SubscribedEventsTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        CountingObserver all(Test::Observer::ALL_EVENTS);
+        assertTenTimes(all);
+        assertEqual(all.begins, 11u);
+        assertEqual(all.passed, 10u);
+        assertEqual(all.failed, 1u);
+
+        CountingObserver passedEnds(Test::Observer::PASSED_ASSERT_END_EVENTS);
+        assertTenTimes(passedEnds);
+        assertEqual(passedEnds.begins, 0u);
+        assertEqual(passedEnds.passed, 10u);
+        assertEqual(passedEnds.failed, 1u);
+
+        // ends of failed assertions are always dispatched
+        CountingObserver none(0);
+        assertTenTimes(none);
+        assertEqual(none.begins, 0u);
+        assertEqual(none.passed, 0u);
+        assertEqual(none.failed, 1u);
+    }
+
+private:
+    static void assertTenTimes(CountingObserver& observer)
+    {
+        Test::AssertionContext context(&observer);
+        Test::Controller::CurrentContextScope scope(context);
+        for (int i = 0; i < 10; ++i)
+            assertTrue(i < 10);
+        assertTrue("fails", false);
+    }
+};
+
+Test::BenchmarkOptions quickOptions()
+{
+    Test::BenchmarkOptions options;
+    options.warmupSeconds = 0.02;
+    options.minSampleSeconds = 0.002;
+    options.samples = 15;
+    return options;
+}
+
+}
+
+namespace SelfTest
+{
+
+void addAssertOverheadTests()
+{
+    Test::Controller& controller = Test::Controller::instance();
+    controller.addTestSuite("assert-overhead/subscribed-events",
+            Test::Suite::instance<SubscribedEventsTest>);
+
+    // the per-assert cost is the difference to the loop
+    controller.addBenchmark("assert-overhead/loop",
+            Test::Benchmark::instance<LoopBenchmark>, quickOptions());
+    controller.addBenchmark("assert-overhead/all-events",
+            Test::Benchmark::instance<PassingAssertBenchmark<
+                Test::Observer::ALL_EVENTS> >, quickOptions());
+    controller.addBenchmark("assert-overhead/passed-ends-only",
+            Test::Benchmark::instance<PassingAssertBenchmark<
+                Test::Observer::PASSED_ASSERT_END_EVENTS> >, quickOptions());
+    controller.addBenchmark("assert-overhead/no-events",
+            Test::Benchmark::instance<PassingAssertBenchmark<0> >, quickOptions());
+}
+
+}
@@ -0,0 +1,273 @@
+#include "SelfTest.h"
+
+#include <testcpp/ArrayAssertions.h>
+#include <testcpp/AssertBatch.h>
+#include <testcpp/Benchmark.h>
+
+#include <map>
+#include <vector>
+
+namespace
+{
+
+class BatchScenario : public Test::Suite
+{
+public:
+    void test()
+    {
+        std::vector<unsigned> values(1000);
+        for (unsigned i = 0; i < values.size(); ++i)
+            values[i] = i * 2;
+        values[100] = values[500] = values[600] = values[900] = 0;
+
+        Test::AssertBatch batch(3);
+        for (unsigned i = 0; i < values.size(); ++i) {
+            assertBatchEqual(batch, i, values[i], i * 2);
+            assertBatchTrue(batch, i, values[i] < 2000);
+        }
+    }
+};
+
+class ArrayScenario : public Test::Suite
+{
+public:
+    void test()
+    {
+        int expected[100];
+        int actual[100];
+        for (int i = 0; i < 100; ++i)
+            expected[i] = actual[i] = i;
+        assertArrayEqual("equal arrays", actual, expected, 100);
+
+        actual[17] = -1;
+        actual[42] = -2;
+        assertArrayEqual("different arrays", actual, expected, 100);
+
+        double close[50];
+        double reference[50];
+        for (int i = 0; i < 50; ++i) {
+            reference[i] = i / 3.0;
+            close[i] = reference[i] * (1 + 1e-9);
+        }
+        assertAllClose("close arrays", close, reference, 50,
+                Test::Tolerance::relativeError(1e-6));
+
+        close[49] += 1;
+        assertAllClose("distant arrays", close, reference, 50,
+                Test::Tolerance::relativeError(1e-6));
+    }
+};
+
+int* leakedInt = 0;
+
+class LeakingScenario : public Test::Suite
+{
+public:
+    void test()
+    {
+        leakedInt = new int(1);
+        Test::doNotOptimize(leakedInt);
+    }
+};
+
+class FreeingScenario : public Test::Suite
+{
+public:
+    void test()
+    {
+        std::vector<int> values(10);
+        Test::doNotOptimize(values);
+    }
+};
+
+class NoAllocationsScenario : public Test::Suite
+{
+public:
+    void test()
+    {
+        int sum = 0;
+        assertNoAllocations(for (int i = 0; i < 10; ++i) sum += i;);
+        Test::doNotOptimize(sum);
+
+        assertNoAllocations(std::vector<int> values(10); Test::doNotOptimize(values););
+    }
+};
+
+typedef std::map<std::string, std::vector<std::string> > SuiteEvents;
+
+/** The events of each suite, by label. */
+SuiteEvents suiteEvents(const SelfTest::ScenarioResult& result)
+{
+    SuiteEvents events;
+    std::vector<std::string>* current = 0;
+
+    for (size_t i = 0; i < result.lines.size(); ++i) {
+        const std::string& line = result.lines[i];
+        if (line.compare(0, 6, "begin ") == 0)
+            current = &events[line.substr(line.find(' ', 6) + 1)];
+        else if (current && line.compare(0, 5, "done ") != 0)
+            current->push_back(line);
+    }
+    return events;
+}
+
+bool isAllocations(const std::string& event)
+{ return event.compare(0, 12, "allocations ") == 0; }
+
+/** The events of a suite without the allocations, which vary by platform. */
+std::vector<std::string> withoutAllocations(const std::vector<std::string>& events)
+{
+    std::vector<std::string> found;
+    for (size_t i = 0; i < events.size(); ++i)
+        if (!isAllocations(events[i]))
+            found.push_back(events[i]);
+    return found;
+}
+
+/** The leaked allocations of a suite, reported right before it ends. */
+std::string leaked(const std::vector<std::string>& events)
+{
+    if (events.size() < 2 || !isAllocations(events[events.size() - 2]))
+        return "not reported";
+    const std::string& allocations = events[events.size() - 2];
+    return allocations.substr(allocations.rfind(' ') + 1);
+}
+
+class BatchAssertTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SuiteEvents events = suiteEvents(SelfTest::runScenario("assertions"));
+        const SuiteEvents::const_iterator batch = events.find("assertions/batch");
+        assertTrue("the batch suite ran", batch != events.end());
+        if (batch == events.end())
+            return;
+
+        // one assertion per call site, failed checks as details
+        const char* const expected[] = {
+            "failed values[i] == i * 2 for 1000 indices",
+            "detail 4 of 1000 failed, the first 3 follow",
+            "detail index 100, values: '0' and '200'",
+            "detail index 500, values: '0' and '1000'",
+            "detail index 600, values: '0' and '1200'"
+        };
+        std::vector<std::string> reported = withoutAllocations(batch->second);
+        assertTrue("the failed call site is reported once",
+                reported.size() == 6 && reported.back() == "end 1");
+        reported.pop_back();
+        assertTrue("the first failures are recorded",
+                reported == SelfTest::linesOf(expected));
+    }
+};
+
+class ArrayAssertTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult result = SelfTest::runScenario(
+                "assertions", "--filter=assertions/arrays");
+
+        const char* const failed[] = { "different arrays", "distant arrays" };
+        assertTrue("differing arrays fail", result.linesStartingWith("failed ")
+                == SelfTest::linesOf(failed));
+
+        const std::vector<std::string> details = result.linesStartingWith("detail ");
+        assertEqual(details.size(), 5u);
+        if (details.size() == 5) {
+            assertEqual(details[0], "2 of 100 elements differ");
+            assertEqual(details[1], "index 17, values: '-1' and '17'");
+            assertEqual(details[2], "index 42, values: '-2' and '42'");
+            assertEqual(details[3], "1 of 50 elements differ, max absolute error 1");
+        }
+        assertEqual(result.lineStartingWith("end "), "2");
+    }
+};
+
+class AllocationHooksTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        assertTrue("testcpp-alloc is linked", Test::AllocationScope::trackingEnabled());
+
+        const SuiteEvents events = suiteEvents(SelfTest::runScenario("assertions"));
+
+        const SuiteEvents::const_iterator leaking = events.find("assertions/leaking");
+        const SuiteEvents::const_iterator freeing = events.find("assertions/freeing");
+        const SuiteEvents::const_iterator none =
+            events.find("assertions/no-allocations");
+        assertTrue("the allocation suites ran", leaking != events.end()
+                && freeing != events.end() && none != events.end());
+        if (leaking == events.end() || freeing == events.end() || none == events.end())
+            return;
+
+        assertEqual(leaked(leaking->second), "1");
+        assertEqual(leaked(freeing->second), "0");
+        assertEqual(leaked(none->second), "0");
+
+        const char* const noAllocationsEvents[] = {
+            "failed std::vector<int> values(10); Test::doNotOptimize(values); "
+                "does not allocate",
+            "detail 1 allocations of 40 bytes",
+            "end 1"
+        };
+        assertTrue("allocating code fails assertNoAllocations",
+                withoutAllocations(none->second)
+                == SelfTest::linesOf(noAllocationsEvents));
+    }
+};
+
+/** The events of a suite do not depend on the thread or process it ran in. */
+class RunModeEventsTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SuiteEvents sequential = suiteEvents(SelfTest::runScenario("assertions"));
+        assertEqual(sequential.size(), 5u);
+
+#ifdef TESTCPP_HAVE_THREADS
+        assertTrue("parallel suites report the same events", sequential
+                == suiteEvents(SelfTest::runScenario("assertions", "--jobs=3")));
+#endif
+        assertTrue("isolated suites report the same events", sequential
+                == suiteEvents(SelfTest::runScenario("assertions", "--isolate")));
+    }
+};
+
+}
+
+namespace SelfTest
+{
+
+void addAssertionTests()
+{
+    Test::Controller& controller = Test::Controller::instance();
+    controller.addTestSuite("assertions/batch", Test::Suite::instance<BatchAssertTest>);
+    controller.addTestSuite("assertions/arrays", Test::Suite::instance<ArrayAssertTest>);
+    controller.addTestSuite("assertions/allocation-hooks",
+            Test::Suite::instance<AllocationHooksTest>);
+    controller.addTestSuite("assertions/run-modes",
+            Test::Suite::instance<RunModeEventsTest>);
+}
+
+bool addAssertionScenario(const std::string& scenario)
+{
+    if (scenario != "assertions")
+        return false;
+
+    Test::Controller& controller = Test::Controller::instance();
+    controller.addTestSuite("assertions/batch", Test::Suite::instance<BatchScenario>);
+    controller.addTestSuite("assertions/arrays", Test::Suite::instance<ArrayScenario>);
+    controller.addTestSuite("assertions/leaking",
+            Test::Suite::instance<LeakingScenario>);
+    controller.addTestSuite("assertions/freeing",
+            Test::Suite::instance<FreeingScenario>);
+    controller.addTestSuite("assertions/no-allocations",
+            Test::Suite::instance<NoAllocationsScenario>);
+    return true;
+}
+
+}
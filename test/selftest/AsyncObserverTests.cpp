@@ -0,0 +1,275 @@
+#include "SelfTest.h"
+
+#include <testcpp/AsyncObserver.h>
+
+#ifdef TESTCPP_HAVE_THREADS
+
+#include <testcpp/TestCases.h>
+#include <testcpp/detail/AllocationCounters.h>
+#include <testcpp/detail/ForwardingObserver.h>
+
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+
+const int PASSING_ASSERTIONS = 500;
+
+class AssertingSuite : public Test::Suite
+{
+public:
+    void test()
+    {
+        for (int i = 0; i < PASSING_ASSERTIONS; ++i)
+            assertTrue("passes", true);
+        assertTrue("fails", false);
+    }
+};
+
+class ExitingSuite : public Test::Suite
+{
+public:
+    void test()
+    { std::exit(3); }
+};
+
+/**
+ * Takes its time with every assertion and tells how many began and
+ * passed when a suite ends.
+ */
+class SlowObserver : public SelfTest::ScenarioObserver
+{
+public:
+    SlowObserver() :
+        SelfTest::ScenarioObserver(),
+        _begins(0),
+        _passes(0)
+    { }
+
+    virtual unsigned subscribedEvents() const
+    { return ALL_EVENTS; }
+
+    virtual void onAssertBegin(const Test::AssertSite& site)
+    {
+        ++_begins;
+        SelfTest::ScenarioObserver::onAssertBegin(site);
+    }
+
+    virtual void onAssertEnd(bool ok)
+    {
+        usleep(100);
+        if (ok)
+            ++_passes;
+        SelfTest::ScenarioObserver::onAssertEnd(ok);
+    }
+
+    virtual void onTestSuiteEnd(int numErrs)
+    {
+        std::cout << "begins " << _begins << " passes " << _passes << std::endl;
+        _begins = _passes = 0;
+        SelfTest::ScenarioObserver::onTestSuiteEnd(numErrs);
+    }
+
+private:
+    int _begins;
+    int _passes;
+};
+
+/** Tells what the adapter dropped once the run has ended. */
+class DroppedAssertionsObserver : public Test::ForwardingObserver
+{
+public:
+    explicit DroppedAssertionsObserver(Test::AsyncObserver* observer) :
+        Test::ForwardingObserver(observer),
+        _asyncObserver(*observer)
+    { }
+
+    virtual void onAllTestSuitesEnd(int lastTestSuiteNum,
+            int testSuitesNumTotal, int numErrs, int numExcepts)
+    {
+        Test::ForwardingObserver::onAllTestSuitesEnd(lastTestSuiteNum,
+                testSuitesNumTotal, numErrs, numExcepts);
+        std::cout << "dropped " << _asyncObserver.droppedAssertions() << std::endl;
+    }
+
+private:
+    Test::AsyncObserver& _asyncObserver;
+};
+
+void setAsyncObserver(Test::AsyncObserver::BackpressurePolicy policy)
+{
+    // a small ring fills up quickly
+    Test::Controller::instance().setObserver(new DroppedAssertionsObserver(
+                new Test::AsyncObserver(new SlowObserver, policy, 256)));
+}
+
+/** The begun and passed assertions of the suite, "" if not reported. */
+std::string assertions(const SelfTest::ScenarioResult& result)
+{ return result.lineStartingWith("begins "); }
+
+unsigned long dropped(const SelfTest::ScenarioResult& result)
+{ return std::strtoul(result.lineStartingWith("dropped ").c_str(), 0, 10); }
+
+class BlockTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult result =
+            SelfTest::runScenario("async-observer-block");
+
+        std::ostringstream all;
+        all << PASSING_ASSERTIONS + 1 << " passes " << PASSING_ASSERTIONS;
+        assertEqual("every assertion is delivered", assertions(result), all.str());
+        assertEqual(result.lineStartingWith("failed "), "fails");
+        assertEqual(dropped(result), 0ul);
+
+        // the run ends once the events are delivered
+        const std::vector<std::string>& lines = result.lines;
+        assertTrue("delivered before onAllTestSuitesEnd() returns",
+                lines.size() >= 2 && lines[lines.size() - 2] == "done 1/1 1 0"
+                && lines.back() == "dropped 0");
+    }
+};
+
+class DropPassingTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult result =
+            SelfTest::runScenario("async-observer-drop");
+
+        // passing assertions are dropped as a whole, begin and end
+        std::istringstream counts(assertions(result));
+        std::string word;
+        int begins = 0;
+        int passes = 0;
+        counts >> begins >> word >> passes;
+        assertEqual("the failed assertion is delivered", begins, passes + 1);
+        assertTrue("passing assertions are dropped", passes < PASSING_ASSERTIONS);
+        assertEqual("every dropped assertion is counted",
+                passes + dropped(result),
+                static_cast<unsigned long>(PASSING_ASSERTIONS));
+
+        assertEqual(result.lineStartingWith("failed "), "fails");
+        assertEqual(result.lineStartingWith("end "), "1");
+        assertEqual(result.lineStartingWith("done "), "1/1 1 0");
+    }
+};
+
+class IsolatedExitTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult result = SelfTest::runScenario(
+                "async-observer-exit", "--isolate --jobs=1");
+        assertTrue("the exiting worker ends", result.wallSeconds < 5);
+        assertEqual(result.lineStartingWith("done "), "2/2 1 1");
+        assertEqual(result.linesStartingWith("all ").size(), 1u);
+    }
+};
+
+class ForkedCopyTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        // the thread of the adapter frees what it was started with
+        Test::detail::UntrackedAllocations untracked;
+
+        Test::AsyncObserver observer(new SlowObserver);
+        const Test::AssertSite site = Test::assertSite("assertTrue", "passes",
+                __FUNCTION__, __FILE__, __LINE__);
+        for (int i = 0; i < PASSING_ASSERTIONS; ++i) {
+            observer.onAssertBegin(site);
+            observer.onAssertEnd(true);
+        }
+
+        // the copy of the adapter in the child has no thread to deliver the
+        // events that are still in the ring
+        const pid_t child = fork();
+        if (child == 0) {
+            observer.~AsyncObserver();
+            _exit(0);
+        }
+        assertTrue("forked", child > 0);
+        if (child < 0)
+            return;
+
+        int status = 0;
+        bool ended = false;
+        for (int i = 0; i < 500 && !ended; ++i) {
+            ended = waitpid(child, &status, WNOHANG) == child;
+            if (!ended)
+                usleep(10000);
+        }
+        if (!ended) {
+            kill(child, SIGKILL);
+            waitpid(child, &status, 0);
+        }
+        assertTrue("the copy is destroyed without waiting", ended);
+    }
+};
+
+}
+
+namespace SelfTest
+{
+
+void addAsyncObserverTests()
+{
+    Test::Controller& controller = Test::Controller::instance();
+    controller.addTestSuite("async-observer/block", Test::Suite::instance<BlockTest>);
+    controller.addTestSuite("async-observer/drop-passing",
+            Test::Suite::instance<DropPassingTest>);
+    controller.addTestSuite("async-observer/isolated-exit",
+            Test::Suite::instance<IsolatedExitTest>);
+    controller.addTestSuite("async-observer/forked-copy",
+            Test::Suite::instance<ForkedCopyTest>);
+}
+
+bool addAsyncObserverScenario(const std::string& scenario)
+{
+    Test::Controller& controller = Test::Controller::instance();
+
+    if (scenario == "async-observer-block") {
+        controller.addTestSuite("asserting", Test::Suite::instance<AssertingSuite>);
+        setAsyncObserver(Test::AsyncObserver::BLOCK);
+    } else if (scenario == "async-observer-drop") {
+        controller.addTestSuite("asserting", Test::Suite::instance<AssertingSuite>);
+        setAsyncObserver(Test::AsyncObserver::DROP_PASSING_EVENTS);
+    } else if (scenario == "async-observer-exit") {
+        controller.addTestSuite("exiting", Test::Suite::instance<ExitingSuite>);
+        controller.addTestSuite("asserting", Test::Suite::instance<AssertingSuite>);
+        setAsyncObserver(Test::AsyncObserver::BLOCK);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+}
+
+#else
+
+namespace SelfTest
+{
+
+// the adapter needs C++11 threads
+void addAsyncObserverTests()
+{ }
+
+bool addAsyncObserverScenario(const std::string&)
+{ return false; }
+
+}
+
+#endif
@@ -0,0 +1,325 @@
+#include "SelfTest.h"
+
+#include <testcpp/AsyncTest.h>
+
+#ifdef TESTCPP_HAVE_ASYNC_TESTS
+
+#include <coroutine>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+
+class SleepingCases
+{
+public:
+    Test::AsyncTask testSlow()
+    { co_await Test::sleepFor(0.3); }
+
+    Test::AsyncTask testMedium()
+    {
+        co_await Test::sleepFor(0.2);
+        assertTrue("medium case failed", false);
+    }
+
+    Test::AsyncTask testFast()
+    {
+        co_await Test::sleepFor(0.1);
+        throw std::runtime_error("fast case failed");
+    }
+
+    Test::AsyncTask testStuck()
+    { co_await std::suspend_always(); }
+};
+
+const Test::AsyncTestCase<SleepingCases> sleepingCases[] = {
+    { "slow", &SleepingCases::testSlow },
+    { "medium", &SleepingCases::testMedium },
+    { "fast", &SleepingCases::testFast }
+};
+
+const Test::AsyncTestCase<SleepingCases> stuckCases[] = {
+    { "stuck", &SleepingCases::testStuck },
+    { "fast", &SleepingCases::testFast }
+};
+
+class CountedFixture
+{
+public:
+    ~CountedFixture()
+    { std::cout << "fixture destroyed" << std::endl; }
+
+    Test::AsyncTask testSleep()
+    { co_await Test::sleepFor(0.01); }
+};
+
+const Test::AsyncTestCase<CountedFixture> sharedFixtureCases[] = {
+    { "first", &CountedFixture::testSleep },
+    { "second", &CountedFixture::testSleep },
+    { "third", &CountedFixture::testSleep }
+};
+
+/** Waits for the descriptors of a socket pair and a regular file. */
+class FdCases
+{
+public:
+    FdCases() :
+        _file(-1)
+    {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, _sockets) != 0)
+            throw std::runtime_error("Cannot create a socket pair");
+
+        char name[] = "/tmp/testcpp-selftest-XXXXXX";
+        _file = mkstemp(name);
+        if (_file < 0)
+            throw std::runtime_error("Cannot create a temporary file");
+        unlink(name);
+    }
+
+    ~FdCases()
+    {
+        close(_file);
+        close(_sockets[0]);
+        if (_sockets[1] >= 0)
+            close(_sockets[1]);
+    }
+
+    Test::AsyncTask testRegularFile()
+    {
+        assertTrue("a regular file is readable", co_await Test::readable(_file));
+        assertTrue("a regular file is writable", co_await Test::writable(_file));
+    }
+
+    Test::AsyncTask testSocket()
+    {
+        assertTrue("an idle socket is writable",
+                co_await Test::writable(_sockets[0], 1.0));
+        assertEqual(write(_sockets[1], "ping", 4), 4);
+        assertTrue("a socket with data is readable",
+                co_await Test::readable(_sockets[0], 1.0));
+
+        char data[4];
+        assertEqual(read(_sockets[0], data, sizeof(data)), 4);
+    }
+
+    Test::AsyncTask testTimeout()
+    {
+        const double start = Test::detail::monotonicSeconds();
+        assertTrue("the timeout expires first",
+                !co_await Test::readable(_sockets[0], 0.05));
+        assertTrue("after the timeout",
+                Test::detail::monotonicSeconds() - start >= 0.05);
+    }
+
+    Test::AsyncTask testHangup()
+    {
+        close(_sockets[1]);
+        _sockets[1] = -1;
+        assertTrue("a hangup wakes the reader",
+                co_await Test::readable(_sockets[0], 1.0));
+    }
+
+    Test::AsyncTask testWaitingReader()
+    {
+        assertTrue("nothing arrives",
+                !co_await Test::readable(_sockets[0], 0.1));
+    }
+
+    Test::AsyncTask testBusyReader()
+    {
+        // starts while the case before waits on the shared socket
+        try {
+            co_await Test::readable(_sockets[0]);
+            assertTrue("a second reader throws", false);
+        } catch (const std::runtime_error& e) {
+            const std::string what = e.what();
+            assertTrue("the descriptor is busy", what.find(
+                        "Another coroutine waits for file descriptor") == 0);
+        }
+    }
+
+private:
+    int _sockets[2];
+    int _file;
+};
+
+const Test::AsyncTestCase<FdCases> fdCases[] = {
+    { "regular-file", &FdCases::testRegularFile },
+    { "socket", &FdCases::testSocket },
+    { "timeout", &FdCases::testTimeout },
+    { "hangup", &FdCases::testHangup }
+};
+
+const Test::AsyncTestCase<FdCases> busyFdCases[] = {
+    { "waiting", &FdCases::testWaitingReader },
+    { "busy", &FdCases::testBusyReader }
+};
+
+class AsyncPlanOrderTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult result = SelfTest::runScenario("async-sleeping");
+
+        const std::vector<std::string> begins = result.linesStartingWith("begin ");
+        assertEqual(begins.size(), 3u);
+        if (begins.size() == 3) {
+            assertEqual(begins[0], "1/3 sleeping/slow");
+            assertEqual(begins[1], "2/3 sleeping/medium");
+            assertEqual(begins[2], "3/3 sleeping/fast");
+        }
+
+        // each case is reported as a block, in plan order
+        const std::vector<std::string>& lines = result.lines;
+        assertEqual(lines.size(), 9u);
+        if (lines.size() == 9) {
+            assertEqual(lines[2], "end 0");
+            assertEqual(lines[4], "failed medium case failed");
+            assertEqual(lines[5], "end 1");
+            assertEqual(lines[7], "exception 0 fast case failed");
+        }
+        assertEqual(result.lineStartingWith("done "), "3/3 1 1");
+    }
+};
+
+class AsyncOverlapTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult together = SelfTest::runScenario("async-sleeping");
+        assertTrue("cases wait together", together.wallSeconds < 0.55);
+
+        const SelfTest::ScenarioResult limited =
+            SelfTest::runScenario("async-sleeping", "--async-cases=1");
+        assertTrue("one case at a time", limited.wallSeconds >= 0.6);
+        assertEqual(limited.lineStartingWith("done "), "3/3 1 1");
+    }
+};
+
+class AsyncParallelTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult result =
+            SelfTest::runScenario("async-sleeping", "--jobs=2");
+        assertEqual(result.linesStartingWith("begin ").size(), 3u);
+        assertEqual(result.lineStartingWith("done "), "3/3 1 1");
+    }
+};
+
+class AsyncStuckCaseTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult result = SelfTest::runScenario("async-stuck");
+        const std::vector<std::string> exceptions =
+            result.linesStartingWith("exception ");
+        assertEqual(exceptions.size(), 2u);
+        if (exceptions.size() == 2) {
+            assertEqual(exceptions[0], "0 Async test case waits for something "
+                    "other than the test event loop and can never resume");
+            assertEqual(exceptions[1], "0 fast case failed");
+        }
+    }
+};
+
+class AsyncSharedFixtureTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult sequential =
+            SelfTest::runScenario("async-shared-fixture");
+        assertEqual(sequential.lineStartingWith("done "), "3/3 0 0");
+        assertEqual("built once", sequential.linesStartingWith("fixture ").size(), 1u);
+
+        const SelfTest::ScenarioResult parallel =
+            SelfTest::runScenario("async-shared-fixture", "--jobs=2");
+        assertEqual(parallel.lineStartingWith("done "), "3/3 0 0");
+        assertEqual("built once", parallel.linesStartingWith("fixture ").size(), 1u);
+    }
+};
+
+class AsyncFdTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult result = SelfTest::runScenario("async-fds");
+        assertTrue("every wait ends as expected",
+                result.linesStartingWith("failed ").empty());
+        assertEqual(result.linesStartingWith("begin ").size(), 6u);
+        assertEqual(result.lineStartingWith("done "), "6/6 0 0");
+
+        // every case waits on an event loop of its own
+        const SelfTest::ScenarioResult isolated =
+            SelfTest::runScenario("async-fds", "--isolate --filter='fds/*'");
+        assertEqual(isolated.lineStartingWith("done "), "4/4 0 0");
+    }
+};
+
+}
+
+namespace SelfTest
+{
+
+void addAsyncTests()
+{
+    Test::Controller& controller = Test::Controller::instance();
+    controller.addTestSuite("async/plan-order",
+            Test::Suite::instance<AsyncPlanOrderTest>);
+    controller.addTestSuite("async/overlap",
+            Test::Suite::instance<AsyncOverlapTest>);
+    controller.addTestSuite("async/parallel",
+            Test::Suite::instance<AsyncParallelTest>);
+    controller.addTestSuite("async/stuck-case",
+            Test::Suite::instance<AsyncStuckCaseTest>);
+    controller.addTestSuite("async/shared-fixture",
+            Test::Suite::instance<AsyncSharedFixtureTest>);
+    controller.addTestSuite("async/fds", Test::Suite::instance<AsyncFdTest>);
+}
+
+bool addAsyncScenario(const std::string& scenario)
+{
+    if (scenario == "async-sleeping") {
+        Test::addAsyncTestCases("sleeping", sleepingCases);
+    } else if (scenario == "async-stuck") {
+        Test::addAsyncTestCases("stuck", stuckCases);
+    } else if (scenario == "async-fds") {
+        Test::addAsyncTestCases("fds", fdCases);
+        Test::addAsyncTestCases("busy-fds", busyFdCases, Test::SHARED_FIXTURE);
+    } else if (scenario == "async-shared-fixture") {
+        Test::addAsyncTestCases("shared", sharedFixtureCases,
+                Test::SHARED_FIXTURE);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+}
+
+#else
+
+namespace SelfTest
+{
+
+// async test cases need C++20, see the testcpp-selftest-cxx20 target
+void addAsyncTests()
+{ }
+
+bool addAsyncScenario(const std::string&)
+{ return false; }
+
+}
+
+#endif
@@ -0,0 +1,195 @@
+#include "SelfTest.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+#include <unistd.h>
+
+namespace
+{
+
+const double SLEEP_SECONDS = 0.05;
+
+class SleepingSuite : public Test::Suite
+{
+public:
+    void test()
+    { usleep(static_cast<useconds_t>(SLEEP_SECONDS * 1e6)); }
+};
+
+class QuickSuite : public Test::Suite
+{
+public:
+    void test()
+    { assertTrue("quick", true); }
+};
+
+class FailingSuite : public Test::Suite
+{
+public:
+    void test()
+    { assertTrue("fails", false); }
+};
+
+/** Tells the regressions of the run. */
+class RegressionObserver : public SelfTest::ScenarioObserver
+{
+public:
+    virtual void onTimingRegression(const Test::TimingRegression& regression)
+    {
+        std::cout << "regression " << regression.label << " "
+                  << regression.baselineMedian << " " << regression.threshold
+                  << std::endl;
+    }
+};
+
+std::string baselineOption(const SelfTest::TemporaryFile& baseline)
+{ return "--baseline=" + baseline.path; }
+
+/** The samples of the label in the baseline, empty if not there. */
+std::vector<double> samples(const std::string& baseline, const std::string& kind,
+        const std::string& label)
+{
+    std::vector<double> result;
+    const std::vector<std::string> lines = SelfTest::linesOf(baseline);
+    const std::string prefix = kind + "\t" + label + "\t";
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (lines[i].compare(0, prefix.size(), prefix) != 0)
+            continue;
+        std::istringstream in(lines[i].substr(prefix.size()));
+        double sample = 0;
+        while (in >> sample)
+            result.push_back(sample);
+    }
+    return result;
+}
+
+class RegressionTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        // a steady baseline, much faster than the run
+        SelfTest::TemporaryFile baseline;
+        baseline.write("suite\tsleeping\t0.01 0.01 0.011 0.009 0.01\n"
+                "suite\tquick\t1\n");
+        const SelfTest::ScenarioResult result =
+            SelfTest::runScenario("baseline", baselineOption(baseline));
+
+        // the deviation is small, so the 5 ms minimum slowdown applies
+        const std::vector<std::string> regressions =
+            result.linesStartingWith("regression ");
+        assertEqual(regressions.size(), 1u);
+        if (!regressions.empty())
+            assertEqual(regressions[0], "sleeping 0.01 0.015");
+
+        assertEqual("the regression counts as an error",
+                result.lineStartingWith("done "), "3/3 2 0");
+        assertEqual("the baseline is left alone", baseline.read(),
+                "suite\tsleeping\t0.01 0.01 0.011 0.009 0.01\nsuite\tquick\t1\n");
+    }
+};
+
+class NoisyBaselineTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        // median 0.05 with a median absolute deviation of 0.03
+        SelfTest::TemporaryFile baseline;
+        baseline.write("suite\tsleeping\t0.01 0.09 0.02 0.08 0.05\n");
+        const SelfTest::ScenarioResult result =
+            SelfTest::runScenario("baseline", baselineOption(baseline));
+
+        assertEqual(result.linesStartingWith("regression ").size(), 0u);
+        assertEqual(result.lineStartingWith("done "), "3/3 1 0");
+    }
+};
+
+class RelativeThresholdTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        SelfTest::TemporaryFile baseline;
+        baseline.write("suite\tsleeping\t0.02 0.02 0.02\n");
+
+        const SelfTest::ScenarioResult strict =
+            SelfTest::runScenario("baseline", baselineOption(baseline));
+        assertEqual(strict.linesStartingWith("regression ").size(), 1u);
+
+        // five times the baseline is allowed
+        const SelfTest::ScenarioResult lenient = SelfTest::runScenario("baseline",
+                baselineOption(baseline) + " --regression-threshold=4");
+        assertEqual(lenient.linesStartingWith("regression ").size(), 0u);
+        assertEqual(lenient.lineStartingWith("done "), "3/3 1 0");
+    }
+};
+
+class UpdateTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        std::ostringstream old;
+        old << "suite\tsleeping\t";
+        for (int i = 0; i < 30; ++i)
+            old << (i ? " " : "") << 0.001 * (i + 1);
+        old << "\nsuite\tgone\t0.5\nbenchmark\tother\t1 2\n";
+
+        SelfTest::TemporaryFile baseline;
+        baseline.write(old.str());
+        const SelfTest::ScenarioResult result = SelfTest::runScenario("baseline",
+                baselineOption(baseline) + " --update-baseline");
+
+        assertEqual("updates are not compared",
+                result.linesStartingWith("regression ").size(), 0u);
+        assertEqual(result.lineStartingWith("done "), "3/3 1 0");
+
+        // the most recent samples are kept
+        const std::string updated = baseline.read();
+        const std::vector<double> sleeping = samples(updated, "suite", "sleeping");
+        assertEqual(sleeping.size(), 30u);
+        if (sleeping.size() == 30) {
+            assertEqual("the oldest sample is dropped", sleeping.front(), 0.002);
+            assertTrue("the run is added", sleeping.back() >= SLEEP_SECONDS);
+        }
+
+        assertEqual(samples(updated, "suite", "quick").size(), 1u);
+        assertEqual("failed suites are not added",
+                samples(updated, "suite", "failing").size(), 0u);
+        assertEqual("other suites are kept", samples(updated, "suite", "gone").size(), 1u);
+        assertEqual(samples(updated, "benchmark", "other").size(), 2u);
+    }
+};
+
+}
+
+namespace SelfTest
+{
+
+void addBaselineTests()
+{
+    Test::Controller& controller = Test::Controller::instance();
+    controller.addTestSuite("baseline/regression", Test::Suite::instance<RegressionTest>);
+    controller.addTestSuite("baseline/noisy", Test::Suite::instance<NoisyBaselineTest>);
+    controller.addTestSuite("baseline/relative-threshold",
+            Test::Suite::instance<RelativeThresholdTest>);
+    controller.addTestSuite("baseline/update", Test::Suite::instance<UpdateTest>);
+}
+
+bool addBaselineScenario(const std::string& scenario)
+{
+    if (scenario != "baseline")
+        return false;
+
+    Test::Controller& controller = Test::Controller::instance();
+    controller.addTestSuite("sleeping", Test::Suite::instance<SleepingSuite>);
+    controller.addTestSuite("quick", Test::Suite::instance<QuickSuite>);
+    controller.addTestSuite("failing", Test::Suite::instance<FailingSuite>);
+    controller.setObserver(new RegressionObserver);
+    return true;
+}
+
+}
@@ -0,0 +1,149 @@
+#include "SelfTest.h"
+
+#include <testcpp/Benchmark.h>
+#include <testcpp/BufferedStdOutView.h>
+
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+
+class PassingSuite : public Test::Suite
+{
+public:
+    void test()
+    { assertTrue("passes", true); }
+};
+
+class FailingSuite : public Test::Suite
+{
+public:
+    void test()
+    { assertEqual("fails", 1, 2); }
+};
+
+int* leakedInt = 0;
+
+class LeakingSuite : public Test::Suite
+{
+public:
+    void test()
+    {
+        assertTrue("passes", true);
+        leakedInt = new int(1);
+        Test::doNotOptimize(leakedInt);
+    }
+};
+
+class ThrowingSuite : public Test::Suite
+{
+public:
+    void test()
+    { throw std::runtime_error("thrown"); }
+};
+
+bool contains(const std::string& str, const std::string& part)
+{ return str.find(part) != std::string::npos; }
+
+size_t countLinesContaining(const SelfTest::ScenarioResult& result,
+        const std::string& part)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < result.lines.size(); ++i)
+        if (contains(result.lines[i], part))
+            ++count;
+    return count;
+}
+
+/** The whole output of the suite begins with a line like this. */
+std::string suiteHeader(const std::string& label, int num)
+{
+    std::ostringstream header;
+    header << "Test suite '" << label << "' (#" << num << "/4):";
+    return header.str();
+}
+
+class AllOutputTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult result =
+            SelfTest::runScenario("buffered-all-output");
+
+        const char* const labels[] = { "passing", "failing", "leaking", "throwing" };
+        for (int i = 0; i < 4; ++i)
+            assertEqual(labels[i], countLinesContaining(result,
+                        suiteHeader(labels[i], i + 1)), 1u);
+
+        assertEqual("every assertion is shown",
+                countLinesContaining(result, "test 'passes'"), 2u);
+        assertEqual(countLinesContaining(result, "): OK"), 0u);
+        assertEqual(countLinesContaining(result, "Leaked 4 bytes"), 1u);
+        assertEqual(countLinesContaining(result, "Did run 4 of 4"), 1u);
+    }
+};
+
+class FailuresOnlyTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult result =
+            SelfTest::runScenario("buffered-failures-only");
+
+        // a passed suite is reduced to one line
+        assertEqual(countLinesContaining(result, suiteHeader("passing", 1)
+                    + " OK"), 1u);
+        assertEqual(countLinesContaining(result, "test 'passes'"), 1u);
+
+        // failed suites are written in full, a leak fails the suite
+        assertEqual(countLinesContaining(result, suiteHeader("failing", 2)), 1u);
+        assertEqual(countLinesContaining(result, "test 'fails'"), 1u);
+        assertEqual(countLinesContaining(result, suiteHeader("leaking", 3)), 1u);
+        assertEqual(countLinesContaining(result, "Leaked 4 bytes"), 1u);
+        assertEqual(countLinesContaining(result, suiteHeader("throwing", 4)), 1u);
+        assertEqual(countLinesContaining(result, "thrown"), 1u);
+
+        assertEqual(countLinesContaining(result, "): OK"), 1u);
+        assertEqual(countLinesContaining(result, "Did run 4 of 4"), 1u);
+    }
+};
+
+void addBufferedViewSuites(Test::BufferedStdOutView::Mode mode)
+{
+    Test::Controller& controller = Test::Controller::instance();
+    controller.addTestSuite("passing", Test::Suite::instance<PassingSuite>);
+    controller.addTestSuite("failing", Test::Suite::instance<FailingSuite>);
+    controller.addTestSuite("leaking", Test::Suite::instance<LeakingSuite>);
+    controller.addTestSuite("throwing", Test::Suite::instance<ThrowingSuite>);
+    controller.setObserver(new Test::BufferedStdOutView(mode));
+}
+
+}
+
+namespace SelfTest
+{
+
+void addBufferedViewTests()
+{
+    Test::Controller& controller = Test::Controller::instance();
+    controller.addTestSuite("buffered-view/all-output",
+            Test::Suite::instance<AllOutputTest>);
+    controller.addTestSuite("buffered-view/failures-only",
+            Test::Suite::instance<FailuresOnlyTest>);
+}
+
+bool addBufferedViewScenario(const std::string& scenario)
+{
+    if (scenario == "buffered-all-output")
+        addBufferedViewSuites(Test::BufferedStdOutView::ALL_OUTPUT);
+    else if (scenario == "buffered-failures-only")
+        addBufferedViewSuites(Test::BufferedStdOutView::FAILURES_ONLY);
+    else
+        return false;
+    return true;
+}
+
+}
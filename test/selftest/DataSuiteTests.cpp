@@ -0,0 +1,501 @@
+#include "SelfTest.h"
+
+#include <testcpp/DataSuite.h>
+
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+
+/** Builds binary test vector records. */
+class BinaryRecords
+{
+public:
+    BinaryRecords& record(unsigned long fieldCount)
+    { return length(fieldCount); }
+
+    BinaryRecords& field(const std::string& bytes)
+    {
+        length(bytes.size());
+        _bytes += bytes;
+        return *this;
+    }
+
+    /** Appends bytes that are not a valid record. */
+    BinaryRecords& raw(const std::string& bytes)
+    {
+        _bytes += bytes;
+        return *this;
+    }
+
+    const std::string& str() const
+    { return _bytes; }
+
+private:
+    BinaryRecords& length(unsigned long value)
+    {
+        for (int i = 0; i < 4; ++i)
+            _bytes += static_cast<char>((value >> (8 * i)) & 0xFF);
+        return *this;
+    }
+
+    std::string _bytes;
+};
+
+/** A record as "offset field|field|...". */
+std::string describe(const Test::TestVector& vector)
+{
+    std::ostringstream out;
+    out << vector.offset() << " ";
+    for (size_t i = 0; i < vector.fieldCount(); ++i)
+        out << (i ? "|" : "") << vector.field(i).str();
+    return out.str();
+}
+
+/** The records the reader reads, or the error it stops with. */
+std::vector<std::string> readAll(Test::VectorFileReader& reader)
+{
+    std::vector<std::string> records;
+    Test::TestVector vector;
+    try {
+        while (reader.next(vector))
+            records.push_back(describe(vector));
+    } catch (const std::runtime_error& e) {
+        records.push_back(e.what());
+    }
+    return records;
+}
+
+std::vector<std::string> readAll(const Test::MappedFile& file,
+        Test::VectorFileFormat format, unsigned part = 0, unsigned parts = 1)
+{
+    Test::VectorFileReader reader(file, format, part, parts);
+    return readAll(reader);
+}
+
+void append(std::vector<std::string>& to, const std::vector<std::string>& records)
+{ to.insert(to.end(), records.begin(), records.end()); }
+
+/** Records of different lengths, so that the part boundaries fall anywhere. */
+const int RECORD_COUNT = 50;
+
+std::string recordInput(int i)
+{ return std::string(static_cast<size_t>(i * 7 % 13), static_cast<char>('a' + i % 26)); }
+
+class LineParsingTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        SelfTest::TemporaryFile file;
+        file.write("in\tout\n\ncrlf\r\n\tempty first\n"
+                "1\t2\t3\t4\t5\t6\t7\t8\t9\nno line end");
+        Test::MappedFile mapped(file.path);
+
+        const char* const expected[] = {
+            "0 in|out",
+            "8 crlf",
+            "14 |empty first",
+            "27 1|2|3|4|5|6|7|8\t9",
+            "45 no line end"
+        };
+        assertTrue("empty lines are skipped, the last field takes the rest",
+                readAll(mapped, Test::LINE_VECTORS) == SelfTest::linesOf(expected));
+    }
+};
+
+class BinaryParsingTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        SelfTest::TemporaryFile file;
+        file.write(BinaryRecords()
+                .record(2).field("in").field("out")
+                .record(0)
+                .record(3).field("").field(std::string("\0\n\t", 3)).field("x")
+                .str());
+        Test::MappedFile mapped(file.path);
+
+        Test::VectorFileReader reader(mapped, Test::BINARY_VECTORS);
+        Test::TestVector vector;
+        assertTrue(reader.next(vector));
+        assertEqual(vector.offset(), 0u);
+        assertEqual(vector.fieldCount(), 2u);
+        assertTrue(vector.field(0) == std::string("in"));
+        assertTrue(vector.field(1) == std::string("out"));
+
+        assertTrue(reader.next(vector));
+        assertEqual(vector.offset(), 17u);
+        assertEqual(vector.fieldCount(), 0u);
+
+        assertTrue(reader.next(vector));
+        assertEqual(vector.offset(), 21u);
+        assertEqual(vector.fieldCount(), 3u);
+        assertEqual(vector.field(0).size, 0u);
+        assertTrue("fields are bytes",
+                vector.field(1) == std::string("\0\n\t", 3));
+        assertTrue(vector.field(2) == std::string("x"));
+
+        assertFalse("the end of the file", reader.next(vector));
+    }
+};
+
+class EmptyFileTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        SelfTest::TemporaryFile file;
+        Test::MappedFile mapped(file.path);
+        assertEqual(mapped.size(), 0u);
+        assertEqual(readAll(mapped, Test::LINE_VECTORS).size(), 0u);
+        assertEqual(readAll(mapped, Test::BINARY_VECTORS, 1, 2).size(), 0u);
+        assertEqual(Test::VectorFileReader::binaryPartOffsets(mapped, 3).size(), 3u);
+    }
+};
+
+class LinePartsTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        std::ostringstream content;
+        for (int i = 0; i < RECORD_COUNT; ++i)
+            content << i << "\t" << recordInput(i) << (i % 5 ? "\n" : "\r\n\n");
+        SelfTest::TemporaryFile file;
+        file.write(content.str());
+        Test::MappedFile mapped(file.path);
+
+        const std::vector<std::string> whole = readAll(mapped, Test::LINE_VECTORS);
+        assertEqual(whole.size(), static_cast<size_t>(RECORD_COUNT));
+
+        // every record is read once, by the part its first byte is in
+        for (unsigned parts = 2; parts <= 70; parts += parts < 10 ? 1 : 20) {
+            std::vector<std::string> records;
+            for (unsigned part = 0; part < parts; ++part)
+                append(records, readAll(mapped, Test::LINE_VECTORS, part, parts));
+            std::ostringstream label;
+            label << parts << " parts";
+            assertTrue(label.str(), records == whole);
+        }
+    }
+};
+
+class BinaryPartsTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        BinaryRecords content;
+        for (int i = 0; i < RECORD_COUNT; ++i) {
+            std::ostringstream num;
+            num << i;
+            content.record(2).field(num.str()).field(recordInput(i));
+        }
+        SelfTest::TemporaryFile file;
+        file.write(content.str());
+        Test::MappedFile mapped(file.path);
+
+        const std::vector<std::string> whole = readAll(mapped, Test::BINARY_VECTORS);
+        assertEqual(whole.size(), static_cast<size_t>(RECORD_COUNT));
+
+        // parts hop over the records before them or begin at a found offset
+        for (unsigned parts = 2; parts <= 70; parts += parts < 10 ? 1 : 20) {
+            const std::vector<size_t> offsets =
+                Test::VectorFileReader::binaryPartOffsets(mapped, parts);
+            std::vector<std::string> hopped;
+            std::vector<std::string> indexed;
+            for (unsigned part = 0; part < parts; ++part) {
+                append(hopped, readAll(mapped, Test::BINARY_VECTORS, part, parts));
+                Test::VectorFileReader reader(mapped, part, parts, offsets[part]);
+                append(indexed, readAll(reader));
+            }
+            std::ostringstream label;
+            label << parts << " parts";
+            assertTrue(label.str() + " hopped", hopped == whole);
+            assertTrue(label.str() + " indexed", indexed == whole);
+        }
+    }
+};
+
+class MalformedRecordsTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const std::string good = BinaryRecords().record(1).field("ok").str();
+        // a cut field count, a cut field size, too many fields, a field
+        // past the end and a missing field, all reported at the record
+        const std::string malformed[] = {
+            BinaryRecords().raw(std::string("\1\0", 2)).str(),
+            BinaryRecords().record(1).raw(std::string("\2\0\0", 3)).str(),
+            BinaryRecords().record(Test::TestVector::MAX_FIELDS + 1).str(),
+            BinaryRecords().record(1).raw(std::string("\x64\0\0\0ab", 6)).str(),
+            BinaryRecords().record(2).field("a").str()
+        };
+
+        for (size_t i = 0; i < sizeof(malformed) / sizeof(malformed[0]); ++i) {
+            SelfTest::TemporaryFile file;
+            file.write(good + malformed[i]);
+            Test::MappedFile mapped(file.path);
+
+            std::ostringstream label;
+            label << "malformed record " << i;
+            const char* const expected[] = {
+                "0 ok",
+                "Malformed test vector at offset 10"
+            };
+            assertTrue(label.str(), readAll(mapped, Test::BINARY_VECTORS)
+                    == SelfTest::linesOf(expected));
+        }
+    }
+};
+
+class MalformedPartsTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        BinaryRecords content;
+        for (int i = 0; i < 10; ++i)
+            content.record(1).field("0123456789");
+        content.record(Test::TestVector::MAX_FIELDS + 1);
+        for (int i = 0; i < 10; ++i)
+            content.record(1).field("0123456789");
+        SelfTest::TemporaryFile file;
+        file.write(content.str());
+        Test::MappedFile mapped(file.path);
+
+        // the parts from the malformed record on begin at it and report it
+        const unsigned PARTS = 4;
+        const std::vector<size_t> offsets =
+            Test::VectorFileReader::binaryPartOffsets(mapped, PARTS);
+        const std::string error = "Malformed test vector at offset 180";
+        size_t recordCount = 0;
+        for (unsigned part = 0; part < PARTS; ++part) {
+            Test::VectorFileReader reader(mapped, part, PARTS, offsets[part]);
+            const std::vector<std::string> records = readAll(reader);
+            const bool reportsError = !records.empty() && records.back() == error;
+            recordCount += records.size() - (reportsError ? 1 : 0);
+            assertEqual("the parts that reach the record report it",
+                    reportsError, offsets[part] == 180 || part == 1);
+        }
+        assertEqual("the records before it are read", recordCount, 10u);
+        assertEqual(offsets[3], 180u);
+    }
+};
+
+class FieldsTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        SelfTest::TemporaryFile file;
+        file.write("skipped\nin\tout\n");
+        Test::MappedFile mapped(file.path);
+        Test::VectorFileReader reader(mapped, Test::LINE_VECTORS);
+        Test::TestVector vector;
+        reader.next(vector);
+        reader.next(vector);
+
+        std::string error;
+        try {
+            vector.field(2);
+        } catch (const std::out_of_range& e) {
+            error = e.what();
+        }
+        assertEqual(error, "Test vector at offset 8 has 2 fields, field 2 requested");
+
+        std::ostringstream printed;
+        printed << vector.field(1);
+        assertEqual(printed.str(), "out");
+
+        const std::string bytes = std::string("a\\\0\x7f", 4) + std::string(100, 'x');
+        const Test::VectorField binary = { bytes.data(), bytes.size() };
+        std::ostringstream escaped;
+        escaped << binary;
+        assertEqual("non-printable bytes are escaped, long fields cut", escaped.str(),
+                "a\\x5c\\x00\\x7f" + std::string(60, 'x') + "... (104 bytes)");
+    }
+};
+
+class LineVectorSuite : public Test::DataSuite
+{
+public:
+    void testVector(const Test::TestVector& vector)
+    {
+        if (vector.field(0) == std::string("throw"))
+            throw std::runtime_error("thrown");
+        assertEqual("fields match", vector.field(0), vector.field(1));
+    }
+};
+
+/**
+ * The lines of the data suite scenario with the file of records, the path
+ * of the file replaced with FILE.
+ */
+std::vector<std::string> scenarioLines(const std::string& scenario,
+        const std::string& content, const std::string& options = "")
+{
+    SelfTest::TemporaryFile file;
+    file.write(content);
+    const SelfTest::ScenarioResult result =
+        SelfTest::runScenario(scenario, options, file.outputVariable());
+
+    std::vector<std::string> lines;
+    for (size_t i = 0; i < result.lines.size(); ++i) {
+        std::string line = result.lines[i];
+        if (line.compare(0, 12, "allocations ") == 0)
+            continue;
+        const size_t path = line.find(file.path);
+        if (path != std::string::npos)
+            line.replace(path, file.path.size(), "FILE");
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+const char LINE_RECORDS[] = "1\t1\n2\t3\nthrow\t0\n4\t4\n";
+
+class RecordNoteTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        // the failures tell the record, the suite goes on after an exception
+        const char* const expected[] = {
+            "all 1",
+            "begin 1/1 vectors",
+            "failed fields match",
+            "detail test vector at offset 4 of 'FILE'",
+            "detail values: '2' and '3'",
+            "failed testVector() does not throw",
+            "detail test vector at offset 8 of 'FILE'",
+            "end 2",
+            "done 1/1 2 0"
+        };
+        assertTrue(scenarioLines("data-suite", LINE_RECORDS)
+                == SelfTest::linesOf(expected));
+    }
+};
+
+class PartSuitesTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const char* const expected[] = {
+            "all 2",
+            "begin 1/2 vectors [1/2]",
+            "failed fields match",
+            "detail test vector at offset 4 of 'FILE'",
+            "detail values: '2' and '3'",
+            "failed testVector() does not throw",
+            "detail test vector at offset 8 of 'FILE'",
+            "end 2",
+            "begin 2/2 vectors [2/2]",
+            "end 0",
+            "done 2/2 2 0"
+        };
+        assertTrue(scenarioLines("data-suite-parts", LINE_RECORDS)
+                == SelfTest::linesOf(expected));
+
+        // the parts are filtered like any other suites
+        const char* const filtered[] = {
+            "all 1",
+            "begin 1/1 vectors [2/2]",
+            "end 0",
+            "done 1/1 0 0"
+        };
+        assertTrue("a part runs alone",
+                scenarioLines("data-suite-parts", LINE_RECORDS, "--filter='*2/2?'")
+                == SelfTest::linesOf(filtered));
+    }
+};
+
+class BinaryVectorSuite : public Test::DataSuite
+{
+public:
+    void testVector(const Test::TestVector& vector)
+    { assertEqual("fields match", vector.field(0), vector.field(1)); }
+};
+
+class MalformedSuiteTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const std::string content = BinaryRecords()
+            .record(2).field("a").field("a")
+            .record(2).field("a").field("b")
+            .record(Test::TestVector::MAX_FIELDS + 1)
+            .record(2).field("c").field("c")
+            .str();
+
+        // the malformed record begins the second part, which reports it
+        const char* const expected[] = {
+            "all 2",
+            "begin 1/2 binary [1/2]",
+            "failed fields match",
+            "detail test vector at offset 14 of 'FILE'",
+            "detail values: 'a' and 'b'",
+            "end 1",
+            "begin 2/2 binary [2/2]",
+            "exception 0 Malformed test vector at offset 28",
+            "done 2/2 1 1"
+        };
+        assertTrue(scenarioLines("data-suite-binary", content)
+                == SelfTest::linesOf(expected));
+    }
+};
+
+}
+
+namespace SelfTest
+{
+
+void addDataSuiteTests()
+{
+    Test::Controller& controller = Test::Controller::instance();
+    controller.addTestSuite("data-suite/line-parsing",
+            Test::Suite::instance<LineParsingTest>);
+    controller.addTestSuite("data-suite/binary-parsing",
+            Test::Suite::instance<BinaryParsingTest>);
+    controller.addTestSuite("data-suite/empty-file",
+            Test::Suite::instance<EmptyFileTest>);
+    controller.addTestSuite("data-suite/line-parts",
+            Test::Suite::instance<LinePartsTest>);
+    controller.addTestSuite("data-suite/binary-parts",
+            Test::Suite::instance<BinaryPartsTest>);
+    controller.addTestSuite("data-suite/malformed-records",
+            Test::Suite::instance<MalformedRecordsTest>);
+    controller.addTestSuite("data-suite/malformed-parts",
+            Test::Suite::instance<MalformedPartsTest>);
+    controller.addTestSuite("data-suite/fields", Test::Suite::instance<FieldsTest>);
+    controller.addTestSuite("data-suite/record-note",
+            Test::Suite::instance<RecordNoteTest>);
+    controller.addTestSuite("data-suite/part-suites",
+            Test::Suite::instance<PartSuitesTest>);
+    controller.addTestSuite("data-suite/malformed-suite",
+            Test::Suite::instance<MalformedSuiteTest>);
+}
+
+bool addDataSuiteScenario(const std::string& scenario)
+{
+    if (scenario == "data-suite")
+        Test::addDataSuite<LineVectorSuite>("vectors", outputPath(),
+                Test::LINE_VECTORS);
+    else if (scenario == "data-suite-parts")
+        Test::addDataSuite<LineVectorSuite>("vectors", outputPath(),
+                Test::LINE_VECTORS, 2);
+    else if (scenario == "data-suite-binary")
+        Test::addDataSuite<BinaryVectorSuite>("binary", outputPath(),
+                Test::BINARY_VECTORS, 2);
+    else
+        return false;
+    return true;
+}
+
+}
@@ -0,0 +1,233 @@
+#include "SelfTest.h"
+
+#include <testcpp/SharedFixture.h>
+#include <testcpp/TestCases.h>
+
+#include <iostream>
+#include <stdexcept>
+
+namespace
+{
+
+/** Tells when it is built and torn down. */
+class ReferenceIndex
+{
+public:
+    ReferenceIndex()
+    { std::cout << "fixture created" << std::endl; }
+
+    ~ReferenceIndex()
+    { std::cout << "fixture destroyed" << std::endl; }
+
+    int lookup() const
+    { return 42; }
+};
+
+class LookupScenario : public Test::Suite
+{
+public:
+    void test()
+    { assertEqual(_index->lookup(), 42); }
+
+private:
+    Test::SharedFixture<ReferenceIndex> _index;
+};
+
+class OtherScenario : public Test::Suite
+{
+public:
+    void test()
+    { }
+};
+
+/** Counts the fixtures and the cases that ran with each. */
+class CountingCases
+{
+public:
+    CountingCases() :
+        _calls(0)
+    { std::cout << "fixture created" << std::endl; }
+
+    void testCall()
+    { std::cout << "call " << ++_calls << std::endl; }
+
+    void testThrow()
+    {
+        ++_calls;
+        throw std::runtime_error("case threw");
+    }
+
+private:
+    int _calls;
+};
+
+const Test::TestCase<CountingCases> countingCases[] = {
+    { "first", &CountingCases::testCall },
+    { "throws", &CountingCases::testThrow },
+    { "second", &CountingCases::testCall }
+};
+
+/** The events without the allocations, which vary by platform. */
+std::vector<std::string> events(const SelfTest::ScenarioResult& result)
+{ return result.linesNotStartingWith("allocations "); }
+
+class SharedFixtureTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        // built for the first user, torn down after the last one
+        const char* const expected[] = {
+            "all 5",
+            "begin 1/5 index/a",
+            "fixture created",
+            "end 0",
+            "begin 2/5 index/b",
+            "end 0",
+            "begin 3/5 other/x",
+            "end 0",
+            "begin 4/5 index/c",
+            "end 0",
+            "fixture destroyed",
+            "begin 5/5 other/y",
+            "end 0",
+            "done 5/5 0 0"
+        };
+        assertTrue("the fixture lives from the first to the last user",
+                events(SelfTest::runScenario("shared-fixture"))
+                == SelfTest::linesOf(expected));
+
+        const SelfTest::ScenarioResult grouped =
+            SelfTest::runScenario("shared-fixture", "--group-fixtures");
+        const char* const groupedOrder[] = {
+            "1/5 index/a", "2/5 index/b", "3/5 index/c", "4/5 other/x", "5/5 other/y"
+        };
+        assertTrue("users of a fixture run one after another",
+                grouped.linesStartingWith("begin ")
+                == SelfTest::linesOf(groupedOrder));
+    }
+};
+
+#ifdef TESTCPP_HAVE_THREADS
+class ParallelSharedFixtureTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult result =
+            SelfTest::runScenario("shared-fixture", "--jobs=3");
+        assertEqual(result.lineStartingWith("done "), "5/5 0 0");
+        assertEqual(result.linesStartingWith("fixture created").size(), 1u);
+        assertEqual(result.linesStartingWith("fixture destroyed").size(), 1u);
+    }
+};
+#endif
+
+class IsolatedSharedFixtureTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        // every worker builds its own fixture
+        const SelfTest::ScenarioResult result =
+            SelfTest::runScenario("shared-fixture", "--isolate --jobs=1");
+        assertEqual(result.lineStartingWith("done "), "5/5 0 0");
+        assertEqual(result.linesStartingWith("fixture created").size(), 1u);
+    }
+};
+
+class TestCasesTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const char* const fresh[] = {
+            "all 3",
+            "begin 1/3 cases/first",
+            "fixture created",
+            "call 1",
+            "end 0",
+            "begin 2/3 cases/throws",
+            "fixture created",
+            "exception 0 case threw",
+            "begin 3/3 cases/second",
+            "fixture created",
+            "call 1",
+            "end 0",
+            "done 3/3 0 1"
+        };
+        assertTrue("every case has a fixture of its own",
+                events(SelfTest::runScenario("fresh-cases"))
+                == SelfTest::linesOf(fresh));
+
+        const char* const shared[] = {
+            "all 3",
+            "begin 1/3 cases/first",
+            "fixture created",
+            "call 1",
+            "end 0",
+            "begin 2/3 cases/throws",
+            "exception 0 case threw",
+            "begin 3/3 cases/second",
+            "call 3",
+            "end 0",
+            "done 3/3 0 1"
+        };
+        assertTrue("the cases share a fixture",
+                events(SelfTest::runScenario("shared-cases"))
+                == SelfTest::linesOf(shared));
+
+        const char* const filtered[] = {
+            "all 1",
+            "begin 1/1 cases/second",
+            "fixture created",
+            "call 1",
+            "end 0",
+            "done 1/1 0 0"
+        };
+        assertTrue("cases are filtered like suites",
+                events(SelfTest::runScenario("fresh-cases", "--filter=cases/second"))
+                == SelfTest::linesOf(filtered));
+    }
+};
+
+}
+
+namespace SelfTest
+{
+
+void addFixtureTests()
+{
+    Test::Controller& controller = Test::Controller::instance();
+    controller.addTestSuite("fixtures/shared", Test::Suite::instance<SharedFixtureTest>);
+#ifdef TESTCPP_HAVE_THREADS
+    controller.addTestSuite("fixtures/shared-parallel",
+            Test::Suite::instance<ParallelSharedFixtureTest>);
+#endif
+    controller.addTestSuite("fixtures/shared-isolated",
+            Test::Suite::instance<IsolatedSharedFixtureTest>);
+    controller.addTestSuite("fixtures/test-cases", Test::Suite::instance<TestCasesTest>);
+}
+
+bool addFixtureScenario(const std::string& scenario)
+{
+    Test::Controller& controller = Test::Controller::instance();
+
+    if (scenario == "shared-fixture") {
+        controller.addTestSuite("index/a", Test::Suite::instance<LookupScenario>);
+        controller.addTestSuite("index/b", Test::Suite::instance<LookupScenario>);
+        controller.addTestSuite("other/x", Test::Suite::instance<OtherScenario>);
+        controller.addTestSuite("index/c", Test::Suite::instance<LookupScenario>);
+        controller.addTestSuite("other/y", Test::Suite::instance<OtherScenario>);
+        Test::addSharedFixtureUsers<ReferenceIndex>("index/*");
+    } else if (scenario == "fresh-cases") {
+        Test::addTestCases("cases", countingCases);
+    } else if (scenario == "shared-cases") {
+        Test::addTestCases("cases", countingCases, Test::SHARED_FIXTURE);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+}
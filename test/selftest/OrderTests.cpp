@@ -0,0 +1,139 @@
+#include "SelfTest.h"
+
+#include <sstream>
+
+namespace
+{
+
+class PassingSuite : public Test::Suite
+{
+public:
+    void test()
+    { assertTrue(true); }
+};
+
+class FailingSuite : public Test::Suite
+{
+public:
+    void test()
+    { assertTrue("fails", false); }
+};
+
+std::string began(const SelfTest::ScenarioResult& result)
+{
+    const std::vector<std::string> begins = result.linesStartingWith("begin ");
+    std::string labels;
+    for (size_t i = 0; i < begins.size(); ++i)
+        labels += (i ? " " : "") + begins[i].substr(begins[i].find(' ') + 1);
+    return labels;
+}
+
+class FailFastTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult all = SelfTest::runScenario("ordering");
+        assertEqual(began(all), "a b c d e");
+        assertEqual(all.lineStartingWith("done "), "5/5 2 0");
+
+        const SelfTest::ScenarioResult failFast =
+            SelfTest::runScenario("ordering", "--fail-fast");
+        assertEqual(began(failFast), "a b");
+        assertEqual(failFast.lineStartingWith("done "), "2/5 1 0");
+
+        const SelfTest::ScenarioResult maxFailures =
+            SelfTest::runScenario("ordering", "--max-failures=2");
+        assertEqual(began(maxFailures), "a b c d");
+        assertEqual(maxFailures.lineStartingWith("done "), "4/5 2 0");
+    }
+};
+
+class HistoryTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        SelfTest::TemporaryFile history;
+        const std::string option = "--history=" + history.path;
+
+        // results are recorded sorted by label
+        SelfTest::runScenario("ordering", option);
+        std::istringstream recorded(history.read());
+        std::string results;
+        for (std::string line; std::getline(recorded, line); )
+            results += line.substr(0, line.find('\t')) + " "
+                + line.substr(line.rfind('\t') + 1) + ";";
+        assertEqual(results, "a passed;b failed;c passed;d failed;e passed;");
+
+        const SelfTest::ScenarioResult failedFirst =
+            SelfTest::runScenario("ordering", option + " --order=failed-first");
+        assertEqual(began(failedFirst), "b d a c e");
+
+        // the last failure runs first and stops the run again
+        const SelfTest::ScenarioResult failFast = SelfTest::runScenario(
+                "ordering", option + " --order=failed-first --fail-fast");
+        assertEqual(began(failFast), "b");
+        assertEqual(failFast.lineStartingWith("done "), "1/5 1 0");
+    }
+};
+
+class HistoryOrderTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        SelfTest::TemporaryFile history;
+        const std::string option = "--history=" + history.path;
+
+        // suites without history are new, they run between failed and passed
+        // ones and count as taking the average time; every run records its
+        // results, so the history is written before each
+        const char* const content = "a\t0.4\tpassed\n"
+            "c\t0.1\tfailed\n"
+            "d\t0.3\tpassed\n"
+            "e\t0.0\tpassed\n";
+
+        history.write(content);
+        assertEqual(began(SelfTest::runScenario("ordering",
+                        option + " --order=failed-first")), "c b a d e");
+
+        history.write(content);
+        assertEqual(began(SelfTest::runScenario("ordering",
+                        option + " --order=fastest-first")), "e c b d a");
+
+        history.write(content);
+        assertEqual(began(SelfTest::runScenario("ordering", option)),
+                "a b c d e");
+    }
+};
+
+}
+
+namespace SelfTest
+{
+
+void addOrderTests()
+{
+    Test::Controller& controller = Test::Controller::instance();
+    controller.addTestSuite("order/fail-fast", Test::Suite::instance<FailFastTest>);
+    controller.addTestSuite("order/history", Test::Suite::instance<HistoryTest>);
+    controller.addTestSuite("order/history-order",
+            Test::Suite::instance<HistoryOrderTest>);
+}
+
+bool addOrderScenario(const std::string& scenario)
+{
+    if (scenario != "ordering")
+        return false;
+
+    Test::Controller& controller = Test::Controller::instance();
+    controller.addTestSuite("a", Test::Suite::instance<PassingSuite>);
+    controller.addTestSuite("b", Test::Suite::instance<FailingSuite>);
+    controller.addTestSuite("c", Test::Suite::instance<PassingSuite>);
+    controller.addTestSuite("d", Test::Suite::instance<FailingSuite>);
+    controller.addTestSuite("e", Test::Suite::instance<PassingSuite>);
+    return true;
+}
+
+}
@@ -0,0 +1,221 @@
+#include "SelfTest.h"
+
+#include <testcpp/Benchmark.h>
+#include <testcpp/PerformanceCounters.h>
+#include <testcpp/detail/EventRecorder.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+
+typedef Test::PerformanceCounters PC;
+
+const unsigned ALL_COUNTERS = PC::CYCLES | PC::INSTRUCTIONS | PC::BRANCH_MISSES
+    | PC::L1D_READ_MISSES | PC::LLC_MISSES | PC::TASK_CLOCK
+    | PC::CONTEXT_SWITCHES | PC::PAGE_FAULTS;
+
+/** Work that takes a little CPU time. */
+double work()
+{
+    volatile double sum = 0;
+    for (int i = 1; i < 200000; ++i)
+        sum = sum + 1.0 / i;
+    return sum;
+}
+
+/**
+ * What does not add up in the counters, "" if they are consistent: only
+ * known counters are flagged, counters that were not counted are zero and
+ * counted ones are not negative.
+ */
+std::string inconsistency(const PC& counters)
+{
+    const struct { PC::Counter counter; double value; const char* name; } values[] = {
+        { PC::CYCLES, counters.cycles, "cycles" },
+        { PC::INSTRUCTIONS, counters.instructions, "instructions" },
+        { PC::BRANCH_MISSES, counters.branchMisses, "branch misses" },
+        { PC::L1D_READ_MISSES, counters.l1dReadMisses, "L1D read misses" },
+        { PC::LLC_MISSES, counters.llcMisses, "LLC misses" },
+        { PC::TASK_CLOCK, counters.taskClockSeconds, "task clock" },
+        { PC::CONTEXT_SWITCHES, counters.contextSwitches, "context switches" },
+        { PC::PAGE_FAULTS, counters.pageFaults, "page faults" }
+    };
+
+    std::ostringstream out;
+    if (counters.counted & ~ALL_COUNTERS)
+        out << "unknown counters flagged; ";
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+        if (!counters.has(values[i].counter) && values[i].value != 0)
+            out << values[i].name << " not counted but " << values[i].value << "; ";
+        if (counters.has(values[i].counter) && values[i].value < 0)
+            out << values[i].name << " negative; ";
+    }
+
+    const bool hasIpc = counters.has(PC::CYCLES) && counters.has(PC::INSTRUCTIONS)
+        && counters.cycles > 0;
+    if (!hasIpc && counters.instructionsPerCycle() != 0)
+        out << "instructions per cycle without both counts; ";
+
+    // the task clock counts nanoseconds, converted to seconds
+    if (counters.has(PC::TASK_CLOCK) && counters.taskClockSeconds > 60)
+        out << "task clock of " << counters.taskClockSeconds << " seconds; ";
+    return out.str();
+}
+
+class ScopeTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        // the kernel may allow hardware, software or no counters at all
+        Test::PerformanceCounterScope scope;
+        Test::doNotOptimize(work());
+        const PC counters = scope.counters();
+        assertEqual(inconsistency(counters), "");
+
+        if (counters.has(PC::INSTRUCTIONS))
+            assertTrue("the work took instructions", counters.instructions > 0);
+        if (counters.has(PC::TASK_CLOCK))
+            assertTrue("the work took CPU time", counters.taskClockSeconds > 0);
+
+        Test::PerformanceCounterScope disabled(false);
+        assertEqual(disabled.counters().counted, 0u);
+    }
+};
+
+class DividedByTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        Test::PerformanceCounterScope scope;
+        Test::doNotOptimize(work());
+        const PC counters = scope.counters();
+        const PC perIteration = counters.dividedBy(4);
+
+        assertEqual("the same counters are counted",
+                perIteration.counted, counters.counted);
+        assertEqual(inconsistency(perIteration), "");
+        assertEqual(perIteration.cycles * 4, counters.cycles);
+        assertEqual(perIteration.instructions * 4, counters.instructions);
+        assertEqual(perIteration.taskClockSeconds * 4, counters.taskClockSeconds);
+        assertEqual(perIteration.pageFaults * 4, counters.pageFaults);
+        assertEqual("the ratio does not change", perIteration.instructionsPerCycle(),
+                counters.instructionsPerCycle());
+    }
+};
+
+/** Tells the counters of every suite. */
+class CountersObserver : public SelfTest::ScenarioObserver
+{
+public:
+    virtual void onTestSuiteStats(const Test::TestSuiteStats& stats)
+    {
+        std::cout << "counted " << stats.counters.counted << std::endl;
+        const std::string error = inconsistency(stats.counters);
+        if (!error.empty())
+            std::cout << "inconsistent " << error << std::endl;
+    }
+};
+
+class WorkingSuite : public Test::Suite
+{
+public:
+    void test()
+    { assertTrue("works", work() > 0); }
+};
+
+class SuiteCountersTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult sequential =
+            SelfTest::runScenario("perf-counters", "--perf-counters");
+        const SelfTest::ScenarioResult isolated =
+            SelfTest::runScenario("perf-counters", "--perf-counters --isolate");
+        const SelfTest::ScenarioResult disabled =
+            SelfTest::runScenario("perf-counters");
+
+        assertEqual(sequential.linesStartingWith("counted ").size(), 2u);
+        assertEqual(sequential.linesStartingWith("inconsistent ").size(), 0u);
+
+        // the counts of isolated suites are sent from the worker
+        assertTrue("the workers count the same counters",
+                isolated.linesStartingWith("counted ")
+                == sequential.linesStartingWith("counted "));
+        assertEqual(isolated.linesStartingWith("inconsistent ").size(), 0u);
+
+        const std::vector<std::string> none = disabled.linesStartingWith("counted ");
+        assertEqual(none.size(), 2u);
+        for (size_t i = 0; i < none.size(); ++i)
+            assertEqual("nothing is counted unless asked", none[i], "0");
+    }
+};
+
+/** Keeps the stats the recorded events were replayed with. */
+class StatsObserver : public SelfTest::ScenarioObserver
+{
+public:
+    virtual void onTestSuiteStats(const Test::TestSuiteStats& s)
+    { stats = s; }
+
+    Test::TestSuiteStats stats;
+};
+
+class RecordedCountersTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        Test::TestSuiteStats stats;
+        stats.counters.counted = PC::TASK_CLOCK | PC::PAGE_FAULTS;
+        stats.counters.taskClockSeconds = 0.25;
+        stats.counters.pageFaults = 12;
+
+        Test::EventRecorder recorder;
+        recorder.onTestSuiteStats(stats);
+        StatsObserver observer;
+        Test::EventRecorder::replay(recorder.buffer(), observer);
+
+        const PC& replayed = observer.stats.counters;
+        assertEqual(replayed.counted, stats.counters.counted);
+        assertEqual(replayed.taskClockSeconds, 0.25);
+        assertEqual(replayed.pageFaults, 12.0);
+        assertEqual(inconsistency(replayed), "");
+    }
+};
+
+}
+
+namespace SelfTest
+{
+
+void addPerformanceCounterTests()
+{
+    Test::Controller& controller = Test::Controller::instance();
+    controller.addTestSuite("perf-counters/scope", Test::Suite::instance<ScopeTest>);
+    controller.addTestSuite("perf-counters/divided-by",
+            Test::Suite::instance<DividedByTest>);
+    controller.addTestSuite("perf-counters/suites",
+            Test::Suite::instance<SuiteCountersTest>);
+    controller.addTestSuite("perf-counters/recorded",
+            Test::Suite::instance<RecordedCountersTest>);
+}
+
+bool addPerformanceCounterScenario(const std::string& scenario)
+{
+    if (scenario != "perf-counters")
+        return false;
+
+    Test::Controller& controller = Test::Controller::instance();
+    controller.addTestSuite("first", Test::Suite::instance<WorkingSuite>);
+    controller.addTestSuite("second", Test::Suite::instance<WorkingSuite>);
+    controller.setObserver(new CountersObserver);
+    return true;
+}
+
+}
@@ -0,0 +1,194 @@
+#include "SelfTest.h"
+
+#include <testcpp/Property.h>
+
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+
+/** Fails for about one value in a hundred. */
+void belowLimit(int value)
+{ assertTrue("value below limit", value < 99000); }
+
+void shorterThanThree(const std::vector<int>& values)
+{
+    if (values.size() >= 3)
+        throw std::runtime_error("three or more values");
+}
+
+void nonNegative(int value)
+{ assertTrue("value not negative", value >= 0); }
+
+class FailingPropertyScenario : public Test::Suite
+{
+public:
+    void test()
+    {
+        Test::PropertyOptions options;
+        options.cases = 10000;
+        Test::checkProperty("all below limit", Test::integers(0, 100000),
+                &belowLimit, options);
+    }
+};
+
+class ThrowingPropertyScenario : public Test::Suite
+{
+public:
+    void test()
+    {
+        Test::checkProperty("all shorter than three",
+                Test::vectorsOf(Test::integers(0, 9)), &shorterThanThree);
+    }
+};
+
+class HoldingPropertyScenario : public Test::Suite
+{
+public:
+    void test()
+    {
+        Test::PropertyOptions options;
+        options.cases = 10000;
+        Test::checkProperty("all not negative", Test::integers(0, 1000),
+                &nonNegative, options);
+    }
+};
+
+/** The same property on one and, with C++11 threads, on several threads. */
+class ThreadedPropertyScenario : public Test::Suite
+{
+public:
+    void test()
+    {
+        Test::PropertyOptions options;
+        options.cases = 10000;
+        Test::checkProperty("all below limit", Test::integers(0, 100000),
+                &belowLimit, options);
+
+#ifdef TESTCPP_HAVE_THREADS
+        options.threads = 4;
+#endif
+        Test::checkProperty("all below limit", Test::integers(0, 100000),
+                &belowLimit, options);
+    }
+};
+
+std::vector<std::string> details(const std::string& options)
+{
+    return SelfTest::runScenario("properties",
+            "--filter=properties/failing " + options).linesStartingWith("detail ");
+}
+
+class ShrinkingTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult result = SelfTest::runScenario(
+                "properties", "--exclude=properties/threads");
+        assertEqual(result.lineStartingWith("done "), "3/3 4 0");
+
+        // the counterexample is checked once more to report its assertions
+        const char* const failed[] = {
+            "value below limit",
+            "all below limit",
+            "property does not throw",
+            "all shorter than three"
+        };
+        assertTrue("the failed properties are reported",
+                result.linesStartingWith("failed ") == SelfTest::linesOf(failed));
+
+        const std::vector<std::string> details = result.linesStartingWith("detail ");
+        assertEqual(details.size(), 4u);
+        if (details.size() == 4) {
+            assertTrue("the integer shrinks to the smallest that fails",
+                    endsWith(details[1], "shrinks: 99000"));
+            assertTrue("the vector shrinks to the shortest that fails",
+                    endsWith(details[3], "shrinks: [0, 0, 0]"));
+        }
+    }
+
+private:
+    static bool endsWith(const std::string& str, const std::string& suffix)
+    {
+        return str.size() >= suffix.size()
+            && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+};
+
+class SeedTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const std::vector<std::string> seeded = details("--property-seed=12345");
+        assertEqual(seeded.size(), 2u);
+        if (seeded.size() != 2)
+            return;
+        assertTrue("the seed is reported", seeded[0].find("with seed 12345")
+                != std::string::npos);
+        assertTrue("a seed repeats the run",
+                details("--property-seed=12345") == seeded);
+
+        // the seed of a random run repeats it
+        const std::vector<std::string> random = details("");
+        assertEqual(random.size(), 2u);
+        if (random.size() != 2)
+            return;
+        const std::string seed = random[0].substr(random[0].rfind(' ') + 1);
+        assertTrue("the reported seed repeats the run",
+                details("--property-seed=" + seed) == random);
+    }
+};
+
+class ThreadedPropertyTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult result = SelfTest::runScenario(
+                "properties", "--filter=properties/threads --property-seed=7");
+
+        const std::vector<std::string> details = result.linesStartingWith("detail ");
+        assertEqual(details.size(), 4u);
+        if (details.size() == 4) {
+            assertEqual(details[0], details[2]);
+            assertEqual(details[1], details[3]);
+        }
+    }
+};
+
+}
+
+namespace SelfTest
+{
+
+void addPropertyTests()
+{
+    Test::Controller& controller = Test::Controller::instance();
+    controller.addTestSuite("properties/shrinking",
+            Test::Suite::instance<ShrinkingTest>);
+    controller.addTestSuite("properties/seed", Test::Suite::instance<SeedTest>);
+    controller.addTestSuite("properties/threads",
+            Test::Suite::instance<ThreadedPropertyTest>);
+}
+
+bool addPropertyScenario(const std::string& scenario)
+{
+    if (scenario != "properties")
+        return false;
+
+    Test::Controller& controller = Test::Controller::instance();
+    controller.addTestSuite("properties/failing",
+            Test::Suite::instance<FailingPropertyScenario>);
+    controller.addTestSuite("properties/throwing",
+            Test::Suite::instance<ThrowingPropertyScenario>);
+    controller.addTestSuite("properties/holding",
+            Test::Suite::instance<HoldingPropertyScenario>);
+    controller.addTestSuite("properties/threads",
+            Test::Suite::instance<ThreadedPropertyScenario>);
+    return true;
+}
+
+}
@@ -0,0 +1,292 @@
+#include "SelfTest.h"
+
+#include <testcpp/JUnitXmlObserver.h>
+#include <testcpp/JsonLinesObserver.h>
+
+#include <cstdlib>
+#include <stdexcept>
+
+namespace
+{
+
+const char* const ESCAPED_LABEL = "a<b> & \"c\" 'd'";
+
+class AssertingSuite : public Test::Suite
+{
+public:
+    void test()
+    {
+        assertTrue("passes", true);
+        assertEqual("a < b", std::string("<x&y>"), std::string("\"z\""));
+        assertTrue("bell\x07", false);
+        assertTrue("passes again", true);
+    }
+};
+
+class ThrowingSuite : public Test::Suite
+{
+public:
+    void test()
+    {
+        assertTrue("before throwing", true);
+        throw std::runtime_error("bad <input>");
+    }
+};
+
+class ExitingSuite : public Test::Suite
+{
+public:
+    void test()
+    { std::exit(3); }
+};
+
+void addReportSuites()
+{
+    Test::Controller& controller = Test::Controller::instance();
+    controller.addTestSuite(ESCAPED_LABEL, Test::Suite::instance<AssertingSuite>);
+    controller.addTestSuite("throwing", Test::Suite::instance<ThrowingSuite>);
+}
+
+bool contains(const std::string& str, const std::string& part)
+{ return str.find(part) != std::string::npos; }
+
+std::vector<std::string> linesContaining(const std::vector<std::string>& lines,
+        const std::string& part)
+{
+    std::vector<std::string> result;
+    for (size_t i = 0; i < lines.size(); ++i)
+        if (contains(lines[i], part))
+            result.push_back(lines[i]);
+    return result;
+}
+
+/** The value of the XML attribute in the line, as written. */
+std::string attribute(const std::string& line, const std::string& name)
+{
+    const std::string start = " " + name + "=\"";
+    const size_t begin = line.find(start);
+    if (begin == std::string::npos)
+        return std::string();
+    const size_t valueBegin = begin + start.size();
+    return line.substr(valueBegin, line.find('"', valueBegin) - valueBegin);
+}
+
+int count(const std::string& line, const std::string& name)
+{ return std::atoi(attribute(line, name).c_str()); }
+
+/**
+ * The value of the JSON member in the line, strings unescaped, other
+ * values as written.
+ */
+std::string field(const std::string& line, const std::string& name)
+{
+    const std::string start = "\"" + name + "\":";
+    size_t pos = line.find(start);
+    if (pos == std::string::npos)
+        return std::string();
+    pos += start.size();
+
+    if (line[pos] != '"')
+        return line.substr(pos, line.find_first_of(",}", pos) - pos);
+
+    std::string value;
+    for (++pos; pos < line.size() && line[pos] != '"'; ++pos) {
+        if (line[pos] != '\\') {
+            value += line[pos];
+            continue;
+        }
+        switch (line[++pos]) {
+            case 'n': value += '\n'; break;
+            case 't': value += '\t'; break;
+            case 'u':
+                value += static_cast<char>(
+                        std::strtol(line.substr(pos + 1, 4).c_str(), 0, 16));
+                pos += 4;
+                break;
+            default: value += line[pos];
+        }
+    }
+    return value;
+}
+
+class JUnitXmlTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        SelfTest::TemporaryFile output;
+        SelfTest::runScenario("junit-report", "", output.outputVariable());
+
+        const std::vector<std::string> lines = SelfTest::linesOf(output.read());
+        assertTrue("the file has lines", lines.size() > 2);
+        if (lines.size() <= 2)
+            return;
+
+        assertEqual(lines[0], "<?xml version=\"1.0\" encoding=\"UTF-8\"?>");
+        assertEqual(lines.back(), "</testsuites>");
+
+        // the placeholders are patched with the counts of the elements
+        const std::vector<std::string> suites = linesContaining(lines, "<testsuite ");
+        assertEqual(suites.size(), 2u);
+        if (suites.size() != 2)
+            return;
+
+        assertEqual(attribute(suites[0], "name"),
+                "a&lt;b&gt; &amp; &quot;c&quot; &apos;d&apos;");
+        assertEqual(count(suites[0], "tests"), 4);
+        assertEqual(count(suites[0], "failures"), 2);
+        assertEqual(count(suites[0], "errors"), 0);
+
+        assertEqual(attribute(suites[1], "name"), "throwing");
+        assertEqual(count(suites[1], "tests"), 2);
+        assertEqual(count(suites[1], "failures"), 0);
+        assertEqual(count(suites[1], "errors"), 1);
+
+        const std::string all = lines[1];
+        assertEqual(count(all, "tests"), 6);
+        assertEqual(count(all, "failures"), 2);
+        assertEqual(count(all, "errors"), 1);
+        assertTrue("the run took time", std::atof(attribute(all, "time").c_str()) >= 0);
+
+        assertEqual(linesContaining(lines, "<testcase ").size(), 6u);
+        assertEqual(linesContaining(lines, "name=\"a &lt; b\"").size(), 1u);
+        assertEqual("control characters are replaced",
+                linesContaining(lines, "name=\"bell?\"").size(), 1u);
+        assertEqual("failure details are escaped",
+                linesContaining(lines, "&lt;x&amp;y&gt;").size(), 1u);
+        assertEqual(linesContaining(lines, "message=\"bad &lt;input&gt;\"").size(), 1u);
+    }
+};
+
+class JUnitXmlIsolatedExitTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        // a worker that exits must not write what the parent has buffered
+        SelfTest::TemporaryFile output;
+        SelfTest::runScenario("junit-report-exit", "--isolate --jobs=1",
+                output.outputVariable());
+
+        const std::vector<std::string> lines = SelfTest::linesOf(output.read());
+        assertEqual(linesContaining(lines, "<?xml ").size(), 1u);
+        assertEqual(linesContaining(lines, "<testsuites ").size(), 1u);
+        assertEqual(linesContaining(lines, "<testsuite ").size(), 3u);
+        assertTrue("the file is complete",
+                !lines.empty() && lines.back() == "</testsuites>");
+    }
+};
+
+class JsonLinesTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        SelfTest::TemporaryFile output;
+        SelfTest::runScenario("json-report", "", output.outputVariable());
+
+        const std::vector<std::string> lines = SelfTest::linesOf(output.read());
+        for (size_t i = 0; i < lines.size(); ++i)
+            assertTrue("one object per line", !lines[i].empty()
+                    && lines[i][0] == '{' && lines[i][lines[i].size() - 1] == '}');
+
+        assertEqual(lines.size(), 11u);
+        if (lines.size() != 11)
+            return;
+
+        assertEqual(field(lines[0], "event"), "run_begin");
+        assertEqual(field(lines[0], "suites"), "2");
+
+        assertEqual(field(lines[1], "event"), "suite_begin");
+        assertEqual(field(lines[1], "suite"), ESCAPED_LABEL);
+
+        assertEqual(field(lines[2], "label"), "passes");
+        assertEqual(field(lines[2], "ok"), "true");
+        assertEqual(field(lines[2], "suite"), ESCAPED_LABEL);
+
+        assertEqual(field(lines[3], "type"), "assertEqual");
+        assertEqual(field(lines[3], "label"), "a < b");
+        assertEqual(field(lines[3], "ok"), "false");
+        assertTrue("failure details are escaped",
+                contains(field(lines[3], "details"), "<x&y>")
+                && contains(lines[3], "\\\"z\\\""));
+
+        assertEqual("control characters are escaped",
+                field(lines[4], "label"), "bell\x07");
+        assertTrue("as \\u escapes", contains(lines[4], "\"bell\\u0007\""));
+
+        assertEqual(field(lines[5], "label"), "passes again");
+
+        assertEqual(field(lines[6], "event"), "suite_end");
+        assertEqual(field(lines[6], "ok"), "false");
+        assertEqual(field(lines[6], "errors"), "2");
+
+        assertEqual(field(lines[8], "label"), "before throwing");
+        assertEqual(field(lines[9], "event"), "suite_end");
+        assertEqual(field(lines[9], "what"), "bad <input>");
+
+        assertEqual(field(lines[10], "event"), "run_end");
+        assertEqual(field(lines[10], "suites_run"), "2");
+        assertEqual(field(lines[10], "errors"), "2");
+        assertEqual(field(lines[10], "exceptions"), "1");
+    }
+};
+
+class JsonLinesFailuresOnlyTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        SelfTest::TemporaryFile output;
+        SelfTest::runScenario("json-report-failures", "", output.outputVariable());
+
+        const std::vector<std::string> lines = SelfTest::linesOf(output.read());
+        const std::vector<std::string> asserts =
+            linesContaining(lines, "\"event\":\"assert\"");
+        assertEqual(asserts.size(), 2u);
+        for (size_t i = 0; i < asserts.size(); ++i)
+            assertEqual(field(asserts[i], "ok"), "false");
+        assertEqual(lines.size(), 8u);
+    }
+};
+
+}
+
+namespace SelfTest
+{
+
+void addReportTests()
+{
+    Test::Controller& controller = Test::Controller::instance();
+    controller.addTestSuite("reports/junit-xml", Test::Suite::instance<JUnitXmlTest>);
+    controller.addTestSuite("reports/junit-xml-isolated-exit",
+            Test::Suite::instance<JUnitXmlIsolatedExitTest>);
+    controller.addTestSuite("reports/json-lines", Test::Suite::instance<JsonLinesTest>);
+    controller.addTestSuite("reports/json-lines-failures-only",
+            Test::Suite::instance<JsonLinesFailuresOnlyTest>);
+}
+
+bool addReportScenario(const std::string& scenario)
+{
+    Test::Controller& controller = Test::Controller::instance();
+
+    if (scenario == "junit-report") {
+        addReportSuites();
+        controller.setObserver(new Test::JUnitXmlObserver(outputPath()));
+    } else if (scenario == "junit-report-exit") {
+        addReportSuites();
+        controller.addTestSuite("exiting", Test::Suite::instance<ExitingSuite>);
+        controller.setObserver(new Test::JUnitXmlObserver(outputPath()));
+    } else if (scenario == "json-report") {
+        addReportSuites();
+        controller.setObserver(new Test::JsonLinesObserver(outputPath()));
+    } else if (scenario == "json-report-failures") {
+        addReportSuites();
+        controller.setObserver(new Test::JsonLinesObserver(outputPath(), false));
+    } else {
+        return false;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,314 @@
+#include "SelfTest.h"
+
+#include <testcpp/detail/TextStreamTestView.h>
+
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+
+#include <unistd.h>
+
+namespace
+{
+
+/** The process that added the scenario, the isolated suites run in others. */
+pid_t scenarioPid = 0;
+
+void sleepSeconds(double seconds)
+{ usleep(static_cast<useconds_t>(seconds * 1e6)); }
+
+class SleepingSuite : public Test::Suite
+{
+public:
+    void test()
+    { sleepSeconds(0.1); }
+};
+
+class SleepingFailingSuite : public Test::Suite
+{
+public:
+    void test()
+    {
+        sleepSeconds(0.1);
+        assertTrue("second suite failed", false);
+        assertTrue("second suite failed again", false);
+    }
+};
+
+class SleepingThrowingSuite : public Test::Suite
+{
+public:
+    void test()
+    {
+        sleepSeconds(0.1);
+        throw std::runtime_error("third suite threw");
+    }
+};
+
+class WorkerSuite : public Test::Suite
+{
+public:
+    void test()
+    {
+        assertTrue("runs in a worker process", getpid() != scenarioPid);
+        std::cout << "pid " << getpid() << std::endl;
+    }
+};
+
+class CrashingSuite : public Test::Suite
+{
+public:
+    void test()
+    { std::raise(SIGSEGV); }
+};
+
+class ExitingSuite : public Test::Suite
+{
+public:
+    void test()
+    { std::exit(3); }
+};
+
+class FailingWorkerSuite : public Test::Suite
+{
+public:
+    void test()
+    { assertTrue("failed in a worker", false); }
+};
+
+/** Buffers the output in a file stream until the run ends. */
+class FileView : public Test::TextStreamTestView
+{
+public:
+    explicit FileView(const std::string& path) :
+        Test::TextStreamTestView(),
+        _out(path.c_str())
+    { }
+
+    virtual void flush()
+    { _out.flush(); }
+
+    virtual Test::TextStreamTestView& operator<< (const std::string& msg)
+    { _out << msg; return *this; }
+
+    virtual Test::TextStreamTestView& operator<< (int msg)
+    { _out << msg; return *this; }
+
+    virtual Test::TextStreamTestView& operator<< (EndLine)
+    { _out << '\n'; return *this; }
+
+    virtual Test::TextStreamTestView& operator<< (Tab)
+    { _out << '\t'; return *this; }
+
+private:
+    std::ofstream _out;
+};
+
+/**
+ * Every suite is reported as one block of events, whichever thread or
+ * process ran it, and numbered once.
+ */
+void assertSuiteBlocks(const SelfTest::ScenarioResult& result, int total)
+{
+    std::set<std::string> nums;
+    bool inSuite = false;
+    bool nested = false;
+
+    for (size_t i = 0; i < result.lines.size(); ++i) {
+        const std::string& line = result.lines[i];
+        if (line.compare(0, 6, "begin ") == 0) {
+            nested = nested || inSuite;
+            inSuite = true;
+            nums.insert(line.substr(6, line.find(' ', 6) - 6));
+        } else if (line.compare(0, 4, "end ") == 0
+                || line.compare(0, 10, "exception ") == 0) {
+            nested = nested || !inSuite;
+            inSuite = false;
+        } else if (line.compare(0, 7, "failed ") == 0) {
+            nested = nested || !inSuite;
+        }
+    }
+
+    assertFalse("suite events do not interleave", nested || inSuite);
+    assertEqual("every suite is numbered once", nums.size(),
+            static_cast<size_t>(total));
+}
+
+/** The result of the scenario does not depend on how the suites run. */
+void assertSleepingResult(const SelfTest::ScenarioResult& result)
+{
+    assertEqual(result.lineStartingWith("done "), "6/6 2 1");
+    assertEqual(result.linesStartingWith("begin ").size(), 6u);
+    assertEqual(result.lineStartingWith("exception "), "0 third suite threw");
+
+    const std::vector<std::string> failed = result.linesStartingWith("failed ");
+    assertEqual(failed.size(), 2u);
+    if (failed.size() == 2) {
+        assertEqual(failed[0], "second suite failed");
+        assertEqual(failed[1], "second suite failed again");
+    }
+    assertSuiteBlocks(result, 6);
+}
+
+class SequentialRunTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult result = SelfTest::runScenario("sleeping");
+        assertSleepingResult(result);
+        assertTrue("sequential suites take their time", result.wallSeconds >= 0.6);
+
+        const std::vector<std::string> begins = result.linesStartingWith("begin ");
+        assertEqual(begins.front(), "1/6 sleeping/first");
+        assertEqual(begins.back(), "6/6 sleeping/sixth");
+    }
+};
+
+#ifdef TESTCPP_HAVE_THREADS
+class ParallelRunTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult result =
+            SelfTest::runScenario("sleeping", "--jobs=6");
+        assertSleepingResult(result);
+        assertTrue("suites run at the same time", result.wallSeconds < 0.45);
+    }
+};
+#endif
+
+class IsolatedRunTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult result =
+            SelfTest::runScenario("sleeping", "--isolate --jobs=6");
+        assertSleepingResult(result);
+        assertTrue("worker processes run at the same time",
+                result.wallSeconds < 0.45);
+    }
+};
+
+class IsolatedCrashTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult result =
+            SelfTest::runScenario("isolated", "--isolate --jobs=1");
+
+        assertEqual(result.lineStartingWith("done "), "7/7 1 2");
+        assertSuiteBlocks(result, 7);
+
+        const std::vector<std::string> exceptions =
+            result.linesStartingWith("exception ");
+        assertEqual(exceptions.size(), 2u);
+        if (exceptions.size() == 2) {
+            assertEqual(exceptions[0], "0 Test suite process was killed by "
+                    "signal SIGSEGV (" + std::string(strsignal(SIGSEGV)) + ")");
+            assertEqual(exceptions[1], "0 Test suite process exited with "
+                    "status 3 before the test suite ended");
+        }
+
+        assertEqual(result.linesStartingWith("failed ").size(), 1u);
+        assertEqual(result.lineStartingWith("failed "), "failed in a worker");
+
+        // one worker runs the suites until it dies, then another takes over
+        const std::vector<std::string> pids = result.linesStartingWith("pid ");
+        assertEqual(pids.size(), 4u);
+        if (pids.size() == 4) {
+            assertEqual(pids[0], pids[1]);
+            assertTrue("a new worker replaces the crashed one", pids[1] != pids[2]);
+            assertTrue("a new worker replaces the exited one", pids[2] != pids[3]);
+        }
+    }
+};
+
+class IsolatedExitTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        // a worker that exits must not write what the parent has buffered
+        SelfTest::TemporaryFile output;
+        SelfTest::runScenario("isolated-exit", "--isolate --jobs=1",
+                output.outputVariable());
+
+        const std::vector<std::string> lines = SelfTest::linesOf(output.read());
+        assertTrue("the output has lines", !lines.empty());
+        if (lines.empty())
+            return;
+
+        assertEqual(lines.front(), "Start running 3 test suites");
+        assertEqual(static_cast<size_t>(std::count(lines.begin(), lines.end(),
+                        lines.front())), 1u);
+        assertEqual(lines[lines.size() - 2], "Did run 3 of 3 total test suites, "
+                "# of errors: 0, # of uncaught exceptions: 1");
+    }
+};
+
+}
+
+namespace SelfTest
+{
+
+void addRunModeTests()
+{
+    Test::Controller& controller = Test::Controller::instance();
+    controller.addTestSuite("run-modes/sequential",
+            Test::Suite::instance<SequentialRunTest>);
+#ifdef TESTCPP_HAVE_THREADS
+    controller.addTestSuite("run-modes/parallel",
+            Test::Suite::instance<ParallelRunTest>);
+#endif
+    controller.addTestSuite("run-modes/isolated",
+            Test::Suite::instance<IsolatedRunTest>);
+    controller.addTestSuite("run-modes/isolated-crash",
+            Test::Suite::instance<IsolatedCrashTest>);
+    controller.addTestSuite("run-modes/isolated-exit",
+            Test::Suite::instance<IsolatedExitTest>);
+}
+
+bool addRunModeScenario(const std::string& scenario)
+{
+    scenarioPid = getpid();
+    Test::Controller& controller = Test::Controller::instance();
+
+    if (scenario == "sleeping") {
+        controller.addTestSuite("sleeping/first", Test::Suite::instance<SleepingSuite>);
+        controller.addTestSuite("sleeping/second",
+                Test::Suite::instance<SleepingFailingSuite>);
+        controller.addTestSuite("sleeping/third",
+                Test::Suite::instance<SleepingThrowingSuite>);
+        controller.addTestSuite("sleeping/fourth", Test::Suite::instance<SleepingSuite>);
+        controller.addTestSuite("sleeping/fifth", Test::Suite::instance<SleepingSuite>);
+        controller.addTestSuite("sleeping/sixth", Test::Suite::instance<SleepingSuite>);
+    } else if (scenario == "isolated") {
+        controller.addTestSuite("isolated/first", Test::Suite::instance<WorkerSuite>);
+        controller.addTestSuite("isolated/second", Test::Suite::instance<WorkerSuite>);
+        controller.addTestSuite("isolated/crash", Test::Suite::instance<CrashingSuite>);
+        controller.addTestSuite("isolated/third", Test::Suite::instance<WorkerSuite>);
+        controller.addTestSuite("isolated/exit", Test::Suite::instance<ExitingSuite>);
+        controller.addTestSuite("isolated/fail",
+                Test::Suite::instance<FailingWorkerSuite>);
+        controller.addTestSuite("isolated/fourth", Test::Suite::instance<WorkerSuite>);
+    } else if (scenario == "isolated-exit") {
+        controller.addTestSuite("exiting/first", Test::Suite::instance<WorkerSuite>);
+        controller.addTestSuite("exiting/exit", Test::Suite::instance<ExitingSuite>);
+        controller.addTestSuite("exiting/second", Test::Suite::instance<WorkerSuite>);
+        controller.setObserver(new FileView(SelfTest::outputPath()));
+    } else {
+        return false;
+    }
+    return true;
+}
+
+}
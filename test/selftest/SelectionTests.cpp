@@ -0,0 +1,180 @@
+#include "SelfTest.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+
+const char* const labels[] = {
+    "parser/empty",
+    "parser/nested",
+    "lexer/tokens",
+    "lexer/comments",
+    "io/read"
+};
+
+const size_t labelCount = sizeof(labels) / sizeof(labels[0]);
+
+/** Tells when it is constructed, filtered out suites must not be. */
+class ConstructedSuite : public Test::Suite
+{
+public:
+    ConstructedSuite()
+    { std::cout << "constructed" << std::endl; }
+
+    void test()
+    { }
+};
+
+/** The labels of the suites that began, in run order. */
+std::vector<std::string> began(const SelfTest::ScenarioResult& result)
+{
+    const std::vector<std::string> begins = result.linesStartingWith("begin ");
+    std::vector<std::string> found;
+    for (size_t i = 0; i < begins.size(); ++i)
+        found.push_back(begins[i].substr(begins[i].find(' ') + 1));
+    return found;
+}
+
+std::string joined(const std::vector<std::string>& strings)
+{
+    std::string all;
+    for (size_t i = 0; i < strings.size(); ++i)
+        all += (i ? " " : "") + strings[i];
+    return all;
+}
+
+std::string selected(const std::string& options)
+{
+    const SelfTest::ScenarioResult result = SelfTest::runScenario("selection", options);
+    const std::vector<std::string> labels = began(result);
+
+    assertEqual("only the selected suites are constructed",
+            result.linesStartingWith("constructed").size(), labels.size());
+    return joined(labels);
+}
+
+class FilterTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        assertEqual(selected(""),
+                "parser/empty parser/nested lexer/tokens lexer/comments io/read");
+        assertEqual(selected("--filter='parser/*'"), "parser/empty parser/nested");
+        assertEqual(selected("--filter=parser/empty --filter='io/*'"),
+                "parser/empty io/read");
+        assertEqual(selected("--filter='*e?/*s'"), "lexer/tokens lexer/comments");
+        assertEqual(selected("--filter=parser"), "");
+    }
+};
+
+class ExcludeTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        assertEqual(selected("--exclude='lexer/*'"),
+                "parser/empty parser/nested io/read");
+        assertEqual(selected("--filter='parser/*' --exclude='*/nested'"),
+                "parser/empty");
+        assertEqual(selected("--exclude='*'"), "");
+    }
+};
+
+class RegexFilterTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        assertEqual(selected("--filter-regex='^(io|lexer)/'"),
+                "lexer/tokens lexer/comments io/read");
+        assertEqual(selected("--filter-regex=e --exclude-regex='s$'"),
+                "parser/empty parser/nested io/read");
+        assertEqual(selected("--filter='parser/*' --filter-regex=read"),
+                "parser/empty parser/nested io/read");
+    }
+};
+
+class ListTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult result =
+            SelfTest::runScenario("selection", "--list --exclude=parser/nested");
+
+        const char* const expected[] = {
+            "parser/empty", "lexer/tokens", "lexer/comments", "io/read"
+        };
+        assertTrue("the selected labels are listed",
+                result.lines == SelfTest::linesOf(expected));
+    }
+};
+
+class ShardTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const unsigned shardCount = 3;
+        std::vector<std::string> all;
+
+        for (unsigned index = 0; index < shardCount; ++index) {
+            std::ostringstream shard;
+            shard << index << "/" << shardCount;
+
+            const SelfTest::ScenarioResult result =
+                SelfTest::runScenario("selection", "--shard=" + shard.str());
+            const std::vector<std::string> shardLabels = began(result);
+            all.insert(all.end(), shardLabels.begin(), shardLabels.end());
+
+            std::ostringstream done;
+            done << shardLabels.size() << "/" << shardLabels.size() << " 0 0";
+            assertEqual("a shard counts only its suites",
+                    result.lineStartingWith("done "), done.str());
+
+            std::ostringstream environment;
+            environment << "TESTCPP_SHARD_INDEX=" << index
+                << " TESTCPP_SHARD_COUNT=" << shardCount;
+            assertTrue("the environment selects the same shard",
+                    began(SelfTest::runScenario("selection", "",
+                            environment.str())) == shardLabels);
+        }
+
+        std::vector<std::string> expected(labels, labels + labelCount);
+        std::sort(all.begin(), all.end());
+        std::sort(expected.begin(), expected.end());
+        assertTrue("every suite runs in exactly one shard", all == expected);
+    }
+};
+
+}
+
+namespace SelfTest
+{
+
+void addSelectionTests()
+{
+    Test::Controller& controller = Test::Controller::instance();
+    controller.addTestSuite("selection/filter", Test::Suite::instance<FilterTest>);
+    controller.addTestSuite("selection/exclude", Test::Suite::instance<ExcludeTest>);
+    controller.addTestSuite("selection/regex-filter",
+            Test::Suite::instance<RegexFilterTest>);
+    controller.addTestSuite("selection/list", Test::Suite::instance<ListTest>);
+    controller.addTestSuite("selection/shard", Test::Suite::instance<ShardTest>);
+}
+
+bool addSelectionScenario(const std::string& scenario)
+{
+    if (scenario != "selection")
+        return false;
+    for (size_t i = 0; i < labelCount; ++i)
+        Test::Controller::instance().addTestSuite(labels[i],
+                Test::Suite::instance<ConstructedSuite>);
+    return true;
+}
+
+}
@@ -0,0 +1,220 @@
+#include "SelfTest.h"
+
+#include <testcpp/detail/Clock.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include <unistd.h>
+
+namespace SelfTest
+{
+
+const char* const SCENARIO_VARIABLE = "TESTCPP_SELFTEST_SCENARIO";
+const char* const OUTPUT_VARIABLE = "TESTCPP_SELFTEST_OUTPUT";
+
+namespace
+{
+
+std::string programPath;
+
+std::string shellQuoted(const std::string& str)
+{
+    std::string quoted = "'";
+    for (size_t i = 0; i < str.size(); ++i)
+        if (str[i] == '\'')
+            quoted += "'\\''";
+        else
+            quoted += str[i];
+    return quoted + "'";
+}
+
+}
+
+void setProgramPath(const char* path)
+{ programPath = path; }
+
+std::string outputPath()
+{
+    const char* path = std::getenv(OUTPUT_VARIABLE);
+    if (!path)
+        throw std::runtime_error(std::string("The scenario needs ")
+                + OUTPUT_VARIABLE);
+    return path;
+}
+
+TemporaryFile::TemporaryFile() :
+    path()
+{
+    char name[] = "/tmp/testcpp-selftest-XXXXXX";
+    const int fd = mkstemp(name);
+    if (fd < 0)
+        throw std::runtime_error("Cannot create a temporary file");
+    close(fd);
+    path = name;
+}
+
+TemporaryFile::~TemporaryFile()
+{ std::remove(path.c_str()); }
+
+void TemporaryFile::write(const std::string& content) const
+{
+    std::ofstream out(path.c_str(), std::ios::out | std::ios::trunc);
+    out << content;
+}
+
+std::string TemporaryFile::read() const
+{
+    std::ifstream in(path.c_str());
+    std::ostringstream content;
+    content << in.rdbuf();
+    return content.str();
+}
+
+std::string TemporaryFile::outputVariable() const
+{ return std::string(OUTPUT_VARIABLE) + "=" + shellQuoted(path); }
+
+ScenarioObserver::ScenarioObserver() :
+    Test::Observer(),
+    _site()
+{ }
+
+void ScenarioObserver::onTestSuiteBegin(const std::string& testSuiteLabel,
+        int testSuiteNum, int testSuitesNumTotal)
+{
+    std::cout << "begin " << testSuiteNum << "/" << testSuitesNumTotal << " "
+        << testSuiteLabel << std::endl;
+}
+
+void ScenarioObserver::onTestSuiteEnd(int numErrs)
+{ std::cout << "end " << numErrs << std::endl; }
+
+void ScenarioObserver::onTestSuiteEndWithStdException(int numErrs,
+        const std::exception& e)
+{ std::cout << "exception " << numErrs << " " << e.what() << std::endl; }
+
+void ScenarioObserver::onTestSuiteEndWithEllipsisException(int numErrs)
+{ std::cout << "exception " << numErrs << " ..." << std::endl; }
+
+void ScenarioObserver::onAssertBegin(const Test::AssertSite& site)
+{ _site = site; }
+
+void ScenarioObserver::onAssertEnd(bool ok)
+{
+    if (!ok)
+        failed();
+}
+
+void ScenarioObserver::onAssertExceptionEndWithExpectedException(
+        const std::exception&)
+{ }
+
+void ScenarioObserver::onAssertExceptionEndWithUnexpectedException(
+        const std::exception&)
+{ failed(); }
+
+void ScenarioObserver::onAssertExceptionEndWithEllipsisException()
+{ failed(); }
+
+void ScenarioObserver::onAssertNoExceptionEndWithStdException(
+        const std::exception&)
+{ failed(); }
+
+void ScenarioObserver::onAssertNoExceptionEndWithEllipsisException()
+{ failed(); }
+
+void ScenarioObserver::onAllTestSuitesBegin(int testSuitesNumTotal)
+{ std::cout << "all " << testSuitesNumTotal << std::endl; }
+
+void ScenarioObserver::onAllTestSuitesEnd(int lastTestSuiteNum,
+        int testSuitesNumTotal, int numErrs, int numExcepts)
+{
+    std::cout << "done " << lastTestSuiteNum << "/" << testSuitesNumTotal
+        << " " << numErrs << " " << numExcepts << std::endl;
+}
+
+void ScenarioObserver::onAssertFailureDetail(const std::string& detail)
+{ std::cout << "detail " << detail << std::endl; }
+
+void ScenarioObserver::onTestSuiteAllocations(const Test::AllocationStats& stats)
+{
+    std::cout << "allocations " << stats.allocations << " "
+        << stats.leakedAllocations << std::endl;
+}
+
+void ScenarioObserver::failed()
+{
+    // the label of assertions without one is the asserted expression
+    std::cout << "failed " << (_site.label ? _site.label : "") << std::endl;
+}
+
+std::vector<std::string> ScenarioResult::linesStartingWith(
+        const std::string& prefix) const
+{
+    std::vector<std::string> found;
+    for (size_t i = 0; i < lines.size(); ++i)
+        if (lines[i].compare(0, prefix.size(), prefix) == 0)
+            found.push_back(lines[i].substr(prefix.size()));
+    return found;
+}
+
+std::string ScenarioResult::lineStartingWith(const std::string& prefix) const
+{
+    const std::vector<std::string> found = linesStartingWith(prefix);
+    return found.empty() ? std::string() : found.front();
+}
+
+std::vector<std::string> ScenarioResult::linesNotStartingWith(
+        const std::string& prefix) const
+{
+    std::vector<std::string> found;
+    for (size_t i = 0; i < lines.size(); ++i)
+        if (lines[i].compare(0, prefix.size(), prefix) != 0)
+            found.push_back(lines[i]);
+    return found;
+}
+
+std::vector<std::string> linesOf(const std::string& text)
+{
+    std::vector<std::string> lines;
+    std::istringstream in(text);
+    for (std::string line; std::getline(in, line); )
+        lines.push_back(line);
+    return lines;
+}
+
+ScenarioResult runScenario(const std::string& scenario,
+        const std::string& options, const std::string& environment)
+{
+    const std::string command = environment + " " + SCENARIO_VARIABLE + "="
+        + shellQuoted(scenario) + " " + shellQuoted(programPath) + " "
+        + options + " 2>/dev/null";
+
+    ScenarioResult result;
+    const double start = Test::detail::monotonicSeconds();
+
+    FILE* output = popen(command.c_str(), "r");
+    if (!output)
+        throw std::runtime_error("Cannot run scenario " + scenario);
+
+    std::string line;
+    for (int c; (c = std::fgetc(output)) != EOF; )
+        if (c == '\n') {
+            result.lines.push_back(line);
+            line.clear();
+        } else {
+            line += static_cast<char>(c);
+        }
+    if (!line.empty())
+        result.lines.push_back(line);
+
+    pclose(output);
+    result.wallSeconds = Test::detail::monotonicSeconds() - start;
+    return result;
+}
+
+}
@@ -0,0 +1,194 @@
+#ifndef TESTCPP_SELFTEST_H__
+#define TESTCPP_SELFTEST_H__
+
+#include <testcpp/testcpp.h>
+
+#include <string>
+#include <vector>
+
+/**
+ * Behavioral tests of the controller. A test runs the self test program
+ * again with the suites of a scenario and the command line options under
+ * test, and checks the events that the scenario run reported.
+ */
+namespace SelfTest
+{
+
+/** The environment variable that selects the scenario of a run. */
+extern const char* const SCENARIO_VARIABLE;
+
+/**
+ * The environment variable that names the file that scenarios with
+ * file-backed observers write to, see outputPath().
+ */
+extern const char* const OUTPUT_VARIABLE;
+
+/** The file that the observer of the scenario writes to. */
+std::string outputPath();
+
+/** Remembers the program to run the scenarios with. */
+void setProgramPath(const char* path);
+
+/**
+ * The events of a scenario run, one per line:
+ *
+ *   all TOTAL
+ *   begin NUM/TOTAL LABEL
+ *   failed ASSERT_LABEL
+ *   detail FAILURE_DETAIL
+ *   allocations ALLOCATIONS LEAKED
+ *   end ERRS
+ *   exception ERRS WHAT
+ *   done LAST/TOTAL ERRS EXCEPTS
+ */
+class ScenarioObserver : public Test::Observer
+{
+public:
+    ScenarioObserver();
+
+    virtual unsigned subscribedEvents() const
+    { return ASSERT_BEGIN_EVENTS; }
+
+    virtual void onTestSuiteBegin(const std::string& testSuiteLabel,
+            int testSuiteNum, int testSuitesNumTotal);
+    virtual void onTestSuiteEnd(int numErrs);
+    virtual void onTestSuiteEndWithStdException(int numErrs, const std::exception& e);
+    virtual void onTestSuiteEndWithEllipsisException(int numErrs);
+
+    virtual void onAssertBegin(const Test::AssertSite& site);
+    virtual void onAssertEnd(bool ok);
+    virtual void onAssertExceptionEndWithExpectedException(const std::exception&);
+    virtual void onAssertExceptionEndWithUnexpectedException(const std::exception&);
+    virtual void onAssertExceptionEndWithEllipsisException();
+    virtual void onAssertNoExceptionEndWithStdException(const std::exception&);
+    virtual void onAssertNoExceptionEndWithEllipsisException();
+
+    virtual void onAllTestSuitesBegin(int testSuitesNumTotal);
+    virtual void onAllTestSuitesEnd(int lastTestSuiteNum, int testSuitesNumTotal,
+            int numErrs, int numExcepts);
+
+    virtual void onAssertFailureDetail(const std::string& detail);
+    virtual void onTestSuiteAllocations(const Test::AllocationStats& stats);
+
+private:
+    void failed();
+
+    Test::AssertSite _site;
+};
+
+/** A file for a test to write and read, removed with the object. */
+class TemporaryFile
+{
+public:
+    /** Throws std::runtime_error if the file cannot be created. */
+    TemporaryFile();
+    ~TemporaryFile();
+
+    void write(const std::string& content) const;
+    std::string read() const;
+
+    /** OUTPUT_VARIABLE set to the path, for the environment of a scenario. */
+    std::string outputVariable() const;
+
+    std::string path;
+};
+
+/** What a scenario run reported and how long it took. */
+struct ScenarioResult
+{
+    ScenarioResult() :
+        lines(),
+        wallSeconds(0)
+    { }
+
+    /** The lines that start with the prefix, without it. */
+    std::vector<std::string> linesStartingWith(const std::string& prefix) const;
+
+    /** The line that starts with the prefix, without it, "" if none does. */
+    std::string lineStartingWith(const std::string& prefix) const;
+
+    /** The lines that do not start with the prefix. */
+    std::vector<std::string> linesNotStartingWith(const std::string& prefix) const;
+
+    std::vector<std::string> lines;
+    double wallSeconds;
+};
+
+/** The lines of the text, without the line ends. */
+std::vector<std::string> linesOf(const std::string& text);
+
+/**
+ * Runs the scenario with the options, a shell-quoted command line, and the
+ * environment, shell variable assignments like "NAME=value". Throws
+ * std::runtime_error if the program cannot be run.
+ */
+ScenarioResult runScenario(const std::string& scenario,
+        const std::string& options = std::string(),
+        const std::string& environment = std::string());
+
+/** The expected lines of a scenario, to compare with what it reported. */
+template <size_t Count>
+std::vector<std::string> linesOf(const char* const (&lines)[Count])
+{ return std::vector<std::string>(lines, lines + Count); }
+
+typedef bool (*AddScenarioFunction)(const std::string& scenario);
+
+/**
+ * Each test file adds its tests to the controller and the suites of its
+ * scenarios, the latter return false for scenarios of other files. The
+ * scenario observer is set before the suites are added, scenarios that
+ * test another observer replace it.
+ */
+void addAssertionTests();
+bool addAssertionScenario(const std::string& scenario);
+
+void addAssertOverheadTests();
+
+void addAsyncObserverTests();
+bool addAsyncObserverScenario(const std::string& scenario);
+
+void addAsyncTests();
+bool addAsyncScenario(const std::string& scenario);
+
+void addBaselineTests();
+bool addBaselineScenario(const std::string& scenario);
+
+void addBufferedViewTests();
+bool addBufferedViewScenario(const std::string& scenario);
+
+void addDataSuiteTests();
+bool addDataSuiteScenario(const std::string& scenario);
+
+void addFixtureTests();
+bool addFixtureScenario(const std::string& scenario);
+
+void addOrderTests();
+bool addOrderScenario(const std::string& scenario);
+
+void addPerformanceCounterTests();
+bool addPerformanceCounterScenario(const std::string& scenario);
+
+void addPropertyTests();
+bool addPropertyScenario(const std::string& scenario);
+
+void addReportTests();
+bool addReportScenario(const std::string& scenario);
+
+void addRunModeTests();
+bool addRunModeScenario(const std::string& scenario);
+
+void addSelectionTests();
+bool addSelectionScenario(const std::string& scenario);
+
+void addSimdTests();
+bool addSimdScenario(const std::string& scenario);
+
+void addTimeoutTests();
+bool addTimeoutScenario(const std::string& scenario);
+
+void addTimingTests();
+bool addTimingScenario(const std::string& scenario);
+
+}
+
+#endif /* TESTCPP_SELFTEST_H */
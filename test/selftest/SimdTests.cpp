@@ -0,0 +1,338 @@
+#include "SelfTest.h"
+
+#include <testcpp/ArrayAssertions.h>
+
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+
+/** xorshift64*, the same values in every run of the scenario. */
+class Random
+{
+public:
+    explicit Random(unsigned long long seed) :
+        _state(seed)
+    { }
+
+    unsigned long long next()
+    {
+        _state ^= _state >> 12;
+        _state ^= _state << 25;
+        _state ^= _state >> 27;
+        return _state * 2685821657736338717ULL;
+    }
+
+    unsigned below(unsigned limit)
+    { return static_cast<unsigned>(next() % limit); }
+
+    /** Uniform in [-1, 1) scaled by a random power of two. */
+    double value()
+    {
+        const double unit = static_cast<double>(next() >> 11) / 4503599627370496.0 - 1;
+        return std::ldexp(unit, static_cast<int>(below(40)) - 20);
+    }
+
+private:
+    unsigned long long _state;
+};
+
+template <typename T>
+struct Bits;
+
+template <>
+struct Bits<float>
+{ typedef unsigned int Type; };
+
+template <>
+struct Bits<double>
+{ typedef unsigned long long Type; };
+
+/** The value the given number of representable values away from value. */
+template <typename T>
+T stepped(T value, long long steps)
+{
+    typename Bits<T>::Type bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    // steps away from zero on the side of the sign of value
+    bits = static_cast<typename Bits<T>::Type>(bits + steps);
+    std::memcpy(&value, &bits, sizeof(bits));
+    return value;
+}
+
+/** Distance in representable values, counting both zeros as one value. */
+template <typename T>
+unsigned long long ulpDistance(T a, T b)
+{
+    typedef typename Bits<T>::Type Type;
+    const Type sign = Type(1) << (sizeof(Type) * 8 - 1);
+
+    Type x;
+    Type y;
+    std::memcpy(&x, &a, sizeof(x));
+    std::memcpy(&y, &b, sizeof(y));
+
+    // sign and magnitude to an offset from the most negative value
+    x = (x & sign) ? sign - (x & ~sign) : sign + x;
+    y = (y & sign) ? sign - (y & ~sign) : sign + y;
+    return x > y ? x - y : y - x;
+}
+
+/** The closeness rule of Test::Tolerance, element by element. */
+template <typename T>
+bool isCloseReference(T a, T b, const Test::Tolerance& tolerance)
+{
+    if (a == b)
+        return true;
+    if (a != a || b != b || std::fabs(a) == std::numeric_limits<T>::infinity()
+            || std::fabs(b) == std::numeric_limits<T>::infinity())
+        return false;
+
+    // the difference as the kernels compute it, rounded to T
+    const T diff = std::fabs(a - b);
+    if (diff == std::numeric_limits<T>::infinity())
+        return false;
+
+    const T absolute = static_cast<T>(std::min<double>(tolerance.absolute,
+                std::numeric_limits<T>::max()));
+    const T relative = static_cast<T>(tolerance.relative);
+
+    return diff <= absolute
+        || diff <= relative * std::max(std::fabs(a), std::fabs(b))
+        || (tolerance.ulps > 0 && ulpDistance(a, b) <= tolerance.ulps);
+}
+
+/** A pair of elements of a kind that the vector kernels treat specially. */
+template <typename T>
+void makePair(Random& random, const Test::Tolerance& tolerance, T& a, T& b)
+{
+    typedef std::numeric_limits<T> Limits;
+    const T specials[] = {
+        Limits::quiet_NaN(), Limits::infinity(), -Limits::infinity(),
+        T(0), -T(0), Limits::max(), -Limits::max(), Limits::min(),
+        Limits::denorm_min(), -Limits::denorm_min(), T(1), T(-1)
+    };
+    const unsigned specialCount = sizeof(specials) / sizeof(specials[0]);
+
+    a = static_cast<T>(random.value());
+    switch (random.below(8)) {
+    case 0:
+        b = a;
+        break;
+    case 1:
+        a = specials[random.below(specialCount)];
+        b = specials[random.below(specialCount)];
+        break;
+    case 2:
+        b = a;
+        a = specials[random.below(specialCount)];
+        break;
+    case 3: {
+        // around the ulp limit, across powers of two too
+        if (random.below(2))
+            a = std::ldexp(T(random.below(2) ? 1 : -1),
+                    static_cast<int>(random.below(60)) - 30);
+        const long long limit = tolerance.ulps;
+        b = stepped(a, limit - 1 + random.below(3));
+        if (random.below(2))
+            std::swap(a, b);
+        break;
+    }
+    case 4: {
+        // around the relative limit
+        const double factor = 1 + tolerance.relative
+            * (0.99 + 0.02 * random.below(2));
+        b = static_cast<T>(a * factor);
+        break;
+    }
+    case 5: {
+        // around the absolute limit
+        const double offset = tolerance.absolute * (0.99 + 0.02 * random.below(2));
+        b = static_cast<T>(a + offset);
+        break;
+    }
+    case 6:
+        b = stepped(a, random.below(2) ? 1 : -1);
+        break;
+    default:
+        b = static_cast<T>(random.value());
+        break;
+    }
+}
+
+std::string bitsOf(double value)
+{
+    unsigned long long bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    std::ostringstream hex;
+    hex << std::hex << std::setfill('0') << std::setw(16) << bits;
+    return hex.str();
+}
+
+std::string describe(const char* kernel, size_t count,
+        const Test::detail::ArrayMismatches& mismatches, bool withMaxError)
+{
+    std::ostringstream line;
+    line << "kernel " << kernel << " " << count << " " << mismatches.count;
+    for (size_t i = 0; i < mismatches.numIndices(); ++i)
+        line << " " << mismatches.indices[i];
+    if (withMaxError)
+        line << " " << bitsOf(mismatches.maxError);
+    return line.str();
+}
+
+const Test::Tolerance tolerances[] = {
+    Test::Tolerance(),
+    Test::Tolerance::absoluteError(1e-3),
+    Test::Tolerance::relativeError(1e-5),
+    Test::Tolerance::ulpDistance(1),
+    Test::Tolerance::ulpDistance(4),
+    Test::Tolerance::ulpDistance(1000),
+    Test::Tolerance(1e-30, 1e-6, 2)
+};
+
+/** Tail lengths of every vector width, and a few longer arrays. */
+size_t arrayLength(Random& random)
+{
+    return random.below(4) ? random.below(40) : 40 + random.below(200);
+}
+
+/**
+ * Prints the results of the comparison kernels for random arrays, the
+ * self test compares them between the SIMD levels.
+ */
+class SimdKernelsScenario : public Test::Suite
+{
+public:
+    void test()
+    {
+        Random random(0x5eed5eedULL);
+        const size_t toleranceCount = sizeof(tolerances) / sizeof(tolerances[0]);
+
+        for (int run = 0; run < 300; ++run) {
+            const Test::Tolerance& tolerance = tolerances[run % toleranceCount];
+            compareFloatingPoint<float>("float", random, tolerance);
+            compareFloatingPoint<double>("double", random, tolerance);
+            compareBytes(random);
+        }
+    }
+
+private:
+    template <typename T>
+    void compareFloatingPoint(const char* kernel, Random& random,
+            const Test::Tolerance& tolerance)
+    {
+        const size_t count = arrayLength(random);
+        std::vector<T> a(count + 1);
+        std::vector<T> b(count + 1);
+
+        // mostly equal elements, so that whole vectors pass the fast check
+        const bool sparse = random.below(2) != 0;
+        size_t expected = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (sparse && random.below(8)) {
+                a[i] = b[i] = static_cast<T>(random.value());
+            } else {
+                makePair(random, tolerance, a[i], b[i]);
+            }
+            if (!isCloseReference(a[i], b[i], tolerance))
+                ++expected;
+        }
+
+        Test::detail::ArrayMismatches mismatches;
+        compareKernel(&a[0], &b[0], count, tolerance, mismatches);
+        assertEqual("mismatches agree with the tolerance", mismatches.count, expected);
+
+        std::cout << describe(kernel, count, mismatches, true) << std::endl;
+    }
+
+    void compareKernel(const float* a, const float* b, size_t count,
+            const Test::Tolerance& tolerance, Test::detail::ArrayMismatches& mismatches)
+    { Test::detail::compareFloats(a, b, count, tolerance, mismatches); }
+
+    void compareKernel(const double* a, const double* b, size_t count,
+            const Test::Tolerance& tolerance, Test::detail::ArrayMismatches& mismatches)
+    { Test::detail::compareDoubles(a, b, count, tolerance, mismatches); }
+
+    void compareBytes(Random& random)
+    {
+        const size_t elementSizes[] = { 1, 2, 3, 4, 8, 12 };
+        const size_t elementSize = elementSizes[random.below(6)];
+        const size_t count = arrayLength(random);
+
+        std::vector<unsigned char> a(elementSize * count + 1);
+        for (size_t i = 0; i < a.size(); ++i)
+            a[i] = static_cast<unsigned char>(random.next());
+        std::vector<unsigned char> b(a);
+
+        size_t expected = 0;
+        for (size_t i = 0; i < count; ++i)
+            if (random.below(16) == 0) {
+                b[i * elementSize + random.below(static_cast<unsigned>(elementSize))] ^=
+                    static_cast<unsigned char>(1 + random.below(255));
+                ++expected;
+            }
+
+        Test::detail::ArrayMismatches mismatches;
+        Test::detail::compareBytes(&a[0], &b[0], elementSize, count, mismatches);
+        assertEqual("differing elements", mismatches.count, expected);
+
+        std::ostringstream kernel;
+        kernel << "bytes" << elementSize;
+        std::cout << describe(kernel.str().c_str(), count, mismatches, false)
+            << std::endl;
+    }
+};
+
+class SimdAgreementTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult native = SelfTest::runScenario("simd-kernels");
+        const SelfTest::ScenarioResult sse2 =
+            SelfTest::runScenario("simd-kernels", "", "TESTCPP_SIMD=sse2");
+        const SelfTest::ScenarioResult scalar =
+            SelfTest::runScenario("simd-kernels", "", "TESTCPP_SIMD=scalar");
+
+        assertEqual(native.lineStartingWith("done "), "1/1 0 0");
+        assertEqual(sse2.lineStartingWith("done "), "1/1 0 0");
+        assertEqual(scalar.lineStartingWith("done "), "1/1 0 0");
+
+        const std::vector<std::string> expected = scalar.linesStartingWith("kernel ");
+        assertEqual(expected.size(), 900u);
+        assertTrue("native kernels agree with scalar",
+                native.linesStartingWith("kernel ") == expected);
+        assertTrue("SSE2 kernels agree with scalar",
+                sse2.linesStartingWith("kernel ") == expected);
+    }
+};
+
+}
+
+namespace SelfTest
+{
+
+void addSimdTests()
+{
+    Test::Controller::instance().addTestSuite("simd/agreement",
+            Test::Suite::instance<SimdAgreementTest>);
+}
+
+bool addSimdScenario(const std::string& scenario)
+{
+    if (scenario != "simd-kernels")
+        return false;
+    Test::Controller::instance().addTestSuite("simd/kernels",
+            Test::Suite::instance<SimdKernelsScenario>);
+    return true;
+}
+
+}
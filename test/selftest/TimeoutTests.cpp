@@ -0,0 +1,209 @@
+#include "SelfTest.h"
+
+#include <testcpp/TestCases.h>
+
+#include <iostream>
+
+#include <unistd.h>
+
+namespace
+{
+
+void sleepSeconds(double seconds)
+{ usleep(static_cast<useconds_t>(seconds * 1e6)); }
+
+class SlowCases
+{
+public:
+    TESTCPP_TYPEDEFS(SlowCases)
+
+    void testHang()
+    {
+        assertTrue("before hanging", true);
+        sleepSeconds(10);
+    }
+
+    void testSlow()
+    { sleepSeconds(0.2); }
+
+    void testWorker()
+    { std::cout << "pid " << getpid() << std::endl; }
+};
+
+const Test::TestCase<SlowCases> hangingCases[] = {
+    { "hang", &SlowCases::testHang },
+    { "after", &SlowCases::testWorker }
+};
+
+const Test::TestCase<SlowCases> slowCases[] = {
+    { "first", &SlowCases::testSlow },
+    { "second", &SlowCases::testSlow },
+    { "third", &SlowCases::testSlow }
+};
+
+/** Hangs when a suite ends, parallel runs hold the observer lock meanwhile. */
+class HangingObserver : public SelfTest::ScenarioObserver
+{
+public:
+    virtual void onTestSuiteEnd(int numErrs)
+    {
+        SelfTest::ScenarioObserver::onTestSuiteEnd(numErrs);
+        sleepSeconds(10);
+    }
+};
+
+bool contains(const std::string& str, const std::string& part)
+{ return str.find(part) != std::string::npos; }
+
+#ifdef TESTCPP_HAVE_THREADS
+class SuiteTimeoutTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        // the watchdog reports the run so far and ends the process
+        const SelfTest::ScenarioResult result =
+            SelfTest::runScenario("hanging", "--timeout=0.3");
+        assertTrue("the hanging suite is not waited for", result.wallSeconds < 5);
+
+        const std::vector<std::string> lines =
+            result.linesNotStartingWith("allocations ");
+        assertEqual(lines.size(), 4u);
+        if (lines.size() != 4)
+            return;
+        assertEqual(lines[0], "all 2");
+        assertEqual(lines[1], "begin 1/2 hanging/hang");
+        assertTrue("the hanging suite times out", contains(lines[2],
+                    "exception 0 Test suite timed out after 0.3 seconds, "
+                    "the last assertion began at "));
+        assertEqual(lines[3], "done 1/2 0 1");
+    }
+};
+
+class ParallelSuiteTimeoutTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult result =
+            SelfTest::runScenario("hanging", "--timeout=0.3 --jobs=2");
+        assertTrue("the hanging suite is not waited for", result.wallSeconds < 5);
+
+        // the other suite ended on a thread of its own
+        assertEqual(result.lineStartingWith("done "), "2/2 0 1");
+        assertEqual(result.linesStartingWith("begin ").size(), 2u);
+        assertTrue("the hanging suite times out",
+                contains(result.lineStartingWith("exception "),
+                    "Test suite timed out after 0.3 seconds"));
+    }
+};
+
+class RunTimeoutTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult result =
+            SelfTest::runScenario("slow", "--run-timeout=0.3");
+
+        const std::vector<std::string> begins = result.linesStartingWith("begin ");
+        assertEqual(begins.size(), 2u);
+        assertTrue("the suite that runs at the deadline times out",
+                contains(result.lineStartingWith("exception "),
+                    "0 Test run timed out after 0.3 seconds before any "
+                    "assertion began"));
+        assertEqual(result.lineStartingWith("done "), "2/3 0 1");
+
+        const SelfTest::ScenarioResult inTime =
+            SelfTest::runScenario("slow", "--run-timeout=5 --timeout=1");
+        assertEqual(inTime.lineStartingWith("done "), "3/3 0 0");
+    }
+};
+
+class HangingObserverTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        // the results are in use by the observer and cannot be reported
+        const SelfTest::ScenarioResult result = SelfTest::runScenario(
+                "hanging-observer", "--jobs=2 --run-timeout=0.3");
+        assertTrue("the hanging observer is not waited for", result.wallSeconds < 5);
+        assertEqual(result.linesStartingWith("end ").size(), 1u);
+        assertEqual(result.lineStartingWith("done "), "");
+    }
+};
+#endif
+
+class IsolatedTimeoutTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const SelfTest::ScenarioResult result =
+            SelfTest::runScenario("hanging", "--isolate --timeout=0.3");
+
+        assertEqual(result.lineStartingWith("done "), "2/2 0 1");
+        assertTrue("the hanging worker is killed", result.wallSeconds < 5);
+
+        const std::string exception = result.lineStartingWith("exception ");
+        assertTrue("the hanging suite times out",
+                contains(exception, "timed out after 0.3 seconds"));
+        assertEqual(result.linesStartingWith("pid ").size(), 1u);
+    }
+};
+
+class TimeoutOptionsTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        const char* const invalid[] = {
+            "--timeout=nan", "--timeout=inf", "--timeout=-1", "--timeout=",
+            "--run-timeout=nan", "--run-timeout=1e400"
+        };
+        for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i)
+            assertEqual(invalid[i],
+                    SelfTest::runScenario("slow", invalid[i]).lineStartingWith("all "),
+                    "");
+    }
+};
+
+}
+
+namespace SelfTest
+{
+
+void addTimeoutTests()
+{
+    Test::Controller& controller = Test::Controller::instance();
+#ifdef TESTCPP_HAVE_THREADS
+    controller.addTestSuite("timeouts/suite", Test::Suite::instance<SuiteTimeoutTest>);
+    controller.addTestSuite("timeouts/parallel-suite",
+            Test::Suite::instance<ParallelSuiteTimeoutTest>);
+    controller.addTestSuite("timeouts/run", Test::Suite::instance<RunTimeoutTest>);
+    controller.addTestSuite("timeouts/hanging-observer",
+            Test::Suite::instance<HangingObserverTest>);
+#endif
+    controller.addTestSuite("timeouts/isolated",
+            Test::Suite::instance<IsolatedTimeoutTest>);
+    controller.addTestSuite("timeouts/options",
+            Test::Suite::instance<TimeoutOptionsTest>);
+}
+
+bool addTimeoutScenario(const std::string& scenario)
+{
+    if (scenario == "hanging") {
+        Test::addTestCases("hanging", hangingCases);
+    } else if (scenario == "slow") {
+        Test::addTestCases("slow", slowCases);
+    } else if (scenario == "hanging-observer") {
+        Test::addTestCases("slow", slowCases);
+        Test::Controller::instance().setObserver(new HangingObserver);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+}
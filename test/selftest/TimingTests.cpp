@@ -0,0 +1,196 @@
+#include "SelfTest.h"
+
+#include <testcpp/TimingObserver.h>
+
+#include <cstdlib>
+
+#include <unistd.h>
+
+namespace
+{
+
+void sleepSeconds(double seconds)
+{ usleep(static_cast<useconds_t>(seconds * 1e6)); }
+
+class FastSuite : public Test::Suite
+{
+public:
+    void test()
+    { }
+};
+
+class SlowSuite : public Test::Suite
+{
+public:
+    void test()
+    { sleepSeconds(0.05); }
+};
+
+class SlowerSuite : public Test::Suite
+{
+public:
+    void test()
+    { sleepSeconds(0.1); }
+};
+
+class AssertingSuite : public Test::Suite
+{
+public:
+    TESTCPP_TYPEDEFS(AssertingSuite)
+
+    void test()
+    {
+        assertTrue("quick", true);
+        assertWontThrow("sleeps", sleep);
+        assertTrue("quick again", true);
+    }
+
+    void sleep()
+    { sleepSeconds(0.02); }
+};
+
+/** Writes the suite durations once the run has ended. */
+class DurationsObserver : public Test::TimingObserver
+{
+public:
+    DurationsObserver(size_t slowestCount, bool timeAssertions) :
+        Test::TimingObserver(new SelfTest::ScenarioObserver, slowestCount,
+                timeAssertions)
+    { }
+
+    virtual void onAllTestSuitesEnd(int lastTestSuiteNum,
+            int testSuitesNumTotal, int numErrs, int numExcepts)
+    {
+        Test::TimingObserver::onAllTestSuitesEnd(lastTestSuiteNum,
+                testSuitesNumTotal, numErrs, numExcepts);
+        writeDurations(SelfTest::outputPath());
+    }
+};
+
+bool endsWith(const std::string& str, const std::string& end)
+{
+    return str.size() >= end.size()
+        && str.compare(str.size() - end.size(), end.size(), end) == 0;
+}
+
+/** The report lines, from the slowest suites header on. */
+std::vector<std::string> report(const SelfTest::ScenarioResult& result)
+{
+    std::vector<std::string>::const_iterator begin = result.lines.begin();
+    while (begin != result.lines.end() && begin->compare(0, 8, "Slowest ") != 0)
+        ++begin;
+    std::vector<std::string>::const_iterator end = begin;
+    while (end != result.lines.end() && end->compare(0, 5, "done ") != 0)
+        ++end;
+    return std::vector<std::string>(begin, end);
+}
+
+class SlowestSuitesTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        SelfTest::TemporaryFile durations;
+        const SelfTest::ScenarioResult result = SelfTest::runScenario(
+                "timing", "", durations.outputVariable());
+        assertEqual(result.lineStartingWith("done "), "4/4 0 0");
+
+        // the slowest suites, then the slowest assertions
+        const std::vector<std::string> lines = report(result);
+        assertEqual(lines.size(), 6u);
+        if (lines.size() != 6)
+            return;
+
+        assertEqual(lines[0].compare(0, 28, "Slowest 2 of 4 test suites ("), 0);
+        assertTrue("slowest first", endsWith(lines[1], "\tslower"));
+        assertTrue("then the next slowest", endsWith(lines[2], "\tslow"));
+
+        assertEqual(lines[3], "Slowest 2 assertions:");
+        assertTrue("the sleeping assertion is the slowest",
+                endsWith(lines[4], "'sleeps'")
+                && lines[4].find("assertWontThrow at ") != std::string::npos);
+        const double microseconds = std::atof(lines[4].c_str());
+        assertTrue("the assertion is timed", microseconds >= 20000);
+    }
+};
+
+class WriteDurationsTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        SelfTest::TemporaryFile durations;
+        SelfTest::runScenario("timing", "", durations.outputVariable());
+
+        // one "label<TAB>seconds" line per suite, in the order they ended
+        const std::vector<std::string> lines = SelfTest::linesOf(durations.read());
+        const char* const labels[] = { "fast", "slow", "slower", "asserting" };
+        const double least[] = { 0, 0.05, 0.1, 0.02 };
+        assertEqual(lines.size(), 4u);
+        for (size_t i = 0; i < lines.size() && i < 4; ++i) {
+            const size_t tab = lines[i].find('\t');
+            assertEqual(lines[i].substr(0, tab), labels[i]);
+            assertTrue(labels[i], tab != std::string::npos
+                    && std::atof(lines[i].c_str() + tab + 1) >= least[i]);
+        }
+    }
+};
+
+class UntimedAssertionsTest : public Test::Suite
+{
+public:
+    void test()
+    {
+        SelfTest::TemporaryFile durations;
+        const SelfTest::ScenarioResult result = SelfTest::runScenario(
+                "timing-untimed-assertions", "", durations.outputVariable());
+
+        const std::vector<std::string> lines = report(result);
+        assertEqual(lines.size(), 5u);
+        if (lines.empty())
+            return;
+        assertEqual(lines[0].compare(0, 28, "Slowest 4 of 4 test suites ("), 0);
+        assertEqual(result.lineStartingWith("Slowest 2 assertions"), "");
+    }
+};
+
+void addTimingSuites()
+{
+    Test::Controller& controller = Test::Controller::instance();
+    controller.addTestSuite("fast", Test::Suite::instance<FastSuite>);
+    controller.addTestSuite("slow", Test::Suite::instance<SlowSuite>);
+    controller.addTestSuite("slower", Test::Suite::instance<SlowerSuite>);
+    controller.addTestSuite("asserting", Test::Suite::instance<AssertingSuite>);
+}
+
+}
+
+namespace SelfTest
+{
+
+void addTimingTests()
+{
+    Test::Controller& controller = Test::Controller::instance();
+    controller.addTestSuite("timing/slowest-suites",
+            Test::Suite::instance<SlowestSuitesTest>);
+    controller.addTestSuite("timing/write-durations",
+            Test::Suite::instance<WriteDurationsTest>);
+    controller.addTestSuite("timing/untimed-assertions",
+            Test::Suite::instance<UntimedAssertionsTest>);
+}
+
+bool addTimingScenario(const std::string& scenario)
+{
+    if (scenario == "timing") {
+        addTimingSuites();
+        Test::Controller::instance().setObserver(new DurationsObserver(2, true));
+    } else if (scenario == "timing-untimed-assertions") {
+        addTimingSuites();
+        Test::Controller::instance().setObserver(new DurationsObserver(10, false));
+    } else {
+        return false;
+    }
+    return true;
+}
+
+}
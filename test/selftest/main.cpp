@@ -0,0 +1,102 @@
+#include "SelfTest.h"
+
+#include <testcpp/StdOutView.h>
+
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+/** run() only returns the errors, suites that throw fail the self test too. */
+class ExceptionCountingView : public Test::ColoredStdOutView
+{
+public:
+    ExceptionCountingView() :
+        Test::ColoredStdOutView(),
+        _numExcepts(0)
+    { }
+
+    virtual void onAllTestSuitesEnd(int lastTestSuiteNum,
+            int testSuitesNumTotal, int numErrs, int numExcepts)
+    {
+        _numExcepts = numExcepts;
+        Test::ColoredStdOutView::onAllTestSuitesEnd(lastTestSuiteNum,
+                testSuitesNumTotal, numErrs, numExcepts);
+    }
+
+    int numExcepts() const
+    { return _numExcepts; }
+
+private:
+    int _numExcepts;
+};
+
+const SelfTest::AddScenarioFunction addScenarioFunctions[] = {
+    &SelfTest::addAssertionScenario,
+    &SelfTest::addAsyncObserverScenario,
+    &SelfTest::addAsyncScenario,
+    &SelfTest::addBaselineScenario,
+    &SelfTest::addBufferedViewScenario,
+    &SelfTest::addDataSuiteScenario,
+    &SelfTest::addFixtureScenario,
+    &SelfTest::addOrderScenario,
+    &SelfTest::addPerformanceCounterScenario,
+    &SelfTest::addPropertyScenario,
+    &SelfTest::addReportScenario,
+    &SelfTest::addRunModeScenario,
+    &SelfTest::addSelectionScenario,
+    &SelfTest::addSimdScenario,
+    &SelfTest::addTimeoutScenario,
+    &SelfTest::addTimingScenario
+};
+
+bool addScenario(const std::string& scenario)
+{
+    const size_t count = sizeof(addScenarioFunctions) / sizeof(addScenarioFunctions[0]);
+    for (size_t i = 0; i < count; ++i)
+        if (addScenarioFunctions[i](scenario))
+            return true;
+    return false;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    SelfTest::setProgramPath(argv[0]);
+    Test::Controller& controller = Test::Controller::instance();
+
+    if (const char* scenario = std::getenv(SelfTest::SCENARIO_VARIABLE)) {
+        controller.setObserver(new SelfTest::ScenarioObserver);
+        if (!addScenario(scenario)) {
+            std::cerr << "Unknown scenario " << scenario << std::endl;
+            return EXIT_FAILURE;
+        }
+        return controller.run(argc, argv);
+    }
+
+    SelfTest::addAssertionTests();
+    SelfTest::addAssertOverheadTests();
+    SelfTest::addAsyncObserverTests();
+    SelfTest::addAsyncTests();
+    SelfTest::addBaselineTests();
+    SelfTest::addBufferedViewTests();
+    SelfTest::addDataSuiteTests();
+    SelfTest::addFixtureTests();
+    SelfTest::addOrderTests();
+    SelfTest::addPerformanceCounterTests();
+    SelfTest::addPropertyTests();
+    SelfTest::addReportTests();
+    SelfTest::addRunModeTests();
+    SelfTest::addSelectionTests();
+    SelfTest::addSimdTests();
+    SelfTest::addTimeoutTests();
+    SelfTest::addTimingTests();
+
+    ExceptionCountingView* view = new ExceptionCountingView;
+    controller.setObserver(view);
+
+    const int numErrs = controller.run(argc, argv);
+    return numErrs > 0 || view->numExcepts() > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -118,7 +118,7 @@ private:
     Object _object;
 };
 
-int main()
+int main(int argc, char* argv[])
 {
     // Example of running tests outside of a suite.
     // Controller initializes the StdOutView observer by default.
@@ -133,7 +133,8 @@ int main()
 
     c.addTestSuite("testsuite1", Test::Suite::instance<TestSuite1>);
 
-    int numErrors = c.run();
+    // Forward the arguments to support --filter, --list etc.
+    int numErrors = c.run(argc, argv);
 
 #ifdef ASK_FOR_PRESS_ENTER_BEFORE_EXIT
     std::cout << "Press ENTER to exit" << std::endl;